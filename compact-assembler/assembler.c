@@ -20,7 +20,7 @@
 //========================================================================================
 
 #define SOURCE_LINE_MAX 256
-#define BASE_ADDRESS 0x00400000 // endereço base para o onde começa o bloco das palavras na memoria
+#define BASE_ADDRESS 0x00400000 // endereço padrão onde começa o bloco das palavras (--base troca)
 #define ST_INITIAL_CAPACITY 8
 #define ENCODING_ERROR_SENTINEL 0xFFFFFFFF 
 
@@ -251,13 +251,16 @@ static inline void symbol_table_add(symbol_table_t* table, const char* label, ui
     table->count++;
 }
 
-// busca uma label, retorna o endereço. Se não encontrar, retorna -1 (0xFFFFFFFF)
-static inline int32_t symbol_table_lookup(const symbol_table_t* table, const char* label) {
+// busca uma label e coloca o endereço em 'address'. retorna false se não encontrar
+// (o -1 de antes não dava para separar de uma label em 0xFFFFFFFF)
+static inline bool symbol_table_lookup(const symbol_table_t* table, const char* label, uint32_t* address) {
     for (size_t i = 0; i < table->count; ++i) {
-        if (strcmp(table->entries[i].label, label) == 0)
-            return table->entries[i].address;
+        if (strcmp(table->entries[i].label, label) == 0) {
+            *address = table->entries[i].address;
+            return true;
+        }
     }
-    return -1;  // (talvez fazer códigos especiais de erro, mas isso dai vai ficar para o yago do futuro)
+    return false;
 }
 
 // debug: imprime todos os símbolos
@@ -564,8 +567,8 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
             rs1 = get_register_number(parsed_inst->operands[0]);
             rs2 = get_register_number(parsed_inst->operands[1]);
             
-            int32_t target_addr_b = symbol_table_lookup(symbols, parsed_inst->operands[2]);
-            if (target_addr_b == -1 && strcmp(parsed_inst->operands[2], "-1") != 0) { // checa se label não foi encontrado
+            uint32_t target_addr_b;
+            if (!symbol_table_lookup(symbols, parsed_inst->operands[2], &target_addr_b)) { // checa se label não foi encontrado
                 
                 // tentar fazer o parser como imediato (offset direto)
                 imm_val = parse_immediate(parsed_inst->operands[2], &imm_success);
@@ -575,7 +578,7 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
                 }
                 // se for um offset direto, ele já é o imm_val
             } else {
-                 imm_val = target_addr_b - (int32_t)current_address; // offset relativo ao PC
+                 imm_val = (int32_t)(target_addr_b - current_address); // offset relativo ao PC
             }
 
 
@@ -638,15 +641,15 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
                 label_str_j = parsed_inst->operands[0];
             }
 
-            int32_t target_addr_j = symbol_table_lookup(symbols, label_str_j);
-             if (target_addr_j == -1 && strcmp(label_str_j, "-1") != 0) {
+            uint32_t target_addr_j;
+            if (!symbol_table_lookup(symbols, label_str_j, &target_addr_j)) {
                 imm_val = parse_immediate(label_str_j, &imm_success);
                 if (!imm_success) {
                     fprintf(stderr, "erro (linha %u): label '%s' nao encontrado e nao e um offset valido para '%s'.\n", parsed_inst->line_number, label_str_j, entry->mnemonic);
                     return ENCODING_ERROR_SENTINEL;
                 }
             } else {
-                imm_val = target_addr_j - (int32_t)current_address;
+                imm_val = (int32_t)(target_addr_j - current_address);
             }
 
             if (rd == -1) {
@@ -737,8 +740,8 @@ static inline instruction_t parse_line(const char* line, uint32_t line_number) {
     return inst;
 }
 
-// parse um vetor de linhas em vetor de instruções
-static inline instruction_t* parse_lines(char** lines, size_t line_count, size_t* out_count, symbol_table_t* table) {
+// parse um vetor de linhas em vetor de instruções, a primeira em 'base'
+static inline instruction_t* parse_lines(char** lines, size_t line_count, uint32_t base, size_t* out_count, symbol_table_t* table) {
     instruction_t* instructions = malloc(line_count * sizeof(instruction_t));
     CHECK_ALLOC(instructions, return NULL);
 
@@ -756,7 +759,7 @@ static inline instruction_t* parse_lines(char** lines, size_t line_count, size_t
         }
 
         instruction_t inst = parse_line(line, (uint32_t)i + 1);
-        inst.address = BASE_ADDRESS + 4 * count;
+        inst.address = base + 4 * (uint32_t)count;
 
         // se havia uma label pendente
         if (pending_label) {
@@ -775,7 +778,7 @@ static inline instruction_t* parse_lines(char** lines, size_t line_count, size_t
 
     // se sobrou uma label no final
     if (pending_label) {
-        symbol_table_add(table, pending_label, BASE_ADDRESS + 4 * count);
+        symbol_table_add(table, pending_label, base + 4 * (uint32_t)count);
         free(pending_label);
     }
 
@@ -818,19 +821,52 @@ static inline void free_instructions(instruction_t* instructions, size_t count)
 
 
 
+// numero com sufixo opcional k/m (ex: 0x1000, 64k)
+static inline int parse_size(const char* text, uint32_t* out) {
+    char* end;
+    unsigned long long value = strtoull(text, &end, 0);
+    if (end == text) return -1;
+    if (*end == 'k' || *end == 'K') { value <<= 10; end++; }
+    else if (*end == 'm' || *end == 'M') { value <<= 20; end++; }
+    if (*end != '\0' || value > UINT32_MAX) return -1;
+    *out = (uint32_t)value;
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 2 || argc > 3) {
-        fprintf(stderr, "uso: %s <arquivo_assembly.asm> [arquivo_saida.mif]\n", argv[0]);
+    // arquivos
+    const char* files[2] = {NULL, NULL};
+    int file_count = 0;
+    uint32_t base_address = BASE_ADDRESS;
+    uint32_t memory_size = 0; // 0 = sem limite
+
+    // a memoria da placa: onde o programa começa e quanto cabe (uma placa por rodada, sem recompilar)
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "--base") == 0 || strcmp(argv[i], "--size") == 0) && i + 1 < argc) {
+            uint32_t* target = argv[i][2] == 'b' ? &base_address : &memory_size;
+            if (parse_size(argv[i + 1], target) != 0 || (target == &base_address && base_address % 4 != 0)) {
+                fprintf(stderr, "erro: valor '%s' invalido para %s.\n", argv[i + 1], argv[i]);
+                return EXIT_FAILURE;
+            }
+            i++;
+        } else if (argv[i][0] != '-' && file_count < 2) {
+            files[file_count++] = argv[i];
+        } else {
+            file_count = 0;
+            break;
+        }
+    }
+    if (file_count == 0) {
+        fprintf(stderr, "uso: %s <arquivo_assembly.asm> [arquivo_saida.mif] [--base <end>] [--size <bytes>]\n", argv[0]);
         return EXIT_FAILURE;
     }
 
-    // arquivos
-    const char* input_filename = argv[1];
+    const char* input_filename = files[0];
     char output_mif_filename[256];
 
     // para o caso que o arquivo é passado como parametro ou nao
-    if (argc == 3) {
-        strncpy(output_mif_filename, argv[2], sizeof(output_mif_filename) - 1);
+    if (files[1]) {
+        strncpy(output_mif_filename, files[1], sizeof(output_mif_filename) - 1);
         output_mif_filename[sizeof(output_mif_filename) - 1] = '\0';
     } else {
         strcpy(output_mif_filename, "memoria.mif");
@@ -857,7 +893,7 @@ int main(int argc, char *argv[]) {
 
     // faz o parser das linhas (talvez eu deveria ter feito um tokenizer, mas n sei bem onde)
     // aqui gera uma lista (vetor) de instruções
-    instructions = parse_lines(lines, line_count, &instruction_arr_count, &sym_table);
+    instructions = parse_lines(lines, line_count, base_address, &instruction_arr_count, &sym_table);
     
     // verificação para caso as instruções dê errado 
     // (talvez trocar essas coisas repetitivas por macros depois)
@@ -872,6 +908,19 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    // programa maior que a memoria da placa não vira mif
+    uint64_t program_size = (uint64_t)instruction_arr_count * 4;
+    if (memory_size && program_size > memory_size) {
+        fprintf(stderr, "erro: programa tem %llu bytes e a memoria (0x%08x, --size) so %u, passou %llu byte(s).\n",
+                (unsigned long long)program_size, base_address, memory_size, (unsigned long long)(program_size - memory_size));
+        for (size_t i = 0; i < line_count; ++i)
+            free(lines[i]);
+        free(lines);
+        free_instructions(instructions, instruction_arr_count);
+        symbol_table_free(&sym_table);
+        return EXIT_FAILURE;
+    }
+
     // finalmente abre o mif para a saida em modo de escrita
     mif_file = fopen(output_mif_filename, "w");
 
@@ -0,0 +1,369 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include "types.h"
+#include "utils.h"
+#include "output.h" // MIF_PRINT_BYTES_BIG_ENDIAN
+#include "sim.h"    // padrões do --run
+#include "hazard.h" // modelos de forwarding
+#include "diag.h"   // formato dos diagnosticos
+#include "map.h"    // formato do --map
+#include "regions.h" // --layout/--region
+#include "verify.h"  // --verify
+
+// modo de operação
+typedef enum {
+    MODE_ASSEMBLE,           // .asm -> .mif (padrão)
+    MODE_OBJECT,             // .asm -> objeto relocavel (-c)
+    MODE_LINK,               // varios objetos -> .mif (--link)
+    MODE_DISASM,             // .mif/binario -> assembly (-d)
+    MODE_RUN,                // .asm -> simulador, sem gravar saida (--run)
+    MODE_VERIFY,             // .asm -> compara com um mif de referencia, sem gravar saida (--verify)
+    MODE_SERVE,              // servidor em unix socket (--serve)
+    MODE_LSP                 // language server no stdin/stdout (--lsp)
+} RUN_MODE;
+
+// opções da linha de comando
+typedef struct {
+    RUN_MODE mode;
+    const char* input_filename;     // primeiro arquivo de entrada
+    const char** inputs;            // todos os arquivos de entrada (aponta para argv)
+    int input_count;
+    char output_filename[256];
+    char data_output_filename[256]; // mif da seção .data
+    int output_given;               // se a saida foi passada (-o ou segundo argumento)
+    const char* listing_filename;   // arquivo .lst (NULL se não pediu)
+    int verbose;                    // imprime a tabela da segunda passagem no stdout
+    int elf;                        // saida em ELF32 (relocavel com -c, executavel no resto)
+    int compress;                   // usa instruções de 16 bits (RV32C) quando couber
+    uint32_t base_address;          // endereço da primeira palavra no -d
+    int big_endian;                 // -d: ordem das linhas/bytes de cada palavra
+    uint32_t sim_memory;            // --run: bytes de RAM a partir de 0x10000000 (sem região para o .data)
+    uint64_t sim_max_steps;         // --run: limite de instruções (0 = sem limite)
+    const char* profile_filename;   // --profile: relatorio de contagens (implica --run)
+    const char* stacks_filename;    // --profile-stacks: pilhas colapsadas para flamegraph
+    const char* hazards_filename;   // --hazards: analise do pipeline ("-" = stdout)
+    const char* map_filename;       // --map: simbolos por endereço com referencias ("-" = stdout)
+    MAP_FORMAT map_format;          // --map-format text|csv
+    memory_layout_t layout;         // --layout/--region: regiões de memoria (count 0 = endereços padrão)
+    const char* verify_filename;    // --verify: mif de referencia do .text
+    size_t verify_max;              // --verify-max: diferenças mostradas (0 = todas)
+    hazard_model_t hazard_model;    // --forwarding / --branch-penalty
+    int schedule;                   // reordena instruções dentro dos blocos para esconder stalls
+    int peephole;                   // remove instruções inuteis logo depois do parse
+    DIAG_FORMAT diag_format;        // --diagnostics text|json
+    size_t max_errors;              // --max-errors: quantos diagnosticos imprimir (0 = todos)
+    const char* server_path;        // --serve: caminho do unix socket
+    unsigned server_threads;        // --threads: tamanho do pool (0 = um por cpu)
+} options_t;
+
+static inline void print_usage(const char* prog) {
+    fprintf(stderr, "uso: %s <arquivo_assembly.asm> [arquivo_saida.mif] [opcoes]\n", prog);
+    fprintf(stderr, "     %s -c <arquivo_assembly.asm> [-o arquivo.o]\n", prog);
+    fprintf(stderr, "     %s --link <arquivo.o>... [-o arquivo_saida.mif]\n", prog);
+    fprintf(stderr, "     %s -d <arquivo.mif|arquivo.bin> [-o saida.asm] [--base <end>] [--endian big|little]\n", prog);
+    fprintf(stderr, "     %s --run <arquivo_assembly.asm> [--mem <bytes>] [--max-steps <n>]\n", prog);
+    fprintf(stderr, "     %s --verify <referencia.mif> <arquivo_assembly.asm> [--verify-max <n>]\n", prog);
+    fprintf(stderr, "opcoes:\n");
+    fprintf(stderr, "  -o <arq>               arquivo de saida\n");
+    fprintf(stderr, "  -c                     gera objeto relocavel em vez do mif\n");
+    fprintf(stderr, "  --link                 liga objetos gerados com -c em um mif\n");
+    fprintf(stderr, "  --data-out <arq>       mif da secao .data (padrao: <saida>_data.mif)\n");
+    fprintf(stderr, "  --elf                  saida em ELF32 RISC-V (relocavel com -c, executavel sem)\n");
+    fprintf(stderr, "  -d, --disasm           disassembla um mif (8/16/32 bits por linha) ou binario cru\n");
+    fprintf(stderr, "  --base <end>           endereco da primeira palavra no -d (padrao: 0x%08x)\n", BASE_ADDRESS);
+    fprintf(stderr, "  --endian big|little    ordem das partes de cada palavra no -d (padrao: a do mif gerado)\n");
+    fprintf(stderr, "  --run                  monta e executa no simulador embutido (nao grava o mif)\n");
+    fprintf(stderr, "  --mem <bytes>          RAM do simulador a partir de 0x10000000, aceita k/m (padrao: 4m).\n");
+    fprintf(stderr, "                         com o .data numa regiao do --layout a RAM e a propria regiao\n");
+    fprintf(stderr, "  --max-steps <n>        para depois de n instrucoes, 0 = sem limite (padrao: %llu)\n",
+            (unsigned long long)SIM_DEFAULT_MAX_STEPS);
+    fprintf(stderr, "  --profile <arq>        com --run: contagem por instrucao, por label e branches tomados\n");
+    fprintf(stderr, "  --profile-stacks <arq> com --run: pilhas colapsadas (flamegraph.pl, speedscope)\n");
+    fprintf(stderr, "  --hazards <arq>        estimativa de ciclos por bloco basico num pipeline de 5 estagios (- = stdout)\n");
+    fprintf(stderr, "  --forwarding full|mem|none  modelo de forwarding do --hazards (padrao: full)\n");
+    fprintf(stderr, "  --branch-penalty <n>   ciclos perdidos num desvio tomado (padrao: %d)\n", HAZARD_DEFAULT_BRANCH_PENALTY);
+    fprintf(stderr, "  --schedule             reordena instrucoes independentes dentro de cada bloco basico\n");
+    fprintf(stderr, "                         para esconder stalls de load-use (usa o modelo do --forwarding)\n");
+    fprintf(stderr, "  --peephole             remove addi x, x, 0, escritas em zero e desvios para a proxima instrucao\n");
+    fprintf(stderr, "  --compress             usa instrucoes comprimidas RV32C quando os operandos cabem\n");
+    fprintf(stderr, "  --diagnostics text|json  formato dos erros e avisos no stderr (padrao: text)\n");
+    fprintf(stderr, "  --max-errors <n>       imprime no maximo n erros/avisos, 0 = todos (padrao: 0)\n");
+    fprintf(stderr, "  --serve <socket>       servidor: recebe fontes por um unix socket e responde json (ver server.h)\n");
+    fprintf(stderr, "  --threads <n>          com --serve: threads atendendo conexoes (padrao: uma por cpu)\n");
+    fprintf(stderr, "  --lsp                  language server no stdin/stdout (definicao, referencias, erros ao vivo)\n");
+    fprintf(stderr, "  -v, --verbose          imprime a tabela endereco/codigo/mnemonico no stdout\n");
+    fprintf(stderr, "  -l, --listing <arq>    gera um arquivo de listagem (.lst)\n");
+    fprintf(stderr, "  --map <arq>            simbolos por endereco com tamanho, linha e quem usa cada um (- = stdout)\n");
+    fprintf(stderr, "  --map-format text|csv  formato do --map (padrao: text)\n");
+    fprintf(stderr, "  --layout <arq>         regioes de memoria da placa, uma por linha: nome origem tamanho secoes\n");
+    fprintf(stderr, "                         (ex: 'rom 0x0 64k .text'). cada regiao vira <saida>_<nome>.mif\n");
+    fprintf(stderr, "  --region <n,o,t,s...>  uma regiao pela linha de comando (ex: ram,0x20000000,16k,.data)\n");
+    fprintf(stderr, "  --verify <arq.mif>     monta e compara o .text palavra por palavra com um mif (8/16/32 bits,\n");
+    fprintf(stderr, "                         ordem do --endian), sem gravar saida. sai com erro se diferir\n");
+    fprintf(stderr, "  --verify-max <n>       diferencas mostradas com disassembly, 0 = todas (padrao: %d)\n", VERIFY_DEFAULT_MAX_REPORT);
+}
+
+static inline void set_output_filename(options_t* opts, const char* name) {
+    strncpy(opts->output_filename, name, sizeof(opts->output_filename) - 1);
+    opts->output_filename[sizeof(opts->output_filename) - 1] = '\0';
+    opts->output_given = 1;
+}
+
+// troca a extensão do arquivo de entrada (ex: prog.asm -> prog.o)
+static inline void derive_output_filename(options_t* opts, const char* extension) {
+    strncpy(opts->output_filename, opts->input_filename, sizeof(opts->output_filename) - 1);
+    opts->output_filename[sizeof(opts->output_filename) - 1] = '\0';
+    char* dot = strrchr(opts->output_filename, '.');
+    char* slash = strrchr(opts->output_filename, '/');
+    if (dot && (!slash || dot > slash)) *dot = '\0';
+    size_t len = strlen(opts->output_filename);
+    if (len + strlen(extension) < sizeof(opts->output_filename))
+        strcat(opts->output_filename, extension);
+}
+
+// opção que precisa de um argumento
+static inline const char* option_value(int argc, char* argv[], int* i) {
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "erro: opcao '%s' requer um argumento.\n", argv[*i]);
+        return NULL;
+    }
+    return argv[++(*i)];
+}
+
+// le argv e preenche as opções. retorna 0 se deu certo
+static inline int parse_options(int argc, char* argv[], options_t* opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->mode = MODE_ASSEMBLE;
+    opts->base_address = BASE_ADDRESS;
+    opts->big_endian = MIF_PRINT_BYTES_BIG_ENDIAN;
+    opts->sim_memory = SIM_DEFAULT_MEMORY;
+    opts->sim_max_steps = SIM_DEFAULT_MAX_STEPS;
+    opts->hazard_model.forwarding = FORWARD_FULL;
+    opts->hazard_model.branch_penalty = HAZARD_DEFAULT_BRANCH_PENALTY;
+    memory_layout_init(&opts->layout);
+    opts->verify_max = VERIFY_DEFAULT_MAX_REPORT;
+
+    opts->inputs = (const char **)malloc((size_t)argc * sizeof(const char *));
+    CHECK_ALLOC(opts->inputs, return -1);
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value;
+
+        if (strcmp(arg, "-v") == 0 || strcmp(arg, "--verbose") == 0) {
+            opts->verbose = 1;
+        } else if (strcmp(arg, "-l") == 0 || strcmp(arg, "--listing") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            opts->listing_filename = value;
+        } else if (strcmp(arg, "-o") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            set_output_filename(opts, value);
+        } else if (strcmp(arg, "--data-out") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            if ((size_t)snprintf(opts->data_output_filename, sizeof(opts->data_output_filename), "%s", value) >= sizeof(opts->data_output_filename)) {
+                fprintf(stderr, "erro: nome de arquivo '%s' muito longo.\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "-c") == 0) {
+            opts->mode = MODE_OBJECT;
+        } else if (strcmp(arg, "--link") == 0) {
+            opts->mode = MODE_LINK;
+        } else if (strcmp(arg, "--elf") == 0) {
+            opts->elf = 1;
+        } else if (strcmp(arg, "--compress") == 0) {
+            opts->compress = 1;
+        } else if (strcmp(arg, "-d") == 0 || strcmp(arg, "--disasm") == 0) {
+            opts->mode = MODE_DISASM;
+        } else if (strcmp(arg, "--run") == 0) {
+            opts->mode = MODE_RUN;
+        } else if (strcmp(arg, "--profile") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            opts->profile_filename = value;
+            opts->mode = MODE_RUN;
+        } else if (strcmp(arg, "--profile-stacks") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            opts->stacks_filename = value;
+            opts->mode = MODE_RUN;
+        } else if (strcmp(arg, "--schedule") == 0) {
+            opts->schedule = 1;
+        } else if (strcmp(arg, "--peephole") == 0) {
+            opts->peephole = 1;
+        } else if (strcmp(arg, "--hazards") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            opts->hazards_filename = value;
+        } else if (strcmp(arg, "--map") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            opts->map_filename = value;
+        } else if (strcmp(arg, "--map-format") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            if (strcmp(value, "text") == 0) opts->map_format = MAP_FORMAT_TEXT;
+            else if (strcmp(value, "csv") == 0) opts->map_format = MAP_FORMAT_CSV;
+            else {
+                fprintf(stderr, "erro: --map-format espera 'text' ou 'csv'.\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--layout") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            if (memory_layout_load(&opts->layout, value) != 0) return -1;
+        } else if (strcmp(arg, "--region") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            char fields[SOURCE_LINE_MAX];
+            char where[SOURCE_LINE_MAX];
+            snprintf(fields, sizeof(fields), "%s", value);
+            snprintf(where, sizeof(where), "--region '%s'", value);
+            if (memory_layout_add(&opts->layout, fields, where) != 0) return -1;
+        } else if (strcmp(arg, "--verify") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            opts->verify_filename = value;
+            opts->mode = MODE_VERIFY;
+        } else if (strcmp(arg, "--verify-max") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            char* end;
+            opts->verify_max = (size_t)strtoull(value, &end, 0);
+            if (end == value || *end != '\0') {
+                fprintf(stderr, "erro: limite de diferencas '%s' invalido.\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--forwarding") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            if (strcmp(value, "full") == 0) opts->hazard_model.forwarding = FORWARD_FULL;
+            else if (strcmp(value, "mem") == 0) opts->hazard_model.forwarding = FORWARD_MEM;
+            else if (strcmp(value, "none") == 0) opts->hazard_model.forwarding = FORWARD_NONE;
+            else {
+                fprintf(stderr, "erro: --forwarding espera 'full', 'mem' ou 'none'.\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--serve") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            opts->server_path = value;
+            opts->mode = MODE_SERVE;
+        } else if (strcmp(arg, "--lsp") == 0) {
+            opts->mode = MODE_LSP;
+        } else if (strcmp(arg, "--threads") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            char* end;
+            opts->server_threads = (unsigned)strtoul(value, &end, 0);
+            if (end == value || *end != '\0') {
+                fprintf(stderr, "erro: numero de threads '%s' invalido.\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--diagnostics") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            if (strcmp(value, "text") == 0) opts->diag_format = DIAG_FORMAT_TEXT;
+            else if (strcmp(value, "json") == 0) opts->diag_format = DIAG_FORMAT_JSON;
+            else {
+                fprintf(stderr, "erro: --diagnostics espera 'text' ou 'json'.\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--max-errors") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            char* end;
+            opts->max_errors = (size_t)strtoull(value, &end, 0);
+            if (end == value || *end != '\0') {
+                fprintf(stderr, "erro: limite de erros '%s' invalido.\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--branch-penalty") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            char* end;
+            opts->hazard_model.branch_penalty = (uint32_t)strtoul(value, &end, 0);
+            if (end == value || *end != '\0') {
+                fprintf(stderr, "erro: penalidade de desvio '%s' invalida.\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--mem") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            if (parse_size(value, &opts->sim_memory) != 0) {
+                fprintf(stderr, "erro: tamanho de memoria '%s' invalido.\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--max-steps") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            char* end;
+            opts->sim_max_steps = strtoull(value, &end, 0);
+            if (end == value || *end != '\0') {
+                fprintf(stderr, "erro: limite de instrucoes '%s' invalido.\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--base") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            char* end;
+            opts->base_address = (uint32_t)strtoul(value, &end, 0);
+            if (*end != '\0') {
+                fprintf(stderr, "erro: endereco '%s' invalido.\n", value);
+                return -1;
+            }
+        } else if (strcmp(arg, "--endian") == 0) {
+            if (!(value = option_value(argc, argv, &i))) return -1;
+            if (strcmp(value, "big") == 0) opts->big_endian = 1;
+            else if (strcmp(value, "little") == 0) opts->big_endian = 0;
+            else {
+                fprintf(stderr, "erro: --endian espera 'big' ou 'little'.\n");
+                return -1;
+            }
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            fprintf(stderr, "erro: opcao desconhecida '%s'.\n", arg);
+            return -1;
+        } else {
+            opts->inputs[opts->input_count++] = arg;
+        }
+    }
+
+    if (memory_layout_finish(&opts->layout) != 0) return -1;
+
+    // o servidor recebe os fontes pelo socket (e o --lsp pelo editor)
+    if (opts->mode == MODE_SERVE || opts->mode == MODE_LSP) {
+        if (opts->input_count > 0) {
+            fprintf(stderr, "erro: %s nao recebe arquivo de entrada ('%s').\n",
+                    opts->mode == MODE_SERVE ? "--serve" : "--lsp", opts->inputs[0]);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (opts->input_count == 0) return -1;
+
+    // compatibilidade: "entrada.asm saida.mif" sem -o
+    if (opts->mode != MODE_LINK && opts->input_count == 2 && !opts->output_given) {
+        set_output_filename(opts, opts->inputs[1]);
+        opts->input_count = 1;
+    }
+    if (opts->mode != MODE_LINK && opts->input_count > 1) {
+        fprintf(stderr, "erro: argumento a mais '%s'.\n", opts->inputs[opts->input_count - 1]);
+        return -1;
+    }
+    opts->input_filename = opts->inputs[0];
+
+    // para o caso que o arquivo é passado como parametro ou nao
+    if (!opts->output_given) {
+        if (opts->mode == MODE_OBJECT)
+            derive_output_filename(opts, ".o");
+        else if (opts->mode == MODE_DISASM)
+            opts->output_filename[0] = '\0'; // stdout
+        else if (opts->elf)
+            derive_output_filename(opts, ".elf");
+        else
+            strcpy(opts->output_filename, "memoria.mif");
+    }
+
+    // memoria.mif -> memoria_data.mif
+    if (opts->data_output_filename[0] == '\0') {
+        const char* output = opts->output_filename;
+        const char* dot = strrchr(output, '.');
+        const char* slash = strrchr(output, '/');
+        int stem = (int)((dot && (!slash || dot > slash)) ? (size_t)(dot - output) : strlen(output));
+        if ((size_t)snprintf(opts->data_output_filename, sizeof(opts->data_output_filename), "%.*s_data.mif", stem, output) >= sizeof(opts->data_output_filename)) {
+            fprintf(stderr, "erro: nome de arquivo '%s' muito longo para derivar o mif do .data (use --data-out).\n", output);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline void free_options(options_t* opts) {
+    free(opts->inputs);
+    opts->inputs = NULL;
+}
+
+#endif
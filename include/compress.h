@@ -0,0 +1,412 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "encoding_table.h"
+#include "encoder.h"
+#include "parser.h"
+
+// RV32C: troca instruções de 32 bits pelas versões de 16 bits quando os operandos cabem.
+// a compressão parte da palavra de 32 bits já codificada, então labels, %hi/%lo e pseudo
+// já chegam resolvidos e a tabela do isa.def continua sendo a unica descrição do encode.
+
+typedef struct {
+    size_t instructions;     // instruções no .text
+    size_t compressed;       // quantas viraram 16 bits
+    uint32_t text_before;    // bytes do .text sem compressão
+    uint32_t text_after;     // bytes do .text com compressão
+    int iterations;          // rodadas até o ponto fixo
+} compress_stats_t;
+
+#define RVC_BIT(value, n) (((uint32_t)(value) >> (n)) & 1u)
+
+static inline int rvc_is_prime(uint32_t reg) {
+    return reg >= 8 && reg <= 15; // x8..x15 cabem nos 3 bits dos formatos CIW/CL/CS/CA/CB
+}
+
+static inline int rvc_fits_signed(int32_t value, int bits) {
+    return value >= -(1 << (bits - 1)) && value < (1 << (bits - 1));
+}
+
+// formato CI com imediato de 6 bits com sinal (c.li, c.addi, c.andi usa o CB parecido)
+static inline uint16_t rvc_ci(uint32_t funct3, uint32_t rd, int32_t imm, uint32_t quadrant) {
+    return (uint16_t)((funct3 << 13) | (RVC_BIT(imm, 5) << 12) | (rd << 7) | (((uint32_t)imm & 0x1F) << 2) | quadrant);
+}
+
+// offset do c.j/c.jal: [11|4|9:8|10|6|7|3:1|5]
+static inline uint16_t rvc_cj(uint32_t funct3, int32_t offset) {
+    uint32_t o = (uint32_t)offset;
+    return (uint16_t)((funct3 << 13) | (RVC_BIT(o, 11) << 12) | (RVC_BIT(o, 4) << 11) | (((o >> 8) & 3) << 9) |
+                      (RVC_BIT(o, 10) << 8) | (RVC_BIT(o, 6) << 7) | (RVC_BIT(o, 7) << 6) | (((o >> 1) & 7) << 3) |
+                      (RVC_BIT(o, 5) << 2) | 0x1);
+}
+
+// offset do c.beqz/c.bnez: [8|4:3] ... [7:6|2:1|5]
+static inline uint16_t rvc_cb_branch(uint32_t funct3, uint32_t rs1, int32_t offset) {
+    uint32_t o = (uint32_t)offset;
+    return (uint16_t)((funct3 << 13) | (RVC_BIT(o, 8) << 12) | (((o >> 3) & 3) << 10) | ((rs1 - 8) << 7) |
+                      (((o >> 6) & 3) << 5) | (((o >> 1) & 3) << 3) | (RVC_BIT(o, 5) << 2) | 0x1);
+}
+
+// c.sub/c.xor/c.or/c.and (formato CA)
+static inline uint16_t rvc_ca(uint32_t funct2, uint32_t rd, uint32_t rs2) {
+    return (uint16_t)((0x23u << 10) | ((rd - 8) << 7) | (funct2 << 5) | ((rs2 - 8) << 2) | 0x1);
+}
+
+// tenta comprimir uma instrução de 32 bits. retorna false se não tem forma de 16 bits
+static inline bool rvc_compress(uint32_t word, uint16_t* out) {
+    uint32_t opcode = word & 0x7F;
+    uint32_t rd     = (word >> 7) & 0x1F;
+    uint32_t funct3 = (word >> 12) & 0x7;
+    uint32_t rs1    = (word >> 15) & 0x1F;
+    uint32_t rs2    = (word >> 20) & 0x1F;
+    uint32_t funct7 = word >> 25;
+    int32_t imm_i   = (int32_t)word >> 20;
+
+    switch (opcode) {
+        case 0x13: // OP-IMM
+            if (funct3 == 0) { // addi
+                if (rd == 0 && rs1 == 0 && imm_i == 0) { *out = 0x0001; return true; } // c.nop
+                if (rd != 0 && rs1 == 0 && rvc_fits_signed(imm_i, 6)) { *out = rvc_ci(2, rd, imm_i, 1); return true; } // c.li
+                if (rd != 0 && rd == rs1 && imm_i != 0 && rvc_fits_signed(imm_i, 6)) { *out = rvc_ci(0, rd, imm_i, 1); return true; } // c.addi
+                if (rd == 2 && rs1 == 2 && imm_i != 0 && imm_i % 16 == 0 && imm_i >= -512 && imm_i <= 496) { // c.addi16sp
+                    uint32_t n = (uint32_t)imm_i;
+                    *out = (uint16_t)((3u << 13) | (RVC_BIT(n, 9) << 12) | (2u << 7) | (RVC_BIT(n, 4) << 6) | (RVC_BIT(n, 6) << 5) |
+                                      (((n >> 7) & 3) << 3) | (RVC_BIT(n, 5) << 2) | 0x1);
+                    return true;
+                }
+                if (rvc_is_prime(rd) && rs1 == 2 && imm_i > 0 && imm_i % 4 == 0 && imm_i <= 1020) { // c.addi4spn
+                    uint32_t u = (uint32_t)imm_i;
+                    *out = (uint16_t)((((u >> 4) & 3) << 11) | (((u >> 6) & 0xF) << 7) | (RVC_BIT(u, 2) << 6) |
+                                      (RVC_BIT(u, 3) << 5) | ((rd - 8) << 2));
+                    return true;
+                }
+                if (rd != 0 && rs1 != 0 && imm_i == 0) { *out = (uint16_t)((0x8u << 12) | (rd << 7) | (rs1 << 2) | 0x2); return true; } // c.mv
+                return false;
+            }
+            if (funct3 == 1 && funct7 == 0 && rd != 0 && rd == rs1 && rs2 != 0) { // c.slli (rs2 aqui é o shamt)
+                *out = (uint16_t)((rd << 7) | (rs2 << 2) | 0x2);
+                return true;
+            }
+            if (funct3 == 5 && rd == rs1 && rvc_is_prime(rd) && rs2 != 0 && (funct7 == 0 || funct7 == 0x20)) { // c.srli/c.srai
+                uint32_t funct2 = funct7 == 0 ? 0 : 1;
+                *out = (uint16_t)((0x4u << 13) | (funct2 << 10) | ((rd - 8) << 7) | (rs2 << 2) | 0x1);
+                return true;
+            }
+            if (funct3 == 7 && rd == rs1 && rvc_is_prime(rd) && rvc_fits_signed(imm_i, 6)) { // c.andi
+                *out = (uint16_t)((0x4u << 13) | (RVC_BIT(imm_i, 5) << 12) | (2u << 10) | ((rd - 8) << 7) | (((uint32_t)imm_i & 0x1F) << 2) | 0x1);
+                return true;
+            }
+            return false;
+
+        case 0x33: // OP
+            if (funct3 == 0 && funct7 == 0 && rd != 0) { // add
+                if (rs1 == 0 && rs2 != 0) { *out = (uint16_t)((0x8u << 12) | (rd << 7) | (rs2 << 2) | 0x2); return true; } // c.mv
+                uint32_t other = rd == rs1 ? rs2 : (rd == rs2 ? rs1 : 0);
+                if (other != 0) { *out = (uint16_t)((0x9u << 12) | (rd << 7) | (other << 2) | 0x2); return true; } // c.add
+                return false;
+            }
+            if (rvc_is_prime(rd) && rvc_is_prime(rs1) && rvc_is_prime(rs2)) {
+                int funct2 = -1;
+                int commutative = 1;
+                if (funct3 == 0 && funct7 == 0x20) { funct2 = 0; commutative = 0; } // c.sub
+                if (funct3 == 4 && funct7 == 0) funct2 = 1;                          // c.xor
+                if (funct3 == 6 && funct7 == 0) funct2 = 2;                          // c.or
+                if (funct3 == 7 && funct7 == 0) funct2 = 3;                          // c.and
+                if (funct2 < 0) return false;
+                if (rd == rs1) { *out = rvc_ca((uint32_t)funct2, rd, rs2); return true; }
+                if (rd == rs2 && commutative) { *out = rvc_ca((uint32_t)funct2, rd, rs1); return true; }
+            }
+            return false;
+
+        case 0x03: // LOAD
+            if (funct3 != 2) return false; // só lw
+            if (rvc_is_prime(rd) && rvc_is_prime(rs1) && imm_i >= 0 && imm_i <= 124 && imm_i % 4 == 0) { // c.lw
+                uint32_t u = (uint32_t)imm_i;
+                *out = (uint16_t)((0x2u << 13) | (((u >> 3) & 7) << 10) | ((rs1 - 8) << 7) | (RVC_BIT(u, 2) << 6) |
+                                  (RVC_BIT(u, 6) << 5) | ((rd - 8) << 2));
+                return true;
+            }
+            if (rd != 0 && rs1 == 2 && imm_i >= 0 && imm_i <= 252 && imm_i % 4 == 0) { // c.lwsp
+                uint32_t u = (uint32_t)imm_i;
+                *out = (uint16_t)((0x2u << 13) | (RVC_BIT(u, 5) << 12) | (rd << 7) | (((u >> 2) & 7) << 4) |
+                                  (((u >> 6) & 3) << 2) | 0x2);
+                return true;
+            }
+            return false;
+
+        case 0x23: { // STORE
+            if (funct3 != 2) return false; // só sw
+            int32_t imm_s = (int32_t)(((int32_t)word >> 25) << 5) | (int32_t)rd;
+            if (rvc_is_prime(rs1) && rvc_is_prime(rs2) && imm_s >= 0 && imm_s <= 124 && imm_s % 4 == 0) { // c.sw
+                uint32_t u = (uint32_t)imm_s;
+                *out = (uint16_t)((0x6u << 13) | (((u >> 3) & 7) << 10) | ((rs1 - 8) << 7) | (RVC_BIT(u, 2) << 6) |
+                                  (RVC_BIT(u, 6) << 5) | ((rs2 - 8) << 2));
+                return true;
+            }
+            if (rs1 == 2 && imm_s >= 0 && imm_s <= 252 && imm_s % 4 == 0) { // c.swsp
+                uint32_t u = (uint32_t)imm_s;
+                *out = (uint16_t)((0x6u << 13) | (((u >> 2) & 0xF) << 9) | (((u >> 6) & 3) << 7) | (rs2 << 2) | 0x2);
+                return true;
+            }
+            return false;
+        }
+
+        case 0x37: { // LUI
+            uint32_t imm_u = word >> 12;
+            int fits = (imm_u != 0 && imm_u <= 31) || imm_u >= 0xFFFE0; // 6 bits com sinal, diferente de zero
+            if (rd == 0 || rd == 2 || !fits) return false;
+            *out = (uint16_t)((0x3u << 13) | (RVC_BIT(imm_u, 5) << 12) | (rd << 7) | ((imm_u & 0x1F) << 2) | 0x1);
+            return true;
+        }
+
+        case 0x6F: { // JAL
+            int32_t offset = (int32_t)((RVC_BIT(word, 31) << 20) | (((word >> 12) & 0xFF) << 12) |
+                                       (RVC_BIT(word, 20) << 11) | (((word >> 21) & 0x3FF) << 1));
+            offset = (offset << 11) >> 11;
+            if (!rvc_fits_signed(offset, 12)) return false;
+            if (rd == 0) { *out = rvc_cj(5, offset); return true; } // c.j
+            if (rd == 1) { *out = rvc_cj(1, offset); return true; } // c.jal (só RV32)
+            return false;
+        }
+
+        case 0x67: // JALR
+            if (funct3 != 0 || imm_i != 0 || rs1 == 0) return false;
+            if (rd == 0) { *out = (uint16_t)((0x8u << 12) | (rs1 << 7) | 0x2); return true; } // c.jr
+            if (rd == 1) { *out = (uint16_t)((0x9u << 12) | (rs1 << 7) | 0x2); return true; } // c.jalr
+            return false;
+
+        case 0x63: { // BRANCH
+            if ((funct3 != 0 && funct3 != 1) || rs2 != 0 || !rvc_is_prime(rs1)) return false;
+            int32_t offset = (int32_t)((RVC_BIT(word, 31) << 12) | (RVC_BIT(word, 7) << 11) |
+                                       (((word >> 25) & 0x3F) << 5) | (((word >> 8) & 0xF) << 1));
+            offset = (offset << 19) >> 19;
+            if (!rvc_fits_signed(offset, 9)) return false;
+            *out = rvc_cb_branch(funct3 == 0 ? 6 : 7, rs1, offset); // c.beqz / c.bnez
+            return true;
+        }
+
+        case 0x73: // SYSTEM
+            if (word == 0x00100073) { *out = 0x9002; return true; } // c.ebreak
+            return false;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// caminho inverso (disassembler): instrução de 16 bits -> equivalente de 32 bits
+
+static inline uint32_t rv_r(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode) {
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+static inline uint32_t rv_i(int32_t imm, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode) {
+    return ((uint32_t)imm << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+static inline uint32_t rv_s(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t opcode) {
+    uint32_t u = (uint32_t)imm;
+    return (((u >> 5) & 0x7F) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | ((u & 0x1F) << 7) | opcode;
+}
+
+static inline uint32_t rv_b(int32_t offset, uint32_t rs2, uint32_t rs1, uint32_t funct3) {
+    uint32_t o = (uint32_t)offset;
+    return (RVC_BIT(o, 12) << 31) | (((o >> 5) & 0x3F) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) |
+           (((o >> 1) & 0xF) << 8) | (RVC_BIT(o, 11) << 7) | 0x63;
+}
+
+static inline uint32_t rv_j(int32_t offset, uint32_t rd) {
+    uint32_t o = (uint32_t)offset;
+    return (RVC_BIT(o, 20) << 31) | (((o >> 1) & 0x3FF) << 21) | (RVC_BIT(o, 11) << 20) | (((o >> 12) & 0xFF) << 12) |
+           (rd << 7) | 0x6F;
+}
+
+static inline int32_t rvc_sext(uint32_t value, int bits) {
+    return (int32_t)(value << (32 - bits)) >> (32 - bits);
+}
+
+// expande uma instrução comprimida. retorna false se não é uma instrução RV32C valida
+static inline bool rvc_expand(uint16_t half, uint32_t* word) {
+    uint32_t h = half;
+    uint32_t quadrant = h & 3;
+    uint32_t funct3 = (h >> 13) & 7;
+    uint32_t rd = (h >> 7) & 0x1F;                 // rd/rs1 completo (CI/CR)
+    uint32_t rs2 = (h >> 2) & 0x1F;                // rs2 completo (CR/CSS)
+    uint32_t rdp = ((h >> 2) & 7) + 8;             // rd'/rs2' (CIW/CL/CS/CA)
+    uint32_t rs1p = ((h >> 7) & 7) + 8;            // rs1'/rd' (CL/CS/CA/CB)
+    int32_t imm6 = rvc_sext((RVC_BIT(h, 12) << 5) | ((h >> 2) & 0x1F), 6);
+
+    if (h == 0) return false; // 0x0000 é ilegal por definição
+
+    switch (quadrant) {
+        case 0: {
+            uint32_t uimm_w = (((h >> 10) & 7) << 3) | (RVC_BIT(h, 6) << 2) | (RVC_BIT(h, 5) << 6);
+            if (funct3 == 0) { // c.addi4spn
+                uint32_t u = (((h >> 11) & 3) << 4) | (((h >> 7) & 0xF) << 6) | (RVC_BIT(h, 6) << 2) | (RVC_BIT(h, 5) << 3);
+                if (u == 0) return false;
+                *word = rv_i((int32_t)u, 2, 0, rdp, 0x13);
+                return true;
+            }
+            if (funct3 == 2) { *word = rv_i((int32_t)uimm_w, rs1p, 2, rdp, 0x03); return true; } // c.lw
+            if (funct3 == 6) { *word = rv_s((int32_t)uimm_w, rdp, rs1p, 2, 0x23); return true; } // c.sw
+            return false;
+        }
+
+        case 1:
+            switch (funct3) {
+                case 0: *word = rv_i(imm6, rd, 0, rd, 0x13); return true; // c.addi / c.nop
+                case 2: *word = rv_i(imm6, 0, 0, rd, 0x13); return true;  // c.li
+                case 1: case 5: { // c.jal / c.j
+                    uint32_t o = (RVC_BIT(h, 12) << 11) | (RVC_BIT(h, 11) << 4) | (((h >> 9) & 3) << 8) | (RVC_BIT(h, 8) << 10) |
+                                 (RVC_BIT(h, 7) << 6) | (RVC_BIT(h, 6) << 7) | (((h >> 3) & 7) << 1) | (RVC_BIT(h, 2) << 5);
+                    *word = rv_j(rvc_sext(o, 12), funct3 == 1 ? 1 : 0);
+                    return true;
+                }
+                case 3:
+                    if (rd == 2) { // c.addi16sp
+                        uint32_t n = (RVC_BIT(h, 12) << 9) | (RVC_BIT(h, 6) << 4) | (RVC_BIT(h, 5) << 6) |
+                                     (((h >> 3) & 3) << 7) | (RVC_BIT(h, 2) << 5);
+                        if (n == 0) return false;
+                        *word = rv_i(rvc_sext(n, 10), 2, 0, 2, 0x13);
+                        return true;
+                    }
+                    if (imm6 == 0 || rd == 0) return false;
+                    *word = (((uint32_t)imm6 & 0xFFFFF) << 12) | (rd << 7) | 0x37; // c.lui
+                    return true;
+                case 4: {
+                    uint32_t funct2 = (h >> 10) & 3;
+                    uint32_t shamt = ((h >> 2) & 0x1F) | (RVC_BIT(h, 12) << 5);
+                    if (funct2 == 0) { if (shamt >= 32) return false; *word = rv_r(0x00, shamt, rs1p, 5, rs1p, 0x13); return true; } // c.srli
+                    if (funct2 == 1) { if (shamt >= 32) return false; *word = rv_r(0x20, shamt, rs1p, 5, rs1p, 0x13); return true; } // c.srai
+                    if (funct2 == 2) { *word = rv_i(imm6, rs1p, 7, rs1p, 0x13); return true; } // c.andi
+                    if (RVC_BIT(h, 12)) return false; // subw/addw são RV64
+                    static const uint32_t ca_funct3[4] = {0, 4, 6, 7};
+                    uint32_t op = (h >> 5) & 3;
+                    *word = rv_r(op == 0 ? 0x20 : 0x00, rdp, rs1p, ca_funct3[op], rs1p, 0x33); // c.sub/xor/or/and
+                    return true;
+                }
+                case 6: case 7: { // c.beqz / c.bnez
+                    uint32_t o = (RVC_BIT(h, 12) << 8) | (((h >> 10) & 3) << 3) | (((h >> 5) & 3) << 6) |
+                                 (((h >> 3) & 3) << 1) | (RVC_BIT(h, 2) << 5);
+                    *word = rv_b(rvc_sext(o, 9), 0, rs1p, funct3 == 6 ? 0 : 1);
+                    return true;
+                }
+            }
+            return false;
+
+        case 2:
+            if (funct3 == 0) { // c.slli
+                uint32_t shamt = ((h >> 2) & 0x1F) | (RVC_BIT(h, 12) << 5);
+                if (shamt >= 32) return false;
+                *word = rv_r(0, shamt, rd, 1, rd, 0x13);
+                return true;
+            }
+            if (funct3 == 2) { // c.lwsp
+                if (rd == 0) return false;
+                uint32_t u = (RVC_BIT(h, 12) << 5) | (((h >> 4) & 7) << 2) | (((h >> 2) & 3) << 6);
+                *word = rv_i((int32_t)u, 2, 2, rd, 0x03);
+                return true;
+            }
+            if (funct3 == 6) { // c.swsp
+                uint32_t u = (((h >> 9) & 0xF) << 2) | (((h >> 7) & 3) << 6);
+                *word = rv_s((int32_t)u, rs2, 2, 2, 0x23);
+                return true;
+            }
+            if (funct3 == 4) {
+                if (!RVC_BIT(h, 12)) {
+                    if (rs2 == 0) { if (rd == 0) return false; *word = rv_i(0, rd, 0, 0, 0x67); return true; } // c.jr
+                    *word = rv_r(0, rs2, 0, 0, rd, 0x33); return true; // c.mv
+                }
+                if (rd == 0 && rs2 == 0) { *word = 0x00100073; return true; } // c.ebreak
+                if (rs2 == 0) { *word = rv_i(0, rd, 0, 1, 0x67); return true; } // c.jalr
+                *word = rv_r(0, rs2, rd, 0, rd, 0x33); return true; // c.add
+            }
+            return false;
+    }
+    return false; // quadrante 3 é instrução de 32 bits
+}
+
+// o tamanho de jumps e branches depende da distancia, que muda conforme o codigo encolhe
+static inline int rvc_layout_dependent(const instruction_t* item) {
+    const instruction_entry_t* entry = find_instruction(item->mnemonic);
+    return entry && (entry->format == FMT_BRANCH || entry->format == FMT_JAL);
+}
+
+// escolhe quais instruções do .text ficam com 16 bits e refaz o layout até ninguem mudar.
+// só encolher pode quebrar um branch já comprimido (ex: .align que passa a precisar de mais
+// padding), então quem deixa de caber volta para 32 bits e nunca mais é tentado.
+// retorna a quantidade de erros do layout
+static inline size_t compress_program(instruction_t* items, size_t count, symbol_table_t* table, compress_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->text_before = section_end_address(items, count, SECTION_TEXT) - section_base_address(SECTION_TEXT);
+
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].kind == ITEM_INSTRUCTION && items[i].section == SECTION_TEXT) {
+            items[i].flags |= ITEM_FLAG_RVC;
+            stats->instructions++;
+        }
+    }
+
+    size_t errors = 0;
+    int changed = 1;
+    encoder_quiet = 1;
+    while (changed && errors == 0) {
+        changed = 0;
+        stats->iterations++;
+        for (size_t i = 0; i < count; i++) {
+            instruction_t* item = &items[i];
+            if (!(item->flags & ITEM_FLAG_RVC) || (item->flags & ITEM_FLAG_NO_RVC)) continue;
+
+            uint16_t half;
+            uint32_t word = encode_instruction(item, table, item->address);
+            int fits = word != ENCODING_ERROR_SENTINEL && rvc_compress(word, &half);
+
+            if (item->flags & ITEM_FLAG_COMPRESSED) {
+                if (!fits) {
+                    item->flags = (uint8_t)((item->flags & ~ITEM_FLAG_COMPRESSED) | ITEM_FLAG_NO_RVC);
+                    changed = 1;
+                }
+            } else if (fits) {
+                item->flags |= ITEM_FLAG_COMPRESSED;
+                changed = 1;
+            } else if (word == ENCODING_ERROR_SENTINEL || !rvc_layout_dependent(item)) {
+                // erro fica para a segunda passagem reportar; o resto não muda com o layout
+                item->flags |= ITEM_FLAG_NO_RVC;
+            }
+        }
+        if (changed)
+            errors += layout_program(items, count, table);
+    }
+    encoder_quiet = 0;
+
+    for (size_t i = 0; i < count; i++)
+        if (items[i].flags & ITEM_FLAG_COMPRESSED)
+            stats->compressed++;
+    stats->text_after = section_end_address(items, count, SECTION_TEXT) - section_base_address(SECTION_TEXT);
+    return errors;
+}
+
+// na segunda passagem: troca a palavra de 32 bits pela de 16 se o item foi comprimido no layout
+static inline uint32_t compress_encoded(const instruction_t* item, uint32_t word) {
+    if (!(item->flags & ITEM_FLAG_COMPRESSED) || word == ENCODING_ERROR_SENTINEL)
+        return word;
+    uint16_t half;
+    if (!rvc_compress(word, &half)) {
+        diag_error(item->line_number, "instrucao '%s' deixou de caber em 16 bits.", item->mnemonic);
+        return ENCODING_ERROR_SENTINEL;
+    }
+    return half;
+}
+
+static inline void compress_report(const compress_stats_t* stats) {
+    // padding de .align pode crescer, então a diferença é com sinal
+    long saved = (long)stats->text_before - (long)stats->text_after;
+    printf("compressao rv32c: %zu de %zu instrucoes em 16 bits, .text %u -> %u bytes (%ld bytes economizados, %d rodada(s)).\n",
+           stats->compressed, stats->instructions, stats->text_before, stats->text_after, saved, stats->iterations);
+}
+
+#endif
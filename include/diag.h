@@ -0,0 +1,317 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stdarg.h>
+
+#include "types.h"
+#include "utils.h"
+
+// diagnosticos: erros e avisos ficam guardados durante a montagem inteira e só são impressos
+// no fim, ordenados por linha e sem repetição (as passagens que refazem o layout reportam o
+// mesmo erro varias vezes). uma rodada mostra todos os erros do arquivo, não só o primeiro.
+//
+//   erro (linha 12, coluna 10): registrador 'x99' invalido para 'addi'.
+//       addi x99, t0, 1
+//            ^
+//
+// a coluna é a do primeiro trecho entre aspas simples da mensagem que aparece na linha
+// depois do começo (quase toda mensagem cita o operando culpado), senão o começo da instrução.
+// com --diagnostics json sai um objeto só, para editor/CI.
+
+typedef enum {
+    DIAG_ERROR,
+    DIAG_WARNING
+} DIAG_SEVERITY;
+
+typedef enum {
+    DIAG_FORMAT_TEXT,
+    DIAG_FORMAT_JSON
+} DIAG_FORMAT;
+
+typedef struct {
+    uint8_t severity;
+    uint32_t line;           // linha no arquivo, 0 = sem linha
+    uint32_t column;         // 1-based, 0 = sem coluna
+    size_t order;            // ordem de chegada, desempata a ordenação
+    char* message;
+} diag_t;
+
+// de onde veio cada linha depois do preprocessador (.include e .macro, ver preprocess.h)
+typedef struct {
+    const char* file;
+    uint32_t line;
+    const char* macro;       // macro que gerou a linha (NULL se não veio de macro)
+    const char* call_file;   // onde a macro foi chamada
+    uint32_t call_line;
+    const char* text;        // trecho a mostrar quando a linha expandida não serve (ou NULL)
+} diag_origin_t;
+
+typedef struct {
+    diag_t* items;
+    size_t count;
+    size_t capacity;
+    size_t errors;
+    const char* filename;
+    char** lines;            // linhas do arquivo como foram lidas (line_number - 1 indexa)
+    size_t line_count;
+    const diag_origin_t* origins; // um por linha, NULL se as linhas são o proprio arquivo
+} diag_state_t;
+
+// um por thread: cada conexão do --serve junta os diagnosticos do seu programa
+static THREAD_LOCAL diag_state_t diag_state;
+
+static inline void diag_set_source(const char* filename, char** lines, size_t line_count) {
+    diag_state.filename = filename;
+    diag_state.lines = lines;
+    diag_state.line_count = line_count;
+    diag_state.origins = NULL;
+}
+
+static inline void diag_set_origins(const diag_origin_t* origins) {
+    diag_state.origins = origins;
+}
+
+// arquivo e linha originais de uma linha do fonte expandido
+static inline diag_origin_t diag_origin(uint32_t line) {
+    diag_origin_t origin = {diag_state.filename, line, NULL, NULL, 0, NULL};
+    if (diag_state.origins && line > 0 && line <= diag_state.line_count)
+        origin = diag_state.origins[line - 1];
+    return origin;
+}
+
+// linha de origem para mostrar ao usuario: "12" ou "inc/io.inc:12" se veio de um .include
+static inline void diag_origin_format(uint32_t line, char* out, size_t size) {
+    diag_origin_t origin = diag_origin(line);
+    if (origin.file && diag_state.filename && strcmp(origin.file, diag_state.filename) != 0)
+        snprintf(out, size, "%s:%u", origin.file, origin.line);
+    else
+        snprintf(out, size, "%u", origin.line);
+}
+
+static inline size_t diag_error_count(void) {
+    return diag_state.errors;
+}
+
+static inline const char* diag_source_line(uint32_t line) {
+    if (line == 0 || line > diag_state.line_count) return NULL;
+    if (diag_state.origins && diag_state.origins[line - 1].text) return diag_state.origins[line - 1].text;
+    return diag_state.lines[line - 1];
+}
+
+// coluna do primeiro 'trecho' citado na mensagem que existe na linha, sem contar o que está no
+// começo dela (o mnemonico quase sempre aparece citado também, mas o culpado é o operando)
+static inline uint32_t diag_find_column(const char* source, const char* message) {
+    if (!source) return 0;
+    const char* start = source;
+    while (isspace((unsigned char)*start)) start++;
+    if (!*start) return 0;
+
+    for (const char* open = strchr(message, '\''); open; ) {
+        const char* close = strchr(open + 1, '\'');
+        if (!close) break;
+        size_t len = (size_t)(close - open - 1);
+        if (len > 0) {
+            for (const char* p = start + 1; (p = strchr(p, open[1])) != NULL; p++)
+                if (strncmp(p, open + 1, len) == 0) return (uint32_t)(p - source) + 1;
+        }
+        open = strchr(close + 1, '\'');
+    }
+    return (uint32_t)(start - source) + 1;
+}
+
+static inline void diag_reportv(DIAG_SEVERITY severity, uint32_t line, const char* format, va_list args) {
+    char message[SOURCE_LINE_MAX * 2];
+    vsnprintf(message, sizeof(message), format, args);
+
+    if (diag_state.count >= diag_state.capacity) {
+        diag_state.capacity = diag_state.capacity ? diag_state.capacity * 2 : 16;
+        diag_t* items = (diag_t *)realloc(diag_state.items, diag_state.capacity * sizeof(diag_t));
+        CHECK_ALLOC(items, exit(EXIT_FAILURE));
+        diag_state.items = items;
+    }
+    diag_t* d = &diag_state.items[diag_state.count];
+    d->severity = (uint8_t)severity;
+    d->line = line;
+    d->column = diag_find_column(diag_source_line(line), message);
+    d->order = diag_state.count++;
+    d->message = my_strdup(message);
+    if (severity == DIAG_ERROR) diag_state.errors++;
+}
+
+static inline void diag_error(uint32_t line, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    diag_reportv(DIAG_ERROR, line, format, args);
+    va_end(args);
+}
+
+static inline void diag_warning(uint32_t line, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    diag_reportv(DIAG_WARNING, line, format, args);
+    va_end(args);
+}
+
+static inline int diag_cmp(const void* a, const void* b) {
+    const diag_t* x = (const diag_t *)a;
+    const diag_t* y = (const diag_t *)b;
+    if (x->line != y->line) return x->line < y->line ? -1 : 1;
+    if (x->column != y->column) return x->column < y->column ? -1 : 1;
+    // repetidos ficam vizinhos para o diag_flush juntar
+    if (x->severity != y->severity) return x->severity < y->severity ? -1 : 1;
+    int c = strcmp(x->message, y->message);
+    if (c != 0) return c;
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+static inline bool diag_same(const diag_t* a, const diag_t* b) {
+    return a->severity == b->severity && a->line == b->line && a->column == b->column &&
+           strcmp(a->message, b->message) == 0;
+}
+
+static inline const char* diag_severity_name(uint8_t severity, DIAG_FORMAT format) {
+    if (format == DIAG_FORMAT_JSON) return severity == DIAG_ERROR ? "error" : "warning";
+    return severity == DIAG_ERROR ? "erro" : "aviso";
+}
+
+static inline void diag_json_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c == '\t') fputs("\\t", f);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static inline void diag_write_text(FILE* f, const diag_t* d) {
+    const char* name = diag_severity_name(d->severity, DIAG_FORMAT_TEXT);
+    diag_origin_t origin = diag_origin(d->line);
+    // o nome do arquivo só aparece quando a linha veio de um .include
+    char where[SOURCE_LINE_MAX];
+    if (origin.file && diag_state.filename && strcmp(origin.file, diag_state.filename) != 0)
+        snprintf(where, sizeof(where), "%s, linha %u", origin.file, origin.line);
+    else
+        snprintf(where, sizeof(where), "linha %u", origin.line);
+
+    if (d->line == 0) fprintf(f, "%s: %s\n", name, d->message);
+    else if (d->column == 0) fprintf(f, "%s (%s): %s\n", name, where, d->message);
+    else fprintf(f, "%s (%s, coluna %u): %s\n", name, where, d->column, d->message);
+
+    // trecho com o ^ embaixo (tab continua tab para o ^ cair no lugar certo).
+    // de macro o trecho é a linha já expandida, que é onde a coluna aponta
+    const char* source = diag_source_line(d->line);
+    if (source && d->column != 0) {
+        fprintf(f, "    %s\n    ", source);
+        for (uint32_t c = 1; c < d->column && source[c - 1]; c++)
+            fputc(source[c - 1] == '\t' ? '\t' : ' ', f);
+        fputs("^\n", f);
+    }
+    if (d->line != 0 && origin.macro)
+        fprintf(f, "    (na macro '%s' chamada em %s, linha %u)\n", origin.macro, origin.call_file, origin.call_line);
+}
+
+static inline void diag_write_json(FILE* f, const diag_t* d, bool first) {
+    diag_origin_t origin = diag_origin(d->line);
+    fprintf(f, "%s\n    {\"severity\": \"%s\", \"file\": ", first ? "" : ",", diag_severity_name(d->severity, DIAG_FORMAT_JSON));
+    diag_json_string(f, origin.file);
+    fprintf(f, ", \"line\": %u, \"column\": %u, \"message\": ", origin.line, d->column);
+    diag_json_string(f, d->message);
+    fputs(", \"excerpt\": ", f);
+    diag_json_string(f, diag_source_line(d->line));
+    if (d->line != 0 && origin.macro) {
+        fputs(", \"macro\": ", f);
+        diag_json_string(f, origin.macro);
+        fputs(", \"calledFrom\": {\"file\": ", f);
+        diag_json_string(f, origin.call_file);
+        fprintf(f, ", \"line\": %u}", origin.call_line);
+    }
+    fputc('}', f);
+}
+
+typedef struct {
+    size_t unique;           // depois de tirar os repetidos
+    size_t shown;            // o que cabe no limite
+    size_t errors;
+    size_t warnings;
+} diag_summary_t;
+
+// ordena e tira os repetidos (no lugar)
+static inline diag_summary_t diag_prepare(size_t limit) {
+    diag_summary_t summary = {0};
+    if (diag_state.count > 1) qsort(diag_state.items, diag_state.count, sizeof(diag_t), diag_cmp);
+    for (size_t i = 0; i < diag_state.count; i++) {
+        if (summary.unique > 0 && diag_same(&diag_state.items[summary.unique - 1], &diag_state.items[i])) {
+            free(diag_state.items[i].message);
+            continue;
+        }
+        diag_state.items[summary.unique++] = diag_state.items[i];
+        if (diag_state.items[i].severity == DIAG_ERROR) summary.errors++;
+        else summary.warnings++;
+    }
+    diag_state.count = summary.unique;
+    summary.shown = limit && summary.unique > limit ? limit : summary.unique;
+    return summary;
+}
+
+// os campos do json, sem as chaves (o --serve coloca junto com o resto da resposta)
+static inline void diag_write_json_fields(FILE* f, const diag_summary_t* summary) {
+    fputs("\"diagnostics\": [", f);
+    for (size_t i = 0; i < summary->shown; i++)
+        diag_write_json(f, &diag_state.items[i], i == 0);
+    fprintf(f, "%s], \"errors\": %zu, \"warnings\": %zu, \"omitted\": %zu",
+            summary->shown ? "\n  " : "", summary->errors, summary->warnings, summary->unique - summary->shown);
+}
+
+// esvazia a lista. a contagem de erros continua valendo para o main decidir se escreve a saida
+static inline void diag_clear(void) {
+    for (size_t i = 0; i < diag_state.count; i++)
+        free(diag_state.items[i].message);
+    diag_state.count = 0;
+}
+
+// imprime tudo que foi juntado (no maximo 'limit', 0 = sem limite) e esvazia a lista
+static inline void diag_flush(FILE* f, DIAG_FORMAT format, size_t limit) {
+    diag_summary_t summary = diag_prepare(limit);
+    if (format == DIAG_FORMAT_JSON) {
+        fputc('{', f);
+        diag_write_json_fields(f, &summary);
+        fputs("}\n", f);
+    } else {
+        for (size_t i = 0; i < summary.shown; i++)
+            diag_write_text(f, &diag_state.items[i]);
+        if (summary.shown < summary.unique)
+            fprintf(f, "... mais %zu diagnostico(s) omitido(s) (--max-errors %zu).\n", summary.unique - summary.shown, limit);
+        if (summary.errors > 0)
+            fprintf(f, "%zu erro(s), %zu aviso(s).\n", summary.errors, summary.warnings);
+    }
+    diag_clear();
+}
+
+// tira da lista o que foi juntado até agora (quem chama fica dono do vetor, ver diag_free_items).
+// o --lsp guarda os diagnosticos de cada linha e só refaz os das linhas que mudaram
+static inline diag_t* diag_take(size_t* count) {
+    diag_t* items = diag_state.items;
+    *count = diag_state.count;
+    diag_state.items = NULL;
+    diag_state.count = 0;
+    diag_state.capacity = 0;
+    diag_state.errors = 0;
+    return items;
+}
+
+static inline void diag_free_items(diag_t* items, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        free(items[i].message);
+    free(items);
+}
+
+static inline void diag_free(void) {
+    diag_clear();
+    free(diag_state.items);
+    memset(&diag_state, 0, sizeof(diag_state));
+}
+
+#endif
@@ -0,0 +1,465 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "utils.h"
+#include "encoding_table.h"
+#include "compress.h"
+#include "output.h"
+
+// disassembler: le o mif gerado pelo montador (qualquer granularidade, qualquer ordem dos bytes)
+// ou um binario cru e devolve assembly que o proprio montador aceita de volta.
+// o decode vai direto na tabela do isa.def (decode_instruction), sem cadeia de ifs.
+
+// imagem em memoria, sempre em bytes little-endian (como a memoria do risc-v)
+typedef struct {
+    uint8_t* bytes;
+    size_t size;
+    uint32_t base;
+} disasm_image_t;
+
+static inline void disasm_image_free(disasm_image_t* image) {
+    free(image->bytes);
+    image->bytes = NULL;
+    image->size = 0;
+}
+
+static inline uint32_t disasm_read32(const disasm_image_t* image, size_t offset) {
+    const uint8_t* p = image->bytes + offset;
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t disasm_read16(const disasm_image_t* image, size_t offset) {
+    const uint8_t* p = image->bytes + offset;
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void disasm_image_push_word(disasm_image_t* image, size_t* capacity, uint32_t word) {
+    if (image->size + 4 > *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 4096;
+        uint8_t* new_bytes = (uint8_t *)realloc(image->bytes, *capacity);
+        CHECK_ALLOC(new_bytes, exit(EXIT_FAILURE));
+        image->bytes = new_bytes;
+    }
+    for (int b = 0; b < 4; b++)
+        image->bytes[image->size++] = (uint8_t)(word >> (8 * b));
+}
+
+// 8 caracteres '0'/'1' de uma vez (swar): cada byte vira 0 ou 1 e a multiplicação junta os
+// 8 bits no byte de cima (as posições dos produtos cruzados nunca se encontram, sem vai-um).
+// false se algum caractere não é 0/1 (X, lixo), aí o laço de caractere por caractere resolve
+static inline bool mif_parse_bits8(const char* s, uint32_t* value) {
+    uint64_t x = 0;
+    for (int k = 0; k < 8; k++)
+        x |= (uint64_t)(uint8_t)s[k] << (8 * k);
+    if ((x & 0xFEFEFEFEFEFEFEFEull) != 0x3030303030303030ull) return false;
+    *value = (uint32_t)(((x & 0x0101010101010101ull) * 0x8040201008040201ull) >> 56);
+    return true;
+}
+
+// mif em texto: uma linha de 8, 16 ou 32 bits por endereço. 'big_endian' diz se a primeira
+// linha de cada palavra é a parte mais significativa (MIF_PRINT_BYTES_BIG_ENDIAN).
+// linhas com X (erro de codificação) viram 0xFFFFFFFF
+static inline bool disasm_parse_mif(const char* text, size_t length, int big_endian, disasm_image_t* image) {
+    size_t capacity = 0;
+    int width = 0;            // bits por linha, descoberto na primeira linha
+    int lines_per_word = 1;
+    int line_in_word = 0;
+    uint32_t word = 0;
+
+    const char* p = text;
+    const char* end = text + length;
+    while (p < end) {
+        const char* line = p;
+        const char* newline = (const char *)memchr(p, '\n', (size_t)(end - p));
+        p = newline ? newline : end;
+        const char* line_end = p;
+        if (p < end) p++;
+        if (line_end > line && line_end[-1] == '\r') line_end--;
+        if (line_end == line) continue;
+
+        int n = (int)(line_end - line);
+        if (width == 0) {
+            if (n != 8 && n != 16 && n != 32) {
+                fprintf(stderr, "erro: linha de %d caracteres no mif (esperado 8, 16 ou 32).\n", n);
+                return false;
+            }
+            width = n;
+            lines_per_word = 32 / width;
+            // linhas do mesmo tamanho: dá para saber o tamanho da imagem sem ir dobrando
+            capacity = (length / (size_t)(n + 1) + (size_t)lines_per_word) * (size_t)(width / 8);
+            uint8_t* bytes = (uint8_t *)realloc(image->bytes, capacity);
+            CHECK_ALLOC(bytes, exit(EXIT_FAILURE));
+            image->bytes = bytes;
+        } else if (n != width) {
+            fprintf(stderr, "erro: mif com linhas de tamanhos diferentes (%d e %d).\n", width, n);
+            return false;
+        }
+
+        uint32_t value = 0;
+        int i = 0;
+        for (uint32_t chunk; i + 8 <= n && mif_parse_bits8(line + i, &chunk); i += 8)
+            value = (value << 8) | chunk;
+        for (; i < n; i++) {
+            char c = line[i];
+            if (c == 'X' || c == 'x') { value = 0xFFFFFFFFu >> (32 - width); break; }
+            if (c != '0' && c != '1') {
+                fprintf(stderr, "erro: caractere '%c' invalido no mif.\n", c);
+                return false;
+            }
+            value = (value << 1) | (uint32_t)(c - '0');
+        }
+
+        int shift = big_endian ? (lines_per_word - 1 - line_in_word) * width : line_in_word * width;
+        word |= value << shift;
+        if (++line_in_word == lines_per_word) {
+            disasm_image_push_word(image, &capacity, word);
+            word = 0;
+            line_in_word = 0;
+        }
+    }
+    if (line_in_word != 0)
+        disasm_image_push_word(image, &capacity, word);
+    return true;
+}
+
+// binario cru: palavras de 32 bits em little-endian (ou big-endian se pedido)
+static inline void disasm_parse_binary(const uint8_t* data, size_t length, int big_endian, disasm_image_t* image) {
+    size_t capacity = 0;
+    for (size_t offset = 0; offset < length; offset += 4) {
+        uint32_t word = 0;
+        for (size_t b = 0; b < 4 && offset + b < length; b++) {
+            size_t shift = big_endian ? 8 * (3 - b) : 8 * b;
+            word |= (uint32_t)data[offset + b] << shift;
+        }
+        disasm_image_push_word(image, &capacity, word);
+    }
+}
+
+// le o arquivo inteiro e decide pelo conteudo: só 0/1/X e quebras de linha = mif
+static inline bool disasm_load(const char* filename, int big_endian, uint32_t base, disasm_image_t* image) {
+    image->bytes = NULL;
+    image->size = 0;
+    image->base = base;
+
+    FILE* f = fopen(filename, "rb");
+    if (!f) {
+        fprintf(stderr, "erro: nao foi possivel ler o arquivo '%s'.\n", filename);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = (uint8_t *)malloc(length > 0 ? (size_t)length : 1);
+    CHECK_ALLOC(data, { fclose(f); return false; });
+    size_t got = fread(data, 1, (size_t)(length > 0 ? length : 0), f);
+    fclose(f);
+
+    bool is_mif = got > 0;
+    for (size_t i = 0; i < got && is_mif; i++) {
+        uint8_t c = data[i];
+        is_mif = c == '0' || c == '1' || c == 'X' || c == '\n' || c == '\r';
+    }
+
+    bool ok = true;
+    if (is_mif)
+        ok = disasm_parse_mif((const char *)data, got, big_endian, image);
+    else
+        disasm_parse_binary(data, got, big_endian, image);
+    free(data);
+    return ok;
+}
+
+// imagem a partir das palavras de uma seção (section_build_image), com os bytes em little-endian
+static inline void disasm_image_from_words(disasm_image_t* image, const uint32_t* words, uint32_t size, uint32_t base) {
+    image->base = base;
+    image->size = size;
+    image->bytes = (uint8_t *)malloc(size ? size : 1);
+    CHECK_ALLOC(image->bytes, exit(EXIT_FAILURE));
+    for (uint32_t b = 0; b < size; ++b)
+        image->bytes[b] = (uint8_t)(words[b / 4] >> (8 * (b & 3)));
+}
+
+// ---------------------------------------------------------------------------
+// formatação (caminho quente: nada de printf). cada linha reserva o pior caso uma vez
+// e escreve direto no buffer com um cursor
+
+#define DISASM_LINE_MAX 128
+#define DISASM_COMMENT_COLUMN 32
+
+static inline char* disasm_put_str(char* p, const char* s) {
+    while (*s) *p++ = *s++;
+    return p;
+}
+
+static inline char* disasm_put_reg(char* p, uint32_t reg) {
+    return disasm_put_str(p, reg_abi_names[reg & 0x1F]);
+}
+
+static inline char* disasm_put_uint(char* p, uint32_t value) {
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static inline char* disasm_put_int(char* p, int32_t value) {
+    if (value < 0) {
+        *p++ = '-';
+        return disasm_put_uint(p, (uint32_t)0 - (uint32_t)value);
+    }
+    return disasm_put_uint(p, (uint32_t)value);
+}
+
+static inline char* disasm_put_hex(char* p, uint32_t value, int digits) {
+    static const char hex_digits[] = "0123456789abcdef";
+    for (int i = 0; i < digits; ++i)
+        p[i] = hex_digits[(value >> (4 * (digits - 1 - i))) & 0xF];
+    return p + digits;
+}
+
+static inline char* disasm_put_label(char* p, uint32_t address) {
+    *p++ = 'L';
+    *p++ = '_';
+    return disasm_put_hex(p, address, 8);
+}
+
+static inline char* disasm_put_sep(char* p) {
+    *p++ = ',';
+    *p++ = ' ';
+    return p;
+}
+
+// labels reconstruidas: um bit por meia-palavra da imagem marcando destino de branch/jal
+typedef struct {
+    uint64_t* bits;
+    size_t halfwords;
+} disasm_targets_t;
+
+static inline int disasm_is_target(const disasm_targets_t* targets, const disasm_image_t* image, uint32_t address) {
+    uint32_t offset = address - image->base;
+    if (address < image->base || (offset & 1) || offset / 2 >= targets->halfwords) return 0;
+    return (int)((targets->bits[offset / 128] >> ((offset / 2) & 63)) & 1);
+}
+
+static inline void disasm_mark_target(disasm_targets_t* targets, const disasm_image_t* image, uint32_t address) {
+    uint32_t offset = address - image->base;
+    if (address < image->base || (offset & 1) || offset / 2 >= targets->halfwords) return;
+    targets->bits[offset / 128] |= (uint64_t)1 << ((offset / 2) & 63);
+}
+
+static inline int32_t disasm_branch_offset(uint32_t word) {
+    int32_t offset = (int32_t)((((word >> 31) & 1) << 12) | (((word >> 7) & 1) << 11) |
+                               (((word >> 25) & 0x3F) << 5) | (((word >> 8) & 0xF) << 1));
+    return (offset << 19) >> 19;
+}
+
+static inline int32_t disasm_jal_offset(uint32_t word) {
+    int32_t offset = (int32_t)((((word >> 31) & 1) << 20) | (((word >> 12) & 0xFF) << 12) |
+                               (((word >> 20) & 1) << 11) | (((word >> 21) & 0x3FF) << 1));
+    return (offset << 11) >> 11;
+}
+
+// pega a instrução em 'offset': devolve o equivalente de 32 bits, a entrada da tabela e o
+// tamanho (2 ou 4). entry = NULL se não é instrução (vira .word/.half na saida)
+static inline const instruction_entry_t* disasm_fetch(const disasm_image_t* image, size_t offset, int rvc,
+                                                      uint32_t* word, uint32_t* length) {
+    if (rvc && offset + 2 <= image->size) {
+        uint16_t half = disasm_read16(image, offset);
+        if ((half & 3) != 3) {
+            *length = 2;
+            return rvc_expand(half, word) ? decode_instruction(*word) : NULL;
+        }
+    }
+    if (offset + 4 > image->size) {
+        *length = (uint32_t)(image->size - offset);
+        return NULL;
+    }
+    *length = 4;
+    *word = disasm_read32(image, offset);
+    return decode_instruction(*word);
+}
+
+// destino de um desvio (se for um)
+static inline bool disasm_target(uint32_t word, uint32_t pc, uint32_t* target) {
+    uint32_t opcode = word & 0x7F;
+    if (opcode == 0x63) { *target = pc + (uint32_t)disasm_branch_offset(word); return true; }
+    if (opcode == 0x6F) { *target = pc + (uint32_t)disasm_jal_offset(word); return true; }
+    return false;
+}
+
+static inline char* disasm_put_target(char* p, const disasm_targets_t* targets, const disasm_image_t* image,
+                                      uint32_t pc, int32_t offset) {
+    uint32_t target = pc + (uint32_t)offset;
+    if (disasm_is_target(targets, image, target))
+        return disasm_put_label(p, target);
+    return disasm_put_int(p, offset); // fora da imagem: offset cru, o montador aceita
+}
+
+// escreve uma instrução já decodificada no formato que o montador aceita
+static inline char* disasm_format(char* p, const instruction_entry_t* entry, uint32_t word, uint32_t pc,
+                                  const disasm_targets_t* targets, const disasm_image_t* image) {
+    uint32_t rd  = (word >> 7) & 0x1F;
+    uint32_t rs1 = (word >> 15) & 0x1F;
+    uint32_t rs2 = (word >> 20) & 0x1F;
+    int32_t imm_i = (int32_t)word >> 20;
+
+    p = disasm_put_str(p, entry->mnemonic);
+    if (entry->format == FMT_SYSTEM) return p;
+    *p++ = ' ';
+
+    switch (entry->format) {
+        case FMT_R:
+            p = disasm_put_reg(p, rd);  p = disasm_put_sep(p);
+            p = disasm_put_reg(p, rs1); p = disasm_put_sep(p);
+            p = disasm_put_reg(p, rs2);
+            break;
+        case FMT_I:
+            p = disasm_put_reg(p, rd);  p = disasm_put_sep(p);
+            p = disasm_put_reg(p, rs1); p = disasm_put_sep(p);
+            p = disasm_put_int(p, imm_i);
+            break;
+        case FMT_SHIFT:
+            p = disasm_put_reg(p, rd);  p = disasm_put_sep(p);
+            p = disasm_put_reg(p, rs1); p = disasm_put_sep(p);
+            p = disasm_put_uint(p, rs2);
+            break;
+        case FMT_LOAD:
+        case FMT_JALR:
+            p = disasm_put_reg(p, rd);  p = disasm_put_sep(p);
+            p = disasm_put_int(p, imm_i);
+            *p++ = '(';
+            p = disasm_put_reg(p, rs1);
+            *p++ = ')';
+            break;
+        case FMT_STORE:
+            p = disasm_put_reg(p, rs2); p = disasm_put_sep(p);
+            p = disasm_put_int(p, (int32_t)((((int32_t)word >> 25) << 5) | (int32_t)rd));
+            *p++ = '(';
+            p = disasm_put_reg(p, rs1);
+            *p++ = ')';
+            break;
+        case FMT_BRANCH:
+            p = disasm_put_reg(p, rs1); p = disasm_put_sep(p);
+            p = disasm_put_reg(p, rs2); p = disasm_put_sep(p);
+            p = disasm_put_target(p, targets, image, pc, disasm_branch_offset(word));
+            break;
+        case FMT_U:
+            p = disasm_put_reg(p, rd);
+            p = disasm_put_str(p, ", 0x");
+            p = disasm_put_hex(p, word >> 12, 5);
+            break;
+        case FMT_JAL:
+            p = disasm_put_reg(p, rd);  p = disasm_put_sep(p);
+            p = disasm_put_target(p, targets, image, pc, disasm_jal_offset(word));
+            break;
+        case FMT_FENCE: {
+            static const char set_names[] = "wroi";
+            for (int k = 0; k < 2; k++) {
+                uint32_t set = (word >> (k == 0 ? 24 : 20)) & 0xF;
+                if (k) p = disasm_put_sep(p);
+                if (!set) *p++ = '0';
+                for (int bit = 3; bit >= 0; bit--)
+                    if (set & (1u << bit)) *p++ = set_names[bit];
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return p;
+}
+
+// uma instrução só (sem labels, desvio sai com o offset cru), para mensagens como as do --verify
+static inline void disasm_at(const disasm_image_t* image, size_t offset, int rvc, char* out) {
+    disasm_targets_t none = {NULL, 0};
+    uint32_t word, length;
+    const instruction_entry_t* entry = disasm_fetch(image, offset, rvc, &word, &length);
+    char* p = out;
+    if (entry) {
+        p = disasm_format(p, entry, word, image->base + (uint32_t)offset, &none, image);
+    } else if (length >= 2) {
+        uint32_t raw = length == 2 ? disasm_read16(image, offset) : disasm_read32(image, offset);
+        p = disasm_put_str(p, length == 2 ? ".half 0x" : ".word 0x");
+        p = disasm_put_hex(p, raw, length == 2 ? 4 : 8);
+    }
+    *p = '\0';
+}
+
+// disassembla a imagem inteira. 'rvc' liga o decode de instruções de 16 bits
+static inline void disassemble_image(const disasm_image_t* image, int rvc, FILE* out) {
+    disasm_targets_t targets;
+    targets.halfwords = (image->size + 1) / 2;
+    size_t bitmap_words = targets.halfwords / 64 + 1;
+    targets.bits = (uint64_t *)calloc(bitmap_words, sizeof(uint64_t));
+    CHECK_ALLOC(targets.bits, exit(EXIT_FAILURE));
+
+    // primeira passada: marca os destinos dos desvios e onde cada instrução começa
+    // (label só faz sentido se o destino cair no inicio de uma linha da saida)
+    disasm_targets_t starts = targets;
+    starts.bits = (uint64_t *)calloc(bitmap_words, sizeof(uint64_t));
+    CHECK_ALLOC(starts.bits, exit(EXIT_FAILURE));
+
+    uint32_t word, length;
+    for (size_t offset = 0; offset < image->size; offset += length) {
+        uint32_t target;
+        uint32_t pc = image->base + (uint32_t)offset;
+        disasm_mark_target(&starts, image, pc);
+        if (disasm_fetch(image, offset, rvc, &word, &length) && disasm_target(word, pc, &target))
+            disasm_mark_target(&targets, image, target);
+        if (length == 0) break;
+    }
+    for (size_t i = 0; i < bitmap_words; i++)
+        targets.bits[i] &= starts.bits[i];
+    free(starts.bits);
+
+    out_buffer_t buf;
+    out_buffer_init(&buf, out);
+
+    for (size_t offset = 0; offset < image->size; offset += length) {
+        uint32_t pc = image->base + (uint32_t)offset;
+        const instruction_entry_t* entry = disasm_fetch(image, offset, rvc, &word, &length);
+        if (length == 0) break;
+
+        char* line = out_buffer_reserve(&buf, 2 * DISASM_LINE_MAX);
+        char* p = line;
+        if (disasm_is_target(&targets, image, pc)) {
+            p = disasm_put_label(p, pc);
+            *p++ = ':';
+            *p++ = '\n';
+        }
+
+        char* start = p;
+        p = disasm_put_str(p, "    ");
+        uint32_t raw = length == 2 ? disasm_read16(image, offset) : disasm_read32(image, offset);
+        if (entry) {
+            p = disasm_format(p, entry, word, pc, &targets, image);
+        } else {
+            // não é instrução: sai como dado, para a volta pelo montador dar a mesma imagem
+            p = disasm_put_str(p, length == 2 ? ".half 0x" : ".word 0x");
+            p = disasm_put_hex(p, raw, (int)length * 2);
+        }
+
+        // comentario com endereço e codigo original
+        do *p++ = ' '; while (p - start < DISASM_COMMENT_COLUMN);
+        *p++ = '#';
+        *p++ = ' ';
+        p = disasm_put_hex(p, pc, 8);
+        *p++ = ':';
+        *p++ = ' ';
+        p = disasm_put_hex(p, raw, (int)length * 2);
+        *p++ = '\n';
+        buf.len += (size_t)(p - line);
+    }
+
+    out_buffer_free(&buf);
+    free(targets.bits);
+}
+
+#endif
@@ -0,0 +1,464 @@
+#ifndef ELF_WRITER_H
+#define ELF_WRITER_H
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "relocation.h"
+#include "object.h"
+#include "output.h"
+
+// estruturas do ELF32 (definidas aqui para não depender do <elf.h>, que não existe em todo lugar)
+
+#define ELF_EM_RISCV      243
+#define ELF_ET_REL        1
+#define ELF_ET_EXEC       2
+#define ELF_EF_RISCV_RVC  0x1
+#define ELF_PT_LOAD       1
+#define ELF_PF_X          1
+#define ELF_PF_W          2
+#define ELF_PF_R          4
+
+#define ELF_SHT_PROGBITS  1
+#define ELF_SHT_SYMTAB    2
+#define ELF_SHT_STRTAB    3
+#define ELF_SHT_RELA      4
+#define ELF_SHF_WRITE     0x1
+#define ELF_SHF_ALLOC     0x2
+#define ELF_SHF_EXECINSTR 0x4
+#define ELF_SHF_INFO_LINK 0x40
+
+#define ELF_STB_LOCAL     0
+#define ELF_STB_GLOBAL    1
+#define ELF_STT_NOTYPE    0
+#define ELF_STT_SECTION   3
+
+#define ELF_R_RISCV_32     1
+#define ELF_R_RISCV_BRANCH 16
+#define ELF_R_RISCV_JAL    17
+#define ELF_R_RISCV_HI20   26
+#define ELF_R_RISCV_LO12_I 27
+#define ELF_R_RISCV_LO12_S 28
+
+// os segmentos do executavel ficam alinhados em pagina (o qemu faz mmap deles)
+#define ELF_PAGE_SIZE     0x1000
+
+typedef struct {
+    unsigned char e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} elf32_ehdr_t;
+
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+} elf32_phdr_t;
+
+typedef struct {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint32_t sh_flags;
+    uint32_t sh_addr;
+    uint32_t sh_offset;
+    uint32_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint32_t sh_addralign;
+    uint32_t sh_entsize;
+} elf32_shdr_t;
+
+typedef struct {
+    uint32_t st_name;
+    uint32_t st_value;
+    uint32_t st_size;
+    unsigned char st_info;
+    unsigned char st_other;
+    uint16_t st_shndx;
+} elf32_sym_t;
+
+typedef struct {
+    uint32_t r_offset;
+    uint32_t r_info;
+    int32_t r_addend;
+} elf32_rela_t;
+
+// os structs acima são gravados direto, então o host precisa ser little-endian
+// (x86 e arm em modo normal são)
+typedef char elf_sizes_check_t[(sizeof(elf32_ehdr_t) == 52 && sizeof(elf32_phdr_t) == 32 &&
+                                sizeof(elf32_shdr_t) == 40 && sizeof(elf32_sym_t) == 16 &&
+                                sizeof(elf32_rela_t) == 12) ? 1 : -1];
+
+// simbolo já no formato intermediario (vem da symbol_table_t ou do objeto)
+typedef struct {
+    const char* name;
+    uint32_t value;
+    uint8_t bind;
+    uint8_t defined;
+} elf_symbol_input_t;
+
+static inline uint32_t elf_reloc_type(RELOC_TYPE type) {
+    switch (type) {
+        case RELOC_BRANCH: return ELF_R_RISCV_BRANCH;
+        case RELOC_JAL:    return ELF_R_RISCV_JAL;
+        case RELOC_HI20:   return ELF_R_RISCV_HI20;
+        case RELOC_LO12_I: return ELF_R_RISCV_LO12_I;
+        case RELOC_LO12_S: return ELF_R_RISCV_LO12_S;
+        case RELOC_ABS32:  return ELF_R_RISCV_32;
+    }
+    return 0;
+}
+
+// nomes das seções, nessa ordem no .shstrtab
+static const char elf_shstrtab[] = "\0.text\0.symtab\0.strtab\0.rela.text\0.shstrtab";
+#define ELF_SHSTR_TEXT      1
+#define ELF_SHSTR_SYMTAB    7
+#define ELF_SHSTR_STRTAB    15
+#define ELF_SHSTR_RELA_TEXT 23
+#define ELF_SHSTR_SHSTRTAB  34
+
+static inline void elf_fill_ident(elf32_ehdr_t* eh, uint16_t type) {
+    memset(eh, 0, sizeof(*eh));
+    memcpy(eh->e_ident, "\x7f" "ELF", 4);
+    eh->e_ident[4] = 1;      // ELFCLASS32
+    eh->e_ident[5] = 1;      // ELFDATA2LSB
+    eh->e_ident[6] = 1;      // EV_CURRENT
+    eh->e_type = type;
+    eh->e_machine = ELF_EM_RISCV;
+    eh->e_version = 1;
+    eh->e_ehsize = sizeof(elf32_ehdr_t);
+    eh->e_shentsize = sizeof(elf32_shdr_t);
+}
+
+// monta .symtab e .strtab. locais primeiro (o ELF exige), 'remap' recebe o novo indice de cada
+// simbolo de entrada. retorna o indice do primeiro global (vai no sh_info do .symtab)
+static inline uint32_t elf_build_symtab(const elf_symbol_input_t* symbols, size_t count, uint16_t text_index,
+                                        out_buffer_t* symtab, out_buffer_t* strtab, uint32_t* remap) {
+    elf32_sym_t sym;
+
+    out_buffer_putc(strtab, '\0');
+    memset(&sym, 0, sizeof(sym));
+    out_buffer_append(symtab, (const char *)&sym, sizeof(sym));   // simbolo nulo
+
+    // simbolo de seção para o .text (o objdump usa para nomear os endereços sem label)
+    memset(&sym, 0, sizeof(sym));
+    sym.st_info = (ELF_STB_LOCAL << 4) | ELF_STT_SECTION;
+    sym.st_shndx = text_index;
+    out_buffer_append(symtab, (const char *)&sym, sizeof(sym));
+
+    uint32_t next = 2;
+    uint32_t first_global = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        uint8_t wanted = pass == 0 ? ELF_STB_LOCAL : ELF_STB_GLOBAL;
+        if (pass == 1) first_global = next;
+        for (size_t i = 0; i < count; ++i) {
+            if (symbols[i].bind != wanted) continue;
+            memset(&sym, 0, sizeof(sym));
+            sym.st_name = (uint32_t)strtab->len;
+            sym.st_value = symbols[i].value;
+            sym.st_info = (unsigned char)((symbols[i].bind << 4) | ELF_STT_NOTYPE);
+            sym.st_shndx = symbols[i].defined ? text_index : 0;
+            out_buffer_append(symtab, (const char *)&sym, sizeof(sym));
+            out_buffer_append(strtab, symbols[i].name, strlen(symbols[i].name) + 1);
+            remap[i] = next++;
+        }
+    }
+    return first_global;
+}
+
+#define ELF_MAX_PARTS 32
+
+// escreve todos os pedaços com um unico writev (ou fwrite em sequencia onde não tem writev)
+static inline int elf_write_parts(const char* filename, const void* const* parts, const size_t* sizes, int part_count) {
+#ifdef _WIN32
+    FILE* f = fopen(filename, "wb");
+    if (!f) return -1;
+    for (int i = 0; i < part_count; ++i) {
+        if (sizes[i] && fwrite(parts[i], 1, sizes[i], f) != sizes[i]) {
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+#else
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+    if (fd < 0) return -1;
+
+    struct iovec iov[ELF_MAX_PARTS];
+    size_t total = 0;
+    for (int i = 0; i < part_count && i < ELF_MAX_PARTS; ++i) {
+        iov[i].iov_base = (void *)parts[i];
+        iov[i].iov_len = sizes[i];
+        total += sizes[i];
+    }
+
+    // writev pode escrever menos que o pedido, então avança o iovec e tenta de novo
+    struct iovec* cur = iov;
+    int remaining_parts = part_count < ELF_MAX_PARTS ? part_count : ELF_MAX_PARTS;
+    while (total > 0) {
+        ssize_t written = writev(fd, cur, remaining_parts);
+        if (written <= 0) {
+            close(fd);
+            return -1;
+        }
+        total -= (size_t)written;
+        while (remaining_parts > 0 && (size_t)written >= cur->iov_len) {
+            written -= (ssize_t)cur->iov_len;
+            cur++;
+            remaining_parts--;
+        }
+        if (remaining_parts > 0) {
+            cur->iov_base = (char *)cur->iov_base + written;
+            cur->iov_len -= (size_t)written;
+        }
+    }
+    close(fd);
+    return 0;
+#endif
+}
+
+static inline uint32_t elf_align4(uint32_t v) {
+    return (v + 3u) & ~3u;
+}
+
+// ---------------------------------------------------------------------------
+// relocavel (ET_REL): .text + .symtab + .strtab + .rela.text + .shstrtab
+
+static inline int elf_write_relocatable(const object_t* obj, const char* filename) {
+    elf_symbol_input_t* symbols = (elf_symbol_input_t *)malloc((obj->symbol_count ? obj->symbol_count : 1) * sizeof(elf_symbol_input_t));
+    uint32_t* remap = (uint32_t *)malloc((obj->symbol_count ? obj->symbol_count : 1) * sizeof(uint32_t));
+    CHECK_ALLOC(symbols, exit(EXIT_FAILURE));
+    CHECK_ALLOC(remap, exit(EXIT_FAILURE));
+
+    for (size_t i = 0; i < obj->symbol_count; ++i) {
+        symbols[i].name = obj->symbols[i].name;
+        symbols[i].value = obj->symbols[i].value;
+        symbols[i].bind = obj->symbols[i].binding == OBJ_SYM_LOCAL ? ELF_STB_LOCAL : ELF_STB_GLOBAL;
+        symbols[i].defined = obj->symbols[i].binding != OBJ_SYM_UNDEF;
+    }
+
+    out_buffer_t symtab, strtab, rela;
+    out_buffer_init(&symtab, NULL);
+    out_buffer_init(&strtab, NULL);
+    out_buffer_init(&rela, NULL);
+
+    uint32_t first_global = elf_build_symtab(symbols, obj->symbol_count, 1, &symtab, &strtab, remap);
+
+    for (size_t i = 0; i < obj->reloc_count; ++i) {
+        elf32_rela_t r;
+        r.r_offset = obj->relocs[i].offset;
+        r.r_info = (remap[obj->relocs[i].symbol] << 8) | elf_reloc_type((RELOC_TYPE)obj->relocs[i].type);
+        r.r_addend = obj->relocs[i].addend;
+        out_buffer_append(&rela, (const char *)&r, sizeof(r));
+    }
+
+    // layout: ehdr | .text | .symtab | .strtab | .rela.text | .shstrtab | pad | shdrs
+    uint32_t text_size = (uint32_t)(obj->word_count * 4);
+    uint32_t off_text = sizeof(elf32_ehdr_t);
+    uint32_t off_symtab = off_text + text_size;
+    uint32_t off_strtab = off_symtab + (uint32_t)symtab.len;
+    uint32_t off_rela = elf_align4(off_strtab + (uint32_t)strtab.len);
+    uint32_t pad_strtab = off_rela - (off_strtab + (uint32_t)strtab.len);
+    uint32_t off_shstrtab = off_rela + (uint32_t)rela.len;
+    uint32_t off_shdrs = elf_align4(off_shstrtab + sizeof(elf_shstrtab));
+    uint32_t pad_shstrtab = off_shdrs - (off_shstrtab + sizeof(elf_shstrtab));
+
+    elf32_shdr_t sh[6];
+    memset(sh, 0, sizeof(sh));
+    sh[1] = (elf32_shdr_t){ELF_SHSTR_TEXT, ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_EXECINSTR, 0, off_text, text_size, 0, 0, 4, 0};
+    sh[2] = (elf32_shdr_t){ELF_SHSTR_SYMTAB, ELF_SHT_SYMTAB, 0, 0, off_symtab, (uint32_t)symtab.len, 3, first_global, 4, sizeof(elf32_sym_t)};
+    sh[3] = (elf32_shdr_t){ELF_SHSTR_STRTAB, ELF_SHT_STRTAB, 0, 0, off_strtab, (uint32_t)strtab.len, 0, 0, 1, 0};
+    sh[4] = (elf32_shdr_t){ELF_SHSTR_RELA_TEXT, ELF_SHT_RELA, ELF_SHF_INFO_LINK, 0, off_rela, (uint32_t)rela.len, 2, 1, 4, sizeof(elf32_rela_t)};
+    sh[5] = (elf32_shdr_t){ELF_SHSTR_SHSTRTAB, ELF_SHT_STRTAB, 0, 0, off_shstrtab, sizeof(elf_shstrtab), 0, 0, 1, 0};
+
+    elf32_ehdr_t eh;
+    elf_fill_ident(&eh, ELF_ET_REL);
+    eh.e_shoff = off_shdrs;
+    eh.e_shnum = 6;
+    eh.e_shstrndx = 5;
+
+    static const char zeros[4] = {0};
+    const void* parts[] = {&eh, obj->words, symtab.data, strtab.data, zeros, rela.data, elf_shstrtab, zeros, sh};
+    size_t sizes[] = {sizeof(eh), text_size, symtab.len, strtab.len, pad_strtab, rela.len, sizeof(elf_shstrtab), pad_shstrtab, sizeof(sh)};
+    int status = elf_write_parts(filename, parts, sizes, (int)(sizeof(sizes) / sizeof(sizes[0])));
+
+    out_buffer_free(&symtab);
+    out_buffer_free(&strtab);
+    out_buffer_free(&rela);
+    free(symbols);
+    free(remap);
+    return status;
+}
+
+// ---------------------------------------------------------------------------
+// executavel (ET_EXEC): um PT_LOAD por região (.text, .data) e entry point em 'entry'
+
+// região de memoria já montada que vira seção + segmento
+typedef struct {
+    const char* name;        // ".text", ".data"
+    uint8_t section;         // SECTION_ID (para achar a seção dos simbolos)
+    uint32_t address;
+    const void* bytes;
+    uint32_t size;
+    int executable;
+} elf_region_t;
+
+#define ELF_MAX_REGIONS 8
+
+static inline int elf_write_executable(const elf_region_t* all_regions, size_t region_count, const symbol_table_t* table,
+                                       uint32_t entry, uint32_t e_flags, const char* filename) {
+    // regiões vazias não viram segmento
+    elf_region_t regions[ELF_MAX_REGIONS];
+    size_t nreg = 0;
+    for (size_t r = 0; r < region_count && nreg < ELF_MAX_REGIONS; ++r)
+        if (all_regions[r].size > 0 || r == 0) regions[nreg++] = all_regions[r];
+
+    elf_symbol_input_t* symbols = (elf_symbol_input_t *)malloc((table->count ? table->count : 1) * sizeof(elf_symbol_input_t));
+    uint32_t* remap = (uint32_t *)malloc((table->count ? table->count : 1) * sizeof(uint32_t));
+    CHECK_ALLOC(symbols, exit(EXIT_FAILURE));
+    CHECK_ALLOC(remap, exit(EXIT_FAILURE));
+
+    // simbolos vão para a seção da região correspondente (indice da seção = regiao + 1)
+    uint16_t section_index[SECTION_COUNT] = {0};
+    for (size_t r = 0; r < nreg; ++r)
+        if (regions[r].section < SECTION_COUNT) section_index[regions[r].section] = (uint16_t)(r + 1);
+
+    for (size_t i = 0; i < table->count; ++i) {
+        symbols[i].name = table->entries[i].label;
+        symbols[i].value = table->entries[i].address;
+        symbols[i].bind = table->entries[i].binding == SYM_GLOBAL ? ELF_STB_GLOBAL : ELF_STB_LOCAL;
+        symbols[i].defined = 1;
+    }
+
+    out_buffer_t symtab, strtab, shstrtab;
+    out_buffer_init(&symtab, NULL);
+    out_buffer_init(&strtab, NULL);
+    out_buffer_init(&shstrtab, NULL);
+
+    uint32_t first_global = elf_build_symtab(symbols, table->count, 1, &symtab, &strtab, remap);
+
+    // corrige o st_shndx dos simbolos que não são do .text
+    elf32_sym_t* syms = (elf32_sym_t *)symtab.data;
+    for (size_t i = 0; i < table->count; ++i) {
+        uint8_t sec = table->entries[i].section;
+        if (sec < SECTION_COUNT && section_index[sec] != 0)
+            syms[remap[i]].st_shndx = section_index[sec];
+    }
+
+    // .shstrtab: nomes das regiões + as tabelas
+    uint32_t name_off[ELF_MAX_REGIONS + 3];
+    out_buffer_putc(&shstrtab, '\0');
+    for (size_t r = 0; r < nreg; ++r) {
+        name_off[r] = (uint32_t)shstrtab.len;
+        out_buffer_append(&shstrtab, regions[r].name, strlen(regions[r].name) + 1);
+    }
+    name_off[nreg] = (uint32_t)shstrtab.len;
+    out_buffer_append(&shstrtab, ".symtab", 8);
+    name_off[nreg + 1] = (uint32_t)shstrtab.len;
+    out_buffer_append(&shstrtab, ".strtab", 8);
+    name_off[nreg + 2] = (uint32_t)shstrtab.len;
+    out_buffer_append(&shstrtab, ".shstrtab", 10);
+
+    // cada região começa num offset congruente ao endereço virtual (modulo pagina), como o loader espera
+    uint32_t phdrs_size = (uint32_t)(nreg * sizeof(elf32_phdr_t));
+    uint32_t cursor = sizeof(elf32_ehdr_t) + phdrs_size;
+    uint32_t region_off[ELF_MAX_REGIONS], region_pad[ELF_MAX_REGIONS];
+    for (size_t r = 0; r < nreg; ++r) {
+        uint32_t page_start = (cursor + ELF_PAGE_SIZE - 1) & ~(uint32_t)(ELF_PAGE_SIZE - 1);
+        region_off[r] = page_start + (regions[r].address & (ELF_PAGE_SIZE - 1));
+        region_pad[r] = region_off[r] - cursor;
+        cursor = region_off[r] + regions[r].size;
+    }
+    uint32_t off_symtab = cursor;
+    uint32_t off_strtab = off_symtab + (uint32_t)symtab.len;
+    uint32_t off_shstrtab = off_strtab + (uint32_t)strtab.len;
+    uint32_t off_shdrs = elf_align4(off_shstrtab + (uint32_t)shstrtab.len);
+    uint32_t pad_shstrtab = off_shdrs - (off_shstrtab + (uint32_t)shstrtab.len);
+
+    uint16_t shnum = (uint16_t)(nreg + 4);
+    elf32_ehdr_t eh;
+    elf_fill_ident(&eh, ELF_ET_EXEC);
+    eh.e_entry = entry;
+    eh.e_flags = e_flags;
+    eh.e_phoff = sizeof(elf32_ehdr_t);
+    eh.e_phentsize = sizeof(elf32_phdr_t);
+    eh.e_phnum = (uint16_t)nreg;
+    eh.e_shoff = off_shdrs;
+    eh.e_shnum = shnum;
+    eh.e_shstrndx = (uint16_t)(shnum - 1);
+
+    elf32_phdr_t ph[ELF_MAX_REGIONS];
+    elf32_shdr_t sh[ELF_MAX_REGIONS + 4];
+    memset(sh, 0, sizeof(sh));
+    for (size_t r = 0; r < nreg; ++r) {
+        uint32_t flags = regions[r].executable ? (ELF_PF_R | ELF_PF_X) : (ELF_PF_R | ELF_PF_W);
+        ph[r] = (elf32_phdr_t){ELF_PT_LOAD, region_off[r], regions[r].address, regions[r].address,
+                               regions[r].size, regions[r].size, flags, ELF_PAGE_SIZE};
+        uint32_t sh_flags = ELF_SHF_ALLOC | (regions[r].executable ? ELF_SHF_EXECINSTR : ELF_SHF_WRITE);
+        sh[r + 1] = (elf32_shdr_t){name_off[r], ELF_SHT_PROGBITS, sh_flags, regions[r].address, region_off[r], regions[r].size, 0, 0, 4, 0};
+    }
+    uint32_t symtab_index = (uint32_t)nreg + 1;
+    sh[symtab_index] = (elf32_shdr_t){name_off[nreg], ELF_SHT_SYMTAB, 0, 0, off_symtab, (uint32_t)symtab.len, symtab_index + 1, first_global, 4, sizeof(elf32_sym_t)};
+    sh[symtab_index + 1] = (elf32_shdr_t){name_off[nreg + 1], ELF_SHT_STRTAB, 0, 0, off_strtab, (uint32_t)strtab.len, 0, 0, 1, 0};
+    sh[symtab_index + 2] = (elf32_shdr_t){name_off[nreg + 2], ELF_SHT_STRTAB, 0, 0, off_shstrtab, (uint32_t)shstrtab.len, 0, 0, 1, 0};
+
+    // pad maximo é menos de duas paginas
+    char* zero_pad = (char *)calloc(1, 2 * ELF_PAGE_SIZE);
+    CHECK_ALLOC(zero_pad, exit(EXIT_FAILURE));
+
+    const void* parts[2 * ELF_MAX_REGIONS + 8];
+    size_t sizes[2 * ELF_MAX_REGIONS + 8];
+    int n = 0;
+    parts[n] = &eh;           sizes[n++] = sizeof(eh);
+    parts[n] = ph;            sizes[n++] = phdrs_size;
+    for (size_t r = 0; r < nreg; ++r) {
+        parts[n] = zero_pad;        sizes[n++] = region_pad[r];
+        parts[n] = regions[r].bytes; sizes[n++] = regions[r].size;
+    }
+    parts[n] = symtab.data;   sizes[n++] = symtab.len;
+    parts[n] = strtab.data;   sizes[n++] = strtab.len;
+    parts[n] = shstrtab.data; sizes[n++] = shstrtab.len;
+    parts[n] = zero_pad;      sizes[n++] = pad_shstrtab;
+    parts[n] = sh;            sizes[n++] = shnum * sizeof(elf32_shdr_t);
+    int status = elf_write_parts(filename, parts, sizes, n);
+
+    free(zero_pad);
+    out_buffer_free(&symtab);
+    out_buffer_free(&strtab);
+    out_buffer_free(&shstrtab);
+    free(symbols);
+    free(remap);
+    return status;
+}
+
+// atalho para quando só existe o .text (saida do linker)
+static inline int elf_write_text_executable(const uint32_t* words, size_t word_count, const symbol_table_t* table,
+                                            uint32_t base, const char* filename) {
+    elf_region_t text = {".text", SECTION_TEXT, base, words, (uint32_t)(word_count * 4), 1};
+    return elf_write_executable(&text, 1, table, base, 0, filename);
+}
+
+#endif
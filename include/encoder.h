@@ -6,35 +6,258 @@
 #include "types.h"
 #include "encoding_table.h"
 #include "symbol_table.h"
+#include "relocation.h"
+#include "expr.h"
+#include "diag.h"
 
 #define ENCODING_ERROR_SENTINEL 0xFFFFFFFF 
+#define NOP_INSTRUCTION 0x00000013 // addi zero, zero, 0 (padding de alinhamento no .text)
+#define RVC_NOP_INSTRUCTION 0x0001  // c.nop (padding de 2 bytes quando tem instrução comprimida)
+
+// passes que só codificam para medir (ex: compressão) ligam isso para não repetir
+// as mensagens que a segunda passagem vai dar de qualquer jeito (um por thread, por causa do --serve)
+static THREAD_LOCAL int encoder_quiet = 0;
+#define ENCODER_ERROR(item, ...) do { if (!encoder_quiet) diag_error((item)->line_number, __VA_ARGS__); } while (0)
+
+// separa um operando "imm(rs1)" em imediato e registrador.
+// procura o ultimo '(' para aceitar coisas como "%lo(tabela)(t1)"
+static inline bool split_offset_base(const char* operand, char* imm_str, size_t imm_size, char* reg_str, size_t reg_size) {
+    const char* open = strrchr(operand, '(');
+    if (!open) return false;
+    const char* close = strchr(open, ')');
+    if (!close || close[1] != '\0') return false;
+
+    size_t imm_len = (size_t)(open - operand);
+    size_t reg_len = (size_t)(close - open - 1);
+    if (imm_len == 0 || imm_len >= imm_size || reg_len == 0 || reg_len >= reg_size) return false;
+
+    memcpy(imm_str, operand, imm_len);
+    imm_str[imm_len] = '\0';
+    rtrim(imm_str);
+    memcpy(reg_str, open + 1, reg_len);
+    reg_str[reg_len] = '\0';
+    return true;
+}
+
+// verifica se o operando é "%hi(simbolo)" ou "%lo(simbolo)" e copia o nome do simbolo
+static inline bool parse_symbol_ref(const char* str, const char* prefix, char* name, size_t name_size) {
+    size_t prefix_len = strlen(prefix);
+    if (strncmp(str, prefix, prefix_len) != 0 || str[prefix_len] != '(') return false;
+
+    const char* start = str + prefix_len + 1;
+    const char* end = strchr(start, ')');
+    if (!end || end[1] != '\0') return false;
+
+    size_t len = (size_t)(end - start);
+    if (len == 0 || len >= name_size) return false;
+    memcpy(name, start, len);
+    name[len] = '\0';
+    return true;
+}
+
+// texto do operando que é imediato (ou destino) na instrução, NULL se ela não tem.
+// o "imm" de "imm(rs1)" é copiado em 'buffer'
+static inline const char* item_immediate_text(const instruction_t* item, char* buffer, size_t size) {
+    if (item->kind == ITEM_DATA) return item->operand_count == 1 ? item->operands[0] : NULL;
+    if (item->kind != ITEM_INSTRUCTION || item->operand_count == 0) return NULL;
+
+    const instruction_entry_t* entry = find_instruction(item->mnemonic);
+    if (!entry) return NULL;
+    char reg[SOURCE_LINE_MAX];
+    switch (entry->format) {
+        case FMT_I:
+        case FMT_SHIFT:
+        case FMT_BRANCH:
+            return item->operand_count == 3 ? item->operands[2] : NULL;
+        case FMT_U:
+            return item->operand_count == 2 ? item->operands[1] : NULL;
+        case FMT_JAL:
+            return item->operands[item->operand_count - 1];
+        case FMT_LOAD:
+        case FMT_STORE:
+        case FMT_JALR:
+            if (item->operand_count == 3) return item->operands[2];
+            if (item->operand_count == 2 && split_offset_base(item->operands[1], buffer, size, reg, sizeof(reg)))
+                return buffer;
+            return NULL;
+        default:
+            return NULL;
+    }
+}
+
+// compila o imediato do item recem parseado. erro de sintaxe fica para o encoder reportar
+static inline void item_compile_expr(instruction_t* item) {
+    char buffer[SOURCE_LINE_MAX];
+    const char* text = item_immediate_text(item, buffer, sizeof(buffer));
+    const char* error;
+    if (text) item->expr = expr_compile(text, &error);
+}
 
-// converte uma string de imediato (decimal ou hexadecimal) para um valor int32_t.
-static inline int32_t parse_immediate(const char* imm_str, bool* success) {
-    if (imm_str == NULL) {
+// expressão compilada de 'text'. reaproveita a do parse se o operando não mudou (a relaxação,
+// por exemplo, troca o destino do branch); senão compila em '*scratch', que quem chama libera
+static inline const expr_t* item_expr(const instruction_t* item, const char* text, expr_t** scratch) {
+    *scratch = NULL;
+    if (item->expr && strcmp(item->expr->text, text) == 0) return item->expr;
+
+    const char* error;
+    *scratch = expr_compile(text, &error);
+    if (!*scratch)
+        ENCODER_ERROR(item, "expressao '%s' invalida para '%s': %s.", text, item->mnemonic, error);
+    return *scratch;
+}
+
+// valor que não cabe em 32 bits não pode simplesmente ser truncado (0x1FFFFFFFF virava -1)
+static inline bool item_value_fits(const instruction_t* item, const char* text, int64_t value) {
+    if (value >= INT32_MIN && value <= (int64_t)UINT32_MAX) return true;
+    ENCODER_ERROR(item, "imediato '%s' nao cabe em 32 bits para '%s'.", text, item->mnemonic);
+    return false;
+}
+
+static inline expr_env_t item_expr_env(const instruction_t* item, const symbol_table_t* symbols, uint32_t pc, bool relocatable) {
+    expr_env_t env = {symbols, pc, item->section, true, relocatable, item->line_number};
+    return env;
+}
+
+// avalia o imediato. false (já com a mensagem) se não deu.
+// 'undefined' é a mensagem de simbolo que falta (recebe o nome e a mnemonic)
+static inline bool item_eval(const instruction_t* item, const char* text, const expr_env_t* env, const char* undefined,
+                             const expr_t** e, expr_t** scratch, expr_result_t* result) {
+    *e = item_expr(item, text, scratch);
+    if (!*e) return false;
+    EXPR_STATUS status = expr_eval(*e, env, result);
+    if (status == EXPR_UNDEFINED) {
+        // expressão já resolvida pelo bind_symbols: o simbolo que falta já foi reportado lá
+        if (!((*e)->flags & EXPR_FLAG_BOUND))
+            ENCODER_ERROR(item, undefined, result->error, item->mnemonic);
+        return false;
+    }
+    if (status == EXPR_ERROR) {
+        ENCODER_ERROR(item, "expressao '%s' invalida para '%s': %s.", text, item->mnemonic, result->error);
+        return false;
+    }
+    return true;
+}
+
+// imediato absoluto (type diz onde ele cai na instrução, e qual %hi/%lo vira relocação).
+// com 'relocs' != NULL (objeto relocavel) o endereço final ainda não é conhecido: o que depende
+// de simbolo vira relocação com addend e o campo fica zerado para o linker preencher
+static inline int32_t parse_immediate_or_symbol(const char* imm_str, RELOC_TYPE type, const instruction_t* parsed_inst,
+                                                const symbol_table_t* symbols, reloc_list_t* relocs, bool* success) {
+    *success = false;
+    if (imm_str == NULL) return 0;
+
+    expr_env_t env = item_expr_env(parsed_inst, symbols, parsed_inst->address, relocs != NULL);
+    const expr_t* e;
+    expr_t* scratch;
+    expr_result_t r;
+    int32_t value = 0;
+    if (item_eval(parsed_inst, imm_str, &env, "simbolo '%s' nao encontrado para '%s'.", &e, &scratch, &r)) {
+        if (!r.symbol) {
+            value = (int32_t)r.value;
+            *success = item_value_fits(parsed_inst, imm_str, r.value);
+        } else if (strcmp(r.symbol, ".") == 0) {
+            ENCODER_ERROR(parsed_inst, "'.' em '%s' nao vira relocacao no objeto, use uma label.", imm_str);
+        } else if (r.modifier != (type == RELOC_HI20 ? EXPR_HI : EXPR_LO)) {
+            ENCODER_ERROR(parsed_inst, "endereco em '%s' precisa de %s() no objeto relocavel.", imm_str, type == RELOC_HI20 ? "%hi" : "%lo");
+        } else {
+            reloc_list_add(relocs, parsed_inst->address, type, r.symbol, (int32_t)r.addend);
+            *success = true;
+        }
+    }
+    expr_free(scratch);
+    return value;
+}
+
+// destino de branch/jal: label (ou expressão com label/'.') vira offset do pc, numero puro já é o offset.
+// no objeto, label de fora do modulo vira relocação 'type'
+static inline int32_t parse_branch_target(const char* target, RELOC_TYPE type, const instruction_t* parsed_inst,
+                                          const symbol_table_t* symbols, uint32_t current_address,
+                                          reloc_list_t* relocs, bool* success) {
+    *success = false;
+    expr_env_t env = item_expr_env(parsed_inst, symbols, current_address, relocs != NULL);
+    const expr_t* e;
+    expr_t* scratch;
+    expr_result_t r;
+    int32_t offset = 0;
+    if (!item_eval(parsed_inst, target, &env, "label '%s' nao encontrado e nao e um offset valido para '%s'.", &e, &scratch, &r)) {
+        expr_free(scratch);
+        return 0;
+    }
+    if (r.symbol && !r.local) {
+        reloc_list_add(relocs, current_address, type, r.symbol, (int32_t)r.addend);
+    } else if (r.symbol || (e->flags & (EXPR_FLAG_SYMBOL | EXPR_FLAG_DOT))) {
+        offset = (int32_t)((uint32_t)r.value - current_address);
+    } else {
+        offset = (int32_t)r.value;
+    }
+    *success = (r.symbol && !r.local) || item_value_fits(parsed_inst, target, r.value);
+    expr_free(scratch);
+    return offset;
+}
+
+static inline uint32_t encode_instruction_reloc(const instruction_t* parsed_inst, const symbol_table_t* symbols,
+                                                uint32_t current_address, reloc_list_t* relocs);
+
+// valor de um item de dados (.word/.half/.byte): expressão, que pode usar labels.
+// no modo objeto o que depende de label vira relocação ABS32 (só no .word)
+static inline uint32_t encode_data_item(const instruction_t* item, const symbol_table_t* symbols,
+                                        reloc_list_t* relocs, bool* success) {
+    const char* operand = item->operands[0];
+    expr_env_t env = item_expr_env(item, symbols, item->address, relocs != NULL);
+    const expr_t* e;
+    expr_t* scratch;
+    expr_result_t r;
+    *success = item_eval(item, operand, &env, "label '%s' nao encontrado para '%s'.", &e, &scratch, &r);
+    expr_free(scratch);
+    if (!*success) return 0;
+
+    if (r.symbol) {
         *success = false;
+        if (item->size != 4) {
+            ENCODER_ERROR(item, "valor '%s' invalido para '%s'.", operand, item->mnemonic);
+        } else if (r.modifier || strcmp(r.symbol, ".") == 0) {
+            ENCODER_ERROR(item, "valor '%s' nao vira relocacao no objeto.", operand);
+        } else {
+            reloc_list_add(relocs, item->address, RELOC_ABS32, r.symbol, (int32_t)r.addend);
+            *success = true;
+        }
         return 0;
     }
-    char* endptr;
-    long val = strtol(imm_str, &endptr, 0);
-    if (endptr == imm_str || *endptr != '\0') { 
+
+    // .half e .byte aceitam tanto com sinal quanto sem sinal
+    if (item->size < 4) {
+        int bits = (int)item->size * 8;
+        if (r.value < -(1 << (bits - 1)) || r.value > (1 << bits) - 1) {
+            ENCODER_ERROR(item, "valor '%s' nao cabe em '%s'.", operand, item->mnemonic);
+            *success = false;
+            return 0;
+        }
+        return (uint32_t)r.value & ((1u << bits) - 1);
+    }
+    if (r.value < INT32_MIN || r.value > (int64_t)UINT32_MAX) {
+        ENCODER_ERROR(item, "valor '%s' nao cabe em '%s'.", operand, item->mnemonic);
         *success = false;
         return 0;
     }
-    *success = true;
-    return (int32_t)val;
+    return (uint32_t)r.value;
 }
 
-
 // codifica uma instrução parseada para seu formato binário de 32 bits.
 static inline uint32_t encode_instruction(const instruction_t* parsed_inst, 
                                           const symbol_table_t* symbols, 
                                           uint32_t current_address) {
+    return encode_instruction_reloc(parsed_inst, symbols, current_address, NULL);
+}
+
+// igual à encode_instruction, mas labels que não estão na tabela (externas) e %hi/%lo viram
+// relocações em 'relocs' em vez de erro. usado para gerar objeto relocavel (-c)
+static inline uint32_t encode_instruction_reloc(const instruction_t* parsed_inst, const symbol_table_t* symbols,
+                                                uint32_t current_address, reloc_list_t* relocs) {
     if (!parsed_inst) return ENCODING_ERROR_SENTINEL;
 
     const instruction_entry_t* entry = find_instruction(parsed_inst->mnemonic);
     if (!entry) {
-        fprintf(stderr, "erro (linha %u): mnemonico desconhecido '%s'.\n", parsed_inst->line_number, parsed_inst->mnemonic);
+        ENCODER_ERROR(parsed_inst, "mnemonico desconhecido '%s'.", parsed_inst->mnemonic);
         return ENCODING_ERROR_SENTINEL;
     }
 
@@ -50,7 +273,7 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
     switch (entry->type) {
         case INST_R:
             if (parsed_inst->operand_count != 3) {
-                fprintf(stderr, "erro (linha %u): instrução '%s' (R-type) requer 3 operandos.\n", parsed_inst->line_number, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "instrução '%s' (R-type) requer 3 operandos.", entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
             rd  = get_register_number(parsed_inst->operands[0]);
@@ -58,8 +281,7 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
             rs2 = get_register_number(parsed_inst->operands[2]);
 
             if (rd == -1 || rs1 == -1 || rs2 == -1) {
-                fprintf(stderr, "erro (linha %u): Nome de registrador inválido para '%s'. rd:%s rs1:%s rs2:%s\n", 
-                        parsed_inst->line_number, entry->mnemonic, parsed_inst->operands[0], parsed_inst->operands[1], parsed_inst->operands[2]);
+                ENCODER_ERROR(parsed_inst, "nome de registrador inválido para '%s'. rd:%s rs1:%s rs2:%s", entry->mnemonic, parsed_inst->operands[0], parsed_inst->operands[1], parsed_inst->operands[2]);
                 return ENCODING_ERROR_SENTINEL;
             }
 
@@ -77,63 +299,89 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
 
             // resolvendo particularidades de algumas instruções
 
-            if (strcmp(entry->mnemonic, "lw") == 0 || strcmp(entry->mnemonic, "lb") == 0 || strcmp(entry->mnemonic, "lh") == 0 ||
-                strcmp(entry->mnemonic, "lbu") == 0 || strcmp(entry->mnemonic, "lhu") == 0) { // lw rd, imm(rs1)
+            if (entry->format == FMT_SYSTEM) { // ecall/ebreak, tudo fixo na tabela
+                if (parsed_inst->operand_count != 0) {
+                    ENCODER_ERROR(parsed_inst, "instrucao '%s' nao tem operandos.", entry->mnemonic);
+                    return ENCODING_ERROR_SENTINEL;
+                }
+                rd = 0;
+                rs1 = 0;
+                imm_val = entry->imm12;
+
+            } else if (entry->format == FMT_FENCE) { // fence [pred, succ], sem operandos = iorw, iorw
+                if (parsed_inst->operand_count != 0 && parsed_inst->operand_count != 2) {
+                    ENCODER_ERROR(parsed_inst, "instrucao '%s' requer 0 ou 2 operandos.", entry->mnemonic);
+                    return ENCODING_ERROR_SENTINEL;
+                }
+                int32_t sets[2] = {0xF, 0xF};
+                for (int k = 0; k < parsed_inst->operand_count; k++) {
+                    sets[k] = 0;
+                    for (const char* c = parsed_inst->operands[k]; *c; c++) {
+                        const char* pos = strchr("wroi", *c); // bit 0 = w ... bit 3 = i
+                        if (!pos) {
+                            ENCODER_ERROR(parsed_inst, "conjunto '%s' invalido para 'fence' (use i, o, r, w).", parsed_inst->operands[k]);
+                            return ENCODING_ERROR_SENTINEL;
+                        }
+                        sets[k] |= 1 << (pos - "wroi");
+                    }
+                }
+                rd = 0;
+                rs1 = 0;
+                imm_val = (sets[0] << 4) | sets[1];
+
+            } else if (entry->format == FMT_LOAD) { // lw rd, imm(rs1)
                 if (parsed_inst->operand_count != 2) {
-                    fprintf(stderr, "erro (linha %u): Instrução '%s' (I-type load) requer 2 operandos no formato rd, imm(rs1).\n", parsed_inst->line_number, entry->mnemonic);
+                    ENCODER_ERROR(parsed_inst, "instrução '%s' (I-type load) requer 2 operandos no formato rd, imm(rs1).", entry->mnemonic);
                     return ENCODING_ERROR_SENTINEL;
                 }
                 rd = get_register_number(parsed_inst->operands[0]);
 
                 // parse "imm(rs1)" (poderia ter feito no parser, mas esqueci que que tinha isso)
-                char imm_str[32], rs1_str[8]; // buffers temporários
-                if (sscanf(parsed_inst->operands[1], "%31[^()](%7[^)])", imm_str, rs1_str) != 2) {
-                     fprintf(stderr, "erro (linha %u): formato de operando invalido para '%s'. esperado 'imm(rs1)', recebido '%s'.\n", parsed_inst->line_number, entry->mnemonic, parsed_inst->operands[1]);
+                char imm_str[SOURCE_LINE_MAX], rs1_str[8]; // buffers temporários
+                if (!split_offset_base(parsed_inst->operands[1], imm_str, sizeof(imm_str), rs1_str, sizeof(rs1_str))) {
+                     ENCODER_ERROR(parsed_inst, "formato de operando invalido para '%s'. esperado 'imm(rs1)', recebido '%s'.", entry->mnemonic, parsed_inst->operands[1]);
                      return ENCODING_ERROR_SENTINEL;
                 }
                 rs1 = get_register_number(rs1_str);
-                imm_val = parse_immediate(imm_str, &imm_success);
+                imm_val = parse_immediate_or_symbol(imm_str, RELOC_LO12_I, parsed_inst, symbols, relocs, &imm_success);
 
-            } else if (strcmp(entry->mnemonic, "slli") == 0 || strcmp(entry->mnemonic, "srli") == 0 || strcmp(entry->mnemonic, "srai") == 0 ) { 
+            } else if (entry->format == FMT_SHIFT) {
                  if (parsed_inst->operand_count != 3) {
-                    fprintf(stderr, "erro (linha %u): Instrucao '%s' (I-type shift) requer 3 operandos.\n", parsed_inst->line_number, entry->mnemonic);
+                    ENCODER_ERROR(parsed_inst, "instrucao '%s' (I-type shift) requer 3 operandos.", entry->mnemonic);
                     return ENCODING_ERROR_SENTINEL;
                 }
                 rd = get_register_number(parsed_inst->operands[0]);
                 rs1 = get_register_number(parsed_inst->operands[1]);
-                imm_val = parse_immediate(parsed_inst->operands[2], &imm_success); // shamt
+                imm_val = parse_immediate_or_symbol(parsed_inst->operands[2], RELOC_LO12_I, parsed_inst, symbols, NULL, &imm_success); // shamt
                 if (imm_success && (imm_val < 0 || imm_val > 0x1F)) { // shamt é de 5 bits (0-31) para RV32I
-                    fprintf(stderr, "Erro (linha %u): Valor de shamt '%s' fora do range (0-31) para '%s'.\n", parsed_inst->line_number, parsed_inst->operands[2], entry->mnemonic);
+                    ENCODER_ERROR(parsed_inst, "valor de shamt '%s' fora do range (0-31) para '%s'.", parsed_inst->operands[2], entry->mnemonic);
                     imm_success = false;
                 }
 
                 // para shifts I-type, o campo 'imm' de 12 bits é construído:
                 // imm[11:5] é o funct7 da tabela (0b0000000 para slli/srli, 0b0100000 para srai)
                 // imm[4:0] é o shamt
-                // a tabela já tem funct7 = 0 para slli e srli. Precisaremos de SRAI.
 
                 uint32_t shamt_bits = (uint32_t)imm_val & 0x1F;
                 uint32_t funct7_bits_for_shift = (uint32_t)entry->funct7 & 0x7F; // funct7 é 7 bits
-                if (strcmp(entry->mnemonic, "srai") == 0) funct7_bits_for_shift = 0b0100000; // hardcode SRAI(não tem na tabela de max)
 
                 imm_val = (int32_t)((funct7_bits_for_shift << 5) | shamt_bits);
             } else {
 
                 if (parsed_inst->operand_count < 1 || parsed_inst->operand_count > 3) { // JALR pode ter 2 ou 3
-                    fprintf(stderr, "erro (linha %u): instrucao '%s' (I-type) numero de operandos invalido.\n", parsed_inst->line_number, entry->mnemonic);
+                    ENCODER_ERROR(parsed_inst, "instrucao '%s' (I-type) numero de operandos invalido.", entry->mnemonic);
                     return ENCODING_ERROR_SENTINEL;
                 }
 
                 rd = get_register_number(parsed_inst->operands[0]);
-                if (strcmp(entry->mnemonic, "jalr") == 0) {
+                if (entry->format == FMT_JALR) {
                     if (parsed_inst->operand_count == 1) {
                         // formato jalr ra
                         const char* reg_name = parsed_inst->operands[0];
                         int reg_num = get_register_number(reg_name);
 
                         if (reg_num == -1) {
-                            fprintf(stderr, "erro (linha %u): registrador '%s' invalido para JALR de 1 operando.\n",
-                                    parsed_inst->line_number, reg_name);
+                            ENCODER_ERROR(parsed_inst, "registrador '%s' invalido para JALR de 1 operando.", reg_name);
                             return ENCODING_ERROR_SENTINEL;
                         }
                         rd = 1;  // rd é sempre o x1 aparentemente (ra)
@@ -142,11 +390,11 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
                 imm_success = true;
                     } else if (parsed_inst->operand_count == 2) {
                         rd = get_register_number(parsed_inst->operands[0]);
-                        char imm_str_jalr[32], rs1_str_jalr[8];
-                        if (sscanf(parsed_inst->operands[1], "%31[^()](%7[^)])", imm_str_jalr, rs1_str_jalr) == 2) {
+                        char imm_str_jalr[SOURCE_LINE_MAX], rs1_str_jalr[8];
+                        if (split_offset_base(parsed_inst->operands[1], imm_str_jalr, sizeof(imm_str_jalr), rs1_str_jalr, sizeof(rs1_str_jalr))) {
                             // formato jalr rd, imm(rs1)
                             rs1 = get_register_number(rs1_str_jalr);
-                            imm_val = parse_immediate(imm_str_jalr, &imm_success);
+                            imm_val = parse_immediate_or_symbol(imm_str_jalr, RELOC_LO12_I, parsed_inst, symbols, relocs, &imm_success);
                         } else {
                             // formato jalr rd, rs1 
                             rs1 = get_register_number(parsed_inst->operands[1]);
@@ -156,30 +404,30 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
                     } else if (parsed_inst->operand_count == 3) {
                         rd = get_register_number(parsed_inst->operands[0]);
                         rs1 = get_register_number(parsed_inst->operands[1]);
-                        imm_val = parse_immediate(parsed_inst->operands[2], &imm_success);
+                        imm_val = parse_immediate_or_symbol(parsed_inst->operands[2], RELOC_LO12_I, parsed_inst, symbols, relocs, &imm_success);
                     } else {
-                        fprintf(stderr, "erro (linha %u): instrucao '%s' (JALR) requer 1, 2 ou 3 operandos. Recebido %d.\n", parsed_inst->line_number, entry->mnemonic, parsed_inst->operand_count);
+                        ENCODER_ERROR(parsed_inst, "instrucao '%s' (JALR) requer 1, 2 ou 3 operandos. Recebido %d.", entry->mnemonic, parsed_inst->operand_count);
                         return ENCODING_ERROR_SENTINEL;
                     }
                 } else { // addi
                     if (parsed_inst->operand_count != 3) {
-                         fprintf(stderr, "erro (linha %u): instrução '%s' (I-type arith/logic) requer 3 operandos.\n", parsed_inst->line_number, entry->mnemonic);
+                         ENCODER_ERROR(parsed_inst, "instrução '%s' (I-type arith/logic) requer 3 operandos.", entry->mnemonic);
                          return ENCODING_ERROR_SENTINEL;
                     }
                     rs1 = get_register_number(parsed_inst->operands[1]);
-                    imm_val = parse_immediate(parsed_inst->operands[2], &imm_success);
+                    imm_val = parse_immediate_or_symbol(parsed_inst->operands[2], RELOC_LO12_I, parsed_inst, symbols, relocs, &imm_success);
                 }
             }
             
             if (rd == -1 || rs1 == -1 || !imm_success) {
-                fprintf(stderr, "erro (linha %u): operando invalido para '%s'. rd:%d rs1:%d imm_ok:%d\n", parsed_inst->line_number, entry->mnemonic, rd, rs1, imm_success);
+                ENCODER_ERROR(parsed_inst, "operando invalido para '%s'. rd:%d rs1:%d imm_ok:%d", entry->mnemonic, rd, rs1, imm_success);
                 return ENCODING_ERROR_SENTINEL;
             }
             // checagem de range do imediato de 12 bits
             if (imm_val < -2048 || imm_val > 2047) {
                  // para slli/srli/srai, imm_val já contém funct7 e shamt, não é um imediato de 12 bits puro
-                if (!(strcmp(entry->mnemonic, "slli") == 0 || strcmp(entry->mnemonic, "srli") == 0 || strcmp(entry->mnemonic, "srai") == 0)) {
-                    fprintf(stderr, "Erro (linha %u): Imediato '%s' fora do range (-2048 a 2047) para '%s'.\n", parsed_inst->line_number, parsed_inst->operands[parsed_inst->operand_count-1], entry->mnemonic);
+                if (entry->format != FMT_SHIFT) {
+                    ENCODER_ERROR(parsed_inst, "imediato '%s' fora do range (-2048 a 2047) para '%s'.", parsed_inst->operands[parsed_inst->operand_count-1], entry->mnemonic);
                     return ENCODING_ERROR_SENTINEL;
                 }
             }
@@ -191,25 +439,25 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
 
         case INST_S: // sw rs2, imm(rs1)
             if (parsed_inst->operand_count != 2) {
-                fprintf(stderr, "erro (linha %u): instrucao '%s' (S-type) requer 2 operandos no formato rs2, imm(rs1).\n", parsed_inst->line_number, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "instrucao '%s' (S-type) requer 2 operandos no formato rs2, imm(rs1).", entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
             rs2 = get_register_number(parsed_inst->operands[0]);
             
-            char imm_s_str[32], rs1_s_str[8];
-            if (sscanf(parsed_inst->operands[1], "%31[^()](%7[^)])", imm_s_str, rs1_s_str) != 2) {
-                 fprintf(stderr, "erro (linha %u): formato de operando invalido para '%s'. esperado 'imm(rs1)', recebido '%s'.\n", parsed_inst->line_number, entry->mnemonic, parsed_inst->operands[1]);
+            char imm_s_str[SOURCE_LINE_MAX], rs1_s_str[8];
+            if (!split_offset_base(parsed_inst->operands[1], imm_s_str, sizeof(imm_s_str), rs1_s_str, sizeof(rs1_s_str))) {
+                 ENCODER_ERROR(parsed_inst, "formato de operando invalido para '%s'. esperado 'imm(rs1)', recebido '%s'.", entry->mnemonic, parsed_inst->operands[1]);
                  return ENCODING_ERROR_SENTINEL;
             }
             rs1 = get_register_number(rs1_s_str);
-            imm_val = parse_immediate(imm_s_str, &imm_success);
+            imm_val = parse_immediate_or_symbol(imm_s_str, RELOC_LO12_S, parsed_inst, symbols, relocs, &imm_success);
 
             if (rs1 == -1 || rs2 == -1 || !imm_success) {
-                fprintf(stderr, "erro (linha %u): operando invalido para '%s'.\n", parsed_inst->line_number, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "operando invalido para '%s'.", entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
             if (imm_val < -2048 || imm_val > 2047) {
-                fprintf(stderr, "erro (linha %u): imediato '%s' fora do range (-2048 a 2047) para '%s'.\n", parsed_inst->line_number, imm_s_str, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "imediato '%s' fora do range (-2048 a 2047) para '%s'.", imm_s_str, entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
 
@@ -223,34 +471,22 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
 
         case INST_B: // beq rs1, rs2, label
             if (parsed_inst->operand_count != 3) {
-                fprintf(stderr, "erro (linha %u): instrucao '%s' (B-type) requer 3 operandos.\n", parsed_inst->line_number, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "instrucao '%s' (B-type) requer 3 operandos.", entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
             rs1 = get_register_number(parsed_inst->operands[0]);
             rs2 = get_register_number(parsed_inst->operands[1]);
             
-            int32_t target_addr_b = symbol_table_lookup(symbols, parsed_inst->operands[2]);
-            if (target_addr_b == -1 && strcmp(parsed_inst->operands[2], "-1") != 0) { // checa se label não foi encontrado
-                
-                // tentar fazer o parser como imediato (offset direto)
-                imm_val = parse_immediate(parsed_inst->operands[2], &imm_success);
-                if (!imm_success) {
-                    fprintf(stderr, "erro (linha %u): label '%s' nao encontrado e nao e um offset valido para '%s'.\n", parsed_inst->line_number, parsed_inst->operands[2], entry->mnemonic);
-                    return ENCODING_ERROR_SENTINEL;
-                }
-                // se for um offset direto, ele já é o imm_val
-            } else {
-                 imm_val = target_addr_b - (int32_t)current_address; // offset relativo ao PC
-            }
-
+            imm_val = parse_branch_target(parsed_inst->operands[2], RELOC_BRANCH, parsed_inst, symbols, current_address, relocs, &imm_success);
+            if (!imm_success) return ENCODING_ERROR_SENTINEL;
 
             if (rs1 == -1 || rs2 == -1) {
-                fprintf(stderr, "erro (linha %u): registrador invalido para '%s'.\n", parsed_inst->line_number, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "registrador invalido para '%s'.", entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
             
             if (imm_val < -4096 || imm_val > 4094 || (imm_val % 2 != 0)) {
-                fprintf(stderr, "erro (linha %u): offset de branch '%s' (valor %d) fora do range ou nao e multiplo de 2 para '%s'.\n", parsed_inst->line_number, parsed_inst->operands[2], imm_val, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "offset de branch '%s' (valor %d) fora do range ou nao e multiplo de 2 para '%s'.", parsed_inst->operands[2], imm_val, entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
 
@@ -266,19 +502,19 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
 
         case INST_U: // lui rd, imm
             if (parsed_inst->operand_count != 2) {
-                fprintf(stderr, "erro (linha %u): instrucao '%s' (U-type) requer 2 operandos.\n", parsed_inst->line_number, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "instrucao '%s' (U-type) requer 2 operandos.", entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
             rd = get_register_number(parsed_inst->operands[0]);
-            imm_val = parse_immediate(parsed_inst->operands[1], &imm_success);
+            imm_val = parse_immediate_or_symbol(parsed_inst->operands[1], RELOC_HI20, parsed_inst, symbols, relocs, &imm_success);
 
             if (rd == -1 || !imm_success) {
-                fprintf(stderr, "erro (linha %u): operando invalido para '%s'.\n", parsed_inst->line_number, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "operando invalido para '%s'.", entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
             
             if (imm_val < 0 || imm_val > 0xFFFFF) { 
-                fprintf(stderr, "erro (linha %u): imediato U-type '%s' fora do range (0 a 0xFFFFF).\n", parsed_inst->line_number, parsed_inst->operands[1], entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "imediato U-type '%s' fora do range (0 a 0xFFFFF).", parsed_inst->operands[1], entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
             
@@ -289,7 +525,7 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
 
         case INST_J: // jal rd, label  (ou jal label, que é jal ra, label)
             if (parsed_inst->operand_count < 1 || parsed_inst->operand_count > 2) {
-                fprintf(stderr, "Erro (linha %u): Instrução '%s' (J-type) requer 1 ou 2 operandos.\n", parsed_inst->line_number, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "instrução '%s' (J-type) requer 1 ou 2 operandos.", entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
 
@@ -303,24 +539,16 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
                 label_str_j = parsed_inst->operands[0];
             }
 
-            int32_t target_addr_j = symbol_table_lookup(symbols, label_str_j);
-             if (target_addr_j == -1 && strcmp(label_str_j, "-1") != 0) {
-                imm_val = parse_immediate(label_str_j, &imm_success);
-                if (!imm_success) {
-                    fprintf(stderr, "erro (linha %u): label '%s' nao encontrado e nao e um offset valido para '%s'.\n", parsed_inst->line_number, label_str_j, entry->mnemonic);
-                    return ENCODING_ERROR_SENTINEL;
-                }
-            } else {
-                imm_val = target_addr_j - (int32_t)current_address;
-            }
+            imm_val = parse_branch_target(label_str_j, RELOC_JAL, parsed_inst, symbols, current_address, relocs, &imm_success);
+            if (!imm_success) return ENCODING_ERROR_SENTINEL;
 
             if (rd == -1) {
-                fprintf(stderr, "Eerro (linha %u): registrador invalido para '%s'.\n", parsed_inst->line_number, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "registrador invalido para '%s'.", entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
 
             if (imm_val < -1048576 || imm_val > 1048574 || (imm_val % 2 != 0)) {
-                fprintf(stderr, "erro (linha %u): offset de jump '%s' (valor %d) fora do range ou nao e multiplo de 2 para '%s'.\n", parsed_inst->line_number, label_str_j, imm_val, entry->mnemonic);
+                ENCODER_ERROR(parsed_inst, "offset de jump '%s' (valor %d) fora do range ou nao e multiplo de 2 para '%s'.", label_str_j, imm_val, entry->mnemonic);
                 return ENCODING_ERROR_SENTINEL;
             }
 
@@ -333,7 +561,7 @@ static inline uint32_t encode_instruction(const instruction_t* parsed_inst,
             break;
             
         default:
-            fprintf(stderr, "erro (linha %u): tipo de instrucao desconhecido ou nao suportado '%d' para '%s'.\n", parsed_inst->line_number, entry->type, entry->mnemonic);
+            ENCODER_ERROR(parsed_inst, "tipo de instrucao desconhecido ou nao suportado '%d' para '%s'.", entry->type, entry->mnemonic);
             return ENCODING_ERROR_SENTINEL;
     }
 
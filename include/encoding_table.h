@@ -45,48 +45,164 @@ static const register_entry_t reg_table[] = {
     {"t6", 31},  {"x31", 31}
 };
 
+// nome ABI de cada registrador (caminho inverso, usado pelo disassembler)
+static const char* const reg_abi_names[32] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+    "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+    "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+// indice depois da letra: "0".."31" sem zero à esquerda, -1 se não é numero
+static inline int register_suffix(const char* p) {
+    if (p[0] < '0' || p[0] > '9') return -1;
+    if (p[1] == '\0') return p[0] - '0';
+    if (p[0] == '0' || p[1] < '0' || p[1] > '9' || p[2] != '\0') return -1;
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+// mesmos nomes da reg_table, mas decodificados direto pela primeira letra (é chamada para
+// todo operando, a busca linear pela tabela aparecia no perfil do --serve)
 static inline int get_register_number(const char *name) {
-    for (size_t i = 0; i < sizeof(reg_table)/sizeof(reg_table[0]); i++)
-        if (strcmp(reg_table[i].name, name) == 0)
-            return reg_table[i].number;
-    return -1; 
+    int n;
+    switch (name[0]) {
+        case 'x':
+            n = register_suffix(name + 1);
+            return n <= 31 ? n : -1;
+        case 'a':
+            n = register_suffix(name + 1);
+            return n >= 0 && n <= 7 ? 10 + n : -1;
+        case 't':
+            if (name[1] == 'p' && name[2] == '\0') return 4;
+            n = register_suffix(name + 1);
+            return n < 0 || n > 6 ? -1 : n <= 2 ? 5 + n : 25 + n;
+        case 's':
+            if (name[1] == 'p' && name[2] == '\0') return 2;
+            n = register_suffix(name + 1);
+            return n < 0 || n > 11 ? -1 : n <= 1 ? 8 + n : 16 + n;
+        case 'z': return strcmp(name, "zero") == 0 ? 0 : -1;
+        case 'r': return name[1] == 'a' && name[2] == '\0' ? 1 : -1;
+        case 'g': return name[1] == 'p' && name[2] == '\0' ? 3 : -1;
+        case 'f': return name[1] == 'p' && name[2] == '\0' ? 8 : -1;
+        default: return -1;
+    }
 }
 
 typedef struct {
     const char *mnemonic;
     INST_TYPE type;
+    INST_FORMAT format;
     uint8_t opcode;
     int8_t funct3;  // pode ser -1 se não se aplica
     int8_t funct7;  // idem
+    int8_t imm12;   // só ecall/ebreak
 } instruction_entry_t;
 
+// a tabela inteira sai do isa.def
 static const instruction_entry_t inst_table[] = {
-    {"add",  INST_R, 0b0110011, 0b000, 0b0000000},
-    {"sub",  INST_R, 0b0110011, 0b000, 0b0100000},
-    {"xor",  INST_R, 0b0110011, 0b100, 0b0000000},
-    {"or",   INST_R, 0b0110011, 0b110, 0b0000000},
-    {"and",  INST_R, 0b0110011, 0b111, 0b0000000},
+#define INST(name, type, format, opcode, funct3, funct7, imm12) {#name, type, format, opcode, funct3, funct7, imm12},
+#include "isa.def"
+#undef INST
+};
 
-    {"addi", INST_I, 0b0010011, 0b000, -1},
-    {"slli", INST_I, 0b0010011, 0b001, 0b0000000},
-    {"srli", INST_I, 0b0010011, 0b101, 0b0000000},
-    {"jalr", INST_I, 0b1100111, 0b000, -1},
-    {"lw",   INST_I, 0b0000011, 0b010, -1},
+#define INST_TABLE_SIZE (sizeof(inst_table)/sizeof(inst_table[0]))
 
-    {"sw",   INST_S, 0b0100011, 0b010, -1},
+// hash dos mnemonicos (endereçamento aberto, potencia de 2 com folga) e indices de decode.
+// são montados uma vez na primeira busca
+#define INST_HASH_SIZE 256
+#define OPCODE_COUNT 128
 
-    {"beq",  INST_B, 0b1100011, 0b000, -1},
-    {"bne",  INST_B, 0b1100011, 0b001, -1},
+// decode direto: chave de 17 bits opcode | funct3 << 7 | funct7 << 10 -> indice + 1 em inst_table.
+// 0 = nenhuma instrução, DECODE_AMBIGUOUS = precisa olhar o imm12 (ecall/ebreak) pela lista do opcode
+#define DECODE_KEY(word) (((word) & 0x7F) | ((((word) >> 12) & 0x7) << 7) | (((word) >> 25) << 10))
+#define DECODE_LUT_SIZE (1u << 17)
+#define DECODE_AMBIGUOUS 0xFF
 
-    {"lui",  INST_U, 0b0110111, -1, -1},
+typedef struct {
+    int16_t slots[INST_HASH_SIZE];          // indice em inst_table, -1 = vazio
+    int16_t opcode_first[OPCODE_COUNT];     // primeira entrada com esse opcode, -1 = nenhuma
+    int16_t opcode_next[INST_TABLE_SIZE];   // proxima entrada com o mesmo opcode
+    uint8_t decode_lut[DECODE_LUT_SIZE];
+    int ready;
+} isa_index_t;
 
-    {"jal",  INST_J, 0b1101111, -1, -1}
-};
+typedef char isa_table_fits_lut_t[(INST_TABLE_SIZE < DECODE_AMBIGUOUS) ? 1 : -1];
+
+static isa_index_t isa_index;
+
+static inline uint32_t mnemonic_hash(const char* s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline void isa_index_build(void) {
+    memset(isa_index.slots, 0xFF, sizeof(isa_index.slots));
+    memset(isa_index.opcode_first, 0xFF, sizeof(isa_index.opcode_first));
+
+    // de trás para frente para a lista de cada opcode ficar na ordem da tabela
+    for (size_t i = INST_TABLE_SIZE; i-- > 0; ) {
+        size_t slot = mnemonic_hash(inst_table[i].mnemonic) & (INST_HASH_SIZE - 1);
+        while (isa_index.slots[slot] != -1)
+            slot = (slot + 1) & (INST_HASH_SIZE - 1);
+        isa_index.slots[slot] = (int16_t)i;
+
+        uint8_t opcode = inst_table[i].opcode & 0x7F;
+        isa_index.opcode_next[i] = isa_index.opcode_first[opcode];
+        isa_index.opcode_first[opcode] = (int16_t)i;
+    }
+
+    // cada entrada ocupa todas as chaves que combinam com ela (funct3/funct7 = -1 é qualquer um)
+    memset(isa_index.decode_lut, 0, sizeof(isa_index.decode_lut));
+    for (size_t i = 0; i < INST_TABLE_SIZE; i++) {
+        const instruction_entry_t* entry = &inst_table[i];
+        for (uint32_t f3 = 0; f3 < 8; f3++) {
+            if (entry->funct3 >= 0 && (uint32_t)entry->funct3 != f3) continue;
+            for (uint32_t f7 = 0; f7 < 128; f7++) {
+                if (entry->funct7 >= 0 && (uint32_t)entry->funct7 != f7) continue;
+                uint32_t key = (entry->opcode & 0x7Fu) | (f3 << 7) | (f7 << 10);
+                uint8_t* slot = &isa_index.decode_lut[key];
+                *slot = (*slot != 0 || entry->imm12 >= 0) ? DECODE_AMBIGUOUS : (uint8_t)(i + 1);
+            }
+        }
+    }
+    isa_index.ready = 1;
+}
 
 static inline const instruction_entry_t* find_instruction(const char *mnemonic) {
-    for (size_t i = 0; i < sizeof(inst_table)/sizeof(inst_table[0]); i++)
-        if (strcmp(inst_table[i].mnemonic, mnemonic) == 0)
-            return &inst_table[i];
+    if (!isa_index.ready) isa_index_build();
+    size_t slot = mnemonic_hash(mnemonic) & (INST_HASH_SIZE - 1);
+    while (isa_index.slots[slot] != -1) {
+        const instruction_entry_t* entry = &inst_table[isa_index.slots[slot]];
+        if (strcmp(entry->mnemonic, mnemonic) == 0)
+            return entry;
+        slot = (slot + 1) & (INST_HASH_SIZE - 1);
+    }
+    return NULL;
+}
+
+// caminho inverso: acha a entrada de uma palavra já codificada pela tabela (opcode, funct3, funct7).
+// retorna NULL se a palavra não é nenhuma instrução conhecida
+static inline const instruction_entry_t* decode_instruction(uint32_t word) {
+    if (!isa_index.ready) isa_index_build();
+    uint8_t hit = isa_index.decode_lut[DECODE_KEY(word)];
+    if (hit != DECODE_AMBIGUOUS)
+        return hit ? &inst_table[hit - 1] : NULL;
+
+    uint32_t funct3 = (word >> 12) & 0x7;
+    uint32_t funct7 = (word >> 25) & 0x7F;
+    uint32_t imm12  = (word >> 20) & 0xFFF;
+
+    for (int16_t i = isa_index.opcode_first[word & 0x7F]; i != -1; i = isa_index.opcode_next[i]) {
+        const instruction_entry_t* entry = &inst_table[i];
+        if (entry->funct3 >= 0 && (uint32_t)entry->funct3 != funct3) continue;
+        if (entry->funct7 >= 0 && (uint32_t)entry->funct7 != funct7) continue;
+        if (entry->imm12 >= 0 && (uint32_t)entry->imm12 != imm12) continue;
+        return entry;
+    }
     return NULL;
 }
 
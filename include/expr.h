@@ -0,0 +1,615 @@
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "relocation.h"
+
+// expressões dos imediatos: `SIZE*4`, `fim - inicio`, `%lo(tabela+8)`, `. - inicio`.
+// o texto é compilado uma vez (no parse) para uma lista pos-fixa e avaliado depois do layout,
+// quando todos os endereços já existem. as passagens que codificam varias vezes (peephole,
+// escalonamento, compressão) só reavaliam a lista, sem ler o texto de novo.
+//
+// no objeto relocavel (-c) o endereço de um simbolo ainda não é conhecido: o resultado fica
+// "simbolo + addend" e quem chama transforma em relocação. diferença de dois simbolos da mesma
+// seção (e '.' menos label) já é numero mesmo assim.
+//
+// precedencia igual à do C: unarios - + ~ !, depois * / %, + -, << >>, < <= > >=, == !=, &, ^, |, &&, ||.
+// funções: %hi(x) e %lo(x) (com a correção do carry), %pcrel_hi(x) (do pc até x) e %pcrel_lo(label),
+// com 'label' no auipc que tem o %pcrel_hi (igual ao gnu as)
+
+#define EXPR_MAX_OPS 64
+
+typedef enum {
+    EXPR_NUMBER,
+    EXPR_SYMBOL,
+    EXPR_DOT,                // endereço do item que está sendo codificado
+    EXPR_NEG, EXPR_NOT, EXPR_LNOT,
+    EXPR_MUL, EXPR_DIV, EXPR_MOD,
+    EXPR_ADD, EXPR_SUB,
+    EXPR_SHL, EXPR_SHR,
+    EXPR_LT, EXPR_LE, EXPR_GT, EXPR_GE,
+    EXPR_EQ, EXPR_NE,
+    EXPR_AND, EXPR_XOR, EXPR_OR,
+    EXPR_LAND, EXPR_LOR,
+    EXPR_HI, EXPR_LO,
+    EXPR_PCREL_HI, EXPR_PCREL_LO
+} EXPR_OP;
+
+#define EXPR_FLAG_SYMBOL 0x01   // usa algum simbolo
+#define EXPR_FLAG_DOT    0x02   // depende do endereço do proprio item ('.' ou %pcrel)
+#define EXPR_FLAG_BOUND  0x04   // 'symbol' dos ops vale para a tabela atual (bind_symbols, até o proximo layout)
+
+#define EXPR_SYMBOL_UNDEFINED UINT32_MAX // 'symbol' de nome que não está na tabela
+
+typedef struct {
+    uint8_t op;              // EXPR_OP
+    uint16_t name;           // EXPR_SYMBOL/EXPR_PCREL_LO: offset do nome em 'names'
+    uint32_t symbol;         // com EXPR_FLAG_BOUND: posição na tabela + 1 (0 = procura pelo nome, label numerica)
+    int64_t value;           // EXPR_NUMBER
+} expr_op_t;
+
+// tudo numa alocação só: [expr_t][ops][text][names]
+typedef struct expr {
+    const char* text;        // texto de onde veio (o encoder compara para saber se o operando mudou)
+    const char* names;       // nomes dos simbolos, separados por '\0'
+    expr_op_t* ops;
+    uint16_t count;
+    uint8_t flags;           // EXPR_FLAG_*
+} expr_t;
+
+typedef enum {
+    EXPR_OK,
+    EXPR_UNDEFINED,          // simbolo que não existe (nome em result.error)
+    EXPR_ERROR               // mensagem em result.error
+} EXPR_STATUS;
+
+typedef struct {
+    const symbol_table_t* symbols; // NULL: só constantes (diretivas, li)
+    uint32_t pc;             // valor do '.'
+    uint8_t section;         // seção do item (para '.' no modo relocavel)
+    bool has_pc;             // '.' e %pcrel_* só fazem sentido dentro de um item
+    bool relocatable;        // objeto (-c): simbolo vira relocação em vez de endereço
+    uint32_t line;           // linha do item (o `1b`/`1f` procura a partir dela)
+} expr_env_t;
+
+typedef struct {
+    int64_t value;           // resultado (ou, com 'symbol', o endereço do simbolo local + addend)
+    int64_t addend;          // com 'symbol': quanto somar ao simbolo na relocação
+    const char* symbol;      // != NULL: ainda depende de onde o modulo vai ser ligado ("." = o proprio item)
+    bool local;              // 'symbol' definido neste modulo ('value' já tem o endereço)
+    uint8_t modifier;        // EXPR_HI/EXPR_LO em cima da relocação (0 = nenhum)
+    const char* error;
+    char local_name[32];     // 'symbol' aponta para cá quando é uma label numerica (.L1^B3)
+} expr_result_t;
+
+// ---- compilação ----
+
+typedef struct {
+    const char* p;
+    expr_op_t ops[EXPR_MAX_OPS];
+    size_t count;
+    char names[SOURCE_LINE_MAX * 2];
+    size_t names_len;
+    uint8_t flags;
+    const char* error;
+} expr_compiler_t;
+
+static inline bool expr_is_name_start(char c) {
+    return isalpha((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+static inline bool expr_is_name_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+// `1b`/`1f` (referencia a label numerica): digitos e a direção, sem mais nada colado.
+// devolve o tamanho, 0 se não é
+static inline size_t expr_local_ref_len(const char* p) {
+    size_t len = 0;
+    while (isdigit((unsigned char)p[len])) len++;
+    if (len == 0 || (p[len] != 'b' && p[len] != 'f') || expr_is_name_char(p[len + 1])) return 0;
+    return len + 1;
+}
+
+static inline void expr_skip_space(expr_compiler_t* c) {
+    while (isspace((unsigned char)*c->p)) c->p++;
+}
+
+// operação de dois numeros (a mesma do compilador, para dobrar constantes, e da avaliação)
+static inline bool expr_binary(uint8_t op, int64_t a, int64_t b, int64_t* out) {
+    switch (op) {
+        case EXPR_MUL: *out = (int64_t)((uint64_t)a * (uint64_t)b); break;
+        case EXPR_DIV: if (b == 0) return false; *out = a / b; break;
+        case EXPR_MOD: if (b == 0) return false; *out = a % b; break;
+        case EXPR_ADD: *out = (int64_t)((uint64_t)a + (uint64_t)b); break;
+        case EXPR_SUB: *out = (int64_t)((uint64_t)a - (uint64_t)b); break;
+        case EXPR_SHL: *out = (int64_t)((uint64_t)a << (b & 63)); break;
+        case EXPR_SHR: *out = a >> (b & 63); break;
+        case EXPR_LT:  *out = a < b; break;
+        case EXPR_LE:  *out = a <= b; break;
+        case EXPR_GT:  *out = a > b; break;
+        case EXPR_GE:  *out = a >= b; break;
+        case EXPR_EQ:  *out = a == b; break;
+        case EXPR_NE:  *out = a != b; break;
+        case EXPR_AND: *out = a & b; break;
+        case EXPR_XOR: *out = a ^ b; break;
+        case EXPR_OR:  *out = a | b; break;
+        case EXPR_LAND: *out = a && b; break;
+        case EXPR_LOR: *out = a || b; break;
+        default: return false;
+    }
+    return true;
+}
+
+static inline int64_t expr_unary(uint8_t op, int64_t a) {
+    switch (op) {
+        case EXPR_NEG: return (int64_t)(0 - (uint64_t)a);
+        case EXPR_NOT: return ~a;
+        case EXPR_LNOT: return !a;
+        case EXPR_HI: return reloc_hi20((uint32_t)a);
+        case EXPR_LO: return reloc_lo12((uint32_t)a);
+        default: return a;
+    }
+}
+
+static inline bool expr_emit(expr_compiler_t* c, uint8_t op, int64_t value, uint16_t name) {
+    if (c->count >= EXPR_MAX_OPS) {
+        c->error = "expressao muito longa";
+        return false;
+    }
+    c->ops[c->count].op = op;
+    c->ops[c->count].value = value;
+    c->ops[c->count].name = name;
+    c->ops[c->count].symbol = 0;
+    c->count++;
+    return true;
+}
+
+// unario em cima de um numero já vira o numero
+static inline bool expr_emit_unary(expr_compiler_t* c, uint8_t op) {
+    if (c->count > 0 && c->ops[c->count - 1].op == EXPR_NUMBER && op != EXPR_PCREL_HI) {
+        c->ops[c->count - 1].value = expr_unary(op, c->ops[c->count - 1].value);
+        return true;
+    }
+    return expr_emit(c, op, 0, 0);
+}
+
+// se os dois operandos são numeros, o segundo termina em count-1 e o primeiro em count-2
+static inline bool expr_emit_binary(expr_compiler_t* c, uint8_t op) {
+    int64_t folded;
+    if (c->count >= 2 && c->ops[c->count - 1].op == EXPR_NUMBER && c->ops[c->count - 2].op == EXPR_NUMBER &&
+        expr_binary(op, c->ops[c->count - 2].value, c->ops[c->count - 1].value, &folded)) {
+        c->count--;
+        c->ops[c->count - 1].value = folded;
+        return true;
+    }
+    return expr_emit(c, op, 0, 0);
+}
+
+// copia o nome em c->names, retorna o offset
+static inline bool expr_add_name(expr_compiler_t* c, const char* name, size_t len, uint16_t* offset) {
+    if (c->names_len + len + 1 > sizeof(c->names)) {
+        c->error = "expressao muito longa";
+        return false;
+    }
+    *offset = (uint16_t)c->names_len;
+    memcpy(c->names + c->names_len, name, len);
+    c->names[c->names_len + len] = '\0';
+    c->names_len += len + 1;
+    return true;
+}
+
+static inline bool expr_parse_binary(expr_compiler_t* c, int min_prec);
+
+// 'negated': veio logo depois de um '-', então cabe até 2^63 (INT64_MIN), senão até INT64_MAX
+static inline bool expr_parse_number(expr_compiler_t* c, bool negated) {
+    const char* start = c->p;
+    size_t quoted = char_literal_len(start);
+    if (quoted) c->p += quoted;
+    else while (isalnum((unsigned char)*c->p) || *c->p == '_') c->p++;
+
+    uint64_t value;
+    bool negative;
+    NUMBER_STATUS status = parse_number(start, (size_t)(c->p - start), &value, &negative);
+    if (status == NUMBER_OK && value > (negated ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX))
+        status = NUMBER_OVERFLOW;
+    if (status != NUMBER_OK) {
+        c->error = status == NUMBER_OVERFLOW ? "numero nao cabe em 64 bits" : "numero invalido";
+        return false;
+    }
+    return expr_emit(c, EXPR_NUMBER, negated ? (int64_t)(0 - value) : (int64_t)value, 0);
+}
+
+// %hi( ... ), %lo( ... ), %pcrel_hi( ... ), %pcrel_lo(label)
+static inline bool expr_parse_function(expr_compiler_t* c) {
+    static const struct { const char* name; uint8_t op; } functions[] = {
+        {"hi", EXPR_HI}, {"lo", EXPR_LO}, {"pcrel_hi", EXPR_PCREL_HI}, {"pcrel_lo", EXPR_PCREL_LO}
+    };
+    const char* start = ++c->p;
+    while (expr_is_name_char(*c->p)) c->p++;
+    size_t len = (size_t)(c->p - start);
+
+    uint8_t op = EXPR_NUMBER;
+    for (size_t i = 0; i < sizeof(functions) / sizeof(functions[0]); i++)
+        if (strlen(functions[i].name) == len && strncmp(functions[i].name, start, len) == 0)
+            op = functions[i].op;
+    expr_skip_space(c);
+    if (op == EXPR_NUMBER || *c->p != '(') {
+        c->error = "funcao desconhecida (use %hi, %lo, %pcrel_hi ou %pcrel_lo)";
+        return false;
+    }
+    c->p++;
+
+    if (op == EXPR_PCREL_LO) {
+        // o argumento é a label do auipc, não uma expressão
+        expr_skip_space(c);
+        const char* name = c->p;
+        size_t local = expr_local_ref_len(name);
+        if (local) c->p += local;
+        else while (expr_is_name_char(*c->p)) c->p++;
+        uint16_t offset;
+        if (c->p == name || (!local && !expr_is_name_start(*name))) {
+            c->error = "%pcrel_lo espera a label do auipc";
+            return false;
+        }
+        if (!expr_add_name(c, name, (size_t)(c->p - name), &offset)) return false;
+        if (!expr_emit(c, EXPR_PCREL_LO, 0, offset)) return false;
+        c->flags |= EXPR_FLAG_SYMBOL | EXPR_FLAG_DOT;
+    } else {
+        if (!expr_parse_binary(c, 0)) return false;
+        if (op == EXPR_PCREL_HI) c->flags |= EXPR_FLAG_DOT;
+        if (!expr_emit_unary(c, op)) return false;
+    }
+
+    expr_skip_space(c);
+    if (*c->p != ')') {
+        c->error = "falta ')'";
+        return false;
+    }
+    c->p++;
+    return true;
+}
+
+static inline bool expr_parse_unary(expr_compiler_t* c) {
+    expr_skip_space(c);
+    char ch = *c->p;
+
+    if (ch == '-' || ch == '+' || ch == '~' || ch == '!') {
+        c->p++;
+        // -9223372036854775808 só cabe junto com o sinal
+        if (ch == '-') {
+            expr_skip_space(c);
+            if (isdigit((unsigned char)*c->p) && !expr_local_ref_len(c->p)) return expr_parse_number(c, true);
+        }
+        if (!expr_parse_unary(c)) return false;
+        if (ch == '+') return true;
+        return expr_emit_unary(c, ch == '-' ? EXPR_NEG : ch == '~' ? EXPR_NOT : EXPR_LNOT);
+    }
+    if (ch == '(') {
+        c->p++;
+        if (!expr_parse_binary(c, 0)) return false;
+        expr_skip_space(c);
+        if (*c->p != ')') {
+            c->error = "falta ')'";
+            return false;
+        }
+        c->p++;
+        return true;
+    }
+    if (ch == '%') return expr_parse_function(c);
+    size_t local = expr_local_ref_len(c->p);
+    if ((isdigit((unsigned char)ch) && !local) || ch == '\'') return expr_parse_number(c, false);
+
+    if (local || expr_is_name_start(ch)) {
+        const char* name = c->p;
+        if (local) c->p += local;
+        else while (expr_is_name_char(*c->p)) c->p++;
+        size_t len = (size_t)(c->p - name);
+        if (len == 1 && name[0] == '.') {
+            c->flags |= EXPR_FLAG_DOT;
+            return expr_emit(c, EXPR_DOT, 0, 0);
+        }
+        uint16_t offset;
+        if (!expr_add_name(c, name, len, &offset)) return false;
+        c->flags |= EXPR_FLAG_SYMBOL;
+        return expr_emit(c, EXPR_SYMBOL, 0, offset);
+    }
+
+    c->error = ch ? "operando esperado" : "expressao incompleta";
+    return false;
+}
+
+// precedencia do operador binario em 'p' (0 = não é operador)
+static inline int expr_operator(const char* p, size_t* len, uint8_t* op) {
+    static const struct { const char* text; uint8_t op; int prec; } ops[] = {
+        {"||", EXPR_LOR, 1}, {"&&", EXPR_LAND, 2}, {"==", EXPR_EQ, 6}, {"!=", EXPR_NE, 6},
+        {"<=", EXPR_LE, 7}, {">=", EXPR_GE, 7}, {"<<", EXPR_SHL, 8}, {">>", EXPR_SHR, 8},
+        {"|", EXPR_OR, 3}, {"^", EXPR_XOR, 4}, {"&", EXPR_AND, 5}, {"<", EXPR_LT, 7}, {">", EXPR_GT, 7},
+        {"+", EXPR_ADD, 9}, {"-", EXPR_SUB, 9}, {"*", EXPR_MUL, 10}, {"/", EXPR_DIV, 10}, {"%", EXPR_MOD, 10}
+    };
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        size_t n = strlen(ops[i].text);
+        if (strncmp(p, ops[i].text, n) == 0) {
+            *len = n;
+            *op = ops[i].op;
+            return ops[i].prec;
+        }
+    }
+    return 0;
+}
+
+static inline bool expr_parse_binary(expr_compiler_t* c, int min_prec) {
+    if (!expr_parse_unary(c)) return false;
+    for (;;) {
+        expr_skip_space(c);
+        size_t len;
+        uint8_t op;
+        int prec = expr_operator(c->p, &len, &op);
+        if (prec == 0 || prec <= min_prec) return true;
+        c->p += len;
+        if (!expr_parse_binary(c, prec)) return false;
+        if (!expr_emit_binary(c, op)) return false;
+    }
+}
+
+// compila 'text'. NULL com 'error' apontando para a mensagem se a sintaxe está errada
+static inline expr_t* expr_compile(const char* text, const char** error) {
+    expr_compiler_t c;
+    c.p = text;
+    c.count = 0;
+    c.names_len = 0;
+    c.flags = 0;
+    c.error = NULL;
+
+    if (!expr_parse_binary(&c, 0)) {
+        *error = c.error;
+        return NULL;
+    }
+    expr_skip_space(&c);
+    if (*c.p != '\0') {
+        *error = *c.p == ')' ? "')' sobrando" : "operador esperado";
+        return NULL;
+    }
+
+    size_t text_len = strlen(text) + 1;
+    expr_t* e = (expr_t *)malloc(sizeof(expr_t) + c.count * sizeof(expr_op_t) + text_len + c.names_len);
+    CHECK_ALLOC(e, exit(EXIT_FAILURE));
+    e->ops = (expr_op_t *)(e + 1);
+    memcpy(e->ops, c.ops, c.count * sizeof(expr_op_t));
+    char* strings = (char *)(e->ops + c.count);
+    memcpy(strings, text, text_len);
+    memcpy(strings + text_len, c.names, c.names_len);
+    e->text = strings;
+    e->names = strings + text_len;
+    e->count = (uint16_t)c.count;
+    e->flags = c.flags;
+    return e;
+}
+
+static inline void expr_free(expr_t* e) {
+    free(e);
+}
+
+// ultima operação é o %pcrel_hi (o auipc que o %pcrel_lo procura)
+static inline bool expr_is_pcrel_hi(const expr_t* e) {
+    return e && e->count > 0 && e->ops[e->count - 1].op == EXPR_PCREL_HI;
+}
+
+// ---- avaliação ----
+
+typedef struct {
+    int64_t value;           // numero, ou endereço do simbolo local + addend
+    const char* symbol;      // relocação pendente (só no modo relocavel)
+    int section;             // seção do simbolo local, -1 se externo
+    uint32_t base;           // endereço do simbolo local (value - base = addend)
+    uint32_t ordinal;        // label numerica: qual definição (0 = label normal)
+    uint8_t modifier;
+} expr_value_t;
+
+static inline EXPR_STATUS expr_fail(expr_result_t* out, EXPR_STATUS status, const char* error) {
+    out->error = error;
+    return status;
+}
+
+static inline EXPR_STATUS expr_eval_ops(const expr_t* e, size_t count, const expr_env_t* env,
+                                        expr_result_t* out, int depth);
+
+// simbolo do op. depois do bind_symbols é só um acesso ao vetor da tabela; antes (e para as labels
+// numericas, que dependem da linha) procura pelo nome. 'ordinal' recebe a definição da label numerica
+static inline const symbol_t* expr_symbol(const expr_t* e, const expr_op_t* op, const expr_env_t* env, uint32_t* ordinal) {
+    if (!env->symbols) return NULL;
+    if ((e->flags & EXPR_FLAG_BOUND) && op->symbol)
+        return op->symbol == EXPR_SYMBOL_UNDEFINED ? NULL : &env->symbols->entries[op->symbol - 1];
+
+    const char* name = e->names + op->name;
+    uint32_t number;
+    bool forward;
+    if (label_numeric_ref(name, &number, &forward))
+        return numeric_label_find(env->symbols, number, forward, env->line, ordinal);
+    return symbol_table_find(env->symbols, name);
+}
+
+// %pcrel_lo(label): o mesmo alvo do %pcrel_hi do auipc em 'label', relativo ao pc do auipc
+static inline EXPR_STATUS expr_pcrel_lo(const expr_t* e, const expr_op_t* op, const expr_env_t* env, expr_result_t* out,
+                                        int depth, int64_t* value) {
+    const symbol_t* label = expr_symbol(e, op, env, NULL);
+    if (!label) return expr_fail(out, EXPR_UNDEFINED, e->names + op->name);
+    if (!label->pcrel_hi || depth > 0)
+        return expr_fail(out, EXPR_ERROR, "a label do %pcrel_lo precisa estar num 'auipc rd, %pcrel_hi(...)'");
+
+    expr_env_t hi_env = *env;
+    hi_env.pc = label->address;
+    hi_env.section = label->section;
+    expr_result_t target;
+    EXPR_STATUS status = expr_eval_ops(label->pcrel_hi, label->pcrel_hi->count - 1, &hi_env, &target, depth + 1);
+    if (status != EXPR_OK) {
+        out->error = target.error;
+        return status;
+    }
+    if (target.symbol && !target.local)
+        return expr_fail(out, EXPR_ERROR, "%pcrel de simbolo externo nao e suportado no objeto");
+    *value = reloc_lo12((uint32_t)(target.value - (int32_t)label->address));
+    return EXPR_OK;
+}
+
+// avalia as 'count' primeiras operações (o %pcrel_lo reavalia o auipc sem o %pcrel_hi do fim)
+static inline EXPR_STATUS expr_eval_ops(const expr_t* e, size_t count, const expr_env_t* env,
+                                        expr_result_t* out, int depth) {
+    expr_value_t stack[EXPR_MAX_OPS];
+    size_t top = 0;
+    memset(out, 0, sizeof(*out));
+
+    for (size_t i = 0; i < count; i++) {
+        const expr_op_t* op = &e->ops[i];
+        expr_value_t v = {0, NULL, -1, 0, 0, 0};
+
+        switch (op->op) {
+            case EXPR_NUMBER:
+                v.value = op->value;
+                stack[top++] = v;
+                continue;
+
+            case EXPR_SYMBOL: {
+                const char* name = e->names + op->name;
+                const symbol_t* sym = expr_symbol(e, op, env, &v.ordinal);
+                uint32_t number;
+                bool forward;
+                // label numerica nunca é externa
+                if (!sym && env->symbols && label_numeric_ref(name, &number, &forward))
+                    return expr_fail(out, EXPR_UNDEFINED, name);
+                if (env->relocatable && env->symbols) {
+                    v.symbol = name;
+                    if (sym) {
+                        v.section = sym->section;
+                        v.base = sym->address;
+                        v.value = (int32_t)sym->address;
+                    }
+                } else if (sym) {
+                    v.value = (int32_t)sym->address;
+                } else {
+                    return expr_fail(out, EXPR_UNDEFINED, name);
+                }
+                stack[top++] = v;
+                continue;
+            }
+
+            case EXPR_DOT:
+                if (!env->has_pc) return expr_fail(out, EXPR_ERROR, "'.' so pode ser usado em instrucao ou dado");
+                v.value = (int32_t)env->pc;
+                if (env->relocatable) {
+                    v.symbol = ".";
+                    v.section = env->section;
+                    v.base = env->pc;
+                }
+                stack[top++] = v;
+                continue;
+
+            case EXPR_PCREL_LO:
+                if (!env->has_pc) return expr_fail(out, EXPR_ERROR, "%pcrel_lo so pode ser usado em instrucao");
+                {
+                    EXPR_STATUS status = expr_pcrel_lo(e, op, env, out, depth, &v.value);
+                    if (status != EXPR_OK) return status;
+                }
+                stack[top++] = v;
+                continue;
+
+            default:
+                break;
+        }
+
+        expr_value_t* a;
+        if (op->op <= EXPR_LNOT || op->op >= EXPR_HI) {
+            // unarios
+            a = &stack[top - 1];
+            if (a->modifier) return expr_fail(out, EXPR_ERROR, "%hi/%lo de simbolo externo precisa ficar por fora da expressao");
+            if (op->op == EXPR_PCREL_HI) {
+                if (!env->has_pc) return expr_fail(out, EXPR_ERROR, "%pcrel_hi so pode ser usado em instrucao");
+                if (a->symbol && a->section < 0)
+                    return expr_fail(out, EXPR_ERROR, "%pcrel de simbolo externo nao e suportado no objeto");
+                if (a->symbol && a->section != env->section)
+                    return expr_fail(out, EXPR_ERROR, "%pcrel para outra secao nao e suportado no objeto");
+                a->value = reloc_hi20((uint32_t)(a->value - (int32_t)env->pc));
+                a->symbol = NULL;
+            } else if (a->symbol) {
+                if (op->op != EXPR_HI && op->op != EXPR_LO)
+                    return expr_fail(out, EXPR_ERROR, "operacao invalida com endereco relocavel");
+                a->modifier = op->op;
+            } else {
+                a->value = expr_unary(op->op, a->value);
+            }
+            continue;
+        }
+
+        expr_value_t b = stack[--top];
+        a = &stack[top - 1];
+        if (a->modifier || b.modifier)
+            return expr_fail(out, EXPR_ERROR, "%hi/%lo de simbolo externo precisa ficar por fora da expressao");
+
+        if (a->symbol || b.symbol) {
+            // simbolo + numero, numero + simbolo, simbolo - numero, e a diferença dentro da mesma seção
+            if (op->op == EXPR_ADD && !(a->symbol && b.symbol)) {
+                if (!a->symbol) {
+                    b.value += a->value;
+                    *a = b;
+                } else {
+                    a->value += b.value;
+                }
+                continue;
+            }
+            if (op->op == EXPR_SUB && !b.symbol) {
+                a->value -= b.value;
+                continue;
+            }
+            if (op->op == EXPR_SUB && a->symbol && a->section >= 0 && a->section == b.section) {
+                a->value -= b.value;
+                a->symbol = NULL;
+                a->section = -1;
+                continue;
+            }
+            return expr_fail(out, EXPR_ERROR, "operacao invalida com endereco relocavel");
+        }
+
+        if (!expr_binary(op->op, a->value, b.value, &a->value))
+            return expr_fail(out, EXPR_ERROR, "divisao por zero");
+    }
+
+    const expr_value_t* r = &stack[0];
+    out->value = r->value;
+    out->symbol = r->symbol;
+    out->local = r->symbol && r->section >= 0;
+    out->addend = r->value - (out->local ? (int32_t)r->base : 0);
+    out->modifier = r->modifier;
+    if (r->symbol && r->ordinal) {
+        uint32_t number = 0;
+        bool forward;
+        label_numeric_ref(r->symbol, &number, &forward);
+        numeric_label_name(number, r->ordinal, out->local_name, sizeof(out->local_name));
+        out->symbol = out->local_name;
+    }
+    return EXPR_OK;
+}
+
+static inline EXPR_STATUS expr_eval(const expr_t* e, const expr_env_t* env, expr_result_t* out) {
+    return expr_eval_ops(e, e->count, env, out, 0);
+}
+
+// expressão que não depende de simbolo nem de endereço (argumento de diretiva, li, .if)
+static inline EXPR_STATUS expr_eval_constant(const char* text, int64_t* value, const char** error) {
+    expr_t* e = expr_compile(text, error);
+    if (!e) return EXPR_ERROR;
+    expr_env_t env = {NULL, 0, 0, false, false, 0};
+    expr_result_t result;
+    EXPR_STATUS status = expr_eval(e, &env, &result);
+    *value = result.value;
+    *error = result.error;
+    // o nome do simbolo mora dentro da expressão: quem quer o nome usa expr_eval direto
+    if (status == EXPR_UNDEFINED) *error = NULL;
+    expr_free(e);
+    return status;
+}
+
+#endif
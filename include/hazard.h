@@ -0,0 +1,310 @@
+#ifndef HAZARD_H
+#define HAZARD_H
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "encoding_table.h"
+#include "compress.h"  // rvc_expand
+#include "disasm.h"    // offsets de branch/jal
+#include "output.h"
+
+// analise estatica de hazards para um core classico de 5 estagios (IF ID EX MEM WB, em ordem).
+// roda depois da segunda passagem, em cima das palavras já codificadas (item.value), então os
+// destinos de branch/jal já são os que a tabela de simbolos resolveu.
+//
+// modelo de tempo, por bloco basico (o que está "em voo" na entrada do bloco é ignorado):
+//   - cada instrução entra no EX um ciclo depois da anterior, a não ser que algum operando
+//     ainda não esteja disponivel. disponivel a partir do EX do produtor + atraso:
+//         forwarding full (EX/MEM e MEM/WB -> EX):  ALU +1, load +2 (load-use = 1 stall)
+//         forwarding mem  (só MEM/WB -> EX):         +2
+//         sem forwarding  (escrita no WB, leitura no ID no mesmo ciclo): +3
+//   - hazard RAW = leitura de um registrador que ainda não chegou no banco (distancia < 3),
+//     resolvida por forwarding ou por stall
+//   - desvio tomado perde 'branch_penalty' ciclos (resolvido no EX = 2), jal um a menos
+//     (o alvo sai no ID). branch condicional: tomado se for para trás (laço), senão não
+//     (heuristica BTFN, a mesma que um preditor estatico usaria)
+
+typedef enum {
+    FORWARD_NONE,
+    FORWARD_MEM,
+    FORWARD_FULL
+} FORWARD_MODEL;
+
+typedef struct {
+    FORWARD_MODEL forwarding;
+    uint32_t branch_penalty;
+} hazard_model_t;
+
+#define HAZARD_DEFAULT_BRANCH_PENALTY 2
+#define HAZARD_PIPELINE_FILL 4   // ciclos até a primeira instrução sair do WB
+
+static inline const char* forward_model_name(FORWARD_MODEL model) {
+    switch (model) {
+        case FORWARD_NONE: return "nenhum";
+        case FORWARD_MEM:  return "mem->ex";
+        case FORWARD_FULL: return "completo";
+    }
+    return "?";
+}
+
+// ciclos entre o EX do produtor e o primeiro EX que pode usar o valor
+static inline uint32_t hazard_result_delay(const hazard_model_t* model, bool is_load) {
+    switch (model->forwarding) {
+        case FORWARD_FULL: return is_load ? 2 : 1;
+        case FORWARD_MEM:  return 2;
+        case FORWARD_NONE: return 3;
+    }
+    return 3;
+}
+
+// operandos de uma instrução já codificada
+typedef struct {
+    const instruction_entry_t* entry;
+    uint32_t word;           // forma de 32 bits (RVC expandida)
+    uint8_t rd;              // 0 = não escreve
+    uint8_t rs[2];           // 0 = não lê
+    bool is_load;
+} hazard_inst_t;
+
+static inline bool hazard_decode_word(uint32_t word, hazard_inst_t* out) {
+    memset(out, 0, sizeof(*out));
+    out->entry = decode_instruction(word);
+    if (!out->entry) return false;
+    out->word = word;
+
+    uint8_t rd = (word >> 7) & 0x1F, rs1 = (word >> 15) & 0x1F, rs2 = (word >> 20) & 0x1F;
+    switch (out->entry->format) {
+        case FMT_R:                       out->rd = rd; out->rs[0] = rs1; out->rs[1] = rs2; break;
+        case FMT_BRANCH: case FMT_STORE:  out->rs[0] = rs1; out->rs[1] = rs2; break;
+        case FMT_I: case FMT_SHIFT:
+        case FMT_LOAD: case FMT_JALR:     out->rd = rd; out->rs[0] = rs1; break;
+        case FMT_U: case FMT_JAL:         out->rd = rd; break;
+        default:                          break;
+    }
+    out->is_load = out->entry->format == FMT_LOAD;
+    return true;
+}
+
+// item já codificado na segunda passagem (item.value, 16 bits se foi comprimido)
+static inline bool hazard_decode(const instruction_t* item, hazard_inst_t* out) {
+    uint32_t word = item->value;
+    if ((item->flags & ITEM_FLAG_COMPRESSED) && !rvc_expand((uint16_t)word, &word)) {
+        memset(out, 0, sizeof(*out));
+        return false;
+    }
+    return hazard_decode_word(word, out);
+}
+
+typedef struct {
+    size_t instructions;
+    size_t raw;
+    uint64_t load_use_stalls;
+    uint64_t data_stalls;    // stalls RAW que não são load-use (só sem forwarding completo)
+    uint64_t branch_cycles;
+    uint64_t cycles;
+} hazard_totals_t;
+
+static inline void hazard_item_text(const instruction_t* item, char* out, size_t size) {
+    size_t len = (size_t)snprintf(out, size, "%s", item->mnemonic);
+    for (int k = 0; k < item->operand_count && len < size; k++)
+        len += (size_t)snprintf(out + len, size - len, "%s%s", k ? ", " : " ", item->operands[k]);
+}
+
+// estado do modelo de tempo dentro de um bloco
+typedef struct {
+    int64_t ready[32];       // primeiro EX em que o valor pode ser usado
+    int64_t written[32];     // EX do produtor (para saber se já chegou no banco)
+    size_t producer[32];     // indice de quem escreveu por ultimo
+    bool load[32];           // se quem escreveu foi um load
+    int64_t ex;              // EX da ultima instrução emitida
+} hazard_state_t;
+
+static inline void hazard_state_init(hazard_state_t* state) {
+    for (int r = 0; r < 32; r++) {
+        state->ready[r] = state->written[r] = INT64_MIN / 2;
+        state->producer[r] = 0;
+        state->load[r] = false;
+    }
+    state->ex = -1;
+}
+
+// emite a proxima instrução: retorna quantos stalls ela pagou e se o culpado foi um load
+static inline uint32_t hazard_issue(hazard_state_t* state, const hazard_inst_t* inst, size_t index,
+                                    const hazard_model_t* model, bool* by_load) {
+    int64_t earliest = state->ex + 1;
+    int64_t start = earliest;
+    *by_load = false;
+    for (int s = 0; s < 2; s++) {
+        uint8_t r = inst->rs[s];
+        if (r != 0 && state->ready[r] > start) {
+            start = state->ready[r];
+            *by_load = state->load[r];
+        }
+    }
+    state->ex = start;
+    if (inst->rd != 0) {
+        state->written[inst->rd] = start;
+        state->ready[inst->rd] = start + hazard_result_delay(model, inst->is_load);
+        state->producer[inst->rd] = index;
+        state->load[inst->rd] = inst->is_load;
+    }
+    return (uint32_t)(start - earliest);
+}
+
+// indice (em 'addrs') da instrução no endereço, ou -1
+static inline long hazard_find_address(const uint32_t* addrs, size_t count, uint32_t address) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (addrs[mid] < address) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < count && addrs[lo] == address) ? (long)lo : -1;
+}
+
+// analisa o .text e escreve o relatorio por bloco em 'f'. retorna os totais
+static inline hazard_totals_t hazard_analyze(const instruction_t* items, size_t count, const symbol_table_t* table,
+                                             const hazard_model_t* model, FILE* f) {
+    hazard_totals_t totals = {0};
+
+    // instruções do .text em ordem de endereço, já decodificadas
+    size_t* order = (size_t *)malloc((count ? count : 1) * sizeof(size_t));
+    uint32_t* addrs = (uint32_t *)malloc((count ? count : 1) * sizeof(uint32_t));
+    hazard_inst_t* insts = (hazard_inst_t *)malloc((count ? count : 1) * sizeof(hazard_inst_t));
+    uint8_t* leader = (uint8_t *)calloc(count ? count : 1, 1);
+    CHECK_ALLOC(order, exit(EXIT_FAILURE));
+    CHECK_ALLOC(addrs, exit(EXIT_FAILURE));
+    CHECK_ALLOC(insts, exit(EXIT_FAILURE));
+    CHECK_ALLOC(leader, exit(EXIT_FAILURE));
+
+    size_t n = 0;
+    uint32_t expected = 0;
+    for (size_t i = 0; i < count; i++) {
+        const instruction_t* item = &items[i];
+        if (item->section != SECTION_TEXT || item->kind != ITEM_INSTRUCTION) continue;
+        if (!hazard_decode(item, &insts[n])) continue;
+        // buraco (dado, .org, .align) no meio do .text também começa bloco novo
+        if (n == 0 || item->address != expected) leader[n] = 1;
+        expected = item->address + item->size;
+        order[n] = i;
+        addrs[n] = item->address;
+        n++;
+    }
+
+    // lideres: destino de desvio e a instrução depois de qualquer desvio
+    for (size_t k = 0; k < n; k++) {
+        INST_FORMAT format = insts[k].entry->format;
+        if (format != FMT_BRANCH && format != FMT_JAL && format != FMT_JALR) continue;
+        if (k + 1 < n) leader[k + 1] = 1;
+        if (format == FMT_JALR) continue;
+        int32_t offset = format == FMT_BRANCH ? disasm_branch_offset(insts[k].word) : disasm_jal_offset(insts[k].word);
+        long target = hazard_find_address(addrs, n, addrs[k] + (uint32_t)offset);
+        if (target >= 0) leader[target] = 1;
+    }
+
+    size_t label_count;
+    text_label_t* labels = symbol_table_text_labels(table, &label_count);
+
+    out_buffer_t buf, details;
+    out_buffer_init(&buf, f);
+    out_buffer_init(&details, NULL);
+    out_buffer_printf(&buf, "hazards: pipeline de 5 estagios, forwarding %s, penalidade de desvio %u ciclo(s)\n\n",
+                      forward_model_name(model->forwarding), model->branch_penalty);
+    out_buffer_printf(&buf, "%5s  %-10s  %-20s %6s %5s %9s %7s %8s %8s\n",
+                      "bloco", "inicio", "label", "instr", "raw", "load-use", "stalls", "desvio", "ciclos");
+
+    char text[SOURCE_LINE_MAX];
+    char location[SOURCE_LINE_MAX];
+    size_t block = 0;
+    for (size_t k = 0; k < n; ) {
+        size_t end = k + 1;
+        while (end < n && !leader[end]) end++;
+
+        hazard_totals_t bt = {0};
+        hazard_state_t state;
+        hazard_state_init(&state);
+        for (size_t j = k; j < end; j++) {
+            const hazard_inst_t* inst = &insts[j];
+            int64_t earliest = state.ex + 1;
+            for (int s = 0; s < 2; s++) {
+                uint8_t r = inst->rs[s];
+                if (r == 0 || (s == 1 && inst->rs[1] == inst->rs[0])) continue;
+                if (earliest >= state.written[r] + 3) continue; // já está no banco de registradores
+                bt.raw++;
+                size_t p = state.producer[r];
+                uint32_t stalls = state.ready[r] > earliest ? (uint32_t)(state.ready[r] - earliest) : 0;
+                hazard_item_text(&items[order[j]], text, sizeof(text));
+                out_buffer_printf(&details, "  0x%08x  %-28s %s de 0x%08x (%s), distancia %zu: %s",
+                                  addrs[j], text, reg_abi_names[r], addrs[p], items[order[p]].mnemonic, j - p,
+                                  stalls ? "" : "forwarding\n");
+                if (stalls)
+                    out_buffer_printf(&details, "%u stall(s)%s\n", stalls, insts[p].is_load ? " (load-use)" : "");
+            }
+            bool by_load;
+            uint32_t stalls = hazard_issue(&state, inst, j, model, &by_load);
+            if (by_load) bt.load_use_stalls += stalls;
+            else bt.data_stalls += stalls;
+        }
+
+        // quem termina o bloco decide a penalidade
+        const hazard_inst_t* last = &insts[end - 1];
+        const char* branch_note = "";
+        if (last->entry->format == FMT_JALR) {
+            bt.branch_cycles = model->branch_penalty;
+        } else if (last->entry->format == FMT_JAL) {
+            bt.branch_cycles = model->branch_penalty > 1 ? model->branch_penalty - 1 : model->branch_penalty;
+        } else if (last->entry->format == FMT_BRANCH) {
+            bool backward = disasm_branch_offset(last->word) <= 0;
+            bt.branch_cycles = backward ? model->branch_penalty : 0;
+            branch_note = backward ? " T" : " N";
+        }
+
+        bt.instructions = end - k;
+        bt.cycles = bt.instructions + bt.load_use_stalls + bt.data_stalls + bt.branch_cycles;
+
+        long l = text_label_find(labels, label_count, addrs[k]);
+        if (l >= 0 && labels[l].address == addrs[k]) snprintf(location, sizeof(location), "%s", labels[l].name);
+        else text_label_location(labels, label_count, addrs[k], location, sizeof(location));
+        out_buffer_printf(&buf, "%5zu  0x%08x  %-20s %6zu %5zu %9llu %7llu %6llu%-2s %8llu\n",
+                          block, addrs[k], location, bt.instructions, bt.raw,
+                          (unsigned long long)bt.load_use_stalls, (unsigned long long)bt.data_stalls,
+                          (unsigned long long)bt.branch_cycles, branch_note, (unsigned long long)bt.cycles);
+
+        totals.instructions += bt.instructions;
+        totals.raw += bt.raw;
+        totals.load_use_stalls += bt.load_use_stalls;
+        totals.data_stalls += bt.data_stalls;
+        totals.branch_cycles += bt.branch_cycles;
+        totals.cycles += bt.cycles;
+        block++;
+        k = end;
+    }
+    if (n > 0) totals.cycles += HAZARD_PIPELINE_FILL;
+
+    out_buffer_printf(&buf, "\ntotal: %zu bloco(s), %zu instrucao(oes), %zu hazard(s) raw, %llu stall(s) load-use, "
+                      "%llu outro(s) stall(s), %llu ciclo(s) de desvio\n",
+                      block, totals.instructions, totals.raw, (unsigned long long)totals.load_use_stalls,
+                      (unsigned long long)totals.data_stalls, (unsigned long long)totals.branch_cycles);
+    out_buffer_printf(&buf, "estimativa: %llu ciclo(s) (cada bloco uma vez, +%d de enchimento), CPI %.2f\n",
+                      (unsigned long long)totals.cycles, n > 0 ? HAZARD_PIPELINE_FILL : 0,
+                      totals.instructions ? (double)totals.cycles / (double)totals.instructions : 0.0);
+    out_buffer_printf(&buf, "(desvio: T = branch para tras, contado como tomado; N = para frente, nao tomado)\n");
+    if (details.len > 0) {
+        out_buffer_puts(&buf, "\nhazards raw:\n");
+        out_buffer_append(&buf, details.data, details.len);
+    }
+
+    out_buffer_free(&details);
+    out_buffer_free(&buf);
+    free(labels);
+    free(order);
+    free(addrs);
+    free(insts);
+    free(leader);
+    return totals;
+}
+
+#endif
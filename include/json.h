@@ -0,0 +1,291 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdarg.h>
+
+#include "types.h"
+#include "utils.h"
+
+// leitor de json pequeno para as mensagens do --lsp (json-rpc): monta a arvore inteira,
+// objetos guardam as chaves em ordem e a busca é linear (as mensagens têm poucos campos).
+// strings saem em utf-8 com o \uXXXX já convertido (inclusive par de surrogates).
+
+#define JSON_MAX_DEPTH 64
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JSON_TYPE;
+
+typedef struct json_value {
+    uint8_t type;
+    bool boolean;
+    double number;
+    char* string;            // JSON_STRING (com '\0' no fim)
+    size_t length;           // tamanho da string em bytes
+    struct json_value* items;// filhos de array/objeto
+    char** keys;             // chaves do objeto (mesmo indice de items)
+    size_t count;
+} json_value_t;
+
+typedef struct {
+    const char* p;
+    const char* end;
+    int depth;
+} json_reader_t;
+
+static inline void json_free(json_value_t* value) {
+    if (!value) return;
+    free(value->string);
+    for (size_t i = 0; i < value->count; i++) {
+        json_free(&value->items[i]);
+        if (value->keys) free(value->keys[i]);
+    }
+    free(value->items);
+    free(value->keys);
+    memset(value, 0, sizeof(*value));
+}
+
+static inline void json_skip_space(json_reader_t* r) {
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\n' || *r->p == '\r'))
+        r->p++;
+}
+
+static inline int json_hex4(const char* p) {
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return -1;
+    }
+    return value;
+}
+
+static inline size_t json_put_utf8(char* out, uint32_t cp) {
+    if (cp < 0x80) { out[0] = (char)cp; return 1; }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// r->p no '"' de abertura. o resultado nunca é maior que o texto escapado
+static inline char* json_read_string(json_reader_t* r, size_t* length) {
+    const char* p = ++r->p;
+    const char* close = p;
+    while (close < r->end && *close != '"') close += *close == '\\' ? 2 : 1;
+    if (close >= r->end) return NULL;
+
+    char* out = (char *)malloc((size_t)(close - p) + 1);
+    CHECK_ALLOC(out, return NULL);
+    size_t n = 0;
+    while (p < close) {
+        if (*p != '\\') {
+            out[n++] = *p++;
+            continue;
+        }
+        p++;
+        switch (*p++) {
+            case '"':  out[n++] = '"'; break;
+            case '\\': out[n++] = '\\'; break;
+            case '/':  out[n++] = '/'; break;
+            case 'b':  out[n++] = '\b'; break;
+            case 'f':  out[n++] = '\f'; break;
+            case 'n':  out[n++] = '\n'; break;
+            case 'r':  out[n++] = '\r'; break;
+            case 't':  out[n++] = '\t'; break;
+            case 'u': {
+                int cp = close - p >= 4 ? json_hex4(p) : -1;
+                if (cp < 0) { free(out); return NULL; }
+                p += 4;
+                uint32_t code = (uint32_t)cp;
+                if (code >= 0xD800 && code < 0xDC00 && close - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    int low = json_hex4(p + 2);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + ((uint32_t)low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                n += json_put_utf8(out + n, code);
+                break;
+            }
+            default:
+                free(out);
+                return NULL;
+        }
+    }
+    out[n] = '\0';
+    *length = n;
+    r->p = close + 1;
+    return out;
+}
+
+static inline bool json_read_value(json_reader_t* r, json_value_t* value);
+
+// array ou objeto (r->p no '[' ou '{')
+static inline bool json_read_container(json_reader_t* r, json_value_t* value, bool object) {
+    char close = object ? '}' : ']';
+    size_t capacity = 0;
+    value->type = object ? JSON_OBJECT : JSON_ARRAY;
+    if (++r->depth > JSON_MAX_DEPTH) return false;
+    r->p++;
+    json_skip_space(r);
+    if (r->p < r->end && *r->p == close) {
+        r->p++;
+        r->depth--;
+        return true;
+    }
+
+    for (;;) {
+        if (value->count >= capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            json_value_t* items = (json_value_t *)realloc(value->items, capacity * sizeof(json_value_t));
+            CHECK_ALLOC(items, return false);
+            value->items = items;
+            if (object) {
+                char** keys = (char **)realloc(value->keys, capacity * sizeof(char *));
+                CHECK_ALLOC(keys, return false);
+                value->keys = keys;
+            }
+        }
+        json_value_t* item = &value->items[value->count];
+        memset(item, 0, sizeof(*item));
+
+        json_skip_space(r);
+        if (object) {
+            size_t key_length;
+            char* key = r->p < r->end && *r->p == '"' ? json_read_string(r, &key_length) : NULL;
+            if (!key) return false;
+            value->keys[value->count] = key;
+            json_skip_space(r);
+            if (r->p >= r->end || *r->p != ':') {
+                value->count++;   // a chave já é nossa, o json_free libera
+                return false;
+            }
+            r->p++;
+        }
+        value->count++;
+        if (!json_read_value(r, item)) return false;
+
+        json_skip_space(r);
+        if (r->p < r->end && *r->p == ',') {
+            r->p++;
+            continue;
+        }
+        if (r->p < r->end && *r->p == close) {
+            r->p++;
+            r->depth--;
+            return true;
+        }
+        return false;
+    }
+}
+
+static inline bool json_read_value(json_reader_t* r, json_value_t* value) {
+    json_skip_space(r);
+    if (r->p >= r->end) return false;
+
+    switch (*r->p) {
+        case '{': return json_read_container(r, value, true);
+        case '[': return json_read_container(r, value, false);
+        case '"':
+            value->type = JSON_STRING;
+            value->string = json_read_string(r, &value->length);
+            return value->string != NULL;
+        case 't':
+        case 'f': {
+            bool t = *r->p == 't';
+            const char* word = t ? "true" : "false";
+            size_t len = strlen(word);
+            if ((size_t)(r->end - r->p) < len || strncmp(r->p, word, len) != 0) return false;
+            value->type = JSON_BOOL;
+            value->boolean = t;
+            r->p += len;
+            return true;
+        }
+        case 'n':
+            if (r->end - r->p < 4 || strncmp(r->p, "null", 4) != 0) return false;
+            value->type = JSON_NULL;
+            r->p += 4;
+            return true;
+        default: {
+            // strtod precisa de '\0': o numero é copiado para um buffer
+            char number[64];
+            size_t len = 0;
+            while (r->p + len < r->end && len < sizeof(number) - 1 && strchr("+-0123456789.eE", r->p[len]))
+                len++;
+            if (len == 0) return false;
+            memcpy(number, r->p, len);
+            number[len] = '\0';
+            char* end;
+            value->type = JSON_NUMBER;
+            value->number = strtod(number, &end);
+            if (end != number + len) return false;
+            r->p += len;
+            return true;
+        }
+    }
+}
+
+// retorna false se o texto não é um json valido (o que foi lido até o erro já foi liberado)
+static inline bool json_parse(const char* text, size_t length, json_value_t* value) {
+    json_reader_t r = {text, text + length, 0};
+    memset(value, 0, sizeof(*value));
+    if (!json_read_value(&r, value)) {
+        json_free(value);
+        return false;
+    }
+    json_skip_space(&r);
+    if (r.p != r.end) {
+        json_free(value);
+        return false;
+    }
+    return true;
+}
+
+// campo de um objeto (NULL se não existe ou se 'object' não é objeto)
+static inline const json_value_t* json_get(const json_value_t* object, const char* key) {
+    if (!object || object->type != JSON_OBJECT) return NULL;
+    for (size_t i = 0; i < object->count; i++)
+        if (strcmp(object->keys[i], key) == 0) return &object->items[i];
+    return NULL;
+}
+
+// caminho de objetos aninhados, ex: json_path(msg, "params", "textDocument", "uri", NULL)
+static inline const json_value_t* json_path(const json_value_t* value, ...) {
+    va_list args;
+    va_start(args, value);
+    for (const char* key = va_arg(args, const char*); key && value; key = va_arg(args, const char*))
+        value = json_get(value, key);
+    va_end(args);
+    return value;
+}
+
+static inline const char* json_string(const json_value_t* value) {
+    return value && value->type == JSON_STRING ? value->string : NULL;
+}
+
+static inline long json_int(const json_value_t* value, long fallback) {
+    return value && value->type == JSON_NUMBER ? (long)value->number : fallback;
+}
+
+#endif
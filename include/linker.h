@@ -0,0 +1,102 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "relocation.h"
+#include "object.h"
+
+// resultado da ligação: imagem final + tabela com os simbolos globais
+typedef struct {
+    uint32_t* words;
+    size_t word_count;
+    symbol_table_t symbols;
+} link_result_t;
+
+static inline void link_result_free(link_result_t* result) {
+    free(result->words);
+    result->words = NULL;
+    result->word_count = 0;
+    symbol_table_free(&result->symbols);
+}
+
+// coloca os modulos um depois do outro a partir de 'base', resolve os simbolos globais por hash
+// e aplica as relocações. todos os erros são reportados antes de desistir.
+// retorna a quantidade de erros (0 = sucesso)
+static inline size_t link_objects(const object_t* objects, const char* const* names, size_t object_count,
+                                  uint32_t base, link_result_t* result) {
+    size_t errors = 0;
+    size_t total_words = 0;
+    size_t total_globals = 0;
+
+    uint32_t* module_base = (uint32_t *)malloc((object_count ? object_count : 1) * sizeof(uint32_t));
+    CHECK_ALLOC(module_base, exit(EXIT_FAILURE));
+
+    for (size_t m = 0; m < object_count; ++m) {
+        module_base[m] = base + 4 * (uint32_t)total_words;
+        total_words += objects[m].word_count;
+        total_globals += objects[m].symbol_count;
+    }
+
+    // simbolos globais: nome -> endereço final
+    symbol_hash_t globals;
+    symbol_hash_init(&globals, total_globals);
+
+    symbol_table_init(&result->symbols);
+    for (size_t m = 0; m < object_count; ++m) {
+        for (size_t s = 0; s < objects[m].symbol_count; ++s) {
+            const obj_symbol_t* sym = &objects[m].symbols[s];
+            if (sym->binding != OBJ_SYM_GLOBAL) continue;
+
+            uint32_t address = module_base[m] + sym->value;
+            uint32_t previous;
+            if (symbol_hash_find(&globals, sym->name, &previous)) {
+                fprintf(stderr, "erro (%s): simbolo global '%s' ja definido em outro modulo.\n", names[m], sym->name);
+                errors++;
+                continue;
+            }
+            symbol_hash_insert(&globals, sym->name, address);
+            symbol_table_add(&result->symbols, sym->name, address);
+            result->symbols.entries[result->symbols.count - 1].binding = SYM_GLOBAL;
+        }
+    }
+
+    result->word_count = total_words;
+    result->words = (uint32_t *)malloc((total_words ? total_words : 1) * sizeof(uint32_t));
+    CHECK_ALLOC(result->words, exit(EXIT_FAILURE));
+
+    for (size_t m = 0; m < object_count; ++m) {
+        const object_t* obj = &objects[m];
+        uint32_t* out = result->words + (module_base[m] - base) / 4;
+        memcpy(out, obj->words, obj->word_count * sizeof(uint32_t));
+
+        for (size_t r = 0; r < obj->reloc_count; ++r) {
+            const obj_reloc_t* reloc = &obj->relocs[r];
+            const obj_symbol_t* sym = &obj->symbols[reloc->symbol];
+
+            uint32_t target;
+            if (sym->binding != OBJ_SYM_UNDEF) {
+                target = module_base[m] + sym->value;
+            } else if (!symbol_hash_find(&globals, sym->name, &target)) {
+                fprintf(stderr, "erro (%s): simbolo '%s' indefinido (referenciado em 0x%08x).\n",
+                        names[m], sym->name, module_base[m] + reloc->offset);
+                errors++;
+                continue;
+            }
+
+            uint32_t pc = module_base[m] + reloc->offset;
+            if (!reloc_apply(&out[reloc->offset / 4], (RELOC_TYPE)reloc->type, target + (uint32_t)reloc->addend, pc)) {
+                fprintf(stderr, "erro (%s): relocacao %s para '%s' fora do range em 0x%08x.\n",
+                        names[m], reloc_type_name((RELOC_TYPE)reloc->type), sym->name, pc);
+                errors++;
+            }
+        }
+    }
+
+    symbol_hash_free(&globals);
+    free(module_base);
+    return errors;
+}
+
+#endif
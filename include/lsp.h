@@ -0,0 +1,763 @@
+#ifndef LSP_H
+#define LSP_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "encoding_table.h"
+#include "encoder.h"
+#include "parser.h"
+#include "output.h"
+#include "diag.h"
+#include "json.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// language server (--lsp): json-rpc no stdin/stdout, com go-to-definition, find-references e
+// diagnosticos ao vivo (os mesmos erros da linha de comando, com a coluna do diag).
+//
+// o documento fica guardado linha a linha, cada uma com os itens que o parser gerou, os
+// simbolos que ela usa e os diagnosticos do parse e da codificação. a cada mudança:
+//   - só as linhas editadas passam pelo parser de novo (parse_source_line)
+//   - o layout roda no documento inteiro, mas é só somar tamanhos e remontar a tabela de simbolos
+//   - só é codificada de novo a linha editada ou a que usa um simbolo cujo endereço mudou do
+//     ponto de vista dela: para branch/jal conta a distancia até o destino (inserir uma linha
+//     antes dos dois não muda nada), para %hi/%lo só se o simbolo existe, no resto o endereço
+//
+// posições do protocolo são em utf-16, convertidas para byte de cada lado.
+
+#define LSP_SERVER_NAME "montador-riscv"
+
+typedef enum {
+    LSP_REF_HALF,            // %hi(x) / %lo(x): nunca dá erro de alcance, só de simbolo que falta
+    LSP_REF_ABSOLUTE,        // endereço do simbolo como imediato (.word x, fim - inicio, ...)
+    LSP_REF_RELATIVE         // destino de branch/jal, ou expressão com '.'
+} LSP_REF_KIND;
+
+// simbolo usado por um operando
+typedef struct {
+    char* name;
+    uint32_t column;         // byte na linha (0-based)
+    uint16_t item;           // indice do item dentro da linha
+    uint8_t kind;
+} lsp_ref_t;
+
+typedef struct {
+    instruction_t* items;    // itens que a linha gerou (o dono dos operandos/labels)
+    size_t item_count;
+    size_t first;            // indice do primeiro item no vetor continuo do documento
+    lsp_ref_t* refs;
+    size_t ref_count;
+    diag_t* parse_diags;
+    size_t parse_diag_count;
+    diag_t* check_diags;     // da codificação (encode_instruction / encode_data_item)
+    size_t check_diag_count;
+    uint64_t check_key;      // dependencias da ultima codificação
+    bool dirty;              // texto mudou desde o ultimo parse
+} lsp_line_t;
+
+typedef struct {
+    char* uri;
+    char** text;             // texto das linhas (sem o '\n'), paralelo a 'lines'
+    lsp_line_t* lines;
+    size_t line_count;
+    size_t line_capacity;
+    instruction_t* items;    // copias rasas dos itens das linhas, em ordem, para o layout
+    size_t item_count;
+    size_t item_capacity;
+    symbol_table_t table;
+    diag_t* layout_diags;
+    size_t layout_diag_count;
+} lsp_document_t;
+
+typedef struct {
+    lsp_document_t* docs;
+    size_t doc_count;
+    size_t doc_capacity;
+    bool shutdown;
+    FILE* out;
+    // estatisticas da ultima analise (aparecem no stderr com -v)
+    size_t reparsed;
+    size_t rechecked;
+} lsp_server_t;
+
+// ---- texto ----
+
+// offset utf-16 do protocolo -> byte na linha (cortado no fim da linha)
+static inline size_t lsp_byte_offset(const char* text, long character) {
+    size_t i = 0;
+    long units = 0;
+    while (text[i] && units < character) {
+        unsigned char c = (unsigned char)text[i];
+        size_t len = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        units += len == 4 ? 2 : 1;
+        while (len-- && text[i]) i++;
+    }
+    return i;
+}
+
+// byte na linha -> offset utf-16
+static inline long lsp_utf16_column(const char* text, size_t byte) {
+    long units = 0;
+    for (size_t i = 0; i < byte && text[i]; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if ((c & 0xC0) == 0x80) continue;         // continuação
+        units += c >= 0xF0 ? 2 : 1;
+    }
+    return units;
+}
+
+static inline bool lsp_is_word_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+// primeira ocorrencia de 'word' como palavra inteira a partir de 'from'. -1 se não tem
+static inline long lsp_find_word(const char* text, const char* word, size_t from) {
+    size_t len = strlen(word);
+    if (len == 0 || from > strlen(text)) return -1;
+    for (const char* p = strstr(text + from, word); p; p = strstr(p + 1, word)) {
+        bool before = p > text && lsp_is_word_char(p[-1]);
+        bool after = lsp_is_word_char(p[len]);
+        if (!before && !after) return (long)(p - text);
+    }
+    return -1;
+}
+
+// nome de simbolo? (registrador e numero não contam)
+static inline bool lsp_is_symbol_name(const char* name) {
+    if (!(isalpha((unsigned char)name[0]) || name[0] == '_' || name[0] == '.')) return false;
+    for (const char* p = name; *p; p++)
+        if (!lsp_is_word_char(*p)) return false;
+    bool ok;
+    parse_immediate(name, &ok);
+    return !ok && get_register_number(name) < 0;
+}
+
+// simbolo usado pelo operando (copiado em 'name'), ou -1 se o operando não usa nenhum
+static inline int lsp_operand_symbol(const char* operand, char* name, size_t size) {
+    char imm[SOURCE_LINE_MAX], reg[SOURCE_LINE_MAX];
+    if (parse_symbol_ref(operand, "%hi", name, size) || parse_symbol_ref(operand, "%lo", name, size))
+        return LSP_REF_HALF;
+    if (split_offset_base(operand, imm, sizeof(imm), reg, sizeof(reg))) {
+        if (parse_symbol_ref(imm, "%lo", name, size)) return LSP_REF_HALF;
+        operand = imm;
+    }
+    if (strlen(operand) >= size || !lsp_is_symbol_name(operand)) return -1;
+    strcpy(name, operand);
+    return LSP_REF_ABSOLUTE;
+}
+
+// ---- documento ----
+
+static inline void lsp_line_clear(lsp_line_t* line) {
+    free_instructions(line->items, line->item_count);
+    for (size_t r = 0; r < line->ref_count; r++)
+        free(line->refs[r].name);
+    free(line->refs);
+    diag_free_items(line->parse_diags, line->parse_diag_count);
+    diag_free_items(line->check_diags, line->check_diag_count);
+    memset(line, 0, sizeof(*line));
+    line->dirty = true;
+}
+
+static inline void lsp_document_free(lsp_document_t* doc) {
+    for (size_t i = 0; i < doc->line_count; i++) {
+        lsp_line_clear(&doc->lines[i]);
+        free(doc->text[i]);
+    }
+    free(doc->lines);
+    free(doc->text);
+    free(doc->items);
+    free(doc->uri);
+    symbol_table_free(&doc->table);
+    diag_free_items(doc->layout_diags, doc->layout_diag_count);
+    memset(doc, 0, sizeof(*doc));
+}
+
+// troca as linhas [first, first + removed) por 'added' linhas novas (texto NULL, linha suja)
+static inline void lsp_splice_lines(lsp_document_t* doc, size_t first, size_t removed, size_t added) {
+    for (size_t i = first; i < first + removed; i++) {
+        lsp_line_clear(&doc->lines[i]);
+        free(doc->text[i]);
+    }
+    size_t new_count = doc->line_count - removed + added;
+    if (new_count > doc->line_capacity) {
+        size_t capacity = doc->line_capacity ? doc->line_capacity : 64;
+        while (capacity < new_count) capacity *= 2;
+        lsp_line_t* lines = (lsp_line_t *)realloc(doc->lines, capacity * sizeof(lsp_line_t));
+        char** text = (char **)realloc(doc->text, capacity * sizeof(char *));
+        CHECK_ALLOC(lines, exit(EXIT_FAILURE));
+        CHECK_ALLOC(text, exit(EXIT_FAILURE));
+        doc->lines = lines;
+        doc->text = text;
+        doc->line_capacity = capacity;
+    }
+    size_t tail = doc->line_count - first - removed;
+    memmove(&doc->lines[first + added], &doc->lines[first + removed], tail * sizeof(lsp_line_t));
+    memmove(&doc->text[first + added], &doc->text[first + removed], tail * sizeof(char *));
+    for (size_t i = first; i < first + added; i++) {
+        memset(&doc->lines[i], 0, sizeof(lsp_line_t));
+        doc->lines[i].dirty = true;
+        doc->text[i] = NULL;
+    }
+    doc->line_count = new_count;
+}
+
+// escreve 'text' (com '\n' ou '\r\n') nas linhas [first, first + n) já abertas pelo splice
+static inline void lsp_fill_lines(lsp_document_t* doc, size_t first, const char* text, size_t length) {
+    size_t line = first;
+    for (size_t start = 0; ; ) {
+        size_t end = start;
+        while (end < length && text[end] != '\n') end++;
+        size_t len = end > start && text[end - 1] == '\r' ? end - start - 1 : end - start;
+        char* s = (char *)malloc(len + 1);
+        CHECK_ALLOC(s, exit(EXIT_FAILURE));
+        memcpy(s, text + start, len);
+        s[len] = '\0';
+        doc->text[line++] = s;
+        if (end >= length) break;
+        start = end + 1;
+    }
+}
+
+static inline size_t lsp_count_lines(const char* text, size_t length) {
+    size_t n = 1;
+    for (size_t i = 0; i < length; i++)
+        if (text[i] == '\n') n++;
+    return n;
+}
+
+// troca o trecho [start, end) (linha/caractere do protocolo) por 'text'
+static inline void lsp_apply_change(lsp_document_t* doc, long start_line, long start_char,
+                                    long end_line, long end_char, const char* text, size_t length) {
+    if (doc->line_count == 0) {
+        lsp_splice_lines(doc, 0, 0, 1);
+        doc->text[0] = my_strdup("");
+    }
+    size_t last = doc->line_count - 1;
+    size_t sl = start_line < 0 ? 0 : (size_t)start_line > last ? last : (size_t)start_line;
+    size_t el = end_line < (long)sl ? sl : (size_t)end_line > last ? last : (size_t)end_line;
+    size_t sb = lsp_byte_offset(doc->text[sl], start_char);
+    size_t eb = lsp_byte_offset(doc->text[el], end_char);
+    if (el == sl && eb < sb) eb = sb;
+
+    // prefixo + texto novo + sufixo, depois quebra em linhas
+    const char* prefix = doc->text[sl];
+    const char* suffix = doc->text[el] + eb;
+    size_t total = sb + length + strlen(suffix);
+    char* joined = (char *)malloc(total + 1);
+    CHECK_ALLOC(joined, exit(EXIT_FAILURE));
+    memcpy(joined, prefix, sb);
+    memcpy(joined + sb, text, length);
+    strcpy(joined + sb + length, suffix);
+
+    size_t added = lsp_count_lines(joined, total);
+    lsp_splice_lines(doc, sl, el - sl + 1, added);
+    lsp_fill_lines(doc, sl, joined, total);
+    free(joined);
+}
+
+static inline void lsp_set_text(lsp_document_t* doc, const char* text, size_t length) {
+    lsp_splice_lines(doc, 0, doc->line_count, lsp_count_lines(text, length));
+    lsp_fill_lines(doc, 0, text, length);
+}
+
+// ---- analise ----
+
+static inline void lsp_add_ref(lsp_line_t* line, size_t* capacity, const char* name, uint32_t column, size_t item, int kind) {
+    if (line->ref_count >= *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 4;
+        lsp_ref_t* refs = (lsp_ref_t *)realloc(line->refs, *capacity * sizeof(lsp_ref_t));
+        CHECK_ALLOC(refs, exit(EXIT_FAILURE));
+        line->refs = refs;
+    }
+    lsp_ref_t* ref = &line->refs[line->ref_count++];
+    ref->name = my_strdup(name);
+    ref->column = column;
+    ref->item = (uint16_t)item;
+    ref->kind = (uint8_t)kind;
+}
+
+// parse de uma linha só. os erros do parser ficam guardados com ela
+static inline void lsp_parse_line(lsp_document_t* doc, size_t index) {
+    lsp_line_t* line = &doc->lines[index];
+    lsp_line_clear(line);
+
+    // o parser escreve no buffer (strip_label), o texto do editor fica intacto
+    char* copy = my_strdup(doc->text[index]);
+    item_list_t list = {0};
+    pending_label_t pending = {NULL, 0};
+    parse_source_line(copy, (uint32_t)index + 1, &pending, &list);
+    if (pending.name) {
+        instruction_t label_item = make_directive_item(ITEM_LABEL, "", NULL, (uint32_t)index + 1);
+        label_item.label = pending.name;
+        item_list_push(&list, &label_item);
+    }
+    free(copy);
+    line->items = list.items;
+    line->item_count = list.count;
+    line->parse_diags = diag_take(&line->parse_diag_count);
+
+    // simbolos usados (depois da expansão das pseudo, então `la` aparece pelos %hi/%lo)
+    const char* text = doc->text[index];
+    const char* body = text;
+    while (isspace((unsigned char)*body)) body++;
+    size_t from = (size_t)(body - text);
+    const char* colon = strchr(body, ':');
+    if (colon) from = (size_t)(colon - text) + 1;
+    while (text[from] && !isspace((unsigned char)text[from])) from++;   // pula o mnemonico
+
+    size_t capacity = 0;
+    for (size_t k = 0; k < line->item_count; k++) {
+        const instruction_t* item = &line->items[k];
+        if (item->kind != ITEM_INSTRUCTION && item->kind != ITEM_DATA) continue;
+        bool relative = false;
+        if (item->kind == ITEM_INSTRUCTION) {
+            const instruction_entry_t* entry = find_instruction(item->mnemonic);
+            relative = entry && (entry->format == FMT_BRANCH || entry->format == FMT_JAL);
+        }
+        if (item->expr) {
+            // simbolos da expressão compilada. com '.' no meio o valor muda junto com a linha,
+            // igual a um destino de branch
+            const expr_t* e = item->expr;
+            uint8_t last = e->ops[e->count - 1].op;
+            int kind = last == EXPR_HI || last == EXPR_LO || last == EXPR_PCREL_HI || last == EXPR_PCREL_LO ? LSP_REF_HALF
+                     : relative || (e->flags & EXPR_FLAG_DOT) ? LSP_REF_RELATIVE : LSP_REF_ABSOLUTE;
+            for (uint16_t i = 0; i < e->count; i++) {
+                if (e->ops[i].op != EXPR_SYMBOL && e->ops[i].op != EXPR_PCREL_LO) continue;
+                const char* name = e->names + e->ops[i].name;
+                long column = lsp_find_word(text, name, from);
+                lsp_add_ref(line, &capacity, name, column < 0 ? (uint32_t)from : (uint32_t)column, k, kind);
+            }
+            continue;
+        }
+        for (int o = 0; o < item->operand_count; o++) {
+            char name[SOURCE_LINE_MAX];
+            int kind = lsp_operand_symbol(item->operands[o], name, sizeof(name));
+            if (kind < 0) continue;
+            if (kind == LSP_REF_ABSOLUTE && relative) kind = LSP_REF_RELATIVE;
+            long column = lsp_find_word(text, name, from);
+            lsp_add_ref(line, &capacity, name, column < 0 ? (uint32_t)from : (uint32_t)column, k, kind);
+        }
+    }
+    line->dirty = false;
+}
+
+// o que a codificação da linha enxerga dos simbolos que ela usa (ver o comentario do topo)
+static inline uint64_t lsp_check_key(const lsp_document_t* doc, const lsp_line_t* line) {
+    uint64_t key = 1469598103934665603ull;
+    for (size_t r = 0; r < line->ref_count; r++) {
+        const lsp_ref_t* ref = &line->refs[r];
+        const instruction_t* item = &doc->items[line->first + ref->item];
+        const symbol_t* sym = symbol_table_resolve(&doc->table, ref->name, item->line_number);
+        uint64_t value;
+        if (!sym) value = 1ull << 40;
+        else if (ref->kind == LSP_REF_HALF) value = 1;
+        else if (ref->kind == LSP_REF_RELATIVE) value = sym->address - item->address;
+        else value = sym->address;
+        key = (key ^ value) * 1099511628211ull;
+    }
+    return key;
+}
+
+// refaz o que a mudança pode ter afetado. 'uri' entra nas mensagens dos diagnosticos
+static inline void lsp_analyze(lsp_server_t* server, lsp_document_t* doc) {
+    diag_set_source(doc->uri, doc->text, doc->line_count);
+    server->reparsed = 0;
+    server->rechecked = 0;
+
+    // 1. parse só das linhas sujas, e o vetor continuo com o numero de linha atualizado
+    size_t total = 0;
+    for (size_t i = 0; i < doc->line_count; i++) {
+        if (doc->lines[i].dirty) {
+            lsp_parse_line(doc, i);
+            doc->lines[i].check_key = ~0ull;      // codifica de qualquer jeito
+            server->reparsed++;
+        }
+        total += doc->lines[i].item_count;
+    }
+    if (total > doc->item_capacity) {
+        size_t capacity = doc->item_capacity ? doc->item_capacity : 256;
+        while (capacity < total) capacity *= 2;
+        free(doc->items);
+        doc->items = (instruction_t *)malloc(capacity * sizeof(instruction_t));
+        CHECK_ALLOC(doc->items, exit(EXIT_FAILURE));
+        doc->item_capacity = capacity;
+    }
+    doc->item_count = 0;
+    for (size_t i = 0; i < doc->line_count; i++) {
+        lsp_line_t* line = &doc->lines[i];
+        line->first = doc->item_count;
+        for (size_t k = 0; k < line->item_count; k++) {
+            line->items[k].line_number = (uint32_t)i + 1;
+            doc->items[doc->item_count++] = line->items[k];
+        }
+    }
+
+    // 2. layout inteiro (endereços e tabela de simbolos)
+    diag_free_items(doc->layout_diags, doc->layout_diag_count);
+    layout_program(doc->items, doc->item_count, &doc->table);
+    doc->layout_diags = diag_take(&doc->layout_diag_count);
+
+    // 3. codifica de novo só as linhas cujas dependencias mudaram
+    encoder_quiet = 0;
+    for (size_t i = 0; i < doc->line_count; i++) {
+        lsp_line_t* line = &doc->lines[i];
+        uint64_t key = lsp_check_key(doc, line);
+        if (key == line->check_key) continue;
+        line->check_key = key;
+        server->rechecked++;
+
+        diag_free_items(line->check_diags, line->check_diag_count);
+        for (size_t k = 0; k < line->item_count; k++) {
+            const instruction_t* item = &doc->items[line->first + k];
+            if (item->kind == ITEM_INSTRUCTION) {
+                encode_instruction(item, &doc->table, item->address);
+            } else if (item->kind == ITEM_DATA) {
+                bool ok;
+                encode_data_item(item, &doc->table, NULL, &ok);
+            }
+        }
+        line->check_diags = diag_take(&line->check_diag_count);
+    }
+}
+
+static inline lsp_document_t* lsp_find_document(lsp_server_t* server, const char* uri) {
+    for (size_t i = 0; uri && i < server->doc_count; i++)
+        if (strcmp(server->docs[i].uri, uri) == 0) return &server->docs[i];
+    return NULL;
+}
+
+// ---- saida ----
+
+// manda uma mensagem com o cabeçalho Content-Length
+static inline void lsp_send(lsp_server_t* server, out_buffer_t* body) {
+    fprintf(server->out, "Content-Length: %zu\r\n\r\n", body->len);
+    fwrite(body->data, 1, body->len, server->out);
+    fflush(server->out);
+}
+
+// "id" da requisição, copiado do jeito que veio (numero ou string)
+static inline void lsp_write_id(out_buffer_t* out, const json_value_t* id) {
+    if (id && id->type == JSON_STRING) out_buffer_json_string(out, id->string);
+    else if (id && id->type == JSON_NUMBER) out_buffer_printf(out, "%.0f", id->number);
+    else out_buffer_puts(out, "null");
+}
+
+static inline void lsp_write_range(out_buffer_t* out, const lsp_document_t* doc, size_t line, size_t start, size_t end) {
+    const char* text = doc->text[line];
+    out_buffer_printf(out, "{\"start\": {\"line\": %zu, \"character\": %ld}, \"end\": {\"line\": %zu, \"character\": %ld}}",
+                      line, lsp_utf16_column(text, start), line, lsp_utf16_column(text, end));
+}
+
+static inline void lsp_write_location(out_buffer_t* out, const lsp_document_t* doc, size_t line, size_t column, size_t length) {
+    out_buffer_puts(out, "{\"uri\": ");
+    out_buffer_json_string(out, doc->uri);
+    out_buffer_puts(out, ", \"range\": ");
+    lsp_write_range(out, doc, line, column, column + length);
+    out_buffer_putc(out, '}');
+}
+
+static inline void lsp_write_diags(out_buffer_t* out, const lsp_document_t* doc, size_t line,
+                                   const diag_t* diags, size_t count, bool* first) {
+    for (size_t d = 0; d < count; d++) {
+        const diag_t* diag = &diags[d];
+        size_t index = line;
+        if (index == (size_t)-1) {
+            if (diag->line == 0 || diag->line > doc->line_count) continue;
+            index = diag->line - 1;
+        }
+        // do começo do trecho até o fim da palavra (sem coluna: a linha inteira)
+        const char* text = doc->text[index];
+        size_t start = diag->column ? diag->column - 1 : 0;
+        size_t end = start;
+        if (diag->column) while (text[end] && lsp_is_word_char(text[end])) end++;
+        if (end == start) end = strlen(text);
+
+        out_buffer_puts(out, *first ? "{\"range\": " : ", {\"range\": ");
+        lsp_write_range(out, doc, index, start, end);
+        out_buffer_printf(out, ", \"severity\": %d, \"source\": \"%s\", \"message\": ",
+                          diag->severity == DIAG_ERROR ? 1 : 2, LSP_SERVER_NAME);
+        out_buffer_json_string(out, diag->message);
+        out_buffer_putc(out, '}');
+        *first = false;
+    }
+}
+
+static inline void lsp_publish(lsp_server_t* server, const lsp_document_t* doc) {
+    out_buffer_t out;
+    out_buffer_init(&out, NULL);
+    out_buffer_puts(&out, "{\"jsonrpc\": \"2.0\", \"method\": \"textDocument/publishDiagnostics\", \"params\": {\"uri\": ");
+    out_buffer_json_string(&out, doc->uri);
+    out_buffer_puts(&out, ", \"diagnostics\": [");
+    bool first = true;
+    for (size_t i = 0; i < doc->line_count; i++) {
+        lsp_write_diags(&out, doc, i, doc->lines[i].parse_diags, doc->lines[i].parse_diag_count, &first);
+        lsp_write_diags(&out, doc, i, doc->lines[i].check_diags, doc->lines[i].check_diag_count, &first);
+    }
+    lsp_write_diags(&out, doc, (size_t)-1, doc->layout_diags, doc->layout_diag_count, &first);
+    out_buffer_puts(&out, "]}}");
+    lsp_send(server, &out);
+    free(out.data);
+}
+
+// ---- requisições ----
+
+// palavra sob o cursor (copiada em 'word'). false se o cursor não está numa palavra
+static inline bool lsp_word_at(const lsp_document_t* doc, const json_value_t* params, size_t* line,
+                               char* word, size_t size) {
+    long l = json_int(json_path(params, "position", "line", NULL), -1);
+    long c = json_int(json_path(params, "position", "character", NULL), -1);
+    if (l < 0 || (size_t)l >= doc->line_count || c < 0) return false;
+    const char* text = doc->text[l];
+    size_t at = lsp_byte_offset(text, c);
+    size_t start = at, end = at;
+    while (start > 0 && lsp_is_word_char(text[start - 1])) start--;
+    while (lsp_is_word_char(text[end])) end++;
+    if (end == start || end - start >= size) return false;
+    memcpy(word, text + start, end - start);
+    word[end - start] = '\0';
+    *line = (size_t)l;
+    return true;
+}
+
+// linha onde a label é definida, -1 se não existe
+static inline long lsp_definition_line(const lsp_document_t* doc, const char* name) {
+    if (!symbol_table_find(&doc->table, name)) return -1;
+    for (size_t i = 0; i < doc->item_count; i++)
+        if (doc->items[i].label && strcmp(doc->items[i].label, name) == 0)
+            return (long)doc->items[i].line_number - 1;
+    return -1;
+}
+
+static inline void lsp_write_definition(out_buffer_t* out, const lsp_document_t* doc, const char* name, long line) {
+    long column = lsp_find_word(doc->text[line], name, 0);
+    lsp_write_location(out, doc, (size_t)line, column < 0 ? 0 : (size_t)column, strlen(name));
+}
+
+static inline void lsp_definition(lsp_document_t* doc, const json_value_t* params, out_buffer_t* out) {
+    char word[SOURCE_LINE_MAX];
+    size_t line;
+    long def = lsp_word_at(doc, params, &line, word, sizeof(word)) ? lsp_definition_line(doc, word) : -1;
+    if (def < 0) out_buffer_puts(out, "null");
+    else lsp_write_definition(out, doc, word, def);
+}
+
+static inline void lsp_references(lsp_document_t* doc, const json_value_t* params, out_buffer_t* out) {
+    char word[SOURCE_LINE_MAX];
+    size_t line;
+    out_buffer_putc(out, '[');
+    if (!lsp_word_at(doc, params, &line, word, sizeof(word))) {
+        out_buffer_putc(out, ']');
+        return;
+    }
+
+    bool first = true;
+    const json_value_t* declaration = json_path(params, "context", "includeDeclaration", NULL);
+    long def = lsp_definition_line(doc, word);
+    if (def >= 0 && declaration && declaration->boolean) {
+        lsp_write_definition(out, doc, word, def);
+        first = false;
+    }
+    for (size_t i = 0; i < doc->line_count; i++) {
+        const lsp_line_t* l = &doc->lines[i];
+        for (size_t r = 0; r < l->ref_count; r++) {
+            if (strcmp(l->refs[r].name, word) != 0) continue;
+            // `la` vira dois itens com o mesmo simbolo na mesma coluna
+            bool repeated = false;
+            for (size_t p = 0; p < r && !repeated; p++)
+                repeated = l->refs[p].column == l->refs[r].column && strcmp(l->refs[p].name, word) == 0;
+            if (repeated) continue;
+            if (!first) out_buffer_puts(out, ", ");
+            lsp_write_location(out, doc, i, l->refs[r].column, strlen(word));
+            first = false;
+        }
+    }
+    out_buffer_putc(out, ']');
+}
+
+static inline void lsp_did_open(lsp_server_t* server, const json_value_t* params) {
+    const char* uri = json_string(json_path(params, "textDocument", "uri", NULL));
+    const json_value_t* text = json_path(params, "textDocument", "text", NULL);
+    if (!uri || !text || text->type != JSON_STRING) return;
+
+    lsp_document_t* doc = lsp_find_document(server, uri);
+    if (!doc) {
+        if (server->doc_count >= server->doc_capacity) {
+            server->doc_capacity = server->doc_capacity ? server->doc_capacity * 2 : 4;
+            lsp_document_t* docs = (lsp_document_t *)realloc(server->docs, server->doc_capacity * sizeof(lsp_document_t));
+            CHECK_ALLOC(docs, exit(EXIT_FAILURE));
+            server->docs = docs;
+        }
+        doc = &server->docs[server->doc_count++];
+        memset(doc, 0, sizeof(*doc));
+        doc->uri = my_strdup(uri);
+        symbol_table_init(&doc->table);
+    }
+    lsp_set_text(doc, text->string, text->length);
+    lsp_analyze(server, doc);
+    lsp_publish(server, doc);
+}
+
+static inline void lsp_did_change(lsp_server_t* server, const json_value_t* params) {
+    lsp_document_t* doc = lsp_find_document(server, json_string(json_path(params, "textDocument", "uri", NULL)));
+    const json_value_t* changes = json_get(params, "contentChanges");
+    if (!doc || !changes || changes->type != JSON_ARRAY) return;
+
+    for (size_t c = 0; c < changes->count; c++) {
+        const json_value_t* change = &changes->items[c];
+        const json_value_t* text = json_get(change, "text");
+        const json_value_t* range = json_get(change, "range");
+        if (!text || text->type != JSON_STRING) continue;
+        if (!range) {
+            lsp_set_text(doc, text->string, text->length);
+            continue;
+        }
+        lsp_apply_change(doc,
+                         json_int(json_path(range, "start", "line", NULL), 0),
+                         json_int(json_path(range, "start", "character", NULL), 0),
+                         json_int(json_path(range, "end", "line", NULL), 0),
+                         json_int(json_path(range, "end", "character", NULL), 0),
+                         text->string, text->length);
+    }
+    lsp_analyze(server, doc);
+    lsp_publish(server, doc);
+}
+
+static inline void lsp_did_close(lsp_server_t* server, const json_value_t* params) {
+    lsp_document_t* doc = lsp_find_document(server, json_string(json_path(params, "textDocument", "uri", NULL)));
+    if (!doc) return;
+
+    // limpa os diagnosticos no editor
+    out_buffer_t out;
+    out_buffer_init(&out, NULL);
+    out_buffer_puts(&out, "{\"jsonrpc\": \"2.0\", \"method\": \"textDocument/publishDiagnostics\", \"params\": {\"uri\": ");
+    out_buffer_json_string(&out, doc->uri);
+    out_buffer_puts(&out, ", \"diagnostics\": []}}");
+    lsp_send(server, &out);
+    free(out.data);
+
+    lsp_document_free(doc);
+    *doc = server->docs[--server->doc_count];
+}
+
+// uma mensagem. retorna false quando chega o 'exit'
+static inline bool lsp_handle(lsp_server_t* server, const json_value_t* message) {
+    const char* method = json_string(json_get(message, "method"));
+    const json_value_t* id = json_get(message, "id");
+    const json_value_t* params = json_get(message, "params");
+    if (!method) return true;   // resposta do cliente para algo que não pedimos
+
+    if (strcmp(method, "exit") == 0) return false;
+    if (strcmp(method, "textDocument/didOpen") == 0) { lsp_did_open(server, params); return true; }
+    if (strcmp(method, "textDocument/didChange") == 0) { lsp_did_change(server, params); return true; }
+    if (strcmp(method, "textDocument/didClose") == 0) { lsp_did_close(server, params); return true; }
+    if (!id) return true;       // outras notificações (initialized, $/cancelRequest, ...)
+
+    out_buffer_t out;
+    out_buffer_init(&out, NULL);
+    out_buffer_puts(&out, "{\"jsonrpc\": \"2.0\", \"id\": ");
+    lsp_write_id(&out, id);
+
+    lsp_document_t* doc = lsp_find_document(server, json_string(json_path(params, "textDocument", "uri", NULL)));
+    if (strcmp(method, "initialize") == 0) {
+        out_buffer_puts(&out, ", \"result\": {\"capabilities\": {\"textDocumentSync\": {\"openClose\": true, \"change\": 2}, "
+                              "\"definitionProvider\": true, \"referencesProvider\": true}, "
+                              "\"serverInfo\": {\"name\": \"" LSP_SERVER_NAME "\"}}}");
+    } else if (strcmp(method, "shutdown") == 0) {
+        server->shutdown = true;
+        out_buffer_puts(&out, ", \"result\": null}");
+    } else if (strcmp(method, "textDocument/definition") == 0) {
+        out_buffer_puts(&out, ", \"result\": ");
+        if (doc) lsp_definition(doc, params, &out);
+        else out_buffer_puts(&out, "null");
+        out_buffer_putc(&out, '}');
+    } else if (strcmp(method, "textDocument/references") == 0) {
+        out_buffer_puts(&out, ", \"result\": ");
+        if (doc) lsp_references(doc, params, &out);
+        else out_buffer_puts(&out, "[]");
+        out_buffer_putc(&out, '}');
+    } else {
+        out_buffer_puts(&out, ", \"error\": {\"code\": -32601, \"message\": ");
+        out_buffer_json_string(&out, method);
+        out_buffer_puts(&out, "}}");
+    }
+    lsp_send(server, &out);
+    free(out.data);
+    return true;
+}
+
+// le uma mensagem (cabeçalhos até a linha vazia, depois Content-Length bytes). NULL no fim da entrada
+static inline char* lsp_read_message(FILE* in, size_t* length) {
+    char header[256];
+    long content_length = -1;
+    for (;;) {
+        if (!fgets(header, sizeof(header), in)) return NULL;
+        if (strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0) {
+            if (content_length >= 0) break;
+            continue;
+        }
+        if (strncmp(header, "Content-Length:", 15) == 0)
+            content_length = strtol(header + 15, NULL, 10);
+    }
+
+    char* body = (char *)malloc((size_t)content_length + 1);
+    CHECK_ALLOC(body, return NULL);
+    if (fread(body, 1, (size_t)content_length, in) != (size_t)content_length) {
+        free(body);
+        return NULL;
+    }
+    body[content_length] = '\0';
+    *length = (size_t)content_length;
+    return body;
+}
+
+// loop principal. retorna o codigo de saida (1 se o cliente mandou 'exit' sem 'shutdown', como pede o protocolo).
+// com 'verbose' o tempo de cada mensagem vai para o stderr
+static inline int lsp_run(FILE* in, FILE* out, bool verbose) {
+#ifdef _WIN32
+    _setmode(_fileno(in), _O_BINARY);
+    _setmode(_fileno(out), _O_BINARY);
+#endif
+    lsp_server_t server;
+    memset(&server, 0, sizeof(server));
+    server.out = out;
+
+    char* body;
+    size_t length;
+    bool running = true;
+    while (running && (body = lsp_read_message(in, &length)) != NULL) {
+        json_value_t message;
+        if (json_parse(body, length, &message)) {
+            clock_t start = clock();
+            server.reparsed = server.rechecked = 0;
+            running = lsp_handle(&server, &message);
+            if (verbose)
+                fprintf(stderr, "lsp: %s em %.2f ms (%zu linha(s) de novo no parser, %zu codificada(s)).\n",
+                        json_string(json_get(&message, "method")) ? json_string(json_get(&message, "method")) : "?",
+                        (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC, server.reparsed, server.rechecked);
+            json_free(&message);
+        } else {
+            out_buffer_t reply;
+            out_buffer_init(&reply, NULL);
+            out_buffer_puts(&reply, "{\"jsonrpc\": \"2.0\", \"id\": null, \"error\": {\"code\": -32700, \"message\": \"json invalido\"}}");
+            lsp_send(&server, &reply);
+            free(reply.data);
+        }
+        free(body);
+    }
+
+    for (size_t i = 0; i < server.doc_count; i++)
+        lsp_document_free(&server.docs[i]);
+    free(server.docs);
+    diag_free();
+    return server.shutdown ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef MAP_H
+#define MAP_H
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "expr.h"
+#include "diag.h"
+#include "output.h"
+#include "parser.h"
+
+// --map: todos os simbolos ordenados por endereço, com tamanho (distancia até o proximo simbolo
+// da seção, ou até o fim dela), linha onde foram definidos e os endereços das instruções/dados que
+// usam cada um. as referencias saem dos ids que o bind_symbols deixou nas expressões, numa passada
+// só pelos itens (contagem por id e depois preenchimento, sem ordenar nada).
+// as labels numericas (1:, 1b) não entram: não são simbolos da tabela.
+
+typedef enum {
+    MAP_FORMAT_TEXT,
+    MAP_FORMAT_CSV
+} MAP_FORMAT;
+
+typedef struct {
+    uint32_t address;
+    uint32_t index;          // posição na tabela (o id do simbolo - 1)
+} map_entry_t;
+
+// endereço, e na mesma posição a ordem de definição (qsort não é estavel)
+static inline int map_entry_cmp(const void* a, const void* b) {
+    const map_entry_t* ea = (const map_entry_t *)a;
+    const map_entry_t* eb = (const map_entry_t *)b;
+    if (ea->address != eb->address) return ea->address < eb->address ? -1 : 1;
+    return (ea->index > eb->index) - (ea->index < eb->index);
+}
+
+typedef struct {
+    uint32_t* offsets;       // refs do simbolo i: addresses[offsets[i] .. offsets[i + 1])
+    uint32_t* addresses;
+    uint8_t* sections;
+} map_xref_t;
+
+// referencias por simbolo. os itens precisam ter passado pelo bind_symbols
+static inline void map_build_xref(const instruction_t* items, size_t count, const symbol_table_t* table, map_xref_t* xref) {
+    xref->offsets = (uint32_t *)calloc(table->count + 1, sizeof(uint32_t));
+    CHECK_ALLOC(xref->offsets, exit(EXIT_FAILURE));
+
+    // conta (em offsets[id], que é o inicio do simbolo seguinte depois da soma)
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        const expr_t* e = items[i].expr;
+        if (!e || !(e->flags & EXPR_FLAG_BOUND)) continue;
+        for (size_t k = 0; k < e->count; k++) {
+            uint32_t id = e->ops[k].symbol;
+            if (id == 0 || id == EXPR_SYMBOL_UNDEFINED) continue;
+            xref->offsets[id]++;
+            total++;
+        }
+    }
+    for (size_t s = 0; s < table->count; s++)
+        xref->offsets[s + 1] += xref->offsets[s];
+
+    xref->addresses = (uint32_t *)malloc((total ? total : 1) * sizeof(uint32_t));
+    xref->sections = (uint8_t *)malloc(total ? total : 1);
+    uint32_t* fill = (uint32_t *)malloc((table->count ? table->count : 1) * sizeof(uint32_t));
+    CHECK_ALLOC(xref->addresses, exit(EXIT_FAILURE));
+    CHECK_ALLOC(xref->sections, exit(EXIT_FAILURE));
+    CHECK_ALLOC(fill, exit(EXIT_FAILURE));
+    if (table->count) memcpy(fill, xref->offsets, table->count * sizeof(uint32_t));
+
+    for (size_t i = 0; i < count; i++) {
+        const expr_t* e = items[i].expr;
+        if (!e || !(e->flags & EXPR_FLAG_BOUND)) continue;
+        for (size_t k = 0; k < e->count; k++) {
+            uint32_t id = e->ops[k].symbol;
+            if (id == 0 || id == EXPR_SYMBOL_UNDEFINED) continue;
+            uint32_t at = fill[id - 1]++;
+            xref->addresses[at] = items[i].address;
+            xref->sections[at] = items[i].section;
+        }
+    }
+    free(fill);
+}
+
+static inline void map_free_xref(map_xref_t* xref) {
+    free(xref->offsets);
+    free(xref->addresses);
+    free(xref->sections);
+}
+
+static inline void map_write(const instruction_t* items, size_t count, const symbol_table_t* table,
+                             const char* source_name, MAP_FORMAT format, FILE* f) {
+    // fim de cada seção, para o tamanho do ultimo simbolo. em 64 bits: uma seção que vai até
+    // 0xffffffff termina em 2^32
+    uint64_t section_end[SECTION_COUNT];
+    for (int s = 0; s < SECTION_COUNT; s++)
+        section_end[s] = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t end = (uint64_t)items[i].address + items[i].size;
+        if (end > section_end[items[i].section]) section_end[items[i].section] = end;
+    }
+
+    map_entry_t* entries = (map_entry_t *)malloc((table->count ? table->count : 1) * sizeof(map_entry_t));
+    CHECK_ALLOC(entries, exit(EXIT_FAILURE));
+    for (size_t s = 0; s < table->count; s++) {
+        entries[s].address = table->entries[s].address;
+        entries[s].index = (uint32_t)s;
+    }
+    qsort(entries, table->count, sizeof(map_entry_t), map_entry_cmp);
+
+    map_xref_t xref;
+    map_build_xref(items, count, table, &xref);
+    size_t text_label_count;
+    text_label_t* text_labels = symbol_table_text_labels(table, &text_label_count);
+
+    out_buffer_t buf;
+    out_buffer_init(&buf, f);
+    if (format == MAP_FORMAT_CSV) {
+        out_buffer_puts(&buf, "address,size,section,binding,defined,symbol,references\n");
+    } else {
+        out_buffer_printf(&buf, "; mapa de simbolos de '%s' (%zu simbolo(s), ordenado por endereco)\n", source_name, table->count);
+        out_buffer_puts(&buf, "; endereco  | tamanho | secao | escopo | linha  | simbolo\n");
+    }
+
+    for (size_t e = 0; e < table->count; e++) {
+        const symbol_t* sym = &table->entries[entries[e].index];
+        // proximo simbolo da mesma seção (as seções não se misturam no vetor ordenado)
+        uint64_t next = section_end[sym->section];
+        for (size_t n = e + 1; n < table->count; n++) {
+            const symbol_t* other = &table->entries[entries[n].index];
+            if (other->section == sym->section) {
+                next = other->address;
+                break;
+            }
+        }
+        uint64_t size = next > sym->address ? next - sym->address : 0;
+        char defined[SOURCE_LINE_MAX];
+        diag_origin_format(sym->line, defined, sizeof(defined));
+        const char* scope = sym->binding == SYM_GLOBAL ? "global" : "local";
+        uint32_t first = xref.offsets[entries[e].index], last = xref.offsets[entries[e].index + 1];
+
+        if (format == MAP_FORMAT_CSV) {
+            out_buffer_hex32(&buf, sym->address);
+            out_buffer_printf(&buf, ",%llu,%s,%s,%s,%s,", (unsigned long long)size, section_name((SECTION_ID)sym->section), scope, defined, sym->label);
+            for (uint32_t r = first; r < last; r++) {
+                if (r > first) out_buffer_putc(&buf, ' ');
+                out_buffer_hex32(&buf, xref.addresses[r]);
+            }
+            out_buffer_putc(&buf, '\n');
+            continue;
+        }
+
+        out_buffer_hex32(&buf, sym->address);
+        out_buffer_puts(&buf, " | ");
+        out_buffer_udec(&buf, size, 7);
+        out_buffer_printf(&buf, " | %-5s | %-6s | %-6s | %s\n", section_name((SECTION_ID)sym->section), scope, defined, sym->label);
+        if (first == last) continue;
+
+        // quem usa: no .text com a label mais proxima, igual ao --profile
+        out_buffer_puts(&buf, "           <-");
+        for (uint32_t r = first; r < last; r++) {
+            out_buffer_puts(&buf, r > first ? ", " : " ");
+            out_buffer_hex32(&buf, xref.addresses[r]);
+            if (xref.sections[r] == SECTION_TEXT && text_label_find(text_labels, text_label_count, xref.addresses[r]) >= 0) {
+                char where[SOURCE_LINE_MAX];
+                text_label_location(text_labels, text_label_count, xref.addresses[r], where, sizeof(where));
+                out_buffer_printf(&buf, " (%s)", where);
+            }
+        }
+        out_buffer_putc(&buf, '\n');
+    }
+
+    out_buffer_free(&buf);
+    free(text_labels);
+    map_free_xref(&xref);
+    free(entries);
+}
+
+#endif
@@ -0,0 +1,372 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "relocation.h"
+#include "encoder.h"
+#include "output.h"
+
+// formato do objeto relocavel (.o), tudo little-endian:
+//
+//   "RVO1"
+//   u32 word_count, u32 symbol_count, u32 reloc_count, u32 strtab_size
+//   u32 words[word_count]
+//   symbols[symbol_count]  { u32 name_offset, u32 value, u32 binding }
+//   relocs[reloc_count]    { u32 offset, u32 type, u32 symbol, i32 addend }
+//   char strtab[strtab_size]
+//
+// 'value' e 'offset' são relativos ao inicio do modulo (o linker soma a base)
+
+#define OBJECT_MAGIC "RVO1"
+
+typedef enum {
+    OBJ_SYM_LOCAL,
+    OBJ_SYM_GLOBAL,
+    OBJ_SYM_UNDEF            // referenciado mas definido em outro modulo
+} OBJ_SYM_BINDING;
+
+typedef struct {
+    char* name;
+    uint32_t value;
+    uint8_t binding;
+} obj_symbol_t;
+
+typedef struct {
+    uint32_t offset;
+    uint8_t type;            // RELOC_TYPE
+    uint32_t symbol;         // indice em symbols[]
+    int32_t addend;
+} obj_reloc_t;
+
+typedef struct {
+    uint32_t* words;
+    size_t word_count;
+    obj_symbol_t* symbols;
+    size_t symbol_count;
+    obj_reloc_t* relocs;
+    size_t reloc_count;
+} object_t;
+
+// ---------------------------------------------------------------------------
+// hash de nomes -> indice (endereçamento aberto, usado pelo objeto e pelo linker)
+
+typedef struct {
+    const char** keys;
+    uint32_t* values;
+    size_t capacity;         // sempre potencia de 2
+    size_t count;
+} symbol_hash_t;
+
+static inline uint32_t symbol_hash_str(const char* s) {
+    uint32_t h = 2166136261u; // fnv-1a
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline void symbol_hash_init(symbol_hash_t* hash, size_t expected) {
+    hash->capacity = 16;
+    while (hash->capacity < expected * 2) hash->capacity *= 2;
+    hash->count = 0;
+    hash->keys = (const char **)calloc(hash->capacity, sizeof(const char *));
+    hash->values = (uint32_t *)malloc(hash->capacity * sizeof(uint32_t));
+    CHECK_ALLOC(hash->keys, exit(EXIT_FAILURE));
+    CHECK_ALLOC(hash->values, exit(EXIT_FAILURE));
+}
+
+static inline void symbol_hash_free(symbol_hash_t* hash) {
+    free(hash->keys);
+    free(hash->values);
+    hash->keys = NULL;
+    hash->values = NULL;
+    hash->capacity = hash->count = 0;
+}
+
+// retorna o indice do slot onde a chave está (ou onde deveria estar)
+static inline size_t symbol_hash_slot(const symbol_hash_t* hash, const char* key) {
+    size_t mask = hash->capacity - 1;
+    size_t slot = symbol_hash_str(key) & mask;
+    while (hash->keys[slot] && strcmp(hash->keys[slot], key) != 0)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static inline void symbol_hash_grow(symbol_hash_t* hash) {
+    symbol_hash_t bigger;
+    symbol_hash_init(&bigger, hash->capacity);
+    for (size_t i = 0; i < hash->capacity; ++i) {
+        if (!hash->keys[i]) continue;
+        size_t slot = symbol_hash_slot(&bigger, hash->keys[i]);
+        bigger.keys[slot] = hash->keys[i];
+        bigger.values[slot] = hash->values[i];
+        bigger.count++;
+    }
+    symbol_hash_free(hash);
+    *hash = bigger;
+}
+
+// a chave não é copiada, precisa viver tanto quanto o hash.
+// retorna 0 se a chave já existia (e não altera o valor)
+static inline int symbol_hash_insert(symbol_hash_t* hash, const char* key, uint32_t value) {
+    if ((hash->count + 1) * 2 > hash->capacity)
+        symbol_hash_grow(hash);
+    size_t slot = symbol_hash_slot(hash, key);
+    if (hash->keys[slot]) return 0;
+    hash->keys[slot] = key;
+    hash->values[slot] = value;
+    hash->count++;
+    return 1;
+}
+
+static inline int symbol_hash_find(const symbol_hash_t* hash, const char* key, uint32_t* value) {
+    size_t slot = symbol_hash_slot(hash, key);
+    if (!hash->keys[slot]) return 0;
+    *value = hash->values[slot];
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// montagem do objeto
+
+static inline void object_free(object_t* obj) {
+    for (size_t i = 0; i < obj->symbol_count; ++i)
+        free(obj->symbols[i].name);
+    free(obj->symbols);
+    free(obj->words);
+    free(obj->relocs);
+    memset(obj, 0, sizeof(*obj));
+}
+
+static inline uint32_t object_add_symbol(object_t* obj, size_t* capacity, const char* name, uint32_t value, uint8_t binding) {
+    if (obj->symbol_count >= *capacity) {
+        *capacity = *capacity == 0 ? ST_INITIAL_CAPACITY : *capacity * 2;
+        obj_symbol_t* new_symbols = (obj_symbol_t *)realloc(obj->symbols, *capacity * sizeof(obj_symbol_t));
+        CHECK_ALLOC(new_symbols, exit(EXIT_FAILURE));
+        obj->symbols = new_symbols;
+    }
+    obj->symbols[obj->symbol_count].name = my_strdup(name);
+    obj->symbols[obj->symbol_count].value = value;
+    obj->symbols[obj->symbol_count].binding = binding;
+    return (uint32_t)obj->symbol_count++;
+}
+
+// codifica o .text como um modulo relocavel. labels que não estão na tabela viram
+// simbolos indefinidos + relocação. retorna a quantidade de itens com erro
+static inline size_t object_build(const instruction_t* instructions, size_t count,
+                                  const symbol_table_t* symbols, object_t* obj) {
+    memset(obj, 0, sizeof(*obj));
+    size_t errors = 0;
+
+    reloc_list_t relocs;
+    reloc_list_init(&relocs);
+
+    // tudo no objeto é relativo ao inicio do .text
+    uint32_t base = section_base_address(SECTION_TEXT);
+    uint64_t text_end = section_end_address(instructions, count, SECTION_TEXT);
+    obj->word_count = (text_end - base + 3) / 4;
+    obj->words = (uint32_t *)calloc(obj->word_count ? obj->word_count : 1, sizeof(uint32_t));
+    CHECK_ALLOC(obj->words, exit(EXIT_FAILURE));
+
+    for (size_t i = 0; i < count; ++i) {
+        const instruction_t* item = &instructions[i];
+        uint32_t offset = item->address - base;
+
+        if (item->section != SECTION_TEXT) {
+            if (item->size > 0) {
+                diag_error(item->line_number, "objeto relocavel ainda so suporta a secao .text.");
+                errors++;
+            }
+            continue;
+        }
+
+        if (item->kind == ITEM_INSTRUCTION) {
+            obj->words[offset / 4] = encode_instruction_reloc(item, symbols, item->address, &relocs);
+            if (obj->words[offset / 4] == ENCODING_ERROR_SENTINEL) errors++;
+        } else if (item->kind == ITEM_DATA) {
+            bool ok;
+            uint32_t value = encode_data_item(item, symbols, &relocs, &ok);
+            if (!ok) errors++;
+            image_put_bytes(obj->words, offset, value, item->size);
+        } else if (item->kind == ITEM_ALIGN) {
+            image_fill_align(obj->words, offset, item->size, 1);
+        }
+    }
+
+    // simbolos definidos no modulo, com valor relativo ao inicio dele
+    size_t sym_capacity = 0;
+    symbol_hash_t index;
+    symbol_hash_init(&index, symbols->count + relocs.count);
+
+    for (size_t i = 0; i < symbols->count; ++i) {
+        const symbol_t* sym = &symbols->entries[i];
+        uint8_t binding = sym->binding == SYM_GLOBAL ? OBJ_SYM_GLOBAL : OBJ_SYM_LOCAL;
+        object_add_symbol(obj, &sym_capacity, sym->label, sym->address - base, binding);
+    }
+    // o hash aponta para os nomes copiados no objeto (realloc não move as strings)
+    for (size_t i = 0; i < obj->symbol_count; ++i)
+        symbol_hash_insert(&index, obj->symbols[i].name, (uint32_t)i);
+
+    obj->reloc_count = relocs.count;
+    obj->relocs = (obj_reloc_t *)malloc((relocs.count ? relocs.count : 1) * sizeof(obj_reloc_t));
+    CHECK_ALLOC(obj->relocs, exit(EXIT_FAILURE));
+
+    for (size_t i = 0; i < relocs.count; ++i) {
+        const relocation_t* r = &relocs.entries[i];
+        uint32_t sym_idx;
+        if (!symbol_hash_find(&index, r->symbol, &sym_idx)) {
+            // label numerica (.L1^B3) só entra no objeto se alguma relocação usa
+            const symbol_t* numeric = numeric_label_by_name(symbols, r->symbol);
+            if (numeric)
+                sym_idx = object_add_symbol(obj, &sym_capacity, r->symbol, numeric->address - base, OBJ_SYM_LOCAL);
+            else
+                sym_idx = object_add_symbol(obj, &sym_capacity, r->symbol, 0, OBJ_SYM_UNDEF);
+            symbol_hash_insert(&index, obj->symbols[sym_idx].name, sym_idx);
+        }
+        obj->relocs[i].offset = r->address - base;
+        obj->relocs[i].type = (uint8_t)r->type;
+        obj->relocs[i].symbol = sym_idx;
+        obj->relocs[i].addend = r->addend;
+    }
+
+    symbol_hash_free(&index);
+    reloc_list_free(&relocs);
+    return errors;
+}
+
+// ---------------------------------------------------------------------------
+// leitura e escrita
+
+static inline void object_put_u32(out_buffer_t* buf, uint32_t v) {
+    char* dst = out_buffer_reserve(buf, 4);
+    dst[0] = (char)(v & 0xFF);
+    dst[1] = (char)((v >> 8) & 0xFF);
+    dst[2] = (char)((v >> 16) & 0xFF);
+    dst[3] = (char)((v >> 24) & 0xFF);
+    buf->len += 4;
+}
+
+static inline uint32_t object_get_u32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// monta o arquivo inteiro em memoria e escreve de uma vez
+static inline int object_write(const object_t* obj, const char* filename) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) return -1;
+
+    size_t strtab_size = 0;
+    for (size_t i = 0; i < obj->symbol_count; ++i)
+        strtab_size += strlen(obj->symbols[i].name) + 1;
+
+    out_buffer_t buf;
+    out_buffer_init(&buf, NULL);
+
+    out_buffer_append(&buf, OBJECT_MAGIC, 4);
+    object_put_u32(&buf, (uint32_t)obj->word_count);
+    object_put_u32(&buf, (uint32_t)obj->symbol_count);
+    object_put_u32(&buf, (uint32_t)obj->reloc_count);
+    object_put_u32(&buf, (uint32_t)strtab_size);
+
+    for (size_t i = 0; i < obj->word_count; ++i)
+        object_put_u32(&buf, obj->words[i]);
+
+    uint32_t name_offset = 0;
+    for (size_t i = 0; i < obj->symbol_count; ++i) {
+        object_put_u32(&buf, name_offset);
+        object_put_u32(&buf, obj->symbols[i].value);
+        object_put_u32(&buf, obj->symbols[i].binding);
+        name_offset += (uint32_t)strlen(obj->symbols[i].name) + 1;
+    }
+
+    for (size_t i = 0; i < obj->reloc_count; ++i) {
+        object_put_u32(&buf, obj->relocs[i].offset);
+        object_put_u32(&buf, obj->relocs[i].type);
+        object_put_u32(&buf, obj->relocs[i].symbol);
+        object_put_u32(&buf, (uint32_t)obj->relocs[i].addend);
+    }
+
+    for (size_t i = 0; i < obj->symbol_count; ++i)
+        out_buffer_append(&buf, obj->symbols[i].name, strlen(obj->symbols[i].name) + 1);
+
+    size_t written = fwrite(buf.data, 1, buf.len, f);
+    int ok = written == buf.len;
+    out_buffer_free(&buf);
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+// le um objeto inteiro para a memoria e valida os tamanhos antes de confiar neles
+static inline int object_read(const char* filename, object_t* obj) {
+    memset(obj, 0, sizeof(*obj));
+
+    FILE* f = fopen(filename, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (file_size < 20) { fclose(f); return -1; }
+
+    unsigned char* data = (unsigned char *)malloc((size_t)file_size);
+    CHECK_ALLOC(data, { fclose(f); return -1; });
+    if (fread(data, 1, (size_t)file_size, f) != (size_t)file_size || memcmp(data, OBJECT_MAGIC, 4) != 0) {
+        free(data);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    uint32_t word_count   = object_get_u32(data + 4);
+    uint32_t symbol_count = object_get_u32(data + 8);
+    uint32_t reloc_count  = object_get_u32(data + 12);
+    uint32_t strtab_size  = object_get_u32(data + 16);
+
+    uint64_t expected = 20 + (uint64_t)word_count * 4 + (uint64_t)symbol_count * 12 + (uint64_t)reloc_count * 16 + strtab_size;
+    if (expected != (uint64_t)file_size || (strtab_size > 0 && data[file_size - 1] != '\0')) {
+        free(data);
+        return -1;
+    }
+
+    const unsigned char* p = data + 20;
+    const char* strtab = (const char *)(data + file_size - strtab_size);
+
+    obj->word_count = word_count;
+    obj->words = (uint32_t *)malloc((word_count ? word_count : 1) * sizeof(uint32_t));
+    CHECK_ALLOC(obj->words, { free(data); return -1; });
+    for (uint32_t i = 0; i < word_count; ++i, p += 4)
+        obj->words[i] = object_get_u32(p);
+
+    obj->symbol_count = symbol_count;
+    obj->symbols = (obj_symbol_t *)calloc(symbol_count ? symbol_count : 1, sizeof(obj_symbol_t));
+    CHECK_ALLOC(obj->symbols, { free(data); object_free(obj); return -1; });
+    for (uint32_t i = 0; i < symbol_count; ++i, p += 12) {
+        uint32_t name_offset = object_get_u32(p);
+        if (name_offset >= strtab_size) { free(data); object_free(obj); return -1; }
+        obj->symbols[i].name = my_strdup(strtab + name_offset);
+        obj->symbols[i].value = object_get_u32(p + 4);
+        obj->symbols[i].binding = (uint8_t)object_get_u32(p + 8);
+    }
+
+    obj->reloc_count = reloc_count;
+    obj->relocs = (obj_reloc_t *)malloc((reloc_count ? reloc_count : 1) * sizeof(obj_reloc_t));
+    CHECK_ALLOC(obj->relocs, { free(data); object_free(obj); return -1; });
+    for (uint32_t i = 0; i < reloc_count; ++i, p += 16) {
+        obj->relocs[i].offset = object_get_u32(p);
+        obj->relocs[i].type = (uint8_t)object_get_u32(p + 4);
+        obj->relocs[i].symbol = object_get_u32(p + 8);
+        obj->relocs[i].addend = (int32_t)object_get_u32(p + 12);
+        if (obj->relocs[i].symbol >= symbol_count || obj->relocs[i].offset / 4 >= word_count) {
+            free(data);
+            object_free(obj);
+            return -1;
+        }
+    }
+
+    free(data);
+    return 0;
+}
+
+#endif
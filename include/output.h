@@ -0,0 +1,488 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdarg.h>
+
+#include "types.h"
+#include "utils.h"
+#include "diag.h"
+#include "symbol_table.h"
+#include "encoding_table.h"
+#include "encoder.h"
+#include "parser.h"
+
+// 1 para byte mais significativo primeiro
+// 0 para byte menos significativo primeiro 
+// (quando MIF_OUTPUT_GRANULARITY == 8)
+#ifndef MIF_PRINT_BYTES_BIG_ENDIAN
+#define MIF_PRINT_BYTES_BIG_ENDIAN 0
+#endif
+
+// 32 para a palavra inteira, 8 para imprimir de 8 em 8 bits
+#ifndef MIF_OUTPUT_GRANULARITY
+#define MIF_OUTPUT_GRANULARITY 32 
+#endif
+
+// tamanho inicial do buffer de saida e limite a partir do qual ele é despejado no arquivo
+// (1 MiB deixa o numero de fwrite() bem baixo mesmo em imagens gigantes)
+#define OUT_BUFFER_INITIAL_CAPACITY (1u << 16)
+#define OUT_BUFFER_FLUSH_THRESHOLD  (1u << 20)
+
+// buffer de texto que cresce sozinho, para formatar a saida toda antes de escrever
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+    FILE* sink;              // arquivo de destino (ou NULL se só acumula em memoria)
+} out_buffer_t;
+
+static inline void out_buffer_init(out_buffer_t* buf, FILE* sink) {
+    buf->len = 0;
+    buf->capacity = OUT_BUFFER_INITIAL_CAPACITY;
+    buf->sink = sink;
+    buf->data = (char *)malloc(buf->capacity);
+    CHECK_ALLOC(buf->data, exit(EXIT_FAILURE));
+}
+
+// escreve o que tiver no buffer no arquivo de destino
+static inline void out_buffer_flush(out_buffer_t* buf) {
+    if (buf->sink && buf->len > 0) {
+        fwrite(buf->data, 1, buf->len, buf->sink);
+        buf->len = 0;
+    }
+}
+
+// garante espaço para mais 'extra' bytes
+static inline char* out_buffer_reserve(out_buffer_t* buf, size_t extra) {
+    if (buf->sink && buf->len + extra > OUT_BUFFER_FLUSH_THRESHOLD)
+        out_buffer_flush(buf);
+
+    if (buf->len + extra > buf->capacity) {
+        size_t new_capacity = buf->capacity;
+        while (buf->len + extra > new_capacity) new_capacity *= 2;
+        char* new_data = (char *)realloc(buf->data, new_capacity);
+        CHECK_ALLOC(new_data, exit(EXIT_FAILURE));
+        buf->data = new_data;
+        buf->capacity = new_capacity;
+    }
+    return buf->data + buf->len;
+}
+
+static inline void out_buffer_append(out_buffer_t* buf, const char* s, size_t n) {
+    char* dst = out_buffer_reserve(buf, n);
+    memcpy(dst, s, n);
+    buf->len += n;
+}
+
+static inline void out_buffer_puts(out_buffer_t* buf, const char* s) {
+    out_buffer_append(buf, s, strlen(s));
+}
+
+static inline void out_buffer_putc(out_buffer_t* buf, char c) {
+    char* dst = out_buffer_reserve(buf, 1);
+    *dst = c;
+    buf->len++;
+}
+
+// "0x" + 8 digitos hexadecimais, sem passar pelo printf
+static inline void out_buffer_hex32(out_buffer_t* buf, uint32_t value) {
+    static const char hex_digits[] = "0123456789abcdef";
+    char* dst = out_buffer_reserve(buf, 10);
+    dst[0] = '0';
+    dst[1] = 'x';
+    for (int i = 0; i < 8; ++i)
+        dst[2 + i] = hex_digits[(value >> (28 - 4 * i)) & 0xF];
+    buf->len += 10;
+}
+
+// os mesmos 8 digitos, sem o "0x" (json do --serve)
+static inline void out_buffer_hex8(out_buffer_t* buf, uint32_t value) {
+    static const char hex_digits[] = "0123456789abcdef";
+    char* dst = out_buffer_reserve(buf, 8);
+    for (int i = 0; i < 8; ++i)
+        dst[i] = hex_digits[(value >> (28 - 4 * i)) & 0xF];
+    buf->len += 8;
+}
+
+// numero decimal alinhado à direita em 'width' colunas
+static inline void out_buffer_udec(out_buffer_t* buf, uint64_t value, int width) {
+    char tmp[24];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    char* dst = out_buffer_reserve(buf, (size_t)(width > n ? width : n));
+    size_t pos = 0;
+    for (int i = n; i < width; ++i) dst[pos++] = ' ';
+    while (n) dst[pos++] = tmp[--n];
+    buf->len += pos;
+}
+
+// formatação livre (para as partes que não estão no caminho quente)
+static inline void out_buffer_printf(out_buffer_t* buf, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (needed <= 0) return;
+
+    char* dst = out_buffer_reserve(buf, (size_t)needed + 1);
+    va_start(args, fmt);
+    vsnprintf(dst, (size_t)needed + 1, fmt, args);
+    va_end(args);
+    buf->len += (size_t)needed;
+}
+
+// despeja o resto e libera a memoria (o arquivo é fechado por quem abriu)
+// string json entre aspas (o --lsp e o --serve)
+static inline void out_buffer_json_string(out_buffer_t* out, const char* s) {
+    out_buffer_putc(out, '"');
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            out_buffer_putc(out, '\\');
+            out_buffer_putc(out, (char)c);
+        } else if (c < 0x20) {
+            out_buffer_printf(out, "\\u%04x", c);
+        } else {
+            out_buffer_putc(out, (char)c);
+        }
+    }
+    out_buffer_putc(out, '"');
+}
+
+static inline void out_buffer_free(out_buffer_t* buf) {
+    out_buffer_flush(buf);
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = buf->capacity = 0;
+}
+
+// ---------------------------------------------------------------------------
+// mif
+
+// escreve uma palavra no formato do mif (binario em texto, com a granularidade escolhida)
+static inline void mif_write_word(out_buffer_t* buf, uint32_t machine_code) {
+    char binary_string[33];
+    for (int bit_pos = 0; bit_pos < 32; ++bit_pos)
+        binary_string[bit_pos] = (char)('0' + ((machine_code >> (31 - bit_pos)) & 1));
+    binary_string[32] = '\n';
+
+    //ninho de rato com defines para poder verificar respostas no rars
+    #if MIF_OUTPUT_GRANULARITY == 8
+    char* dst = out_buffer_reserve(buf, 36);
+        #if MIF_PRINT_BYTES_BIG_ENDIAN == 1
+    static const int byte_order[4] = {0, 8, 16, 24};  // MSB byte (bits 31-24) primeiro
+        #else
+    static const int byte_order[4] = {24, 16, 8, 0};  // LSB byte (bits 7-0) primeiro
+        #endif
+    for (int b = 0; b < 4; ++b) {
+        memcpy(dst + 9 * b, &binary_string[byte_order[b]], 8);
+        dst[9 * b + 8] = '\n';
+    }
+    buf->len += 36;
+    #else
+    out_buffer_append(buf, binary_string, 33);
+    #endif
+}
+
+// palavra que não conseguiu ser codificada
+static inline void mif_write_error(out_buffer_t* buf) {
+    #if MIF_OUTPUT_GRANULARITY == 8
+    out_buffer_puts(buf, "XXXXXXXX\nXXXXXXXX\nXXXXXXXX\nXXXXXXXX\n");
+    #else
+    out_buffer_puts(buf, "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\n");
+    #endif
+}
+
+// arquivo de saida escrito em "<nome>.tmp" e só renomeado no fim se deu tudo certo:
+// com erro o arquivo antigo fica intacto e nunca sobra um mif pela metade
+typedef struct {
+    FILE* file;
+    char* path;
+    char* temp_path;
+} output_file_t;
+
+static inline FILE* output_file_open(output_file_t* out, const char* path) {
+    size_t len = strlen(path);
+    out->path = my_strdup(path);
+    out->temp_path = (char *)malloc(len + 5);
+    CHECK_ALLOC(out->temp_path, exit(EXIT_FAILURE));
+    memcpy(out->temp_path, path, len);
+    memcpy(out->temp_path + len, ".tmp", 5);
+    out->file = fopen(out->temp_path, "w");
+    return out->file;
+}
+
+// fecha e publica (keep) ou descarta. retorna 0 se deu certo
+static inline int output_file_close(output_file_t* out, bool keep) {
+    int status = 0;
+    if (out->file) {
+        if (fclose(out->file) != 0) {
+            keep = false;
+            status = -1;
+        }
+        if (keep && rename(out->temp_path, out->path) != 0) status = -1;
+        if (!keep || status != 0) remove(out->temp_path);
+    }
+    free(out->path);
+    free(out->temp_path);
+    memset(out, 0, sizeof(*out));
+    return status;
+}
+
+// mif de uma seção inteira escrito em streaming: os itens chegam em ordem de endereço
+// e os buracos (.org/.space) são preenchidos com zero sem precisar da imagem em memoria
+typedef struct {
+    out_buffer_t buf;
+    uint32_t address;        // endereço do proximo byte que vai para o mif
+    uint32_t word;           // bytes já acumulados da palavra atual (little-endian)
+    int error;               // a palavra atual tem bytes de instrução que deu erro
+} mif_stream_t;
+
+static inline void mif_stream_init(mif_stream_t* ms, FILE* f, uint32_t base) {
+    out_buffer_init(&ms->buf, f);
+    ms->address = base;
+    ms->word = 0;
+    ms->error = 0;
+}
+
+static inline void mif_stream_emit(mif_stream_t* ms) {
+    if (ms->error)
+        mif_write_error(&ms->buf);
+    else
+        mif_write_word(&ms->buf, ms->word);
+    ms->word = 0;
+    ms->error = 0;
+}
+
+static inline void mif_stream_byte(mif_stream_t* ms, uint8_t byte, int error) {
+    ms->word |= (uint32_t)byte << (8 * (ms->address & 3));
+    if (error) ms->error = 1;
+    ms->address++;
+    if ((ms->address & 3) == 0)
+        mif_stream_emit(ms);
+}
+
+// zeros até 'target' (palavras inteiras vão direto)
+static inline void mif_stream_fill(mif_stream_t* ms, uint32_t target) {
+    while (ms->address < target && (ms->address & 3) != 0)
+        mif_stream_byte(ms, 0, 0);
+    while (ms->address < target && target - ms->address >= 4) {
+        mif_write_word(&ms->buf, 0);
+        ms->address += 4;
+    }
+    while (ms->address < target)
+        mif_stream_byte(ms, 0, 0);
+}
+
+// coloca 'size' bytes de 'value' em 'address'
+static inline void mif_stream_put(mif_stream_t* ms, uint32_t address, uint32_t value, uint32_t size, int error) {
+    mif_stream_fill(ms, address);
+    if (size == 4 && (ms->address & 3) == 0) {
+        ms->word = value;
+        ms->error = error;
+        ms->address += 4;
+        mif_stream_emit(ms);
+        return;
+    }
+    for (uint32_t b = 0; b < size; ++b)
+        mif_stream_byte(ms, (uint8_t)(value >> (8 * b)), error);
+}
+
+// padding de alinhamento (nop nas palavras inteiras do .text)
+static inline void mif_stream_align(mif_stream_t* ms, uint32_t address, uint32_t size, int is_text) {
+    mif_stream_fill(ms, address);
+    uint32_t end = address + size;
+    while (ms->address < end) {
+        if (is_text && (ms->address & 3) == 0 && end - ms->address >= 4)
+            mif_stream_put(ms, ms->address, NOP_INSTRUCTION, 4, 0);
+        else if (is_text && (ms->address & 1) == 0 && end - ms->address >= 2)
+            mif_stream_put(ms, ms->address, RVC_NOP_INSTRUCTION, 2, 0);
+        else
+            mif_stream_byte(ms, 0, 0);
+    }
+}
+
+// completa até o fim da seção e a ultima palavra
+static inline void mif_stream_finish(mif_stream_t* ms, uint32_t end) {
+    mif_stream_fill(ms, end);
+    while ((ms->address & 3) != 0)
+        mif_stream_byte(ms, 0, 0);
+    out_buffer_free(&ms->buf);
+}
+
+// ---------------------------------------------------------------------------
+// imagem em memoria (para as saidas que precisam da seção inteira, como elf e objeto)
+
+// escreve 'size' bytes little-endian no offset (em bytes) de uma imagem de palavras
+static inline void image_put_bytes(uint32_t* words, uint32_t offset, uint32_t value, uint32_t size) {
+    for (uint32_t b = 0; b < size; ++b, ++offset) {
+        uint32_t shift = 8 * (offset & 3);
+        words[offset / 4] = (words[offset / 4] & ~(0xFFu << shift)) | (((value >> (8 * b)) & 0xFF) << shift);
+    }
+}
+
+// padding de alinhamento: nop nas palavras inteiras do .text, zero no resto
+static inline void image_fill_align(uint32_t* words, uint32_t offset, uint32_t size, int is_text) {
+    uint32_t end = offset + size;
+    while (offset < end) {
+        if (is_text && (offset & 3) == 0 && end - offset >= 4) {
+            words[offset / 4] = NOP_INSTRUCTION;
+            offset += 4;
+        } else if (is_text && (offset & 1) == 0 && end - offset >= 2) {
+            image_put_bytes(words, offset, RVC_NOP_INSTRUCTION, 2);
+            offset += 2;
+        } else {
+            image_put_bytes(words, offset++, 0, 1);
+        }
+    }
+}
+
+// monta a imagem de uma seção a partir dos valores já codificados nos itens (item.value).
+// retorna um vetor de palavras (zerado nos buracos) e o tamanho em bytes
+static inline uint32_t* section_build_image(const instruction_t* items, size_t count, SECTION_ID section, uint32_t* size_bytes) {
+    uint32_t base = section_base_address(section);
+    uint64_t end = section_end_address(items, count, section);
+    size_t word_count = (end - base + 3) / 4;
+
+    uint32_t* words = (uint32_t *)calloc(word_count ? word_count : 1, sizeof(uint32_t));
+    CHECK_ALLOC(words, exit(EXIT_FAILURE));
+
+    for (size_t i = 0; i < count; ++i) {
+        const instruction_t* item = &items[i];
+        if (item->section != section || item->size == 0) continue;
+        if (item->kind == ITEM_INSTRUCTION || item->kind == ITEM_DATA)
+            image_put_bytes(words, item->address - base, item->value, item->size);
+        else if (item->kind == ITEM_ALIGN)
+            image_fill_align(words, item->address - base, item->size, section == SECTION_TEXT);
+    }
+
+    *size_bytes = (uint32_t)(end - base);
+    return words;
+}
+
+// imagem de uma região (--layout): as seções dela nos seus endereços, zero no que sobra entre elas
+static inline uint32_t* region_build_image(const instruction_t* items, size_t count, const memory_region_t* region, uint32_t* size_bytes) {
+    uint64_t end = region->origin;
+    for (uint8_t k = 0; k < region->section_count; ++k) {
+        uint64_t section_end = section_end_address(items, count, (SECTION_ID)region->sections[k]);
+        if (section_end > end) end = section_end;
+    }
+
+    size_t word_count = (end - region->origin + 3) / 4;
+    uint32_t* words = (uint32_t *)calloc(word_count ? word_count : 1, sizeof(uint32_t));
+    CHECK_ALLOC(words, exit(EXIT_FAILURE));
+
+    // as seções começam alinhadas em 4 (regions.h), então é copia de palavras inteiras
+    for (uint8_t k = 0; k < region->section_count; ++k) {
+        SECTION_ID section = (SECTION_ID)region->sections[k];
+        uint32_t size;
+        uint32_t* section_words = section_build_image(items, count, section, &size);
+        memcpy(words + (section_base_address(section) - region->origin) / 4, section_words, (size + 3) / 4 * sizeof(uint32_t));
+        free(section_words);
+    }
+
+    *size_bytes = (uint32_t)(end - region->origin);
+    return words;
+}
+
+// escreve uma imagem inteira (ex: saida do linker) em um arquivo mif
+static inline int mif_write_image(const uint32_t* words, size_t count, const char* filename) {
+    FILE* f = fopen(filename, "w");
+    if (!f) return -1;
+    out_buffer_t buf;
+    out_buffer_init(&buf, f);
+    for (size_t i = 0; i < count; ++i)
+        mif_write_word(&buf, words[i]);
+    out_buffer_free(&buf);
+    fclose(f);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// listagem (.lst) e tabela de debug
+
+// cabeçalho do arquivo de listagem
+static inline void listing_write_header(out_buffer_t* buf, const char* source_name) {
+    out_buffer_printf(buf, "; listagem de '%s'\n", source_name);
+    out_buffer_puts(buf, "; endereco  | codigo     | linha | fonte\n");
+}
+
+// uma linha da listagem: endereço, palavra, linha original e o destino resolvido (B/J)
+// 'failed' vem do loop de codificação: um .word -1 tem a mesma palavra do sentinela e não é erro
+static inline void listing_write_entry(out_buffer_t* buf, const instruction_t* inst, uint32_t machine_code, bool failed,
+                                       const char* source_line, const symbol_table_t* symbols) {
+    if (inst->label) {
+        out_buffer_puts(buf, inst->label);
+        out_buffer_puts(buf, ":\n");
+    }
+
+    out_buffer_hex32(buf, inst->address);
+    out_buffer_puts(buf, " | ");
+    if (!failed)
+        out_buffer_hex32(buf, machine_code);
+    else
+        out_buffer_puts(buf, "XXXXXXXXXX");
+    out_buffer_puts(buf, " | ");
+    // a linha do arquivo de verdade, não a do texto já expandido pelo preprocessador
+    char line[SOURCE_LINE_MAX];
+    diag_origin_format(inst->line_number, line, sizeof(line));
+    out_buffer_printf(buf, "%5s | ", line);
+
+    // a linha original pode ter 'label:' inline, tira para não repetir
+    const char* text = source_line ? source_line : inst->mnemonic;
+    // (qualquer label, '.word a, b' gera varios itens e só o primeiro carrega a label)
+    if (source_line) {
+        size_t label_len = 0;
+        while (isalnum((unsigned char)text[label_len]) || text[label_len] == '_' || text[label_len] == '.')
+            label_len++;
+        if (label_len > 0 && text[label_len] == ':') {
+            text += label_len + 1;
+            while (isspace((unsigned char)*text)) text++;
+        }
+    }
+    out_buffer_puts(buf, text);
+
+    // para branches e jumps, mostra para onde a label foi resolvida
+    const instruction_entry_t* entry = find_instruction(inst->mnemonic);
+    if (entry && (entry->type == INST_B || entry->type == INST_J) && inst->operand_count > 0) {
+        const char* target = inst->operands[inst->operand_count - 1];
+        const symbol_t* sym = symbol_table_resolve(symbols, target, inst->line_number);
+        if (sym) {
+            out_buffer_puts(buf, "  ; -> ");
+            out_buffer_puts(buf, target);
+            out_buffer_puts(buf, " @ ");
+            out_buffer_hex32(buf, sym->address);
+        }
+    }
+    out_buffer_putc(buf, '\n');
+}
+
+// tabela antiga do stdout, agora só com --verbose
+static inline void table_write_header(out_buffer_t* buf) {
+    out_buffer_puts(buf, "--- iniciando segunda passagem (codificacao) ---\n");
+    out_buffer_puts(buf, "endereco   | codigo maq. (hex) | mnemonico\n");
+    out_buffer_puts(buf, "--------------------------------------------------\n");
+}
+
+static inline void table_write_entry(out_buffer_t* buf, const instruction_t* inst, uint32_t machine_code) {
+    out_buffer_hex32(buf, inst->address);
+    if (machine_code != ENCODING_ERROR_SENTINEL) {
+        out_buffer_puts(buf, " | ");
+        out_buffer_hex32(buf, machine_code);
+        out_buffer_puts(buf, "        | ");
+    } else {
+        out_buffer_puts(buf, " | erro encoding       | ");
+    }
+    out_buffer_puts(buf, inst->mnemonic);
+    out_buffer_putc(buf, '\n');
+}
+
+static inline void table_write_footer(out_buffer_t* buf) {
+    out_buffer_puts(buf, "--------------------------------------------------\n");
+}
+
+#endif
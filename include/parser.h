@@ -4,6 +4,10 @@
 #include "types.h"
 #include "utils.h"
 #include "symbol_table.h"
+#include "diag.h"
+#include "regions.h"
+#include "pseudo.h"
+#include "encoder.h"
 
 // verificar se a linha contém apenas uma label
 static inline int is_label_only(const char* line) {
@@ -22,34 +26,214 @@ static inline char* strip_label(char* token) {
 // faz split dos operandos por virgula
 static inline int split_operands(char* str, char* operands[4]) {
     int count = 0;
-    char* token = strtok(str, ",");
+    char* cursor = str;
+    char* token = next_field(&cursor, ',');
     while (token && count < 4) {
         operands[count++] = my_strdup(ltrim(token));
-        token = strtok(NULL, ",");
+        token = next_field(&cursor, ',');
     }
     return count;
 }
 
+// libera vetor de instructions (kkk caso eu lembre de usar essa porra)
+static inline void free_instructions(instruction_t* instructions, size_t count) {
+    if (!instructions) return;
+    for (size_t i = 0; i < count; i++) {
+        free(instructions[i].label);
+        for (int j = 0; j < instructions[i].operand_count; j++) {
+            free(instructions[i].operands[j]);
+        }
+        expr_free(instructions[i].expr);
+    }
+    free(instructions);
+}
+
+// verifica se a linha é uma diretiva (.globl, .word, ...)
+static inline int is_directive(const char* line) {
+    return line[0] == '.';
+}
+
+// vetor de itens que cresce conforme o parse (uma linha de .word pode virar varios itens)
+typedef struct {
+    instruction_t* items;
+    size_t count;
+    size_t capacity;
+} item_list_t;
+
+// label sozinha numa linha, esperando o proximo item (a linha dela vai para o --map)
+typedef struct {
+    char* name;
+    uint32_t line;
+} pending_label_t;
+
+static inline instruction_t* item_list_push(item_list_t* list, const instruction_t* item) {
+    if (list->count >= list->capacity) {
+        list->capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+        instruction_t* new_items = (instruction_t *)realloc(list->items, list->capacity * sizeof(instruction_t));
+        CHECK_ALLOC(new_items, exit(EXIT_FAILURE));
+        list->items = new_items;
+    }
+    list->items[list->count] = *item;
+    return &list->items[list->count++];
+}
+
+// cria um item de diretiva com um operando (ou nenhum)
+static inline instruction_t make_directive_item(ITEM_KIND kind, const char* name, const char* operand, uint32_t line_number) {
+    instruction_t item = {0};
+    item.kind = (uint8_t)kind;
+    item.line_number = line_number;
+    // as chaves de diretiva cabem no mnemonic (.section vira .text/.data), o corte é só garantia
+    size_t len = strlen(name);
+    memcpy(item.mnemonic, name, len < sizeof(item.mnemonic) ? len : sizeof(item.mnemonic) - 1);
+    if (operand) {
+        item.operands[0] = my_strdup(operand);
+        item.operand_count = 1;
+    }
+    return item;
+}
+
+// argumento numerico de diretiva (.align, .space, .org): expressão constante, o layout
+// precisa do valor antes de qualquer label ter endereço
+static inline bool directive_number(const char* arg, const char* name, uint32_t line_number, uint32_t* out) {
+    int64_t value = 0;
+    const char* error = NULL;
+    if (!arg || !*arg || expr_eval_constant(arg, &value, &error) != EXPR_OK || value < 0 || value > UINT32_MAX) {
+        if (error) diag_error(line_number, "argumento invalido para '%s': %s.", name, error);
+        else diag_error(line_number, "argumento invalido para '%s'.", name);
+        return false;
+    }
+    *out = (uint32_t)value;
+    return true;
+}
+
+// copia a linha para um buffer de SOURCE_LINE_MAX (cortando se precisar). só o tamanho da linha:
+// o strncpy completava o buffer inteiro com zeros, a cada linha do programa
+static inline void copy_source_line(char* buffer, const char* line) {
+    const char* end = (const char *)memchr(line, '\0', SOURCE_LINE_MAX - 1);
+    size_t len = end ? (size_t)(end - line) : SOURCE_LINE_MAX - 1;
+    memcpy(buffer, line, len);
+    buffer[len] = '\0';
+}
+
+// trata uma linha de diretiva, gerando zero ou mais itens. 'label' (se tiver) vai no primeiro item
+// com posição. retorna false se a diretiva tiver erro
+static inline bool parse_directive(const char* text, uint32_t line_number, char** label, item_list_t* list) {
+    char buffer[SOURCE_LINE_MAX];
+    copy_source_line(buffer, text);
+
+    char* comment_ptr = find_unquoted(buffer, '#');
+    if (comment_ptr)
+        *comment_ptr = '\0';
+    rtrim(buffer);
+
+    char* name = buffer;
+    char* args = buffer;
+    while (*args && !isspace((unsigned char)*args)) args++;
+    if (*args) *args++ = '\0';
+    args = ltrim(args);
+
+    instruction_t item;
+    uint32_t number = 0;
+
+    if (strcmp(name, ".globl") == 0 || strcmp(name, ".global") == 0) {
+        // um item por simbolo, o binding é aplicado no layout depois que todas as labels existem
+        char* save;
+        for (char* sym = strtok_r(args, " \t,", &save); sym; sym = strtok_r(NULL, " \t,", &save)) {
+            item = make_directive_item(ITEM_GLOBAL, ".globl", sym, line_number);
+            item_list_push(list, &item);
+        }
+        return true;
+    }
+    if (strcmp(name, ".extern") == 0) {
+        // simbolos não definidos já viram relocação no modo objeto, nada a fazer
+        return true;
+    }
+
+    if (strcmp(name, ".text") == 0 || strcmp(name, ".data") == 0 || strcmp(name, ".section") == 0) {
+        char* save;
+        const char* section_name = strcmp(name, ".section") == 0 ? strtok_r(args, " \t,", &save) : name;
+        if (section_name && strcmp(section_name, ".text") == 0) {
+            item = make_directive_item(ITEM_SECTION, ".text", NULL, line_number);
+            item.value = SECTION_TEXT;
+        } else if (section_name && (strcmp(section_name, ".data") == 0 || strcmp(section_name, ".rodata") == 0)) {
+            item = make_directive_item(ITEM_SECTION, ".data", NULL, line_number);
+            item.value = SECTION_DATA;
+        } else {
+            diag_error(line_number, "secao '%s' nao suportada.", section_name ? section_name : "");
+            return false;
+        }
+    } else if (strcmp(name, ".word") == 0 || strcmp(name, ".half") == 0 || strcmp(name, ".byte") == 0) {
+        uint32_t size = name[1] == 'w' ? 4 : name[1] == 'h' ? 2 : 1;
+        bool first = true;
+        char* cursor = args;
+        for (char* value = next_field(&cursor, ','); value; value = next_field(&cursor, ',')) {
+            value = ltrim(value);
+            rtrim(value);
+            item = make_directive_item(ITEM_DATA, name, value, line_number);
+            item.size = size;
+            if (first && *label) {
+                item.label = *label;
+                *label = NULL;
+            }
+            first = false;
+            item_list_push(list, &item);
+        }
+        if (first) {
+            diag_error(line_number, "'%s' sem valores.", name);
+            return false;
+        }
+        return true;
+    } else if (strcmp(name, ".space") == 0 || strcmp(name, ".zero") == 0) {
+        if (!directive_number(args, name, line_number, &number)) return false;
+        item = make_directive_item(ITEM_SPACE, name, NULL, line_number);
+        item.size = number;
+    } else if (strcmp(name, ".align") == 0 || strcmp(name, ".p2align") == 0 || strcmp(name, ".balign") == 0) {
+        if (!directive_number(args, name, line_number, &number)) return false;
+        // .align n no riscv é 2^n bytes (igual .p2align), .balign já recebe os bytes
+        uint32_t alignment = strcmp(name, ".balign") == 0 ? number : (number < 31 ? 1u << number : 0);
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+            diag_error(line_number, "alinhamento '%s' invalido para '%s'.", args, name);
+            return false;
+        }
+        item = make_directive_item(ITEM_ALIGN, ".align", NULL, line_number);
+        item.value = alignment;
+    } else if (strcmp(name, ".org") == 0) {
+        if (!directive_number(args, name, line_number, &number)) return false;
+        item = make_directive_item(ITEM_ORG, name, NULL, line_number);
+        item.value = number;
+    } else {
+        diag_warning(line_number, "diretiva '%s' ignorada.", name);
+        return true;
+    }
+
+    if (*label) {
+        item.label = *label;
+        *label = NULL;
+    }
+    item_list_push(list, &item);
+    return true;
+}
+
 // parse uma linha e retorna um instruction_t
 static inline instruction_t parse_line(const char* line, uint32_t line_number) {
     instruction_t inst = {0};
     inst.line_number = line_number;
 
     char buffer[SOURCE_LINE_MAX];
-    strncpy(buffer, line, SOURCE_LINE_MAX - 1);
-    buffer[SOURCE_LINE_MAX - 1] = '\0';
+    copy_source_line(buffer, line);
 
-    char* comment_ptr = strchr(buffer, '#');
+    char* comment_ptr = find_unquoted(buffer, '#');
     if (comment_ptr)
         *comment_ptr = '\0';
     rtrim(buffer);
 
-    char* token = strtok(buffer, " \t");
+    char* save;
+    char* token = strtok_r(buffer, " \t", &save);
 
     // caso tenha label
     if (token && strchr(token, ':')) {
         inst.label = strip_label(token);
-        token = strtok(NULL, " \t"); // proximo token (possivel mnemonic)
+        token = strtok_r(NULL, " \t", &save); // proximo token (possivel mnemonic)
     }
 
     // caso nao tenha instrucao (so label)
@@ -59,7 +243,7 @@ static inline instruction_t parse_line(const char* line, uint32_t line_number) {
     inst.mnemonic[sizeof(inst.mnemonic) - 1] = '\0';
 
     // restante da linha sao os operandos
-    char* operand_str = strtok(NULL, "\n");
+    char* operand_str = strtok_r(NULL, "\n", &save);
     if (operand_str) {
         inst.operand_count = split_operands(operand_str, inst.operands);
     }
@@ -67,52 +251,365 @@ static inline instruction_t parse_line(const char* line, uint32_t line_number) {
     return inst;
 }
 
-// parse um vetor de linhas em vetor de instruções
-static inline instruction_t* parse_lines(char** lines, size_t line_count, size_t* out_count, symbol_table_t* table) {
-    instruction_t* instructions = (instruction_t *) malloc(line_count * sizeof(instruction_t));
-    CHECK_ALLOC(instructions, return NULL);
+// endereço inicial de cada seção (o da região dela, se tem --layout/--region)
+static inline uint32_t section_base_address(SECTION_ID section) {
+    const memory_layout_t* layout = memory_layout_active;
+    if (layout && layout->section_region[section] >= 0)
+        return layout->section_base[section];
+    return section == SECTION_DATA ? DATA_BASE_ADDRESS : BASE_ADDRESS;
+}
+
+static inline const char* section_name(SECTION_ID section) {
+    return section == SECTION_DATA ? ".data" : ".text";
+}
+
+// uma passada do layout: distribui os endereços usando um location counter por seção e (re)monta
+// a tabela de simbolos. deixa em 'location' o fim de cada seção
+static inline size_t layout_sections(instruction_t* items, size_t count, symbol_table_t* table, uint32_t location[SECTION_COUNT]) {
+    for (int s = 0; s < SECTION_COUNT; s++)
+        location[s] = section_base_address((SECTION_ID)s);
+
+    uint8_t section = SECTION_TEXT;
+    size_t errors = 0;
+
+    symbol_table_free(table);
+    symbol_table_init(table);
+
+    for (size_t i = 0; i < count; i++) {
+        instruction_t* item = &items[i];
+        item->section = section;
+        item->address = location[section];
+        if (item->expr) item->expr->flags &= (uint8_t)~EXPR_FLAG_BOUND; // a tabela vai ser refeita
+
+        // label fica no endereço antes do efeito da diretiva (igual ao gnu as)
+        if (item->label) {
+            uint32_t number;
+            symbol_t* sym = NULL;
+            if (label_is_numeric(item->label, &number))
+                sym = symbol_table_add_numeric(table, number, item->line_number, location[section]);
+            else if (symbol_table_add(table, item->label, location[section]))
+                sym = &table->entries[table->count - 1];
+
+            uint32_t label_line = item->label_line ? item->label_line : item->line_number;
+            if (sym) {
+                sym->section = section;
+                sym->line = label_line;
+                if (item->kind == ITEM_INSTRUCTION && expr_is_pcrel_hi(item->expr) && strcmp(item->mnemonic, "auipc") == 0)
+                    sym->pcrel_hi = item->expr;
+            } else {
+                diag_error(label_line, "label '%s' ja definida.", item->label);
+                errors++;
+            }
+        }
+
+        switch (item->kind) {
+            case ITEM_INSTRUCTION:
+                // com RV32C as instruções só precisam estar alinhadas em 2 bytes
+                if (location[section] % ((item->flags & ITEM_FLAG_RVC) ? 2 : 4) != 0) {
+                    diag_error(item->line_number, "instrucao '%s' em endereco desalinhado 0x%08x.", item->mnemonic, location[section]);
+                    errors++;
+                }
+                item->size = (item->flags & ITEM_FLAG_COMPRESSED) ? 2 : 4;
+                break;
+
+            case ITEM_ALIGN:
+                item->size = (item->value - (location[section] & (item->value - 1))) & (item->value - 1);
+                break;
+
+            case ITEM_ORG: {
+                // aceita tanto endereço absoluto quanto offset a partir do inicio da seção
+                uint32_t base = section_base_address((SECTION_ID)section);
+                uint32_t target = item->value >= base ? item->value : base + item->value;
+                if (target < location[section]) {
+                    diag_error(item->line_number, ".org 0x%08x volta para tras (location counter em 0x%08x).", target, location[section]);
+                    errors++;
+                    target = location[section];
+                }
+                item->size = target - location[section];
+                break;
+            }
 
-    char* pending_label = NULL;
-    size_t count = 0;
+            case ITEM_SECTION:
+                section = (uint8_t)item->value;
+                item->size = 0;
+                break;
 
-    for (size_t i = 0; i < line_count; i++) {
-        char* line = lines[i];
+            case ITEM_GLOBAL:
+            case ITEM_LABEL:
+                item->size = 0;
+                break;
 
-        // caso a linha seja apenas uma label
-        if (is_label_only(line)) {
-            free(pending_label);
-            pending_label = strip_label(line);
+            default: // ITEM_DATA e ITEM_SPACE já sabem o tamanho desde o parse
+                break;
+        }
+
+        location[item->section] += item->size;
+    }
+
+    // só agora todas as labels existem para receber o binding global
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].kind == ITEM_GLOBAL)
+            symbol_table_mark_global(table, items[i].operands[0]);
+    }
+
+    return errors;
+}
+
+// distribui os endereços e (re)monta a tabela de simbolos. pode ser chamada de novo sempre que
+// alguma passagem mudar o tamanho dos itens. seção que divide a região com outra começa onde a
+// anterior termina, então o layout roda de novo quando esse inicio muda (a de cima não depende
+// da de baixo, uma rodada a mais por seção encadeada basta). retorna a quantidade de erros
+static inline size_t layout_program(instruction_t* items, size_t count, symbol_table_t* table) {
+    uint32_t end[SECTION_COUNT];
+    size_t errors = layout_sections(items, count, table, end);
+    for (int pass = 1; errors == 0 && pass < SECTION_COUNT && memory_layout_chain(end); pass++)
+        errors = layout_sections(items, count, table, end);
+    return errors;
+}
+
+// ---- resolução entre as passagens ----
+// depois do ultimo layout cada simbolo usado nas expressões vira a posição dele na tabela
+// (o vetor de entries é denso), então a segunda passagem não procura nome nenhum. os que faltam
+// são reportados aqui, uma vez por nome com todas as linhas que usam, e não um erro por uso
+
+#define BIND_MAX_LINES 8     // linhas listadas por simbolo indefinido
+
+typedef struct {
+    const char* name;        // aponta para a expressão do primeiro uso
+    uint32_t first_line;
+    uint32_t last_line;
+    uint32_t lines[BIND_MAX_LINES];
+    size_t count;            // usos (pode passar de BIND_MAX_LINES)
+} bind_undefined_t;
+
+// "linha N" do fonte original (com .include a linha expandida não diz nada para quem lê)
+static inline void bind_append_line(char* out, size_t size, uint32_t line) {
+    diag_origin_t origin = diag_origin(line);
+    size_t len = strlen(out);
+    snprintf(out + len, size - len, "%s%u", len ? ", " : "", origin.line);
+}
+
+// no modo objeto (relocatable) quem falta é externo, não erro. retorna quantos nomes faltaram
+static inline size_t bind_symbols(instruction_t* items, size_t count, const symbol_table_t* table, bool relocatable) {
+    symbol_table_t undefined_index;  // nome -> posição em 'undefined' (no campo address)
+    symbol_table_init(&undefined_index);
+    bind_undefined_t* undefined = NULL;
+    size_t undefined_count = 0, undefined_capacity = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        expr_t* e = items[i].expr;
+        if (!e) continue;
+        for (size_t k = 0; k < e->count; k++) {
+            expr_op_t* op = &e->ops[k];
+            if (op->op != EXPR_SYMBOL && op->op != EXPR_PCREL_LO) continue;
+            const char* name = e->names + op->name;
+
+            uint32_t number;
+            bool forward, found;
+            bool numeric = label_numeric_ref(name, &number, &forward);
+            if (numeric) {
+                // depende da linha de quem usa, continua na busca binaria
+                op->symbol = 0;
+                found = numeric_label_find(table, number, forward, items[i].line_number, NULL) != NULL;
+            } else {
+                const symbol_t* sym = symbol_table_find(table, name);
+                op->symbol = sym ? (uint32_t)(sym - table->entries) + 1 : EXPR_SYMBOL_UNDEFINED;
+                found = sym != NULL;
+            }
+            // no objeto label normal que falta é externa (mas o %pcrel_lo precisa do auipc aqui)
+            if (found || (relocatable && !numeric && op->op == EXPR_SYMBOL)) continue;
+
+            const symbol_t* known = symbol_table_find(&undefined_index, name);
+            bind_undefined_t* entry;
+            if (known) {
+                entry = &undefined[known->address];
+            } else {
+                if (undefined_count >= undefined_capacity) {
+                    undefined_capacity = undefined_capacity ? undefined_capacity * 2 : ST_INITIAL_CAPACITY;
+                    bind_undefined_t* grown = (bind_undefined_t *)realloc(undefined, undefined_capacity * sizeof(bind_undefined_t));
+                    CHECK_ALLOC(grown, exit(EXIT_FAILURE));
+                    undefined = grown;
+                }
+                symbol_table_add(&undefined_index, name, (uint32_t)undefined_count);
+                entry = &undefined[undefined_count++];
+                entry->name = name;
+                entry->first_line = items[i].line_number;
+                entry->count = 0;
+            }
+            // a mesma linha conta uma vez só (ex: as duas metades do `la`)
+            if (entry->count > 0 && entry->last_line == items[i].line_number) continue;
+            entry->last_line = items[i].line_number;
+            if (entry->count < BIND_MAX_LINES) entry->lines[entry->count] = items[i].line_number;
+            entry->count++;
+        }
+        e->flags |= EXPR_FLAG_BOUND;
+    }
+
+    for (size_t u = 0; u < undefined_count; u++) {
+        const bind_undefined_t* entry = &undefined[u];
+        if (entry->count == 1) {
+            diag_error(entry->first_line, "label '%s' nao encontrado.", entry->name);
             continue;
         }
+        char lines[BIND_MAX_LINES * 12 + 32] = "";
+        size_t listed = entry->count < BIND_MAX_LINES ? entry->count : BIND_MAX_LINES;
+        for (size_t l = 1; l < listed; l++)
+            bind_append_line(lines, sizeof(lines), entry->lines[l]);
+        if (entry->count > listed) {
+            size_t len = strlen(lines);
+            snprintf(lines + len, sizeof(lines) - len, " e mais %zu", entry->count - listed);
+        }
+        diag_error(entry->first_line, "label '%s' nao encontrado (usado tambem nas linhas %s).", entry->name, lines);
+    }
+
+    free(undefined);
+    symbol_table_free(&undefined_index);
+    return undefined_count;
+}
+
+static inline void parse_source_items(char* source, uint32_t line_number, pending_label_t* pending, item_list_t* list) {
+    char* line = ltrim(source); // tira espaços iniciais nas linhas
 
-        instruction_t inst = parse_line(line, (uint32_t)i + 1);
-        inst.address = BASE_ADDRESS + 4 * count;
+    if (line[0] == '\0' || line[0] == '#') // ignora linhas vazias
+        return;
 
-        // se havia uma label pendente
-        if (pending_label) {
-            inst.label = pending_label;
-            symbol_table_add(table, pending_label, inst.address);
-            pending_label = NULL;
+    // caso a linha seja apenas uma label
+    if (is_label_only(line)) {
+        free(pending->name);
+        pending->name = strip_label(line);
+        pending->line = line_number;
+        return;
+    }
+
+    // label inline antes de diretiva (ex: `tabela: .word 1, 2`)
+    const char* text = line;
+    char* inline_label = NULL;
+    const char* colon = strchr(line, ':');
+    if (colon && !is_directive(line)) {
+        const char* after = colon + 1;
+        while (isspace((unsigned char)*after)) after++;
+        if (is_directive(after)) {
+            char label_buf[SOURCE_LINE_MAX];
+            size_t len = (size_t)(colon - line);
+            if (len >= sizeof(label_buf)) len = sizeof(label_buf) - 1;
+            memcpy(label_buf, line, len);
+            label_buf[len] = '\0';
+            rtrim(label_buf);
+            inline_label = my_strdup(label_buf);
+            text = after;
         }
+    }
 
-        // se a instrução possui label inline, como `main2: beq` (tive problema com isso)
-        else if (inst.label) {
-            symbol_table_add(table, inst.label, inst.address);
+    if (is_directive(text)) {
+        if (inline_label) {
+            free(pending->name);
+            pending->name = inline_label;
+            pending->line = line_number;
         }
+        size_t first = list->count;
+        bool labeled = pending->name != NULL;
+        parse_directive(text, line_number, &pending->name, list); // erro já foi para o diag
+        if (labeled && !pending->name && first < list->count)
+            list->items[first].label_line = pending->line;
+        return;
+    }
 
-        instructions[count++] = inst;
+    instruction_t inst = parse_line(line, line_number);
+    inst.kind = ITEM_INSTRUCTION;
+
+    // se havia uma label pendente
+    if (pending->name) {
+        if (inst.label) {
+            // duas labels no mesmo endereço, a pendente vira um item proprio
+            instruction_t label_item = make_directive_item(ITEM_LABEL, "", NULL, inst.line_number);
+            label_item.label = pending->name;
+            label_item.label_line = pending->line;
+            item_list_push(list, &label_item);
+        } else {
+            inst.label = pending->name;
+            inst.label_line = pending->line;
+        }
+        pending->name = NULL;
+    }
+
+    // pseudo-instrução vira as instruções base aqui, antes do layout
+    char expansion[PSEUDO_MAX_EXPANSION][SOURCE_LINE_MAX];
+    int expanded = pseudo_expand(&inst, expansion);
+    if (expanded != 0) {
+        if (expanded < 0 && inst.label) {
+            // a label continua existindo, senão cada uso dela vira mais um erro
+            instruction_t label_item = make_directive_item(ITEM_LABEL, "", NULL, inst.line_number);
+            label_item.label = inst.label;
+            label_item.label_line = inst.label_line;
+            item_list_push(list, &label_item);
+        }
+        for (int k = 0; k < expanded; k++) {
+            instruction_t base = parse_line(expansion[k], inst.line_number);
+            base.kind = ITEM_INSTRUCTION;
+            if (k == 0) {
+                base.label = inst.label;
+                base.label_line = inst.label_line;
+            }
+            item_list_push(list, &base);
+        }
+        for (int j = 0; j < inst.operand_count; j++)
+            free(inst.operands[j]);
+        return;
     }
 
+    item_list_push(list, &inst);
+}
+
+// parse uma linha do fonte, jogando os itens em 'list'. uma linha só com label fica em
+// 'pending' até o proximo item (o --lsp chama linha por linha e reaproveita o resto).
+// os imediatos já saem compilados (expr.h), o encoder só avalia
+static inline void parse_source_line(char* source, uint32_t line_number, pending_label_t* pending, item_list_t* list) {
+    size_t first = list->count;
+    parse_source_items(source, line_number, pending, list);
+    for (size_t i = first; i < list->count; i++)
+        item_compile_expr(&list->items[i]);
+}
+
+// parse um vetor de linhas em vetor de instruções (e itens de diretiva) e já faz o layout
+static inline instruction_t* parse_lines(char** lines, size_t line_count, size_t* out_count, symbol_table_t* table) {
+    item_list_t list = {0};
+    pending_label_t pending = {NULL, 0};
+
+    for (size_t i = 0; i < line_count; i++)
+        parse_source_line(lines[i], (uint32_t)i + 1, &pending, &list);
+
     // se sobrou uma label no final
-    if (pending_label) {
-        symbol_table_add(table, pending_label, BASE_ADDRESS + 4 * count);
-        free(pending_label);
+    if (pending.name) {
+        instruction_t label_item = make_directive_item(ITEM_LABEL, "", NULL, (uint32_t)line_count);
+        label_item.label = pending.name;
+        label_item.label_line = pending.line;
+        item_list_push(&list, &label_item);
+    }
+
+    // com erro o layout roda do mesmo jeito: a segunda passagem ainda acha os erros de
+    // codificação das outras linhas (quem chama olha o diag_error_count() antes de gerar saida)
+    layout_program(list.items, list.count, table);
+
+    // vetor vazio ainda precisa ser um ponteiro valido para o main
+    if (!list.items) {
+        list.items = (instruction_t *)malloc(sizeof(instruction_t));
+        CHECK_ALLOC(list.items, return NULL);
     }
 
-    *out_count = count;
-    return instructions;
+    *out_count = list.count;
+    return list.items;
 }
 
+// encontra o fim (maior endereço ocupado + 1) de uma seção. em 64 bits: uma seção que vai até
+// 0xffffffff termina em 2^32
+static inline uint64_t section_end_address(const instruction_t* items, size_t count, SECTION_ID section) {
+    uint64_t end = section_base_address(section);
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].section == section && (uint64_t)items[i].address + items[i].size > end)
+            end = (uint64_t)items[i].address + items[i].size;
+    }
+    return end;
+}
 
 static inline void instruction_dump(const instruction_t* instr) {
     printf("instruction at 0x%08X (line %u):\n", instr->address, instr->line_number);
@@ -135,16 +632,4 @@ static inline void instruction_dump(const instruction_t* instr) {
 }
 
 
-// libera vetor de instructions (kkk caso eu lembre de usar essa porra)
-static inline void free_instructions(instruction_t* instructions, size_t count) {
-    if (!instructions) return;
-    for (size_t i = 0; i < count; i++) {
-        free(instructions[i].label);
-        for (int j = 0; j < instructions[i].operand_count; j++) {
-            free(instructions[i].operands[j]);
-        }
-    }
-    free(instructions);
-}
-
 #endif
\ No newline at end of file
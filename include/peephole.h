@@ -0,0 +1,197 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "encoder.h"
+#include "parser.h"
+#include "disasm.h"
+#include "hazard.h"
+
+// otimizador peephole (--peephole) sobre o vetor de itens, logo depois do parse_lines:
+//   - `addi x, x, 0` (mv de um registrador para ele mesmo, comum em codigo gerado)
+//   - instruções de ALU que escrevem em zero (o resultado some, e nenhuma delas tem efeito colateral)
+//   - jal zero / branch para a instrução seguinte
+//
+// o nop canonico (addi zero, zero, 0) fica: quem escreve nop quer o ciclo ou o padding.
+// loads em zero também ficam (podem dar fault ou mexer em periferico), e jal/jalr com rd
+// diferente de zero escrevem o endereço de retorno.
+// tirar uma instrução muda os endereços, então o layout e a tabela de simbolos são refeitos
+// a cada rodada, e remover um item pode deixar outro jump apontando para o seguinte (daí o loop).
+// branches com offset numerico não se ajustam sozinhos: nada entre eles e o destino é removido.
+
+typedef enum {
+    PEEPHOLE_SELF_MOVE,
+    PEEPHOLE_WRITE_ZERO,
+    PEEPHOLE_JUMP_NEXT,
+    PEEPHOLE_RULE_COUNT
+} PEEPHOLE_RULE;
+
+static const char* const peephole_rule_names[PEEPHOLE_RULE_COUNT] = {
+    "addi x, x, 0",
+    "escrita em zero",
+    "desvio para a proxima instrucao"
+};
+
+typedef struct {
+    size_t removed[PEEPHOLE_RULE_COUNT];
+    size_t kept;             // casaram uma regra mas estavam no alcance de um offset numerico
+    int iterations;
+    uint32_t text_before;
+    uint32_t text_after;
+} peephole_stats_t;
+
+// trecho [low, high) coberto por um desvio com offset numerico
+typedef struct {
+    uint32_t low;
+    uint32_t high;
+    size_t owner;
+} peephole_range_t;
+
+// regra que remove a instrução já codificada, -1 se nenhuma
+static inline int peephole_match(const instruction_t* item, const hazard_inst_t* inst) {
+    INST_FORMAT format = inst->entry->format;
+    uint8_t rs1 = (inst->word >> 15) & 0x1F;
+    int32_t imm = (int32_t)inst->word >> 20;
+
+    if (format == FMT_I && inst->entry->funct3 == 0 && inst->rd == rs1 && imm == 0) {
+        // só com o 0 escrito: o %lo(label) do la pode valer 0 agora e deixar de valer depois do layout
+        bool literal = false;
+        if (item->operand_count == 3) parse_immediate(item->operands[2], &literal);
+        return inst->rd != 0 && literal ? PEEPHOLE_SELF_MOVE : -1;
+    }
+    if (inst->rd == 0 && (format == FMT_R || format == FMT_I || format == FMT_SHIFT || format == FMT_U))
+        return PEEPHOLE_WRITE_ZERO;
+    if (format == FMT_JAL && inst->rd == 0 && disasm_jal_offset(inst->word) == (int32_t)item->size)
+        return PEEPHOLE_JUMP_NEXT;
+    if (format == FMT_BRANCH && disasm_branch_offset(inst->word) == (int32_t)item->size)
+        return PEEPHOLE_JUMP_NEXT;
+    return -1;
+}
+
+// jump/branch cujo destino está escrito como numero (ex: `beq a0, a1, 8`)
+static inline bool peephole_numeric_target(const instruction_t* item, const hazard_inst_t* inst) {
+    INST_FORMAT format = inst->entry->format;
+    if ((format != FMT_BRANCH && format != FMT_JAL) || item->operand_count == 0) return false;
+    const char* target = item->operands[item->operand_count - 1];
+    if (item->expr && strcmp(item->expr->text, target) == 0)
+        return !(item->expr->flags & (EXPR_FLAG_SYMBOL | EXPR_FLAG_DOT));
+    bool ok;
+    parse_immediate(target, &ok);
+    return ok;
+}
+
+// tira o item do programa. se tinha label, sobra um item de label no lugar
+// (a label passa a valer o endereço da instrução seguinte)
+static inline void peephole_remove(instruction_t* item, item_list_t* out) {
+    for (int k = 0; k < item->operand_count; k++)
+        free(item->operands[k]);
+    expr_free(item->expr);
+    if (!item->label) return;
+
+    instruction_t label_item = make_directive_item(ITEM_LABEL, "", NULL, item->line_number);
+    label_item.label = item->label;
+    label_item.section = item->section;
+    label_item.address = item->address;
+    item_list_push(out, &label_item);
+}
+
+// retorna a quantidade de erros do layout
+static inline size_t peephole_program(instruction_t** items, size_t* count, symbol_table_t* table, peephole_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->text_before = section_end_address(*items, *count, SECTION_TEXT) - section_base_address(SECTION_TEXT);
+
+    size_t errors = 0;
+    encoder_quiet = 1;
+    for (;;) {
+        stats->iterations++;
+        stats->kept = 0;     // vale o que sobrou na ultima rodada
+        size_t n = *count;
+        int8_t* rule = (int8_t *)malloc(n ? n : 1);
+        peephole_range_t* ranges = (peephole_range_t *)malloc((n ? n : 1) * sizeof(peephole_range_t));
+        CHECK_ALLOC(rule, exit(EXIT_FAILURE));
+        CHECK_ALLOC(ranges, exit(EXIT_FAILURE));
+        size_t range_count = 0, matches = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            const instruction_t* item = &(*items)[i];
+            rule[i] = -1;
+            if (item->kind != ITEM_INSTRUCTION || item->section != SECTION_TEXT) continue;
+
+            hazard_inst_t inst;
+            uint32_t word = encode_instruction(item, table, item->address);
+            if (word == ENCODING_ERROR_SENTINEL || !hazard_decode_word(word, &inst)) continue;
+
+            if (peephole_numeric_target(item, &inst)) {
+                int32_t offset = inst.entry->format == FMT_JAL ? disasm_jal_offset(word) : disasm_branch_offset(word);
+                uint32_t target = item->address + (uint32_t)offset;
+                ranges[range_count].low = offset < 0 ? target : item->address;
+                ranges[range_count].high = offset < 0 ? item->address : target;
+                ranges[range_count].owner = i;
+                range_count++;
+            }
+            rule[i] = (int8_t)peephole_match(item, &inst);
+            if (rule[i] >= 0) matches++;
+        }
+
+        // o que está entre um offset numerico e o destino fica (o proprio desvio pode sair)
+        size_t removed = 0;
+        for (size_t i = 0; i < n && matches > 0; i++) {
+            if (rule[i] < 0) continue;
+            uint32_t address = (*items)[i].address;
+            for (size_t r = 0; r < range_count; r++) {
+                if (ranges[r].owner != i && address >= ranges[r].low && address < ranges[r].high) {
+                    rule[i] = -1;
+                    stats->kept++;
+                    break;
+                }
+            }
+            if (rule[i] >= 0) removed++;
+        }
+        free(ranges);
+
+        if (removed == 0) {
+            free(rule);
+            break;
+        }
+
+        item_list_t out = {0};
+        for (size_t i = 0; i < n; i++) {
+            instruction_t* item = &(*items)[i];
+            if (rule[i] >= 0) {
+                stats->removed[rule[i]]++;
+                peephole_remove(item, &out);
+            } else {
+                item_list_push(&out, item);
+            }
+        }
+        free(rule);
+        free(*items);
+        *items = out.items;
+        *count = out.count;
+
+        errors += layout_program(*items, *count, table);
+        if (errors > 0) break;
+    }
+    encoder_quiet = 0;
+
+    stats->text_after = section_end_address(*items, *count, SECTION_TEXT) - section_base_address(SECTION_TEXT);
+    return errors;
+}
+
+static inline void peephole_report(const peephole_stats_t* stats) {
+    size_t total = 0;
+    for (int r = 0; r < PEEPHOLE_RULE_COUNT; r++)
+        total += stats->removed[r];
+    printf("peephole: %zu instrucao(oes) removida(s), .text %u -> %u bytes (%d rodada(s)).\n",
+           total, stats->text_before, stats->text_after, stats->iterations);
+    for (int r = 0; r < PEEPHOLE_RULE_COUNT; r++)
+        printf("  %-32s %zu\n", peephole_rule_names[r], stats->removed[r]);
+    if (stats->kept > 0)
+        printf("  %zu mantida(s) por estar(em) no alcance de um desvio com offset numerico.\n", stats->kept);
+}
+
+#endif
@@ -0,0 +1,814 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "expr.h"
+#include "diag.h"
+
+// preprocessador: roda antes do parse_lines e devolve as linhas já expandidas, cada uma com o
+// arquivo/linha de onde veio (diag_origin_t), para os erros apontarem para o fonte de verdade.
+//
+//   .include "arquivo"       caminho relativo ao arquivo que inclui. o conteudo é lido uma vez só
+//                            (cache), e um arquivo inteiro dentro de `.ifndef X` ... `.endif` nem
+//                            é relido quando X já existe (include guard)
+//   .macro nome a, b=1       ... .endm. no corpo, \a vira o argumento, \@ o numero da expansão
+//                            (para labels unicas) e \() não vira nada (separa `\a\()_fim`)
+//   .equ / .set NOME, expr   constante (pode ser redefinida). o nome é trocado pelo valor nas
+//                            linhas seguintes
+//   .if expr / .ifdef NOME / .ifndef NOME / .else / .endif
+//
+// o corpo da macro é quebrado em pedaços (texto e parametro) uma vez só, na definição; cada
+// expansão só concatena os pedaços com os argumentos.
+
+#define PP_MAX_INCLUDE_DEPTH 32
+#define PP_MAX_MACRO_DEPTH   64  // macro chamando macro (pega recursão infinita)
+#define PP_MAX_MACRO_PARAMS  16
+#define PP_MAX_IF_DEPTH      64
+#define PP_PARAM_COUNTER     -2  // \@ no corpo da macro
+
+// arquivo lido (um por caminho)
+typedef struct {
+    char* path;
+    char** lines;
+    size_t line_count;
+    char* guard;             // X do `.ifndef X` que cerca o arquivo todo (ou NULL)
+} pp_file_t;
+
+// pedaço do corpo de uma macro: texto literal ou parametro
+typedef struct {
+    char* text;              // literal (NULL se for parametro)
+    int param;               // indice do parametro, PP_PARAM_COUNTER, ou -1 se literal
+} pp_segment_t;
+
+typedef struct {
+    pp_segment_t* segments;
+    size_t count;
+    uint32_t line;           // linha do corpo no arquivo onde a macro foi definida
+} pp_body_line_t;
+
+typedef struct {
+    char* name;
+    char* params[PP_MAX_MACRO_PARAMS];
+    char* defaults[PP_MAX_MACRO_PARAMS]; // NULL = obrigatorio
+    int param_count;
+    pp_body_line_t* body;
+    size_t body_count;
+    size_t body_capacity;
+    const char* file;        // arquivo da definição (aponta para o cache)
+} pp_macro_t;
+
+typedef struct {
+    bool active;             // as linhas deste nivel entram?
+    bool taken;              // algum ramo já entrou (o .else só entra se nenhum entrou)
+    bool has_else;
+    uint32_t line;
+} pp_cond_t;
+
+typedef struct {
+    const char* filename;    // arquivo principal
+    // saida
+    char** lines;
+    diag_origin_t* origins;
+    size_t count;
+    size_t capacity;
+
+    pp_file_t* files;
+    size_t file_count;
+    size_t file_capacity;
+    pp_macro_t* macros;
+    size_t macro_count;
+    size_t macro_capacity;
+    symbol_table_t macro_index; // nome -> indice em macros
+    symbol_table_t constants;   // nome -> valor (.equ/.set)
+
+    pp_cond_t conds[PP_MAX_IF_DEPTH];
+    int cond_depth;
+    pp_macro_t* defining;    // macro sendo definida (entre .macro e .endm)
+    int defining_depth;      // .macro dentro do corpo (vai junto para o corpo)
+    unsigned counter;        // \@
+    size_t errors;
+} preprocessor_t;
+
+// origem da linha sendo processada (vai para o diag_origin_t de cada linha de saida)
+typedef struct {
+    const char* file;
+    uint32_t line;
+    const char* macro;
+    const char* call_file;
+    uint32_t call_line;
+} pp_context_t;
+
+static inline void preprocess_init(preprocessor_t* pp) {
+    memset(pp, 0, sizeof(*pp));
+    symbol_table_init(&pp->macro_index);
+    symbol_table_init(&pp->constants);
+}
+
+// as linhas de saida não são liberadas aqui (quem chamou ficou com elas)
+static inline void preprocess_free(preprocessor_t* pp) {
+    for (size_t i = 0; i < pp->file_count; i++) {
+        for (size_t l = 0; l < pp->files[i].line_count; l++)
+            free(pp->files[i].lines[l]);
+        free(pp->files[i].lines);
+        free(pp->files[i].path);
+        free(pp->files[i].guard);
+    }
+    free(pp->files);
+    for (size_t m = 0; m < pp->macro_count; m++) {
+        pp_macro_t* macro = &pp->macros[m];
+        free(macro->name);
+        for (int p = 0; p < macro->param_count; p++) {
+            free(macro->params[p]);
+            free(macro->defaults[p]);
+        }
+        for (size_t b = 0; b < macro->body_count; b++) {
+            for (size_t s = 0; s < macro->body[b].count; s++)
+                free(macro->body[b].segments[s].text);
+            free(macro->body[b].segments);
+        }
+        free(macro->body);
+    }
+    free(pp->macros);
+    for (size_t i = 0; pp->origins && i < pp->count; i++)
+        free((char *)pp->origins[i].text);
+    free(pp->origins);
+    symbol_table_free(&pp->macro_index);
+    symbol_table_free(&pp->constants);
+}
+
+// ---- saida ----
+
+static inline void pp_emit(preprocessor_t* pp, const char* text, const pp_context_t* ctx) {
+    if (pp->count >= pp->capacity) {
+        pp->capacity = pp->capacity ? pp->capacity * 2 : 256;
+        char** lines = (char **)realloc(pp->lines, pp->capacity * sizeof(char *));
+        diag_origin_t* origins = (diag_origin_t *)realloc(pp->origins, pp->capacity * sizeof(diag_origin_t));
+        CHECK_ALLOC(lines, exit(EXIT_FAILURE));
+        CHECK_ALLOC(origins, exit(EXIT_FAILURE));
+        pp->lines = lines;
+        pp->origins = origins;
+    }
+    pp->lines[pp->count] = my_strdup(text);
+    diag_origin_t* origin = &pp->origins[pp->count];
+    origin->file = ctx->file;
+    origin->line = ctx->line;
+    origin->macro = ctx->macro;
+    origin->call_file = ctx->call_file;
+    origin->call_line = ctx->call_line;
+    origin->text = NULL;
+    pp->count++;
+}
+
+// erro numa linha que não vai para a saida (diretiva do preprocessador): vira uma linha vazia
+// na saida só para o diag ter onde apontar, com o texto original como trecho
+static inline void pp_error(preprocessor_t* pp, const char* text, const pp_context_t* ctx, const char* format, ...) {
+    char message[SOURCE_LINE_MAX * 2];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    pp_emit(pp, "", ctx);
+    pp->origins[pp->count - 1].text = my_strdup(text);
+    diag_set_source(pp->filename, pp->lines, pp->count);
+    diag_set_origins(pp->origins);
+    diag_error((uint32_t)pp->count, "%s", message);
+    pp->errors++;
+}
+
+// ---- texto ----
+
+static inline bool pp_is_ident_start(char c) {
+    return isalpha((unsigned char)c) || c == '_' || c == '.';
+}
+
+static inline bool pp_is_ident_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+// copia a linha sem o comentario e sem espaços nas pontas
+static inline void pp_strip(const char* text, char* out, size_t size) {
+    strncpy(out, text, size - 1);
+    out[size - 1] = '\0';
+    char* comment = find_unquoted(out, '#');
+    if (comment) *comment = '\0';
+    rtrim(out);
+    char* start = ltrim(out);
+    memmove(out, start, strlen(start) + 1);
+}
+
+// separa "label: resto" (label fica vazia se não tem)
+static inline const char* pp_split_label(const char* line, char* label, size_t size) {
+    label[0] = '\0';
+    const char* end = line;
+    while (*end && !isspace((unsigned char)*end) && *end != ':') end++;
+    if (*end != ':' || end == line) return line;
+    size_t len = (size_t)(end - line);
+    if (len >= size) len = size - 1;
+    memcpy(label, line, len);
+    label[len] = '\0';
+    end++;
+    while (isspace((unsigned char)*end)) end++;
+    return end;
+}
+
+// primeira palavra de 'text' em 'word', devolve o resto (sem espaços no começo)
+static inline const char* pp_first_word(const char* text, char* word, size_t size) {
+    size_t len = 0;
+    while (text[len] && !isspace((unsigned char)text[len])) len++;
+    size_t copy = len < size ? len : size - 1;
+    memcpy(word, text, copy);
+    word[copy] = '\0';
+    text += len;
+    while (isspace((unsigned char)*text)) text++;
+    return text;
+}
+
+// troca as constantes pelos valores (fora de comentario e de '...'/"...").
+// o mnemonico e a label ficam como estão
+static inline void pp_substitute(const preprocessor_t* pp, const char* text, char* out, size_t size) {
+    size_t n = 0;
+    const char* p = text;
+
+    // label e mnemonico passam direto
+    while (isspace((unsigned char)*p)) p++;
+    const char* rest = p;
+    while (*rest && !isspace((unsigned char)*rest) && *rest != ':') rest++;
+    if (*rest == ':') {
+        rest++;
+        while (isspace((unsigned char)*rest)) rest++;
+        while (*rest && !isspace((unsigned char)*rest)) rest++;
+    }
+    size_t head = (size_t)(rest - text);
+    if (head >= size) head = size - 1;
+    memcpy(out, text, head);
+    n = head;
+    p = rest;
+
+    while (*p && n + 1 < size) {
+        if (*p == '#') break;
+        if (*p == '\'' || *p == '"') {
+            char quote = *p;
+            out[n++] = *p++;
+            while (*p && *p != quote && n + 1 < size) {
+                if (*p == '\\' && p[1]) out[n++] = *p++;
+                out[n++] = *p++;
+            }
+            if (*p && n + 1 < size) out[n++] = *p++;
+            continue;
+        }
+        bool after_percent = p > text && p[-1] == '%';
+        if (pp_is_ident_start(*p) && !(p > text && pp_is_ident_char(p[-1])) && !after_percent) {
+            const char* end = p;
+            while (pp_is_ident_char(*end)) end++;
+            char name[SOURCE_LINE_MAX];
+            size_t len = (size_t)(end - p);
+            if (len < sizeof(name)) {
+                memcpy(name, p, len);
+                name[len] = '\0';
+                const symbol_t* constant = symbol_table_find(&pp->constants, name);
+                if (constant) {
+                    n += (size_t)snprintf(out + n, size - n, "%d", (int32_t)constant->address);
+                    if (n >= size) n = size - 1;
+                    p = end;
+                    continue;
+                }
+            }
+            while (p < end && n + 1 < size) out[n++] = *p++;
+            continue;
+        }
+        out[n++] = *p++;
+    }
+    // o comentario vai junto (o listing mostra a linha)
+    while (*p && n + 1 < size) out[n++] = *p++;
+    out[n] = '\0';
+}
+
+// ---- expressões do .if/.equ ----
+
+// avalia 'text' com o mesmo compilador de expressões dos imediatos (expr.h), os simbolos são
+// as constantes do .equ. em erro, 'undefined' tem o nome que faltou (ou fica vazio se foi sintaxe)
+static inline bool pp_eval(const preprocessor_t* pp, const char* text, int32_t* value, char* undefined, size_t size) {
+    undefined[0] = '\0';
+    *value = 0;
+    const char* error;
+    expr_t* e = expr_compile(text, &error);
+    if (!e) return false;
+
+    expr_env_t env = {&pp->constants, 0, 0, false, false, 0};
+    expr_result_t result;
+    EXPR_STATUS status = expr_eval(e, &env, &result);
+    if (status == EXPR_UNDEFINED) snprintf(undefined, size, "%s", result.error);
+    *value = (int32_t)result.value;
+    expr_free(e);
+    return status == EXPR_OK;
+}
+
+// ---- arquivos ----
+
+static inline pp_file_t* pp_find_file(preprocessor_t* pp, const char* path) {
+    for (size_t i = 0; i < pp->file_count; i++)
+        if (strcmp(pp->files[i].path, path) == 0) return &pp->files[i];
+    return NULL;
+}
+
+// X se o arquivo todo está dentro de `.ifndef X` ... `.endif`
+static inline char* pp_detect_guard(char** lines, size_t count) {
+    char text[SOURCE_LINE_MAX], word[SOURCE_LINE_MAX];
+    size_t first = 0, last = count;
+    while (first < count) {
+        pp_strip(lines[first], text, sizeof(text));
+        if (text[0]) break;
+        first++;
+    }
+    while (last > first) {
+        pp_strip(lines[last - 1], text, sizeof(text));
+        if (text[0]) break;
+        last--;
+    }
+    if (first + 1 >= last) return NULL;
+
+    pp_strip(lines[first], text, sizeof(text));
+    const char* name = pp_first_word(text, word, sizeof(word));
+    if (strcmp(word, ".ifndef") != 0 || !pp_is_ident_start(name[0])) return NULL;
+    char* guard = my_strdup(name);
+
+    // o .endif que fecha o .ifndef tem que ser a ultima linha
+    int depth = 0;
+    for (size_t i = first; i < last; i++) {
+        pp_strip(lines[i], text, sizeof(text));
+        pp_first_word(text, word, sizeof(word));
+        if (strncmp(word, ".if", 3) == 0) depth++;
+        else if (strcmp(word, ".endif") == 0 && --depth == 0 && i != last - 1) {
+            free(guard);
+            return NULL;
+        }
+    }
+    if (depth != 0) {
+        free(guard);
+        return NULL;
+    }
+    return guard;
+}
+
+static inline pp_file_t* pp_add_file(preprocessor_t* pp, const char* path, char** lines, size_t count) {
+    if (pp->file_count >= pp->file_capacity) {
+        pp->file_capacity = pp->file_capacity ? pp->file_capacity * 2 : 8;
+        pp_file_t* files = (pp_file_t *)realloc(pp->files, pp->file_capacity * sizeof(pp_file_t));
+        CHECK_ALLOC(files, exit(EXIT_FAILURE));
+        // os ponteiros para path de arquivos antigos estão nas origens: o realloc só move a
+        // struct, a string continua no mesmo lugar
+        pp->files = files;
+    }
+    pp_file_t* file = &pp->files[pp->file_count++];
+    file->path = my_strdup(path);
+    file->lines = lines;
+    file->line_count = count;
+    file->guard = pp_detect_guard(lines, count);
+    return file;
+}
+
+// caminho do include relativo ao diretorio de quem inclui. false se não cabe em 'size'
+static inline bool pp_resolve_path(const char* from, const char* name, char* out, size_t size) {
+    const char* slash = from ? strrchr(from, '/') : NULL;
+#ifdef _WIN32
+    const char* backslash = from ? strrchr(from, '\\') : NULL;
+    if (backslash && (!slash || backslash > slash)) slash = backslash;
+#endif
+    size_t dir = name[0] == '/' || !slash ? 0 : (size_t)(slash - from) + 1;
+    size_t len = strlen(name);
+    if (dir + len >= size) return false;
+    memcpy(out, from, dir);
+    memcpy(out + dir, name, len + 1);
+    return true;
+}
+
+// ---- macros ----
+
+// quebra uma linha do corpo em texto e parametros (feito uma vez, na definição)
+static inline void pp_macro_add_line(pp_macro_t* macro, const char* text, uint32_t line) {
+    if (macro->body_count >= macro->body_capacity) {
+        macro->body_capacity = macro->body_capacity ? macro->body_capacity * 2 : 8;
+        pp_body_line_t* body = (pp_body_line_t *)realloc(macro->body, macro->body_capacity * sizeof(pp_body_line_t));
+        CHECK_ALLOC(body, exit(EXIT_FAILURE));
+        macro->body = body;
+    }
+    pp_body_line_t* body = &macro->body[macro->body_count++];
+    body->segments = NULL;
+    body->count = 0;
+    body->line = line;
+
+    size_t capacity = 0;
+    const char* literal = text;
+    const char* p = text;
+    for (;;) {
+        int param = -1;
+        size_t skip = 0;
+        if (*p == '\\') {
+            if (p[1] == '@') {
+                param = PP_PARAM_COUNTER;
+                skip = 2;
+            } else if (p[1] == '(' && p[2] == ')') {
+                param = -3;      // separador, não gera nada
+                skip = 3;
+            } else {
+                for (int k = 0; k < macro->param_count; k++) {
+                    size_t len = strlen(macro->params[k]);
+                    if (strncmp(p + 1, macro->params[k], len) == 0 && !pp_is_ident_char(p[1 + len])) {
+                        param = k;
+                        skip = len + 1;
+                        break;
+                    }
+                }
+            }
+        }
+        if (skip == 0 && *p) {
+            p++;
+            continue;
+        }
+
+        // fecha o literal até aqui e (se tiver) coloca o parametro
+        for (int pass = 0; pass < 2; pass++) {
+            bool is_literal = pass == 0;
+            if (is_literal && p == literal) continue;
+            if (!is_literal && (skip == 0 || param == -3)) continue;
+            if (body->count >= capacity) {
+                capacity = capacity ? capacity * 2 : 4;
+                pp_segment_t* segments = (pp_segment_t *)realloc(body->segments, capacity * sizeof(pp_segment_t));
+                CHECK_ALLOC(segments, exit(EXIT_FAILURE));
+                body->segments = segments;
+            }
+            pp_segment_t* segment = &body->segments[body->count++];
+            if (is_literal) {
+                size_t len = (size_t)(p - literal);
+                segment->text = (char *)malloc(len + 1);
+                CHECK_ALLOC(segment->text, exit(EXIT_FAILURE));
+                memcpy(segment->text, literal, len);
+                segment->text[len] = '\0';
+                segment->param = -1;
+            } else {
+                segment->text = NULL;
+                segment->param = param;
+            }
+        }
+        if (*p == '\0') break;
+        p += skip;
+        literal = p;
+    }
+}
+
+// ".macro nome a, b=1" (virgula ou espaço entre os parametros)
+static inline bool pp_macro_begin(preprocessor_t* pp, const char* args, const char* file, const char* text, const pp_context_t* ctx) {
+    char buffer[SOURCE_LINE_MAX], name[SOURCE_LINE_MAX];
+    snprintf(buffer, sizeof(buffer), "%s", args);
+    const char* rest = pp_first_word(buffer, name, sizeof(name));
+    if (!pp_is_ident_start(name[0])) {
+        pp_error(pp, text, ctx, ".macro sem nome.");
+        return false;
+    }
+    if (symbol_table_find(&pp->macro_index, name)) {
+        pp_error(pp, text, ctx, "macro '%s' ja definida.", name);
+        return false;
+    }
+
+    if (pp->macro_count >= pp->macro_capacity) {
+        pp->macro_capacity = pp->macro_capacity ? pp->macro_capacity * 2 : 8;
+        pp_macro_t* macros = (pp_macro_t *)realloc(pp->macros, pp->macro_capacity * sizeof(pp_macro_t));
+        CHECK_ALLOC(macros, exit(EXIT_FAILURE));
+        pp->macros = macros;
+    }
+    pp_macro_t* macro = &pp->macros[pp->macro_count];
+    memset(macro, 0, sizeof(*macro));
+    macro->name = my_strdup(name);
+    macro->file = file;
+
+    char params[SOURCE_LINE_MAX];
+    snprintf(params, sizeof(params), "%s", rest);
+    char* save;
+    for (char* param = strtok_r(params, ", \t", &save); param; param = strtok_r(NULL, ", \t", &save)) {
+        if (macro->param_count >= PP_MAX_MACRO_PARAMS) {
+            pp_error(pp, text, ctx, "macro '%s' com mais de %d parametros.", name, PP_MAX_MACRO_PARAMS);
+            break;
+        }
+        char* equals = strchr(param, '=');
+        if (equals) *equals = '\0';
+        macro->params[macro->param_count] = my_strdup(param);
+        macro->defaults[macro->param_count] = equals ? my_strdup(equals + 1) : NULL;
+        macro->param_count++;
+    }
+
+    symbol_table_add(&pp->macro_index, name, (uint32_t)pp->macro_count);
+    pp->macro_count++;
+    pp->defining = macro;
+    pp->defining_depth = 0;
+    return true;
+}
+
+static inline void pp_process(preprocessor_t* pp, char** lines, size_t count, const pp_context_t* base, int depth);
+
+// expande a chamada 'name args' (a linha de texto com as substituições vai para o pp_process de novo)
+static inline void pp_macro_expand(preprocessor_t* pp, pp_macro_t* macro, const char* args,
+                                   const char* text, const pp_context_t* ctx, int depth) {
+    if (depth >= PP_MAX_MACRO_DEPTH) {
+        pp_error(pp, text, ctx, "macro '%s' expandida dentro dela mesma demais (limite %d).", macro->name, PP_MAX_MACRO_DEPTH);
+        return;
+    }
+
+    char buffer[SOURCE_LINE_MAX];
+    snprintf(buffer, sizeof(buffer), "%s", args);
+    const char* values[PP_MAX_MACRO_PARAMS] = {0};
+    int given = 0;
+    if (buffer[0]) {
+        char* save;
+        for (char* arg = strtok_r(buffer, ",", &save); arg; arg = strtok_r(NULL, ",", &save)) {
+            if (given >= macro->param_count) {
+                pp_error(pp, text, ctx, "argumentos demais para a macro '%s' (espera %d).", macro->name, macro->param_count);
+                return;
+            }
+            rtrim(arg);
+            values[given++] = ltrim(arg);
+        }
+    }
+    for (int k = 0; k < macro->param_count; k++) {
+        if (k < given && values[k][0]) continue;
+        if (!macro->defaults[k]) {
+            pp_error(pp, text, ctx, "argumento '%s' faltando para a macro '%s'.", macro->params[k], macro->name);
+            return;
+        }
+        values[k] = macro->defaults[k];
+    }
+
+    // instancia o corpo
+    char counter[16];
+    snprintf(counter, sizeof(counter), "%u", pp->counter++);
+    char** expanded = (char **)malloc((macro->body_count ? macro->body_count : 1) * sizeof(char *));
+    CHECK_ALLOC(expanded, exit(EXIT_FAILURE));
+    for (size_t b = 0; b < macro->body_count; b++) {
+        char out[SOURCE_LINE_MAX];
+        size_t n = 0;
+        out[0] = '\0';
+        for (size_t s = 0; s < macro->body[b].count; s++) {
+            const pp_segment_t* segment = &macro->body[b].segments[s];
+            const char* piece = segment->param == -1 ? segment->text
+                              : segment->param == PP_PARAM_COUNTER ? counter : values[segment->param];
+            int written = snprintf(out + n, sizeof(out) - n, "%s", piece);
+            n += written > 0 ? (size_t)written : 0;
+            if (n >= sizeof(out)) n = sizeof(out) - 1;
+        }
+        expanded[b] = my_strdup(out);
+    }
+
+    // o corpo pode definir outra macro e mover o vetor 'macros': daqui para frente só o que foi copiado
+    size_t body_count = macro->body_count;
+    uint32_t* body_lines = (uint32_t *)malloc((body_count ? body_count : 1) * sizeof(uint32_t));
+    CHECK_ALLOC(body_lines, exit(EXIT_FAILURE));
+    for (size_t b = 0; b < body_count; b++)
+        body_lines[b] = macro->body[b].line;
+    pp_context_t inner = {macro->file, 0, macro->name, ctx->file, ctx->line};
+
+    // as linhas do corpo têm numeros espalhados: processa uma a uma com a linha certa
+    for (size_t b = 0; b < body_count; b++) {
+        inner.line = body_lines[b];
+        pp_process(pp, &expanded[b], 1, &inner, depth + 1);
+        free(expanded[b]);
+    }
+    free(expanded);
+    free(body_lines);
+}
+
+// ---- loop principal ----
+
+static inline void pp_include(preprocessor_t* pp, const char* args, const char* text, const pp_context_t* ctx, int depth);
+
+static inline bool pp_cond_active(const preprocessor_t* pp) {
+    return pp->cond_depth == 0 || pp->conds[pp->cond_depth - 1].active;
+}
+
+static inline void pp_cond_push(preprocessor_t* pp, bool value, const char* text, const pp_context_t* ctx) {
+    if (pp->cond_depth >= PP_MAX_IF_DEPTH) {
+        pp_error(pp, text, ctx, ".if aninhado demais (limite %d).", PP_MAX_IF_DEPTH);
+        return;
+    }
+    bool parent = pp_cond_active(pp);
+    pp_cond_t* cond = &pp->conds[pp->cond_depth++];
+    cond->active = parent && value;
+    cond->taken = value;
+    cond->has_else = false;
+    cond->line = ctx->line;
+}
+
+// linhas com a origem 'base' (linha base->line para a primeira, e seguintes em ordem).
+// 'depth' conta include + macro para pegar recursão
+static inline void pp_process(preprocessor_t* pp, char** lines, size_t count, const pp_context_t* base, int depth) {
+    pp_context_t ctx = *base;
+    for (size_t i = 0; i < count; i++, ctx.line++) {
+        const char* raw = lines[i];
+        char text[SOURCE_LINE_MAX], label[SOURCE_LINE_MAX], word[SOURCE_LINE_MAX];
+        pp_strip(raw, text, sizeof(text));
+        const char* body = pp_split_label(text, label, sizeof(label));
+        const char* args = pp_first_word(body, word, sizeof(word));
+
+        // dentro de .macro tudo vai para o corpo, menos o .endm que fecha
+        if (pp->defining) {
+            if (strcmp(word, ".macro") == 0) pp->defining_depth++;
+            if (strcmp(word, ".endm") == 0 && pp->defining_depth-- == 0) {
+                pp->defining = NULL;
+                continue;
+            }
+            pp_macro_add_line(pp->defining, raw, ctx.line);
+            continue;
+        }
+
+        // condicionais contam mesmo no trecho desligado (para achar o .endif certo)
+        if (strcmp(word, ".if") == 0 || strcmp(word, ".ifdef") == 0 || strcmp(word, ".ifndef") == 0) {
+            bool value = false;
+            if (pp_cond_active(pp)) {
+                if (word[3] == '\0') {
+                    int32_t v;
+                    char undefined[SOURCE_LINE_MAX];
+                    if (!pp_eval(pp, args, &v, undefined, sizeof(undefined))) {
+                        if (undefined[0]) pp_error(pp, raw, &ctx, "simbolo '%s' nao definido em '.if'.", undefined);
+                        else pp_error(pp, raw, &ctx, "expressao invalida em '.if'.");
+                    }
+                    value = v != 0;
+                } else {
+                    bool defined = symbol_table_find(&pp->constants, args) || symbol_table_find(&pp->macro_index, args);
+                    value = word[3] == 'd' ? defined : !defined;
+                }
+            }
+            pp_cond_push(pp, value, raw, &ctx);
+            continue;
+        }
+        if (strcmp(word, ".else") == 0 || strcmp(word, ".endif") == 0) {
+            if (pp->cond_depth == 0) {
+                pp_error(pp, raw, &ctx, "'%s' sem '.if'.", word);
+                continue;
+            }
+            pp_cond_t* cond = &pp->conds[pp->cond_depth - 1];
+            if (word[1] == 'e' && word[2] == 'n') {
+                pp->cond_depth--;
+            } else if (cond->has_else) {
+                pp_error(pp, raw, &ctx, "'.else' repetido (o '.if' esta na linha %u).", cond->line);
+            } else {
+                bool parent = pp->cond_depth < 2 || pp->conds[pp->cond_depth - 2].active;
+                cond->has_else = true;
+                cond->active = parent && !cond->taken;
+                cond->taken = true;
+            }
+            continue;
+        }
+        if (!pp_cond_active(pp)) continue;
+
+        // label antes de diretiva do preprocessador ou de macro fica numa linha só dela
+        bool is_macro = symbol_table_find(&pp->macro_index, word) != NULL;
+        bool is_directive = strcmp(word, ".equ") == 0 || strcmp(word, ".set") == 0 ||
+                            strcmp(word, ".include") == 0 || strcmp(word, ".macro") == 0 || strcmp(word, ".endm") == 0;
+        if ((is_macro || is_directive) && label[0]) {
+            char label_line[SOURCE_LINE_MAX];
+            snprintf(label_line, sizeof(label_line), "%s:", label);
+            pp_emit(pp, label_line, &ctx);
+        }
+
+        if (strcmp(word, ".equ") == 0 || strcmp(word, ".set") == 0) {
+            char name[SOURCE_LINE_MAX];
+            const char* comma = strchr(args, ',');
+            size_t len = comma ? (size_t)(comma - args) : 0;
+            if (!comma || len == 0 || len >= sizeof(name)) {
+                pp_error(pp, raw, &ctx, "'%s' espera 'nome, valor'.", word);
+                continue;
+            }
+            memcpy(name, args, len);
+            name[len] = '\0';
+            rtrim(name);
+            if (!pp_is_ident_start(name[0])) {
+                pp_error(pp, raw, &ctx, "nome '%s' invalido para '%s'.", name, word);
+                continue;
+            }
+            int32_t value;
+            char undefined[SOURCE_LINE_MAX];
+            if (!pp_eval(pp, comma + 1, &value, undefined, sizeof(undefined))) {
+                if (undefined[0]) pp_error(pp, raw, &ctx, "simbolo '%s' nao definido em '%s'.", undefined, word);
+                else pp_error(pp, raw, &ctx, "valor invalido para '%s'.", name);
+                continue;
+            }
+            symbol_t* constant = symbol_table_find(&pp->constants, name);
+            if (constant) constant->address = (uint32_t)value;
+            else symbol_table_add(&pp->constants, name, (uint32_t)value);
+            continue;
+        }
+        if (strcmp(word, ".include") == 0) {
+            pp_include(pp, args, raw, &ctx, depth);
+            continue;
+        }
+        if (strcmp(word, ".macro") == 0) {
+            pp_macro_begin(pp, args, ctx.file, raw, &ctx);
+            continue;
+        }
+        if (strcmp(word, ".endm") == 0) {
+            pp_error(pp, raw, &ctx, "'.endm' sem '.macro'.");
+            continue;
+        }
+        if (is_macro) {
+            pp_macro_t* macro = &pp->macros[symbol_table_find(&pp->macro_index, word)->address];
+            pp_macro_expand(pp, macro, args, raw, &ctx, depth);
+            continue;
+        }
+
+        // linha normal: só troca as constantes
+        if (pp->constants.count == 0) {
+            pp_emit(pp, raw, &ctx);
+        } else {
+            char out[SOURCE_LINE_MAX];
+            pp_substitute(pp, raw, out, sizeof(out));
+            pp_emit(pp, out, &ctx);
+        }
+    }
+}
+
+static inline void pp_include(preprocessor_t* pp, const char* args, const char* text, const pp_context_t* ctx, int depth) {
+    char name[SOURCE_LINE_MAX];
+    size_t len = strlen(args);
+    if (len < 2 || args[0] != '"' || args[len - 1] != '"') {
+        pp_error(pp, text, ctx, "'.include' espera um nome entre aspas.");
+        return;
+    }
+    snprintf(name, sizeof(name), "%.*s", (int)(len - 2), args + 1);
+    if (depth >= PP_MAX_INCLUDE_DEPTH) {
+        pp_error(pp, text, ctx, "'.include' de '%s' aninhado demais (limite %d, include recursivo?).", name, PP_MAX_INCLUDE_DEPTH);
+        return;
+    }
+
+    char path[SOURCE_LINE_MAX];
+    if (!pp_resolve_path(ctx->file, name, path, sizeof(path))) {
+        pp_error(pp, text, ctx, "caminho do '.include' de '%s' muito longo.", name);
+        return;
+    }
+    pp_file_t* file = pp_find_file(pp, path);
+    if (!file) {
+        size_t count = 0;
+        char** lines = read_file_lines(path, &count);
+        if (!lines) {
+            pp_error(pp, text, ctx, "nao foi possivel ler o arquivo '%s' do '.include'.", name);
+            return;
+        }
+        file = pp_add_file(pp, path, lines, count);
+    }
+
+    // include guard: o arquivo inteiro sumiria de qualquer jeito
+    if (file->guard && (symbol_table_find(&pp->constants, file->guard) || symbol_table_find(&pp->macro_index, file->guard)))
+        return;
+
+    // o pp_add_file de um include aninhado pode mover o vetor de arquivos: copia o que precisa
+    const char* path_ref = file->path;
+    char** lines = file->lines;
+    size_t count = file->line_count;
+    int cond_depth = pp->cond_depth;
+
+    pp_context_t inner = {path_ref, 1, ctx->macro, ctx->call_file, ctx->call_line};
+    pp_process(pp, lines, count, &inner, depth + 1);
+
+    if (pp->defining && pp->defining->file == path_ref) {
+        pp_error(pp, text, ctx, "'.macro %s' sem '.endm' em '%s'.", pp->defining->name, name);
+        pp->defining = NULL;
+    }
+    if (pp->cond_depth > cond_depth) {
+        pp_error(pp, text, ctx, "'.if' sem '.endif' em '%s'.", name);
+        pp->cond_depth = cond_depth;
+    }
+}
+
+// expande o arquivo principal (já lido em 'lines'). devolve as linhas novas (o chamador libera,
+// igual ao read_file_lines) e deixa as origens em pp->origins para o diag_set_origins
+static inline char** preprocess_lines(preprocessor_t* pp, const char* filename, char** lines, size_t count, size_t* out_count) {
+    pp_context_t ctx = {filename, 1, NULL, NULL, 0};
+    pp->filename = filename;
+    pp_process(pp, lines, count, &ctx, 0);
+
+    ctx.line = (uint32_t)count;
+    if (pp->defining) {
+        pp_error(pp, "", &ctx, "'.macro %s' sem '.endm'.", pp->defining->name);
+        pp->defining = NULL;
+    }
+    if (pp->cond_depth > 0) {
+        ctx.line = pp->conds[pp->cond_depth - 1].line;
+        pp_error(pp, "", &ctx, "'.if' sem '.endif'.");
+        pp->cond_depth = 0;
+    }
+
+    // vetor vazio ainda precisa ser um ponteiro valido
+    if (!pp->lines) {
+        pp->lines = (char **)malloc(sizeof(char *));
+        CHECK_ALLOC(pp->lines, exit(EXIT_FAILURE));
+    }
+    char** result = pp->lines;
+    *out_count = pp->count;
+    pp->lines = NULL;
+    return result;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "types.h"
+#include "utils.h"
+#include "output.h"
+#include "symbol_table.h"
+#include "disasm.h"
+#include "sim.h"
+
+// relatorios do --profile a partir dos contadores do sim_run_profiled:
+//   - texto: instruções por label (a label mais proxima antes do pc), instruções mais
+//     executadas e taxa de desvios tomados por branch, tudo ordenado por contagem
+//   - pilhas colapsadas ("main;f;g 1234" por linha), o formato do flamegraph.pl/speedscope
+
+typedef struct {
+    uint64_t count;
+    uint32_t index;
+} profile_entry_t;
+
+// maior contagem primeiro, empate pela ordem do programa
+static inline int profile_entry_cmp(const void* a, const void* b) {
+    const profile_entry_t* ea = (const profile_entry_t *)a;
+    const profile_entry_t* eb = (const profile_entry_t *)b;
+    if (ea->count != eb->count) return ea->count < eb->count ? 1 : -1;
+    return (ea->index > eb->index) - (ea->index < eb->index);
+}
+
+// texto da instrução no pc (o disassembler, sem labels)
+static inline void profile_instruction_text(const sim_t* sim, size_t index, char* out) {
+    uint32_t pc = sim->op_pc[index];
+    uint32_t word, length;
+    const instruction_entry_t* entry = disasm_fetch(&sim->text, pc - sim->text.base, sim->rvc, &word, &length);
+    disasm_targets_t no_targets = {0};
+    char* end = out;
+    if (entry) end = disasm_format(out, entry, word, pc, &no_targets, &sim->text);
+    *end = '\0';
+}
+
+static inline double profile_percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+static inline void profile_write_report(FILE* f, const sim_t* sim, const sim_profile_t* profile,
+                                        const symbol_table_t* table, const sim_result_t* result) {
+    size_t label_count;
+    text_label_t* labels = symbol_table_text_labels(table, &label_count);
+    uint64_t total = result->instructions;
+
+    out_buffer_t buf;
+    out_buffer_init(&buf, f);
+    out_buffer_printf(&buf, "perfil: %llu instrucao(oes) executada(s), parou em %s\n\n",
+                      (unsigned long long)total, sim_halt_name(result->reason));
+
+    // por label. o balde label_count é o codigo antes da primeira label
+    profile_entry_t* per_label = (profile_entry_t *)calloc(label_count + 1, sizeof(profile_entry_t));
+    CHECK_ALLOC(per_label, exit(EXIT_FAILURE));
+    for (size_t l = 0; l <= label_count; l++)
+        per_label[l].index = (uint32_t)l;
+    for (size_t i = 0; i < sim->end_op; i++) {
+        if (!profile->counts[i]) continue;
+        long l = text_label_find(labels, label_count, sim->op_pc[i]);
+        per_label[l < 0 ? label_count : (size_t)l].count += profile->counts[i];
+    }
+    qsort(per_label, label_count + 1, sizeof(profile_entry_t), profile_entry_cmp);
+
+    out_buffer_printf(&buf, "por label:\n%14s %8s  %s\n", "instrucoes", "%", "label");
+    for (size_t l = 0; l <= label_count && per_label[l].count; l++)
+        out_buffer_printf(&buf, "%14llu %7.2f%%  %s\n", (unsigned long long)per_label[l].count,
+                          profile_percent(per_label[l].count, total),
+                          per_label[l].index == label_count ? "(sem label)" : labels[per_label[l].index].name);
+    free(per_label);
+
+    // por instrução, e os branches junto (mesma ordenação)
+    profile_entry_t* hot = (profile_entry_t *)malloc((sim->end_op ? sim->end_op : 1) * sizeof(profile_entry_t));
+    CHECK_ALLOC(hot, exit(EXIT_FAILURE));
+    size_t hot_count = 0;
+    for (size_t i = 0; i < sim->end_op; i++) {
+        if (!profile->counts[i]) continue;
+        hot[hot_count].count = profile->counts[i];
+        hot[hot_count].index = (uint32_t)i;
+        hot_count++;
+    }
+    qsort(hot, hot_count, sizeof(profile_entry_t), profile_entry_cmp);
+
+    char location[SOURCE_LINE_MAX];
+    char text[DISASM_LINE_MAX];
+    out_buffer_printf(&buf, "\npor instrucao:\n%14s %8s  %-10s  %-24s %s\n", "execucoes", "%", "endereco", "local", "instrucao");
+    for (size_t h = 0; h < hot_count; h++) {
+        size_t i = hot[h].index;
+        text_label_location(labels, label_count, sim->op_pc[i], location, sizeof(location));
+        profile_instruction_text(sim, i, text);
+        out_buffer_printf(&buf, "%14llu %7.2f%%  0x%08x  %-24s %s\n", (unsigned long long)hot[h].count,
+                          profile_percent(hot[h].count, total), sim->op_pc[i], location, text);
+    }
+
+    out_buffer_printf(&buf, "\nbranches:\n%14s %14s %8s  %-10s  %-24s %s\n",
+                      "execucoes", "tomados", "%tomado", "endereco", "local", "instrucao");
+    for (size_t h = 0; h < hot_count; h++) {
+        size_t i = hot[h].index;
+        uint8_t code = sim->ops[i].code;
+        if (code >= INST_TABLE_SIZE || inst_table[code].format != FMT_BRANCH) continue;
+        text_label_location(labels, label_count, sim->op_pc[i], location, sizeof(location));
+        profile_instruction_text(sim, i, text);
+        out_buffer_printf(&buf, "%14llu %14llu %7.2f%%  0x%08x  %-24s %s\n", (unsigned long long)hot[h].count,
+                          (unsigned long long)profile->taken[i], profile_percent(profile->taken[i], hot[h].count),
+                          sim->op_pc[i], location, text);
+    }
+
+    out_buffer_free(&buf);
+    free(hot);
+    free(labels);
+}
+
+// nome do frame: a label da entrada da função (ou o endereço)
+static inline void profile_frame_name(const sim_t* sim, const text_label_t* labels, size_t count,
+                                      const sim_frame_t* frame, char* out, size_t size) {
+    uint32_t pc = sim->op_pc[frame->entry];
+    long l = text_label_find(labels, count, pc);
+    if (l >= 0 && labels[l].address == pc) snprintf(out, size, "%s", labels[l].name);
+    else text_label_location(labels, count, pc, out, size);
+}
+
+static inline void profile_write_collapsed(FILE* f, const sim_t* sim, const sim_profile_t* profile,
+                                           const symbol_table_t* table) {
+    size_t label_count;
+    text_label_t* labels = symbol_table_text_labels(table, &label_count);
+
+    // caminho de cada frame montado da folha para a raiz
+    uint32_t* path = (uint32_t *)malloc(profile->frame_count * sizeof(uint32_t));
+    CHECK_ALLOC(path, exit(EXIT_FAILURE));
+
+    out_buffer_t buf;
+    out_buffer_init(&buf, f);
+    char name[SOURCE_LINE_MAX];
+    for (size_t i = 0; i < profile->frame_count; i++) {
+        if (!profile->frames[i].self) continue;
+        size_t depth = 0;
+        for (uint32_t fr = (uint32_t)i; ; fr = profile->frames[fr].parent) {
+            path[depth++] = fr;
+            if (fr == 0) break;
+        }
+        while (depth-- > 0) {
+            profile_frame_name(sim, labels, label_count, &profile->frames[path[depth]], name, sizeof(name));
+            out_buffer_puts(&buf, name);
+            out_buffer_putc(&buf, depth ? ';' : ' ');
+        }
+        out_buffer_printf(&buf, "%llu\n", (unsigned long long)profile->frames[i].self);
+    }
+    out_buffer_free(&buf);
+    free(path);
+    free(labels);
+}
+
+#endif
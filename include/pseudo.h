@@ -0,0 +1,133 @@
+#ifndef PSEUDO_H
+#define PSEUDO_H
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "utils.h"
+#include "diag.h"
+#include "expr.h"
+
+// pseudo-instruções: cada uma vira uma ou mais instruções base ANTES do layout,
+// então os endereços das labels já saem certos depois da expansão.
+// no template, $0..$3 são trocados pelos operandos escritos pelo usuario
+#define PSEUDO_MAX_EXPANSION 2
+
+typedef struct {
+    const char* mnemonic;
+    int operand_count;      // mesma mnemonic com outra quantidade de operandos é instrução base (ex: jal rd, label)
+    const char* expansion[PSEUDO_MAX_EXPANSION]; // NULL = tratada no codigo (li)
+} pseudo_entry_t;
+
+static const pseudo_entry_t pseudo_table[] = {
+    {"nop",  0, {"addi x0, x0, 0", NULL}},
+    {"mv",   2, {"addi $0, $1, 0", NULL}},
+    {"neg",  2, {"sub $0, x0, $1", NULL}},
+    {"not",  2, {"xori $0, $1, -1", NULL}},
+    {"seqz", 2, {"sltiu $0, $1, 1", NULL}},
+    {"snez", 2, {"sltu $0, x0, $1", NULL}},
+    {"sltz", 2, {"slt $0, $1, x0", NULL}},
+    {"sgtz", 2, {"slt $0, x0, $1", NULL}},
+
+    {"j",    1, {"jal x0, $0", NULL}},
+    {"jal",  1, {"jal ra, $0", NULL}},
+    {"jr",   1, {"jalr x0, 0($0)", NULL}},
+    {"ret",  0, {"jalr x0, 0(ra)", NULL}},
+    // sem auipc, call/tail viram jal direto (±1 MiB)
+    {"call", 1, {"jal ra, $0", NULL}},
+    {"tail", 1, {"jal x0, $0", NULL}},
+
+    {"beqz", 2, {"beq $0, x0, $1", NULL}},
+    {"bnez", 2, {"bne $0, x0, $1", NULL}},
+    {"blez", 2, {"bge x0, $0, $1", NULL}},
+    {"bgez", 2, {"bge $0, x0, $1", NULL}},
+    {"bltz", 2, {"blt $0, x0, $1", NULL}},
+    {"bgtz", 2, {"blt x0, $0, $1", NULL}},
+    // comparações que não existem no hardware são as outras com os operandos trocados
+    {"bgt",  3, {"blt $1, $0, $2", NULL}},
+    {"ble",  3, {"bge $1, $0, $2", NULL}},
+    {"bgtu", 3, {"bltu $1, $0, $2", NULL}},
+    {"bleu", 3, {"bgeu $1, $0, $2", NULL}},
+
+    // la usa endereço absoluto, o %hi já vem com a correção do carry do %lo
+    {"la",   2, {"lui $0, %hi($1)", "addi $0, $0, %lo($1)"}},
+    {"li",   2, {NULL, NULL}}
+};
+
+static inline const pseudo_entry_t* find_pseudo(const char* mnemonic, int operand_count) {
+    for (size_t i = 0; i < sizeof(pseudo_table)/sizeof(pseudo_table[0]); i++)
+        if (pseudo_table[i].operand_count == operand_count && strcmp(pseudo_table[i].mnemonic, mnemonic) == 0)
+            return &pseudo_table[i];
+    return NULL;
+}
+
+// troca $n pelos operandos
+static inline void pseudo_fill_template(const char* template_text, const instruction_t* inst, char* out, size_t out_size) {
+    size_t len = 0;
+    for (const char* p = template_text; *p && len + 1 < out_size; p++) {
+        if (*p == '$' && p[1] >= '0' && p[1] <= '3' && p[1] - '0' < inst->operand_count) {
+            const char* operand = inst->operands[p[1] - '0'];
+            size_t n = strlen(operand);
+            if (len + n >= out_size) n = out_size - len - 1;
+            memcpy(out + len, operand, n);
+            len += n;
+            p++;
+        } else {
+            out[len++] = *p;
+        }
+    }
+    out[len] = '\0';
+}
+
+// li: escolhe a menor sequencia para a constante.
+// cabe em 12 bits -> addi; parte baixa zero -> só lui; senão lui + addi com o carry corrigido
+static inline int pseudo_expand_li(const instruction_t* inst, char lines[PSEUDO_MAX_EXPANSION][SOURCE_LINE_MAX]) {
+    const char* imm_str = inst->operands[1];
+    int64_t value;
+    const char* error;
+    EXPR_STATUS status = expr_eval_constant(imm_str, &value, &error);
+    if (status == EXPR_UNDEFINED) {
+        diag_error(inst->line_number, "'li' requer uma constante ('%s'), para enderecos use 'la'.", imm_str);
+        return -1;
+    }
+    if (status != EXPR_OK) {
+        diag_error(inst->line_number, "constante '%s' invalida para 'li': %s.", imm_str, error);
+        return -1;
+    }
+    if (value < INT32_MIN || value > (long long)UINT32_MAX) {
+        diag_error(inst->line_number, "constante '%s' nao cabe em 32 bits.", imm_str);
+        return -1;
+    }
+
+    uint32_t word = (uint32_t)value;
+    int32_t lo = (int32_t)(word << 20) >> 20;
+    uint32_t hi = ((word + 0x800) >> 12) & 0xFFFFF;
+    const char* rd = inst->operands[0];
+
+    if ((int32_t)word >= -2048 && (int32_t)word <= 2047) {
+        snprintf(lines[0], SOURCE_LINE_MAX, "addi %s, x0, %d", rd, (int32_t)word);
+        return 1;
+    }
+    snprintf(lines[0], SOURCE_LINE_MAX, "lui %s, 0x%x", rd, hi);
+    if (lo == 0)
+        return 1;
+    snprintf(lines[1], SOURCE_LINE_MAX, "addi %s, %s, %d", rd, rd, lo);
+    return 2;
+}
+
+// se 'inst' for pseudo, escreve as instruções base (em texto) em 'lines'.
+// retorna quantas foram geradas, 0 se não é pseudo, -1 se deu erro
+static inline int pseudo_expand(const instruction_t* inst, char lines[PSEUDO_MAX_EXPANSION][SOURCE_LINE_MAX]) {
+    const pseudo_entry_t* entry = find_pseudo(inst->mnemonic, inst->operand_count);
+    if (!entry) return 0;
+
+    if (entry->expansion[0] == NULL)
+        return pseudo_expand_li(inst, lines);
+
+    int count = 0;
+    for (; count < PSEUDO_MAX_EXPANSION && entry->expansion[count]; count++)
+        pseudo_fill_template(entry->expansion[count], inst, lines[count], SOURCE_LINE_MAX);
+    return count;
+}
+
+#endif
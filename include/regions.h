@@ -0,0 +1,266 @@
+#ifndef REGIONS_H
+#define REGIONS_H
+
+#include "types.h"
+#include "utils.h"
+#include "diag.h"
+
+// regiões de memoria da placa (rom, ram, ...): nome, origem, tamanho e as seções que vão nela.
+// vem de um arquivo (--layout) e/ou da linha de comando (--region). sem nenhuma região cada seção
+// fica no endereço de sempre (BASE_ADDRESS/DATA_BASE_ADDRESS, os do rars) e não tem limite.
+//
+// uma região por linha, '#' comenta (no --region os campos vão separados por virgula):
+//     # nome   origem       tamanho   seções
+//     rom      0x00000000   64k       .text
+//     ram      0x20000000   16k       .data
+//
+// seções na mesma região ficam uma depois da outra, na ordem da linha (alinhadas em 4). o inicio
+// da segunda só se sabe depois do layout da primeira, por isso o section_base é atualizado pelo
+// layout_program. cada região vira uma imagem propria na saida (memoria.mif -> memoria_rom.mif)
+
+#define REGION_MAX 16
+#define REGION_NAME_MAX 32
+
+typedef struct {
+    char name[REGION_NAME_MAX];
+    uint32_t origin;
+    uint32_t length;
+    uint8_t sections[SECTION_COUNT]; // na ordem em que são colocadas
+    uint8_t section_count;
+} memory_region_t;
+
+typedef struct {
+    memory_region_t regions[REGION_MAX];
+    size_t count;
+    int8_t section_region[SECTION_COUNT];  // região de cada seção (-1 = nenhuma)
+    uint32_t section_base[SECTION_COUNT];  // inicio de cada seção (o layout ajusta as encadeadas)
+} memory_layout_t;
+
+// layout em uso nesta thread (NULL = endereços padrão). o main liga com o das opções e cada
+// pedido do --serve com a copia dele
+static THREAD_LOCAL memory_layout_t* memory_layout_active = NULL;
+
+static inline void memory_layout_init(memory_layout_t* layout) {
+    memset(layout, 0, sizeof(*layout));
+    for (int s = 0; s < SECTION_COUNT; s++)
+        layout->section_region[s] = -1;
+}
+
+// mesmos nomes que o .section aceita
+static inline bool memory_layout_section(const char* name, uint8_t* section) {
+    if (strcmp(name, ".text") == 0) *section = SECTION_TEXT;
+    else if (strcmp(name, ".data") == 0 || strcmp(name, ".rodata") == 0) *section = SECTION_DATA;
+    else return false;
+    return true;
+}
+
+// uma região a partir dos campos "nome origem tamanho seção...". 'where' diz de onde veio
+// a definição nas mensagens. retorna a quantidade de erros (todos os campos são olhados)
+static inline size_t memory_layout_add(memory_layout_t* layout, char* fields, const char* where) {
+    const char* seps = " \t,";
+    char* save;
+    char* name = strtok_r(fields, seps, &save);
+    char* origin = strtok_r(NULL, seps, &save);
+    char* length = strtok_r(NULL, seps, &save);
+    if (!name || !origin || !length) {
+        fprintf(stderr, "erro: %s: regiao espera 'nome origem tamanho secoes'.\n", where);
+        return 1;
+    }
+    if (layout->count >= REGION_MAX) {
+        fprintf(stderr, "erro: %s: no maximo %d regioes.\n", where, REGION_MAX);
+        return 1;
+    }
+
+    size_t errors = 0;
+    memory_region_t* region = &layout->regions[layout->count];
+    memset(region, 0, sizeof(*region));
+    if (strlen(name) >= REGION_NAME_MAX) {
+        fprintf(stderr, "erro: %s: nome de regiao '%s' muito longo.\n", where, name);
+        errors++;
+    }
+    snprintf(region->name, sizeof(region->name), "%s", name);
+    for (size_t r = 0; r < layout->count; r++) {
+        if (strcmp(layout->regions[r].name, region->name) == 0) {
+            fprintf(stderr, "erro: %s: regiao '%s' ja definida.\n", where, name);
+            errors++;
+        }
+    }
+
+    if (parse_size(origin, &region->origin) != 0) {
+        fprintf(stderr, "erro: %s: origem '%s' invalida.\n", where, origin);
+        errors++;
+    } else if (region->origin % 4 != 0) {
+        fprintf(stderr, "erro: %s: origem '%s' nao esta alinhada em 4.\n", where, origin);
+        errors++;
+    }
+    if (parse_size(length, &region->length) != 0 || region->length == 0) {
+        fprintf(stderr, "erro: %s: tamanho '%s' invalido.\n", where, length);
+        errors++;
+    } else if ((uint64_t)region->origin + region->length > (uint64_t)UINT32_MAX + 1) {
+        fprintf(stderr, "erro: %s: regiao '%s' passa do fim do espaco de enderecamento.\n", where, name);
+        errors++;
+    }
+
+    for (char* name_s = strtok_r(NULL, seps, &save); name_s; name_s = strtok_r(NULL, seps, &save)) {
+        uint8_t section;
+        if (!memory_layout_section(name_s, &section)) {
+            fprintf(stderr, "erro: %s: secao '%s' nao suportada.\n", where, name_s);
+            errors++;
+        } else if (layout->section_region[section] >= 0) {
+            fprintf(stderr, "erro: %s: secao '%s' ja esta na regiao '%s'.\n", where, name_s,
+                    layout->regions[layout->section_region[section]].name);
+            errors++;
+        } else {
+            for (uint8_t k = 0; k < region->section_count; k++) {
+                if (region->sections[k] == section) {
+                    fprintf(stderr, "erro: %s: secao '%s' repetida.\n", where, name_s);
+                    errors++;
+                }
+            }
+            if (errors == 0) region->sections[region->section_count++] = section;
+        }
+    }
+
+    if (errors > 0) return errors;
+    for (uint8_t k = 0; k < region->section_count; k++) {
+        layout->section_region[region->sections[k]] = (int8_t)layout->count;
+        layout->section_base[region->sections[k]] = region->origin;
+    }
+    layout->count++;
+    return 0;
+}
+
+// le um arquivo de layout inteiro. retorna 0 se todas as linhas estão certas
+static inline int memory_layout_load(memory_layout_t* layout, const char* filename) {
+    size_t line_count;
+    char** lines = read_file_lines(filename, &line_count);
+    if (!lines) {
+        fprintf(stderr, "erro: nao foi possivel ler o arquivo de layout '%s'.\n", filename);
+        return -1;
+    }
+
+    size_t errors = 0;
+    for (size_t i = 0; i < line_count; i++) {
+        char* comment = strchr(lines[i], '#');
+        if (comment) *comment = '\0';
+        char* line = ltrim(lines[i]);
+        rtrim(line);
+        if (line[0] != '\0') {
+            char where[SOURCE_LINE_MAX];
+            snprintf(where, sizeof(where), "layout '%s' linha %zu", filename, i + 1);
+            errors += memory_layout_add(layout, line, where);
+        }
+        free(lines[i]);
+    }
+    free(lines);
+    return errors == 0 ? 0 : -1;
+}
+
+// depois de todas as regiões: nenhuma pode cobrir outra
+static inline int memory_layout_finish(const memory_layout_t* layout) {
+    size_t errors = 0;
+    for (size_t a = 0; a < layout->count; a++) {
+        for (size_t b = a + 1; b < layout->count; b++) {
+            const memory_region_t* ra = &layout->regions[a];
+            const memory_region_t* rb = &layout->regions[b];
+            if ((uint64_t)ra->origin < (uint64_t)rb->origin + rb->length &&
+                (uint64_t)rb->origin < (uint64_t)ra->origin + ra->length) {
+                fprintf(stderr, "erro: regioes '%s' e '%s' se sobrepoem.\n", ra->name, rb->name);
+                errors++;
+            }
+        }
+    }
+    return errors == 0 ? 0 : -1;
+}
+
+// memoria.mif -> memoria_rom.mif
+static inline void memory_region_filename(const char* output, const char* region, char* out, size_t size) {
+    const char* dot = strrchr(output, '.');
+    const char* slash = strrchr(output, '/');
+    int stem = (int)((dot && (!slash || dot > slash)) ? (size_t)(dot - output) : strlen(output));
+    snprintf(out, size, "%.*s_%s.mif", stem, output, region);
+}
+
+// chamada pelo layout_program com o fim de cada seção: coloca cada seção encadeada logo depois
+// da anterior na região. retorna true se algum inicio mudou (aí o layout precisa rodar de novo)
+static inline bool memory_layout_chain(const uint32_t end[SECTION_COUNT]) {
+    memory_layout_t* layout = memory_layout_active;
+    if (!layout) return false;
+
+    bool changed = false;
+    for (size_t r = 0; r < layout->count; r++) {
+        const memory_region_t* region = &layout->regions[r];
+        for (uint8_t k = 1; k < region->section_count; k++) {
+            uint8_t prev = region->sections[k - 1];
+            uint32_t start = (end[prev] + 3) & ~3u;
+            if (layout->section_base[region->sections[k]] != start) {
+                layout->section_base[region->sections[k]] = start;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+// RAM do --run quando o .data está numa região: do inicio do .data até o fim da região. o .text
+// depois do .data na mesma região ficaria dentro da RAM (e a pilha em cima dele), isso é recusado.
+// retorna 1 sem região para o .data (fica a RAM padrão), 0 com a RAM em 'base'/'size', -1 se não dá
+static inline int memory_layout_data_ram(uint32_t* base, uint32_t* size) {
+    const memory_layout_t* layout = memory_layout_active;
+    if (!layout || layout->section_region[SECTION_DATA] < 0) return 1;
+
+    const memory_region_t* region = &layout->regions[layout->section_region[SECTION_DATA]];
+    uint32_t start = layout->section_base[SECTION_DATA];
+    if (layout->section_region[SECTION_TEXT] == layout->section_region[SECTION_DATA] &&
+        layout->section_base[SECTION_TEXT] > start) {
+        fprintf(stderr, "erro: --run precisa do .text antes do .data na regiao '%s' (a RAM vai do .data ate o fim da regiao).\n",
+                region->name);
+        return -1;
+    }
+    *base = start;
+    *size = (uint32_t)((uint64_t)region->origin + region->length - start);
+    return 0;
+}
+
+// confere o layout final contra as regiões: toda região que estourou é reportada (na linha do
+// primeiro item que passa do fim), junto com as seções que não estão em região nenhuma.
+// retorna a quantidade de erros
+static inline size_t memory_layout_check(const instruction_t* items, size_t count) {
+    const memory_layout_t* layout = memory_layout_active;
+    if (!layout) return 0;
+
+    uint32_t overflow_line[REGION_MAX] = {0};
+    uint64_t end[REGION_MAX] = {0};
+    uint32_t unplaced_line[SECTION_COUNT] = {0};
+    for (size_t i = 0; i < count; i++) {
+        const instruction_t* item = &items[i];
+        if (item->size == 0) continue;
+        int r = layout->section_region[item->section];
+        if (r < 0) {
+            if (!unplaced_line[item->section]) unplaced_line[item->section] = item->line_number;
+            continue;
+        }
+        uint64_t item_end = (uint64_t)item->address + item->size;
+        if (item_end > end[r]) end[r] = item_end;
+        if (item_end > (uint64_t)layout->regions[r].origin + layout->regions[r].length && !overflow_line[r])
+            overflow_line[r] = item->line_number;
+    }
+
+    size_t errors = 0;
+    for (size_t r = 0; r < layout->count; r++) {
+        if (!overflow_line[r]) continue;
+        const memory_region_t* region = &layout->regions[r];
+        uint64_t limit = (uint64_t)region->origin + region->length;
+        diag_error(overflow_line[r], "regiao '%s' estourou: ocupa ate 0x%08llx mas termina em 0x%08llx (%llu byte(s) a mais).",
+                   region->name, (unsigned long long)end[r], (unsigned long long)limit, (unsigned long long)(end[r] - limit));
+        errors++;
+    }
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        if (!unplaced_line[s]) continue;
+        diag_error(unplaced_line[s], "secao '%s' nao esta em nenhuma regiao do layout.", s == SECTION_DATA ? ".data" : ".text");
+        errors++;
+    }
+    return errors;
+}
+
+#endif
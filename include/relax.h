@@ -0,0 +1,139 @@
+#ifndef RELAX_H
+#define RELAX_H
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "encoding_table.h"
+#include "parser.h"
+
+// relaxação de branches: B-type só alcança ±4 KiB, então um branch longe demais vira
+//     bne rs1, rs2, 8     (condição invertida, pula o jal)
+//     jal x0, label       (±1 MiB)
+// cada relaxação só aumenta o programa, então repetir até ninguem mudar sempre termina.
+
+typedef struct {
+    const char* mnemonic;
+    const char* inverse;
+} branch_inverse_t;
+
+static const branch_inverse_t branch_inverse_table[] = {
+    {"beq", "bne"},
+    {"bne", "beq"},
+    {"blt", "bge"},
+    {"bge", "blt"},
+    {"bltu", "bgeu"},
+    {"bgeu", "bltu"}
+};
+
+static inline const char* branch_inverse(const char* mnemonic) {
+    for (size_t i = 0; i < sizeof(branch_inverse_table)/sizeof(branch_inverse_table[0]); i++)
+        if (strcmp(branch_inverse_table[i].mnemonic, mnemonic) == 0)
+            return branch_inverse_table[i].inverse;
+    return NULL;
+}
+
+static inline int branch_offset_fits(int32_t offset) {
+    return offset >= -4096 && offset <= 4094;
+}
+
+// coloca o par (branch invertido, jal) no fim de 'out'
+static inline void relax_emit_pair(instruction_t* branch, item_list_t* out) {
+    instruction_t jump = {0};
+    jump.kind = ITEM_INSTRUCTION;
+    jump.line_number = branch->line_number;
+    strcpy(jump.mnemonic, "jal");
+    jump.operands[0] = my_strdup("x0");
+    jump.operands[1] = branch->operands[2];
+    jump.operand_count = 2;
+    jump.expr = branch->expr;    // o destino vai junto com a expressão já compilada
+
+    strcpy(branch->mnemonic, branch_inverse(branch->mnemonic));
+    branch->operands[2] = my_strdup("8");
+    branch->expr = NULL;
+
+    // o "8" só vale com os dois em 32 bits: o --compress não pode encolher nenhum do par
+    branch->flags |= ITEM_FLAG_NO_RVC;
+    jump.flags |= ITEM_FLAG_NO_RVC;
+
+    item_list_push(out, branch);
+    item_list_push(out, &jump);
+}
+
+// relaxa os branches fora do range até chegar num ponto fixo. só os branches ainda curtos
+// ficam na worklist, e cada rodada custa O(itens) (o destino é a expressão já compilada,
+// avaliada com o hash da tabela de simbolos, mais uma copia do vetor).
+// branches para labels externas ficam com o linker. retorna a quantidade de erros do layout
+static inline size_t relax_branches(instruction_t** items, size_t* count, symbol_table_t* table, size_t* relaxed_count) {
+    size_t errors = 0;
+    *relaxed_count = 0;
+
+    // candidatos: branches com instrução inversa conhecida
+    size_t* worklist = (size_t *)malloc((*count ? *count : 1) * sizeof(size_t));
+    CHECK_ALLOC(worklist, exit(EXIT_FAILURE));
+    size_t work_count = 0;
+    for (size_t i = 0; i < *count; i++) {
+        const instruction_t* item = &(*items)[i];
+        if (item->kind != ITEM_INSTRUCTION || item->operand_count != 3) continue;
+        const instruction_entry_t* entry = find_instruction(item->mnemonic);
+        if (entry && entry->type == INST_B && branch_inverse(item->mnemonic))
+            worklist[work_count++] = i;
+    }
+
+    uint8_t* far = (uint8_t *)calloc(*count ? *count : 1, 1);
+    CHECK_ALLOC(far, exit(EXIT_FAILURE));
+
+    while (work_count > 0) {
+        size_t far_count = 0;
+        for (size_t w = 0; w < work_count; w++) {
+            const instruction_t* branch = &(*items)[worklist[w]];
+            // offset numerico fica como está, label externa (não avalia) fica com o linker
+            const expr_t* e = branch->expr;
+            if (!e || !(e->flags & (EXPR_FLAG_SYMBOL | EXPR_FLAG_DOT))) continue;
+            expr_env_t env = {table, branch->address, branch->section, true, false, branch->line_number};
+            expr_result_t target;
+            if (expr_eval(e, &env, &target) != EXPR_OK) continue;
+            if (!branch_offset_fits((int32_t)((uint32_t)target.value - branch->address))) {
+                far[worklist[w]] = 1;
+                far_count++;
+            }
+        }
+        if (far_count == 0) break;
+
+        // reconstroi o vetor com os pares no lugar dos branches longes
+        item_list_t out = {0};
+        size_t new_work_count = 0;
+        size_t w = 0;
+        for (size_t i = 0; i < *count; i++) {
+            instruction_t* item = &(*items)[i];
+            if (far[i]) {
+                relax_emit_pair(item, &out);
+                if (w < work_count && worklist[w] == i) w++;
+                continue;
+            }
+            if (w < work_count && worklist[w] == i) {
+                worklist[new_work_count++] = out.count;
+                w++;
+            }
+            item_list_push(&out, item);
+        }
+        free(*items);
+        *items = out.items;
+        *count = out.count;
+        work_count = new_work_count;
+        *relaxed_count += far_count;
+
+        free(far);
+        far = (uint8_t *)calloc(*count, 1);
+        CHECK_ALLOC(far, exit(EXIT_FAILURE));
+
+        errors += layout_program(*items, *count, table);
+        if (errors > 0) break;
+    }
+
+    free(far);
+    free(worklist);
+    return errors;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef RELOCATION_H
+#define RELOCATION_H
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "utils.h"
+
+#define RELOC_INITIAL_CAPACITY 8
+
+static inline void reloc_list_init(reloc_list_t* list) {
+    list->entries = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+static inline void reloc_list_add(reloc_list_t* list, uint32_t address, RELOC_TYPE type, const char* symbol, int32_t addend) {
+    if (list->count >= list->capacity) {
+        list->capacity = list->capacity == 0 ? RELOC_INITIAL_CAPACITY : list->capacity * 2;
+        relocation_t* new_entries = (relocation_t *)realloc(list->entries, list->capacity * sizeof(relocation_t));
+        CHECK_ALLOC(new_entries, exit(EXIT_FAILURE));
+        list->entries = new_entries;
+    }
+    list->entries[list->count].address = address;
+    list->entries[list->count].type = type;
+    list->entries[list->count].symbol = my_strdup(symbol);
+    list->entries[list->count].addend = addend;
+    list->count++;
+}
+
+static inline void reloc_list_free(reloc_list_t* list) {
+    for (size_t i = 0; i < list->count; ++i)
+        free(list->entries[i].symbol);
+    free(list->entries);
+    reloc_list_init(list);
+}
+
+static inline const char* reloc_type_name(RELOC_TYPE type) {
+    switch (type) {
+        case RELOC_BRANCH: return "BRANCH";
+        case RELOC_JAL:    return "JAL";
+        case RELOC_HI20:   return "HI20";
+        case RELOC_LO12_I: return "LO12_I";
+        case RELOC_LO12_S: return "LO12_S";
+        case RELOC_ABS32:  return "ABS32";
+    }
+    return "?";
+}
+
+// %hi com a correção do carry: o addi/lw que vem depois soma um imediato COM sinal,
+// então se o bit 11 estiver ligado o %hi precisa de +1
+static inline uint32_t reloc_hi20(uint32_t value) {
+    return ((value + 0x800) >> 12) & 0xFFFFF;
+}
+
+static inline int32_t reloc_lo12(uint32_t value) {
+    return (int32_t)(value << 20) >> 20;
+}
+
+// aplica uma relocação em uma palavra ja codificada.
+// 'value' é o endereço final do simbolo + addend e 'pc' o endereço da instrução.
+// retorna false se o valor não cabe no campo
+static inline bool reloc_apply(uint32_t* word, RELOC_TYPE type, uint32_t value, uint32_t pc) {
+    encoded_fields_t f;
+    f.word = *word;
+    int32_t offset = (int32_t)(value - pc);
+
+    switch (type) {
+        case RELOC_BRANCH:
+            if (offset < -4096 || offset > 4094 || (offset % 2 != 0)) return false;
+            f.b.imm4_1  = (uint32_t)(offset >> 1) & 0xF;
+            f.b.imm10_5 = (uint32_t)(offset >> 5) & 0x3F;
+            f.b.imm11   = (uint32_t)(offset >> 11) & 0x1;
+            f.b.imm12   = (uint32_t)(offset >> 12) & 0x1;
+            break;
+        case RELOC_JAL:
+            if (offset < -1048576 || offset > 1048574 || (offset % 2 != 0)) return false;
+            f.j.imm10_1  = (uint32_t)(offset >> 1) & 0x3FF;
+            f.j.imm11    = (uint32_t)(offset >> 11) & 0x1;
+            f.j.imm19_12 = (uint32_t)(offset >> 12) & 0xFF;
+            f.j.imm20    = (uint32_t)(offset >> 20) & 0x1;
+            break;
+        case RELOC_HI20:
+            f.u.imm = (int32_t)reloc_hi20(value);
+            break;
+        case RELOC_LO12_I:
+            f.i.imm = reloc_lo12(value);
+            break;
+        case RELOC_LO12_S: {
+            int32_t lo = reloc_lo12(value);
+            f.s.imm4_0  = (uint32_t)lo & 0x1F;
+            f.s.imm11_5 = (lo >> 5) & 0x7F;
+            break;
+        }
+        case RELOC_ABS32:
+            f.word = value;
+            break;
+        default:
+            return false;
+    }
+
+    *word = f.word;
+    return true;
+}
+
+#endif
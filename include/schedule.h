@@ -0,0 +1,242 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "utils.h"
+#include "symbol_table.h"
+#include "encoder.h"
+#include "hazard.h"
+
+// escalonamento de lista dentro de cada bloco basico (--schedule): reordena instruções
+// independentes para encher o buraco entre um load e o primeiro uso dele.
+//
+//   - o bloco nunca atravessa uma label nem o destino de um desvio (mesmo com offset numerico),
+//     e quem termina o bloco (branch, jal, jalr, ecall, ebreak, fence) fica no fim
+//   - as dependencias saem das palavras codificadas: RAW (com a latencia do modelo de
+//     forwarding do --hazards), WAR e WAW. memoria sem analise de alias: load e store nunca
+//     trocam de ordem entre si, e store com store também não
+//   - o bloco só muda se o modelo de tempo disser que ficou melhor (nunca piora)
+//
+// roda depois da relaxação e antes da compressão: os tamanhos dentro do bloco são todos iguais,
+// então nenhuma label muda de endereço e a tabela de simbolos continua valendo.
+
+#define SCHEDULE_MAX_BLOCK 256   // blocos maiores são escalonados em janelas deste tamanho
+
+typedef struct {
+    size_t blocks;           // blocos com mais de uma instrução
+    size_t changed_blocks;   // blocos que foram reordenados
+    size_t moved;            // instruções que mudaram de lugar
+    uint64_t stalls_before;
+    uint64_t stalls_after;
+} schedule_stats_t;
+
+typedef struct {
+    hazard_inst_t inst;
+    bool is_store;
+    bool ok;                 // codificou sem erro
+} schedule_node_t;
+
+// fim de bloco: controle de fluxo e as instruções que servem de barreira
+static inline bool schedule_is_terminator(const hazard_inst_t* inst) {
+    INST_FORMAT format = inst->entry->format;
+    return format == FMT_BRANCH || format == FMT_JAL || format == FMT_JALR ||
+           format == FMT_SYSTEM || format == FMT_FENCE;
+}
+
+static inline bool schedule_reads(const hazard_inst_t* inst, uint8_t reg) {
+    return reg != 0 && (inst->rs[0] == reg || inst->rs[1] == reg);
+}
+
+// 'b' (depois no programa) depende de 'a'? devolve a latencia minima entre os EX, -1 se não depende
+static inline int schedule_dependency(const schedule_node_t* a, const schedule_node_t* b, const hazard_model_t* model) {
+    int latency = -1;
+    if (a->inst.rd != 0 && schedule_reads(&b->inst, a->inst.rd))
+        latency = (int)hazard_result_delay(model, a->inst.is_load);                 // RAW
+    else if (b->inst.rd != 0 && (schedule_reads(&a->inst, b->inst.rd) || a->inst.rd == b->inst.rd))
+        latency = 1;                                                                 // WAR/WAW
+    bool a_mem = a->inst.is_load || a->is_store, b_mem = b->inst.is_load || b->is_store;
+    if (latency < 0 && a_mem && b_mem && (a->is_store || b->is_store))
+        latency = 1;                                                                 // memoria
+    return latency;
+}
+
+// stalls de uma ordem (indices locais em 'nodes')
+static inline uint64_t schedule_stalls(const schedule_node_t* nodes, const size_t* order, size_t n,
+                                       const hazard_model_t* model) {
+    hazard_state_t state;
+    hazard_state_init(&state);
+    uint64_t stalls = 0;
+    bool by_load;
+    for (size_t p = 0; p < n; p++)
+        stalls += hazard_issue(&state, &nodes[order[p]].inst, p, model, &by_load);
+    return stalls;
+}
+
+// escalona nodes[0..n) (o ultimo pode ser o terminador, que fica fixo se 'fixed_last').
+// escreve a nova ordem em 'order'
+// 'latency' é uma matriz SCHEDULE_MAX_BLOCK x SCHEDULE_MAX_BLOCK de trabalho
+static inline void schedule_block(const schedule_node_t* nodes, size_t n, bool fixed_last,
+                                  const hazard_model_t* model, int (*latency)[SCHEDULE_MAX_BLOCK], size_t* order) {
+    int height[SCHEDULE_MAX_BLOCK];
+    int preds[SCHEDULE_MAX_BLOCK];
+    int64_t avail[SCHEDULE_MAX_BLOCK];
+    bool done[SCHEDULE_MAX_BLOCK];
+
+    for (size_t j = 0; j < n; j++) {
+        preds[j] = 0;
+        avail[j] = 0;
+        done[j] = false;
+        for (size_t i = 0; i < j; i++) {
+            latency[i][j] = schedule_dependency(&nodes[i], &nodes[j], model);
+            if (fixed_last && j == n - 1 && latency[i][j] < 0) latency[i][j] = 1;
+            if (latency[i][j] >= 0) preds[j]++;
+        }
+    }
+
+    // prioridade: caminho mais longo (em latencia) até o fim do bloco
+    for (size_t i = n; i-- > 0; ) {
+        height[i] = 1;
+        for (size_t j = i + 1; j < n; j++)
+            if (latency[i][j] >= 0 && latency[i][j] + height[j] > height[i])
+                height[i] = latency[i][j] + height[j];
+    }
+
+    int64_t cycle = 0;
+    for (size_t p = 0; p < n; p++) {
+        // entre as prontas: a que começa mais cedo, depois a mais critica, depois a ordem original
+        size_t best = n;
+        int64_t best_start = 0;
+        for (size_t j = 0; j < n; j++) {
+            if (done[j] || preds[j] > 0) continue;
+            int64_t start = avail[j] > cycle ? avail[j] : cycle;
+            if (best == n || start < best_start || (start == best_start && height[j] > height[best])) {
+                best = j;
+                best_start = start;
+            }
+        }
+        done[best] = true;
+        order[p] = best;
+        cycle = best_start + 1;
+        for (size_t j = best + 1; j < n; j++) {
+            if (latency[best][j] < 0) continue;
+            preds[j]--;
+            if (best_start + latency[best][j] > avail[j]) avail[j] = best_start + latency[best][j];
+        }
+    }
+}
+
+// aplica a nova ordem em items[first..first+n): a label do bloco fica na primeira posição
+// e os endereços são redistribuidos a partir do inicio
+static inline void schedule_apply(instruction_t* items, size_t first, const size_t* order, size_t n) {
+    instruction_t* copy = (instruction_t *)malloc(n * sizeof(instruction_t));
+    CHECK_ALLOC(copy, exit(EXIT_FAILURE));
+    memcpy(copy, &items[first], n * sizeof(instruction_t));
+
+    char* label = copy[0].label;
+    copy[0].label = NULL;
+    uint32_t address = copy[0].address;
+    for (size_t p = 0; p < n; p++) {
+        items[first + p] = copy[order[p]];
+        items[first + p].address = address;
+        address += items[first + p].size;
+    }
+    items[first].label = label;
+    free(copy);
+}
+
+static inline int schedule_address_cmp(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static inline void schedule_program(instruction_t* items, size_t count, symbol_table_t* table,
+                                    const hazard_model_t* model, schedule_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    // codifica tudo uma vez (os erros ficam para a segunda passagem reportar)
+    schedule_node_t* nodes = (schedule_node_t *)calloc(count ? count : 1, sizeof(schedule_node_t));
+    uint32_t* targets = (uint32_t *)malloc((count ? count : 1) * sizeof(uint32_t));
+    CHECK_ALLOC(nodes, exit(EXIT_FAILURE));
+    CHECK_ALLOC(targets, exit(EXIT_FAILURE));
+    size_t target_count = 0;
+
+    encoder_quiet = 1;
+    for (size_t i = 0; i < count; i++) {
+        const instruction_t* item = &items[i];
+        if (item->kind != ITEM_INSTRUCTION || item->section != SECTION_TEXT) continue;
+        uint32_t word = encode_instruction(item, table, item->address);
+        if (word == ENCODING_ERROR_SENTINEL || !hazard_decode_word(word, &nodes[i].inst)) continue;
+        nodes[i].ok = true;
+        nodes[i].is_store = nodes[i].inst.entry->format == FMT_STORE;
+        if (nodes[i].inst.entry->format == FMT_BRANCH)
+            targets[target_count++] = item->address + (uint32_t)disasm_branch_offset(word);
+        else if (nodes[i].inst.entry->format == FMT_JAL)
+            targets[target_count++] = item->address + (uint32_t)disasm_jal_offset(word);
+    }
+    encoder_quiet = 0;
+    qsort(targets, target_count, sizeof(uint32_t), schedule_address_cmp);
+
+    int (*latency)[SCHEDULE_MAX_BLOCK] = (int (*)[SCHEDULE_MAX_BLOCK])malloc(sizeof(int[SCHEDULE_MAX_BLOCK][SCHEDULE_MAX_BLOCK]));
+    CHECK_ALLOC(latency, exit(EXIT_FAILURE));
+    schedule_node_t block[SCHEDULE_MAX_BLOCK];
+    size_t order[SCHEDULE_MAX_BLOCK];
+    size_t identity[SCHEDULE_MAX_BLOCK];
+    for (size_t p = 0; p < SCHEDULE_MAX_BLOCK; p++)
+        identity[p] = p;
+
+    for (size_t i = 0; i < count; ) {
+        if (!nodes[i].ok) { i++; continue; }
+
+        // bloco: instruções seguidas, sem label nem destino de desvio depois da primeira
+        size_t end = i;
+        bool terminated = false;
+        while (end < count && nodes[end].ok && end - i < SCHEDULE_MAX_BLOCK) {
+            if (end > i) {
+                if (items[end].label) break;
+                if (bsearch(&items[end].address, targets, target_count, sizeof(uint32_t), schedule_address_cmp)) break;
+            }
+            end++;
+            if (schedule_is_terminator(&nodes[end - 1].inst)) {
+                terminated = true;
+                break;
+            }
+        }
+
+        size_t n = end - i;
+        if (n > 1) {
+            stats->blocks++;
+            memcpy(block, &nodes[i], n * sizeof(schedule_node_t));
+            schedule_block(block, n, terminated, model, latency, order);
+
+            uint64_t before = schedule_stalls(block, identity, n, model);
+            uint64_t after = schedule_stalls(block, order, n, model);
+            if (after < before) {
+                for (size_t p = 0; p < n; p++)
+                    if (order[p] != p) stats->moved++;
+                schedule_apply(items, i, order, n);
+                stats->changed_blocks++;
+            } else {
+                after = before;
+            }
+            stats->stalls_before += before;
+            stats->stalls_after += after;
+        }
+        i = end;
+    }
+
+    free(latency);
+    free(nodes);
+    free(targets);
+}
+
+static inline void schedule_report(const schedule_stats_t* stats) {
+    printf("escalonamento: %zu de %zu bloco(s) reordenado(s), %zu instrucao(oes) movida(s), "
+           "%llu stall(s) removido(s) (%llu -> %llu).\n",
+           stats->changed_blocks, stats->blocks, stats->moved,
+           (unsigned long long)(stats->stalls_before - stats->stalls_after),
+           (unsigned long long)stats->stalls_before, (unsigned long long)stats->stalls_after);
+}
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "types.h"
+#include "utils.h"
+
+// servidor em unix domain socket (--serve): o plugin do editor / gerador de testes mantem uma
+// conexão aberta e manda um programa por pedido, sem pagar o startup do processo a cada vez.
+//
+// protocolo (nos dois sentidos): [tamanho: u32 little-endian][tamanho bytes]
+//   - uma conexão pode mandar quantos pedidos quiser, cada um recebe exatamente uma resposta, em ordem
+//   - o conteudo do pedido e da resposta é problema do handler (o main monta: ver serve_request)
+//
+// uma thread do pool atende uma conexão inteira; conexões além do pool esperam na fila do accept.
+// o estado global do montador é por thread (THREAD_LOCAL), menos o indice da isa, que é montado
+// antes de subir as threads. SIGINT/SIGTERM param de aceitar e apagam o socket.
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define SERVER_MAX_MESSAGE (64u << 20)   // pedido maior que isso derruba a conexão
+#define SERVER_QUEUE_SIZE  64             // conexões aceitas esperando uma thread
+#define SERVER_BACKLOG     128
+
+// monta a resposta do pedido em 'response'
+typedef void (*server_handler_t)(const char* request, size_t length, FILE* response, void* context);
+
+typedef struct {
+    int fds[SERVER_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    server_handler_t handler;
+    void* context;
+} server_t;
+
+static volatile sig_atomic_t server_stop = 0;
+
+static inline void server_on_signal(int sig) {
+    (void)sig;
+    server_stop = 1;
+}
+
+static inline int server_read_full(int fd, void* data, size_t size) {
+    uint8_t* p = (uint8_t *)data;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static inline int server_write_full(int fd, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t *)data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+// retorna 1 com uma mensagem em *data (o chamador libera), 0 no fim da conexão, -1 se deu erro
+static inline int server_read_message(int fd, char** data, size_t* length) {
+    uint8_t header[4];
+    ssize_t n;
+    do n = read(fd, header, 1); while (n < 0 && errno == EINTR);
+    if (n == 0) return 0;
+    if (n < 0 || server_read_full(fd, header + 1, 3) != 0) return -1;
+
+    uint32_t size = (uint32_t)header[0] | (uint32_t)header[1] << 8 | (uint32_t)header[2] << 16 | (uint32_t)header[3] << 24;
+    if (size > SERVER_MAX_MESSAGE) return -1;
+    *data = (char *)malloc(size + 1);
+    CHECK_ALLOC(*data, return -1);
+    if (server_read_full(fd, *data, size) != 0) {
+        free(*data);
+        return -1;
+    }
+    (*data)[size] = '\0';
+    *length = size;
+    return 1;
+}
+
+static inline int server_write_message(int fd, const char* data, size_t length) {
+    uint8_t header[4] = {(uint8_t)length, (uint8_t)(length >> 8), (uint8_t)(length >> 16), (uint8_t)(length >> 24)};
+    if (server_write_full(fd, header, 4) != 0) return -1;
+    return server_write_full(fd, data, length);
+}
+
+static inline void server_connection(server_t* server, int fd) {
+    char* request;
+    size_t length;
+    while (server_read_message(fd, &request, &length) == 1) {
+        char* response = NULL;
+        size_t response_length = 0;
+        FILE* f = open_memstream(&response, &response_length);
+        CHECK_ALLOC(f, { free(request); return; });
+        server->handler(request, length, f, server->context);
+        fclose(f);
+        free(request);
+
+        int status = server_write_message(fd, response, response_length);
+        free(response);
+        if (status != 0) return;
+    }
+}
+
+static inline void* server_worker(void* arg) {
+    server_t* server = (server_t *)arg;
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        while (server->count == 0)
+            pthread_cond_wait(&server->not_empty, &server->lock);
+        int fd = server->fds[server->head];
+        server->head = (server->head + 1) % SERVER_QUEUE_SIZE;
+        server->count--;
+        pthread_cond_signal(&server->not_full);
+        pthread_mutex_unlock(&server->lock);
+
+        server_connection(server, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static inline void server_enqueue(server_t* server, int fd) {
+    pthread_mutex_lock(&server->lock);
+    while (server->count == SERVER_QUEUE_SIZE)
+        pthread_cond_wait(&server->not_full, &server->lock);
+    server->fds[(server->head + server->count) % SERVER_QUEUE_SIZE] = fd;
+    server->count++;
+    pthread_cond_signal(&server->not_empty);
+    pthread_mutex_unlock(&server->lock);
+}
+
+// escuta em 'path' até SIGINT/SIGTERM. retorna 0 se saiu normalmente
+static inline int server_run(const char* path, unsigned threads, server_handler_t handler, void* context) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "erro: caminho do socket '%s' muito longo.\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // socket velho de uma execução anterior pode ser apagado, qualquer outro arquivo não
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "erro: '%s' ja existe e nao e um socket.\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd, SERVER_BACKLOG) != 0) {
+        fprintf(stderr, "erro: nao foi possivel escutar em '%s': %s.\n", path, strerror(errno));
+        if (listen_fd >= 0) close(listen_fd);
+        return -1;
+    }
+
+    server_t server;
+    memset(&server, 0, sizeof(server));
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.not_empty, NULL);
+    pthread_cond_init(&server.not_full, NULL);
+    server.handler = handler;
+    server.context = context;
+
+    // as threads nascem com os sinais bloqueados: quem acorda com SIGINT é o accept daqui
+    sigset_t mask, old_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+    signal(SIGPIPE, SIG_IGN); // cliente que fecha no meio da resposta não derruba o servidor
+
+#ifdef __GLIBC__
+    // cada pedido aloca e libera tudo de novo: com os limites padrão a glibc devolve o heap para o
+    // sistema no fim do pedido e o seguinte paga as page faults de novo (~60 por pedido de 1k linhas)
+    mallopt(M_TRIM_THRESHOLD, 64 << 20);
+    mallopt(M_MMAP_THRESHOLD, 4 << 20);
+#endif
+
+    if (threads == 0) threads = 1;
+    for (unsigned t = 0; t < threads; t++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, server_worker, &server) != 0) {
+            fprintf(stderr, "erro: nao foi possivel criar a thread %u.\n", t);
+            close(listen_fd);
+            unlink(path);
+            return -1;
+        }
+        pthread_detach(thread);
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = server_on_signal; // sem SA_RESTART: o accept volta com EINTR
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    fprintf(stderr, "escutando em '%s' com %u thread(s).\n", path, threads);
+    int status = 0;
+    while (!server_stop) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "erro: accept falhou: %s.\n", strerror(errno));
+            status = -1;
+            break;
+        }
+        server_enqueue(&server, fd);
+    }
+
+    // as threads morrem com o processo (conexões no meio de um pedido são cortadas)
+    close(listen_fd);
+    unlink(path);
+    return status;
+}
+
+#endif
+
+#endif
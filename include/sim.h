@@ -0,0 +1,381 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "types.h"
+#include "utils.h"
+#include "encoding_table.h"
+#include "disasm.h" // disasm_fetch, offsets de branch/jal
+
+// simulador RV32IM (--run). o .text é decodificado UMA vez para um vetor denso de micro-ops
+// (um por instrução, na ordem do programa) e o laço principal só pula de handler em handler
+// (computed goto no gcc/clang, switch no resto). desvios já guardam o indice da op de destino,
+// então nada de decode nem de conta de endereço no caminho quente.
+//
+// memoria: o .text (só leitura) e uma RAM em [SIM_RAM_BASE, SIM_RAM_BASE + --mem), com o
+// .data copiado no endereço dele (DATA_BASE_ADDRESS). com o .data numa região do --layout a RAM
+// é a própria região, do inicio do .data até o fim dela. escrever no .text é erro (as ops já
+// foram decodificadas).
+//
+// para quando achar: ebreak, ecall, um desvio para ele mesmo (end_loop: beq zero, zero, end_loop),
+// o fim do .text, o limite de instruções, ou um erro (instrução invalida, acesso fora da memoria).
+
+#define SIM_RAM_BASE 0x10000000u            // inicio da memoria de dados do rars
+#define SIM_DEFAULT_MEMORY (4u << 20)       // cobre o .data (0x10010000) com folga para a pilha
+#define SIM_DEFAULT_MAX_STEPS 1000000000ull
+#define SIM_NO_OP UINT32_MAX                // meia-palavra que não é inicio de instrução
+
+#if defined(__GNUC__) && !defined(SIM_NO_COMPUTED_GOTO)
+#define SIM_COMPUTED_GOTO 1
+#else
+#define SIM_COMPUTED_GOTO 0
+#endif
+
+// uma op por instrução do isa.def (mesma ordem de inst_table) + as ops internas
+typedef enum {
+#define INST(name, type, format, opcode, funct3, funct7, imm12) SIM_OP_##name,
+#include "isa.def"
+#undef INST
+    SIM_OP_ILLEGAL,          // palavra que não decodifica
+    SIM_OP_BAD_TARGET,       // destino de desvio fora do .text ou no meio de uma instrução
+    SIM_OP_END,              // caiu do fim do .text
+    SIM_OP_SELF_LOOP,        // destino de um desvio para ele mesmo
+    SIM_OP_COUNT
+} SIM_OP;
+
+typedef char sim_op_fits_code_t[(SIM_OP_COUNT <= 256) ? 1 : -1];
+
+// 8 bytes por instrução. rd = 0 vira o registrador 32 (lixo), então x0 nunca é escrito
+// e ninguém precisa zerar ele depois de cada op
+typedef struct {
+    uint8_t code;            // SIM_OP
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    int32_t imm;             // imediato (auipc já com o pc somado) ou indice da op de destino
+} sim_op_t;
+
+typedef enum {
+    SIM_HALT_EBREAK,
+    SIM_HALT_ECALL,
+    SIM_HALT_SELF_LOOP,
+    SIM_HALT_END,
+    SIM_HALT_LIMIT,
+    SIM_HALT_ILLEGAL,
+    SIM_HALT_BAD_JUMP,
+    SIM_HALT_LOAD_FAULT,
+    SIM_HALT_STORE_FAULT
+} SIM_HALT;
+
+// profiling (--profile): contadores por op e arvore de chamadas. com o .text sem RVC o indice
+// da op é exatamente (pc - text.base) / 4, então o vetor é plano e o custo é um incremento
+typedef struct {
+    uint32_t parent;
+    uint32_t entry;          // indice da op onde a função começa
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint64_t self;           // instruções executadas com esse caminho no topo da pilha
+} sim_frame_t;
+
+typedef struct {
+    uint64_t* counts;        // execuções de cada op
+    uint64_t* taken;         // quantas vezes cada desvio foi tomado
+    sim_frame_t* frames;     // 0 = raiz (inicio do programa)
+    size_t frame_count;
+    size_t frame_capacity;
+    uint32_t current;
+    uint64_t mark;           // instruções já atribuidas a algum frame
+} sim_profile_t;
+
+typedef struct {
+    uint32_t x[33];          // x[32] recebe as escritas em x0
+
+    sim_op_t* ops;
+    uint32_t* op_pc;         // pc de cada op (fora do caminho quente: link, relatorio)
+    size_t op_count;
+    size_t op_capacity;
+    size_t end_op;           // indice da SIM_OP_END (as ops antes dela são as instruções do .text)
+    uint32_t* pc_map;        // meia-palavra do .text -> indice da op (jalr)
+    int rvc;
+
+    disasm_image_t text;
+    uint8_t* ram;
+    uint32_t ram_base;
+    uint32_t ram_size;
+    sim_profile_t* profile;  // só no sim_run_profiled
+} sim_t;
+
+typedef struct {
+    SIM_HALT reason;
+    uint32_t pc;             // instrução onde parou
+    uint32_t address;        // endereço do acesso que falhou / destino invalido
+    uint64_t instructions;
+    double seconds;
+} sim_result_t;
+
+static inline const char* sim_halt_name(SIM_HALT reason) {
+    switch (reason) {
+        case SIM_HALT_EBREAK:      return "ebreak";
+        case SIM_HALT_ECALL:       return "ecall";
+        case SIM_HALT_SELF_LOOP:   return "laco infinito (desvio para ele mesmo)";
+        case SIM_HALT_END:         return "fim do .text";
+        case SIM_HALT_LIMIT:       return "limite de instrucoes";
+        case SIM_HALT_ILLEGAL:     return "instrucao invalida";
+        case SIM_HALT_BAD_JUMP:    return "desvio para fora do .text";
+        case SIM_HALT_LOAD_FAULT:  return "leitura fora da memoria";
+        case SIM_HALT_STORE_FAULT: return "escrita fora da memoria";
+    }
+    return "?";
+}
+
+// só ebreak/ecall/laço/fim são um jeito normal de terminar o programa
+static inline int sim_halt_ok(SIM_HALT reason) {
+    return reason <= SIM_HALT_END;
+}
+
+static inline uint32_t sim_push_op(sim_t* sim, uint8_t code, uint32_t pc) {
+    if (sim->op_count == sim->op_capacity) {
+        sim->op_capacity = sim->op_capacity ? sim->op_capacity * 2 : 1024;
+        sim->ops = (sim_op_t *)realloc(sim->ops, sim->op_capacity * sizeof(sim_op_t));
+        sim->op_pc = (uint32_t *)realloc(sim->op_pc, sim->op_capacity * sizeof(uint32_t));
+        CHECK_ALLOC(sim->ops, exit(EXIT_FAILURE));
+        CHECK_ALLOC(sim->op_pc, exit(EXIT_FAILURE));
+    }
+    sim_op_t* op = &sim->ops[sim->op_count];
+    memset(op, 0, sizeof(*op));
+    op->code = code;
+    sim->op_pc[sim->op_count] = pc;
+    return (uint32_t)sim->op_count++;
+}
+
+// indice da op que começa em 'pc', SIM_NO_OP se não tem nenhuma
+static inline uint32_t sim_lookup(const sim_t* sim, uint32_t pc) {
+    uint32_t offset = pc - sim->text.base;
+    if ((offset & 1) || offset >= sim->text.size) return SIM_NO_OP;
+    return sim->pc_map[offset / 2];
+}
+
+// decodifica o .text inteiro. 'rvc' liga as instruções de 16 bits (programa montado com --compress)
+static inline void sim_predecode(sim_t* sim, int rvc) {
+    size_t halfwords = sim->text.size / 2 + 1;
+    sim->pc_map = (uint32_t *)malloc(halfwords * sizeof(uint32_t));
+    CHECK_ALLOC(sim->pc_map, exit(EXIT_FAILURE));
+    memset(sim->pc_map, 0xFF, halfwords * sizeof(uint32_t));
+
+    // primeira passada: uma op por instrução, na ordem (cair para a proxima é só op + 1)
+    uint32_t word, length;
+    for (size_t offset = 0; offset < sim->text.size; offset += length) {
+        uint32_t pc = sim->text.base + (uint32_t)offset;
+        const instruction_entry_t* entry = disasm_fetch(&sim->text, offset, rvc, &word, &length);
+        if (length < 2) break; // sobra de 1 byte no fim
+
+        uint32_t index = sim_push_op(sim, entry ? (uint8_t)(entry - inst_table) : SIM_OP_ILLEGAL, pc);
+        sim->pc_map[offset / 2] = index;
+        if (!entry) continue;
+
+        sim_op_t* op = &sim->ops[index];
+        uint32_t rd = (word >> 7) & 0x1F;
+        op->rd  = (uint8_t)(rd ? rd : 32);
+        op->rs1 = (uint8_t)((word >> 15) & 0x1F);
+        op->rs2 = (uint8_t)((word >> 20) & 0x1F);
+
+        switch (entry->format) {
+            case FMT_U:
+                op->imm = (int32_t)(word & 0xFFFFF000u);
+                if (op->code == SIM_OP_auipc) op->imm = (int32_t)(pc + (uint32_t)op->imm);
+                break;
+            case FMT_I:
+            case FMT_LOAD:
+            case FMT_JALR:
+                op->imm = (int32_t)word >> 20;
+                break;
+            case FMT_SHIFT:
+                op->imm = (int32_t)((word >> 20) & 0x1F);
+                break;
+            case FMT_STORE:
+                op->imm = (((int32_t)word >> 25) << 5) | (int32_t)((word >> 7) & 0x1F);
+                break;
+            case FMT_BRANCH:
+                op->imm = (int32_t)(pc + (uint32_t)disasm_branch_offset(word)); // resolvido abaixo
+                break;
+            case FMT_JAL:
+                op->imm = (int32_t)(pc + (uint32_t)disasm_jal_offset(word));
+                break;
+            default:
+                break;
+        }
+    }
+    size_t instruction_ops = sim_push_op(sim, SIM_OP_END, sim->text.base + (uint32_t)sim->text.size);
+    sim->end_op = instruction_ops;
+    sim->rvc = rvc;
+
+    // segunda passada: destino dos desvios vira indice. laço em si mesmo e destino
+    // invalido ganham uma op propria (com o pc certo para o relatorio)
+    for (size_t i = 0; i < instruction_ops; i++) {
+        uint8_t code = sim->ops[i].code;
+        if (code >= INST_TABLE_SIZE) continue;
+        if (inst_table[code].format != FMT_BRANCH && inst_table[code].format != FMT_JAL) continue;
+
+        uint32_t target_pc = (uint32_t)sim->ops[i].imm;
+        uint32_t target = sim_lookup(sim, target_pc);
+        if (target == i)
+            target = sim_push_op(sim, SIM_OP_SELF_LOOP, target_pc);
+        else if (target == SIM_NO_OP)
+            target = sim_push_op(sim, SIM_OP_BAD_TARGET, target_pc);
+        sim->ops[i].imm = (int32_t)target;
+    }
+}
+
+// memoria. leitura/escrita byte a byte: o compilador junta em um acesso só nos hosts
+// little-endian, e desalinhado funciona de graça
+static inline uint32_t sim_get(const uint8_t* p, uint32_t size) {
+    uint32_t value = p[0];
+    if (size > 1) value |= (uint32_t)p[1] << 8;
+    if (size > 2) value |= ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    return value;
+}
+
+static inline void sim_set(uint8_t* p, uint32_t value, uint32_t size) {
+    p[0] = (uint8_t)value;
+    if (size > 1) p[1] = (uint8_t)(value >> 8);
+    if (size > 2) {
+        p[2] = (uint8_t)(value >> 16);
+        p[3] = (uint8_t)(value >> 24);
+    }
+}
+
+// caminho lento das leituras: dado guardado no .text (tabelas constantes)
+static inline bool sim_read_text(const sim_t* sim, uint32_t address, uint32_t size, uint32_t* value) {
+    uint32_t offset = address - sim->text.base;
+    if (offset >= sim->text.size || sim->text.size - offset < size) return false;
+    *value = sim_get(sim->text.bytes + offset, size);
+    return true;
+}
+
+// prepara a memoria: a RAM em [ram_base, ram_base + memory_size), o .data copiado nela e a pilha
+// apontando para o topo. retorna false se a RAM não comporta o .data
+static inline bool sim_init(sim_t* sim, disasm_image_t text, const uint8_t* data, uint32_t data_base,
+                            uint32_t data_size, uint32_t ram_base, uint32_t memory_size, int rvc) {
+    memset(sim, 0, sizeof(*sim));
+    uint32_t data_offset = data_base - ram_base;
+    if (memory_size < 16 || (data_size > 0 && (data_base < ram_base || memory_size < data_offset ||
+                                               memory_size - data_offset < data_size))) {
+        fprintf(stderr, "erro: memoria do simulador (%u bytes em 0x%08x) nao comporta o .data em 0x%08x (%u bytes).\n",
+                memory_size, ram_base, data_base, data_size);
+        return false;
+    }
+
+    sim->text = text;
+    sim->ram_base = ram_base;
+    sim->ram_size = memory_size;
+    sim->ram = (uint8_t *)calloc(memory_size, 1);
+    CHECK_ALLOC(sim->ram, exit(EXIT_FAILURE));
+    if (data_size > 0)
+        memcpy(sim->ram + data_offset, data, data_size);
+
+    sim->x[2] = (uint32_t)(((uint64_t)ram_base + memory_size) & ~(uint64_t)15); // sp no topo da RAM
+    sim_predecode(sim, rvc);
+    return true;
+}
+
+static inline void sim_free(sim_t* sim) {
+    free(sim->ops);
+    free(sim->op_pc);
+    free(sim->pc_map);
+    free(sim->ram);
+    sim->ops = NULL;
+    sim->op_pc = NULL;
+    sim->pc_map = NULL;
+    sim->ram = NULL;
+}
+
+static inline uint32_t sim_profile_frame(sim_profile_t* profile, uint32_t parent, uint32_t entry) {
+    if (profile->frame_count == profile->frame_capacity) {
+        profile->frame_capacity = profile->frame_capacity ? profile->frame_capacity * 2 : 64;
+        profile->frames = (sim_frame_t *)realloc(profile->frames, profile->frame_capacity * sizeof(sim_frame_t));
+        CHECK_ALLOC(profile->frames, exit(EXIT_FAILURE));
+    }
+    sim_frame_t* frame = &profile->frames[profile->frame_count];
+    frame->parent = parent;
+    frame->entry = entry;
+    frame->first_child = 0;
+    frame->next_sibling = 0;
+    frame->self = 0;
+    if (profile->frame_count > 0) {
+        frame->next_sibling = profile->frames[parent].first_child;
+        profile->frames[parent].first_child = (uint32_t)profile->frame_count;
+    }
+    return (uint32_t)profile->frame_count++;
+}
+
+static inline void sim_profile_init(sim_profile_t* profile, const sim_t* sim) {
+    memset(profile, 0, sizeof(*profile));
+    profile->counts = (uint64_t *)calloc(sim->op_count, sizeof(uint64_t));
+    profile->taken = (uint64_t *)calloc(sim->op_count, sizeof(uint64_t));
+    CHECK_ALLOC(profile->counts, exit(EXIT_FAILURE));
+    CHECK_ALLOC(profile->taken, exit(EXIT_FAILURE));
+    sim_profile_frame(profile, 0, 0);
+}
+
+static inline void sim_profile_free(sim_profile_t* profile) {
+    free(profile->counts);
+    free(profile->taken);
+    free(profile->frames);
+    memset(profile, 0, sizeof(*profile));
+}
+
+// chamada: o que rodou até aqui é do frame atual, e o caminho desce para o filho 'entry'
+static inline void sim_profile_call(sim_profile_t* profile, uint32_t entry, uint64_t steps) {
+    profile->frames[profile->current].self += steps - profile->mark;
+    profile->mark = steps;
+
+    uint32_t child = profile->frames[profile->current].first_child;
+    while (child && profile->frames[child].entry != entry)
+        child = profile->frames[child].next_sibling;
+    profile->current = child ? child : sim_profile_frame(profile, profile->current, entry);
+}
+
+// retorno (ou fim da simulação): fecha a conta do frame atual e sobe um nivel
+static inline void sim_profile_return(sim_profile_t* profile, uint64_t steps) {
+    profile->frames[profile->current].self += steps - profile->mark;
+    profile->mark = steps;
+    if (profile->current != 0)
+        profile->current = profile->frames[profile->current].parent;
+}
+
+// o laço do interpretador (sim_loop.inc). 'max_steps' = 0 é sem limite
+static inline sim_result_t sim_run(sim_t* sim, uint64_t max_steps) {
+#define SIM_PROFILE 0
+#include "sim_loop.inc"
+#undef SIM_PROFILE
+}
+
+// igual ao sim_run, contando execuções, desvios tomados e a arvore de chamadas em sim->profile
+static inline sim_result_t sim_run_profiled(sim_t* sim, uint64_t max_steps) {
+#define SIM_PROFILE 1
+#include "sim_loop.inc"
+#undef SIM_PROFILE
+}
+
+// relatorio: motivo da parada, desempenho e os registradores que não estão zerados
+static inline void sim_report(const sim_t* sim, const sim_result_t* result, FILE* out) {
+    fprintf(out, "simulacao: parou em %s (pc 0x%08x)", sim_halt_name(result->reason), result->pc);
+    if (result->reason == SIM_HALT_BAD_JUMP || result->reason == SIM_HALT_LOAD_FAULT ||
+        result->reason == SIM_HALT_STORE_FAULT)
+        fprintf(out, ", endereco 0x%08x", result->address);
+    if (result->reason == SIM_HALT_ECALL)
+        fprintf(out, ", a7 = %d", (int32_t)sim->x[17]);
+    fprintf(out, "\n");
+
+    double mips = result->seconds > 0 ? (double)result->instructions / result->seconds / 1e6 : 0.0;
+    fprintf(out, "  %llu instrucao(oes) em %.3f s (%.1f MIPS)\n",
+            (unsigned long long)result->instructions, result->seconds, mips);
+
+    for (int r = 1; r < 32; r++)
+        if (sim->x[r] != 0)
+            fprintf(out, "  %-4s = 0x%08x  (%d)\n", reg_abi_names[r], sim->x[r], (int32_t)sim->x[r]);
+}
+
+#endif
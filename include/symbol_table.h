@@ -12,6 +12,12 @@ static inline void symbol_table_init(symbol_table_t* table) {
     table->capacity = ST_INITIAL_CAPACITY;
     table->entries = (symbol_t *)malloc(sizeof(symbol_t) * table->capacity);
     CHECK_ALLOC(table->entries, exit(EXIT_FAILURE));
+    table->index_capacity = ST_INITIAL_CAPACITY * 2;
+    table->index = (uint32_t *)calloc(table->index_capacity, sizeof(uint32_t));
+    CHECK_ALLOC(table->index, exit(EXIT_FAILURE));
+    table->numeric = NULL;
+    table->numeric_count = 0;
+    table->numeric_capacity = 0;
 }
 
 // libera memoria da tabela
@@ -19,17 +25,52 @@ static inline void symbol_table_free(symbol_table_t* table) {
     for (size_t i = 0; i < table->count; ++i)
         free(table->entries[i].label);
     free(table->entries);
+    free(table->index);
+    for (size_t i = 0; i < table->numeric_count; ++i)
+        free(table->numeric[i].defs);
+    free(table->numeric);
 }
 
-// adiciona uma nova label com endereço
-static inline void symbol_table_add(symbol_table_t* table, const char* label, uint32_t address) {
-    // verifica se já existe
-    for (size_t i = 0; i < table->count; ++i) {
-        if (strcmp(table->entries[i].label, label) == 0) {
-            fprintf(stderr, "symbol '%s' already defined\n", label);
-            exit(EXIT_FAILURE);
-        }
+// FNV-1a (o --serve e o layout procuram label o tempo todo, busca linear ficava quadratica)
+static inline uint32_t symbol_table_hash(const char* label) {
+    uint32_t h = 2166136261u;
+    for (; *label; label++) {
+        h ^= (uint8_t)*label;
+        h *= 16777619u;
     }
+    return h;
+}
+
+// posição no indice onde a label está ou onde ela entraria
+static inline size_t symbol_table_slot(const symbol_table_t* table, const char* label) {
+    size_t mask = table->index_capacity - 1;
+    size_t slot = symbol_table_hash(label) & mask;
+    while (table->index[slot] != 0 && strcmp(table->entries[table->index[slot] - 1].label, label) != 0)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static inline void symbol_table_reindex(symbol_table_t* table) {
+    free(table->index);
+    table->index = (uint32_t *)calloc(table->index_capacity, sizeof(uint32_t));
+    CHECK_ALLOC(table->index, exit(EXIT_FAILURE));
+    for (size_t i = 0; i < table->count; ++i)
+        table->index[symbol_table_slot(table, table->entries[i].label)] = (uint32_t)i + 1;
+}
+
+// entrada da label, NULL se não existe
+static inline symbol_t* symbol_table_find(const symbol_table_t* table, const char* label) {
+    uint32_t i = table->index[symbol_table_slot(table, label)];
+    return i ? &table->entries[i - 1] : NULL;
+}
+
+// adiciona uma nova label com endereço.
+// retorna false se ela já existe (quem chama reporta, com a linha)
+static inline bool symbol_table_add(symbol_table_t* table, const char* label, uint32_t address) {
+    // verifica se já existe
+    size_t slot = symbol_table_slot(table, label);
+    if (table->index[slot] != 0)
+        return false;
 
     if (table->count >= table->capacity) {
         table->capacity *= 2;
@@ -40,16 +81,200 @@ static inline void symbol_table_add(symbol_table_t* table, const char* label, ui
 
     table->entries[table->count].label = my_strdup(label);
     table->entries[table->count].address = address;
-    table->count++;
+    table->entries[table->count].binding = SYM_LOCAL;
+    table->entries[table->count].line = 0;
+    table->entries[table->count].pcrel_hi = NULL;
+    table->index[slot] = (uint32_t)++table->count;
+
+    if (table->count * 2 > table->index_capacity) {
+        table->index_capacity *= 2;
+        symbol_table_reindex(table);
+    }
+    return true;
+}
+
+// marca um simbolo como global (.globl). retorna 0 se o simbolo não existe (fica como externo)
+static inline int symbol_table_mark_global(symbol_table_t* table, const char* label) {
+    symbol_t* sym = symbol_table_find(table, label);
+    if (!sym)
+        return 0;
+    sym->binding = SYM_GLOBAL;
+    return 1;
+}
+
+// ---- labels numericas (estilo gnu as) ----
+// `1:` pode ser definida quantas vezes quiser; `1b` é a ultima definição antes (ou na mesma linha)
+// e `1f` a primeira depois. elas não entram no hash: cada numero tem o vetor das suas definições
+// na ordem do fonte, e a referencia é uma busca binaria pela linha de quem usa
+
+// label so com digitos (`1`, `42`)
+static inline bool label_is_numeric(const char* label, uint32_t* number) {
+    uint64_t n = 0;
+    const char* p = label;
+    for (; isdigit((unsigned char)*p); p++) {
+        n = n * 10 + (uint64_t)(*p - '0');
+        if (n > UINT32_MAX) return false;
+    }
+    if (p == label || *p != '\0') return false;
+    *number = (uint32_t)n;
+    return true;
 }
 
-// busca uma label, retorna o endereço. Se não encontrar, retorna -1 (0xFFFFFFFF)
-static inline int32_t symbol_table_lookup(const symbol_table_t* table, const char* label) {
-    for (size_t i = 0; i < table->count; ++i) {
-        if (strcmp(table->entries[i].label, label) == 0)
-            return table->entries[i].address;
+// referencia `1b`/`1f`. 'forward' diz a direção
+static inline bool label_numeric_ref(const char* name, uint32_t* number, bool* forward) {
+    size_t len = strlen(name);
+    if (len < 2 || (name[len - 1] != 'b' && name[len - 1] != 'f')) return false;
+    char digits[16];
+    if (len - 1 >= sizeof(digits)) return false;
+    memcpy(digits, name, len - 1);
+    digits[len - 1] = '\0';
+    if (!label_is_numeric(digits, number)) return false;
+    *forward = name[len - 1] == 'f';
+    return true;
+}
+
+// posição do numero no vetor (ou onde ele entraria)
+static inline size_t numeric_label_slot(const symbol_table_t* table, uint32_t number) {
+    size_t lo = 0, hi = table->numeric_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (table->numeric[mid].number < number) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// adiciona uma definição de 'number' (o layout chama na ordem dos itens). devolve o simbolo
+// para quem chama preencher seção e pcrel_hi
+static inline symbol_t* symbol_table_add_numeric(symbol_table_t* table, uint32_t number, uint32_t line, uint32_t address) {
+    size_t slot = numeric_label_slot(table, number);
+    if (slot == table->numeric_count || table->numeric[slot].number != number) {
+        if (table->numeric_count >= table->numeric_capacity) {
+            table->numeric_capacity = table->numeric_capacity ? table->numeric_capacity * 2 : ST_INITIAL_CAPACITY;
+            numeric_label_t* grown = (numeric_label_t *)realloc(table->numeric, table->numeric_capacity * sizeof(numeric_label_t));
+            CHECK_ALLOC(grown, exit(EXIT_FAILURE));
+            table->numeric = grown;
+        }
+        memmove(&table->numeric[slot + 1], &table->numeric[slot], (table->numeric_count - slot) * sizeof(numeric_label_t));
+        table->numeric_count++;
+        numeric_label_t fresh = {number, NULL, 0, 0};
+        table->numeric[slot] = fresh;
     }
-    return -1;  // (talvez fazer códigos especiais de erro, mas isso dai vai ficar para o yago do futuro)
+
+    numeric_label_t* label = &table->numeric[slot];
+    if (label->count >= label->capacity) {
+        label->capacity = label->capacity ? label->capacity * 2 : ST_INITIAL_CAPACITY;
+        numeric_def_t* grown = (numeric_def_t *)realloc(label->defs, label->capacity * sizeof(numeric_def_t));
+        CHECK_ALLOC(grown, exit(EXIT_FAILURE));
+        label->defs = grown;
+    }
+    // o --schedule pode trocar a ordem dos itens: mantem o vetor ordenado pela linha
+    size_t at = label->count;
+    while (at > 0 && label->defs[at - 1].line > line) {
+        label->defs[at] = label->defs[at - 1];
+        at--;
+    }
+    numeric_def_t def = {line, {NULL, address, SYM_LOCAL, SECTION_TEXT, line, NULL}};
+    label->defs[at] = def;
+    label->count++;
+    return &label->defs[at].symbol;
+}
+
+// definição que `number` + direção enxerga da linha 'line'. 'ordinal' (se != NULL) recebe a
+// posição dela entre as definições do numero, começando em 1 (é o nome dela no objeto)
+static inline const symbol_t* numeric_label_find(const symbol_table_t* table, uint32_t number, bool forward,
+                                                 uint32_t line, uint32_t* ordinal) {
+    size_t slot = numeric_label_slot(table, number);
+    if (slot == table->numeric_count || table->numeric[slot].number != number) return NULL;
+    const numeric_label_t* label = &table->numeric[slot];
+
+    // primeira definição com linha > 'line'
+    size_t lo = 0, hi = label->count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (label->defs[mid].line <= line) lo = mid + 1;
+        else hi = mid;
+    }
+    size_t found;
+    if (forward) {
+        if (lo == label->count) return NULL;
+        found = lo;
+    } else {
+        if (lo == 0) return NULL;
+        found = lo - 1;
+    }
+    if (ordinal) *ordinal = (uint32_t)found + 1;
+    return &label->defs[found].symbol;
+}
+
+// nome da definição no objeto relocavel (o mesmo formato que o gnu as usa: numero, ^B, ordinal)
+static inline void numeric_label_name(uint32_t number, uint32_t ordinal, char* out, size_t size) {
+    snprintf(out, size, ".L%u^B%u", number, ordinal);
+}
+
+// o inverso, para o objeto achar a definição de uma relocação. NULL se não é esse formato
+static inline const symbol_t* numeric_label_by_name(const symbol_table_t* table, const char* name) {
+    unsigned number, ordinal;
+    int consumed = 0;
+    if (sscanf(name, ".L%u^B%u%n", &number, &ordinal, &consumed) != 2 || name[consumed] != '\0' || ordinal == 0)
+        return NULL;
+    size_t slot = numeric_label_slot(table, number);
+    if (slot == table->numeric_count || table->numeric[slot].number != number) return NULL;
+    if (ordinal > table->numeric[slot].count) return NULL;
+    return &table->numeric[slot].defs[ordinal - 1].symbol;
+}
+
+// simbolo que 'name' usado na linha 'line' enxerga: label normal ou referencia `1b`/`1f`
+static inline const symbol_t* symbol_table_resolve(const symbol_table_t* table, const char* name, uint32_t line) {
+    uint32_t number;
+    bool forward;
+    if (label_numeric_ref(name, &number, &forward))
+        return numeric_label_find(table, number, forward, line, NULL);
+    return symbol_table_find(table, name);
+}
+
+// labels do .text ordenadas por endereço, para achar "de qual função é esse pc"
+typedef struct {
+    uint32_t address;
+    const char* name;        // aponta para a tabela, não é copia
+} text_label_t;
+
+static inline int text_label_cmp(const void* a, const void* b) {
+    const text_label_t* la = (const text_label_t *)a;
+    const text_label_t* lb = (const text_label_t *)b;
+    return (la->address > lb->address) - (la->address < lb->address);
+}
+
+static inline text_label_t* symbol_table_text_labels(const symbol_table_t* table, size_t* count) {
+    text_label_t* labels = (text_label_t *)malloc((table->count ? table->count : 1) * sizeof(text_label_t));
+    CHECK_ALLOC(labels, exit(EXIT_FAILURE));
+    *count = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        if (table->entries[i].section != SECTION_TEXT) continue;
+        labels[*count].address = table->entries[i].address;
+        labels[*count].name = table->entries[i].label;
+        (*count)++;
+    }
+    qsort(labels, *count, sizeof(text_label_t), text_label_cmp);
+    return labels;
+}
+
+// label mais proxima em ou antes de 'pc' (busca binaria). -1 se o pc vem antes de todas
+static inline long text_label_find(const text_label_t* labels, size_t count, uint32_t pc) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (labels[mid].address <= pc) lo = mid + 1;
+        else hi = mid;
+    }
+    return (long)lo - 1;
+}
+
+// "label+off" (ou o endereço se não tem label antes)
+static inline void text_label_location(const text_label_t* labels, size_t count, uint32_t pc, char* out, size_t size) {
+    long l = text_label_find(labels, count, pc);
+    if (l < 0) snprintf(out, size, "0x%08x", pc);
+    else snprintf(out, size, "%s+%u", labels[l].name, pc - labels[l].address);
 }
 
 // debug: imprime todos os símbolos
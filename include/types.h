@@ -9,6 +9,31 @@
 
 #define SOURCE_LINE_MAX 256
 #define BASE_ADDRESS 0x00400000
+#define DATA_BASE_ADDRESS 0x10010000 // mesmo inicio do .data do rars
+
+// seções do programa, cada uma com seu location counter
+typedef enum {
+    SECTION_TEXT,
+    SECTION_DATA,
+    SECTION_COUNT
+} SECTION_ID;
+
+// o que cada item do programa parseado representa
+typedef enum {
+    ITEM_INSTRUCTION,        // instrução de 32 bits
+    ITEM_DATA,               // .word/.half/.byte (um valor por item)
+    ITEM_SPACE,              // .space/.zero (bytes zerados)
+    ITEM_ALIGN,              // .align/.balign (padding)
+    ITEM_ORG,                // .org (pula até o endereço)
+    ITEM_SECTION,            // .text/.data (troca de seção)
+    ITEM_GLOBAL,             // .globl
+    ITEM_LABEL               // label sozinha no fim do arquivo
+} ITEM_KIND;
+
+// flags de cada item
+#define ITEM_FLAG_RVC        0x01   // pode ficar em endereço multiplo de 2 (modo compressão ligado)
+#define ITEM_FLAG_COMPRESSED 0x02   // codificada em 16 bits (RV32C)
+#define ITEM_FLAG_NO_RVC     0x04   // não tentar comprimir de novo
 
 // enum para o tipo da instrução
 typedef enum {
@@ -18,27 +43,80 @@ typedef enum {
     INST_INVALID
 } INST_TYPE;
 
+// sintaxe dos operandos (o tipo diz onde os campos vão, o formato diz como ler a linha)
+typedef enum {
+    FMT_R,                   // rd, rs1, rs2
+    FMT_I,                   // rd, rs1, imm
+    FMT_SHIFT,               // rd, rs1, shamt
+    FMT_LOAD,                // rd, imm(rs1)
+    FMT_JALR,                // rd, imm(rs1) | rd, rs1, imm | rs1
+    FMT_STORE,               // rs2, imm(rs1)
+    FMT_BRANCH,              // rs1, rs2, label
+    FMT_U,                   // rd, imm20
+    FMT_JAL,                 // rd, label | label
+    FMT_FENCE,               // [pred, succ]
+    FMT_SYSTEM               // sem operandos (ecall/ebreak)
+} INST_FORMAT;
+
+// binding do simbolo (só importa quando gera objeto relocavel)
+typedef enum {
+    SYM_LOCAL,
+    SYM_GLOBAL
+} SYM_BINDING;
+
 // para a tablela de simbolos (nao sei se vou fazer usando a tabela)
 typedef struct {
     char* label;
     uint32_t address;
+    uint8_t binding;         // SYM_LOCAL ou SYM_GLOBAL (.globl)
+    uint8_t section;         // SECTION_ID onde a label foi definida
+    uint32_t line;           // linha (do fonte expandido) onde foi definida, 0 se não veio do fonte
+    const struct expr* pcrel_hi; // label de um `auipc rd, %pcrel_hi(x)`: a expressão do auipc (do item)
 } symbol_t;
 
+// definição de uma label numerica (`1:`), na ordem do fonte
+typedef struct {
+    uint32_t line;           // linha do item que recebeu a label
+    symbol_t symbol;         // 'label' fica NULL, o nome é o numero
+} numeric_def_t;
+
+// todas as definições de um numero, ordenadas por linha (busca binaria para o 1b/1f)
+typedef struct {
+    uint32_t number;
+    numeric_def_t* defs;
+    size_t count;
+    size_t capacity;
+} numeric_label_t;
+
 typedef struct {
     symbol_t* entries;
     size_t count;
     size_t capacity;
+    uint32_t* index;         // hash nome -> posição + 1 (0 = vazio), sempre com folga de 2x
+    size_t index_capacity;
+    numeric_label_t* numeric; // labels numericas, ordenadas por numero (fora do hash)
+    size_t numeric_count;
+    size_t numeric_capacity;
 } symbol_table_t;
 
 
 // struct parar representar a instrução depois do parser
+// (diretivas de dados/layout também viram itens aqui, com 'kind' diferente)
 typedef struct {
     char *label;             // label associada (ou NULL)
     char mnemonic[8];        // nome da instrução
     char *operands[4];       // até 4 operandos
     int operand_count;       // qt. de operandos
     uint32_t line_number;    // linha no source code
+    uint32_t label_line;     // linha da label, quando ela veio sozinha numa linha antes (0 = line_number)
     uint32_t address;
+    uint8_t kind;            // ITEM_KIND
+    uint8_t section;         // SECTION_ID
+    uint8_t flags;           // ITEM_FLAG_*
+    uint32_t size;           // bytes ocupados na seção
+    uint32_t value;          // parametro da diretiva (alinhamento, destino do .org, seção)
+                             // ou valor codificado depois da segunda passagem
+    struct expr* expr;       // imediato compilado no parse (expr.h), NULL se não tem ou não compilou
 } instruction_t;
 
 // union utilizando bitfields para guardar as instruções 'encoded' 
@@ -100,6 +178,30 @@ typedef union {
     
 } encoded_fields_t;
 
+// tipos de relocação (referencias que só o linker consegue resolver)
+typedef enum {
+    RELOC_BRANCH,            // B-type, offset relativo ao pc (beq/bne)
+    RELOC_JAL,               // J-type, offset relativo ao pc (jal)
+    RELOC_HI20,              // U-type, %hi(simbolo) absoluto
+    RELOC_LO12_I,            // I-type, %lo(simbolo) absoluto
+    RELOC_LO12_S,            // S-type, %lo(simbolo) absoluto
+    RELOC_ABS32              // .word simbolo
+} RELOC_TYPE;
+
+// relocação pendente gerada pelo encoder
+typedef struct {
+    uint32_t address;        // endereço da instrução que vai ser corrigida
+    RELOC_TYPE type;
+    char* symbol;            // nome do simbolo referenciado
+    int32_t addend;
+} relocation_t;
+
+typedef struct {
+    relocation_t* entries;
+    size_t count;
+    size_t capacity;
+} reloc_list_t;
+
 // instrução na forma final
 typedef struct {
     INST_TYPE type;
@@ -6,9 +6,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdbool.h>
 
 #include "types.h"
 
+// strtok_r é posix, no windows o equivalente tem outro nome
+#ifdef _WIN32
+#define strtok_r strtok_s
+#endif
+
+// estado global que precisa ser um por thread (o --serve monta varios programas ao mesmo tempo)
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 // macro para verificar alocações
 #define CHECK_ALLOC(p, action_on_fail)                                                  \
     do {                                                                                \
@@ -47,7 +62,184 @@ static inline char* my_strdup(const char* s) {
 }
 
 
-// le um arquivo e retorna um vetor de strings.
+// ---- literais numericos ----
+// parser proprio em cima de (ptr, len), sem precisar de '\0' no fim nem copiar o token:
+//   decimal (123), hexa (0x7f), binario (0b1010), octal (0o17 ou 017, igual ao strtol),
+//   caractere ('A', '\n', '\x41'), '_' entre digitos (1_000_000) e sinal opcional.
+// o overflow é exato: a magnitude tem que caber em 64 bits sem sinal
+
+typedef enum {
+    NUMBER_OK,
+    NUMBER_INVALID,
+    NUMBER_OVERFLOW
+} NUMBER_STATUS;
+
+static inline int number_digit_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return 99;
+}
+
+// tamanho do literal de caractere que começa em 'p' ('a', '\n', '\x41'), 0 se não é um
+static inline size_t char_literal_len(const char* p) {
+    if (p[0] != '\'') return 0;
+    size_t i = 1;
+    if (p[i] == '\\') {
+        i++;
+        if (p[i] == 'x') {
+            i++;
+            while (number_digit_value(p[i]) < 16) i++;
+        } else if (p[i]) {
+            i++;
+        }
+    } else if (p[i] && p[i] != '\'') {
+        i++;
+    }
+    return p[i] == '\'' ? i + 1 : 0;
+}
+
+// valor do caractere entre as aspas (o literal já foi validado pelo char_literal_len)
+static inline NUMBER_STATUS char_literal_value(const char* p, size_t len, uint64_t* value) {
+    if (len < 3 || len != char_literal_len(p)) return NUMBER_INVALID;
+    if (p[1] != '\\') {
+        *value = (uint8_t)p[1];
+        return NUMBER_OK;
+    }
+    switch (p[2]) {
+        case 'n': *value = '\n'; break;
+        case 't': *value = '\t'; break;
+        case 'r': *value = '\r'; break;
+        case '0': *value = 0; break;
+        case '\\': case '\'': case '"': *value = (uint8_t)p[2]; break;
+        case 'x': {
+            if (len < 6 || len > 7) return NUMBER_INVALID; // '\xN' ou '\xNN'
+            *value = 0;
+            for (size_t i = 3; i + 1 < len; i++) *value = *value * 16 + (uint64_t)number_digit_value(p[i]);
+            break;
+        }
+        default: return NUMBER_INVALID;
+    }
+    return NUMBER_OK;
+}
+
+// literal de 'len' bytes em 'text'. 'magnitude' sai sem o sinal e 'negative' diz se tinha '-'
+static inline NUMBER_STATUS parse_number(const char* text, size_t len, uint64_t* magnitude, bool* negative) {
+    const char* p = text;
+    const char* end = text + len;
+    *negative = false;
+    *magnitude = 0;
+    if (p < end && (*p == '-' || *p == '+')) *negative = *p++ == '-';
+    if (p == end) return NUMBER_INVALID;
+    if (*p == '\'') return char_literal_value(p, (size_t)(end - p), magnitude);
+
+    unsigned base = 10;
+    if (end - p >= 2 && p[0] == '0') {
+        char prefix = (char)(p[1] | 0x20);
+        if (prefix == 'x') base = 16;
+        else if (prefix == 'b') base = 2;
+        else if (prefix == 'o') base = 8;
+        if (base != 10) p += 2;
+        else base = 8; // 017 é octal, igual ao strtol com base 0
+    }
+    if (p == end) return NUMBER_INVALID;
+
+    // caminho comum: até 19 digitos decimais sem '_' não tem como estourar
+    uint64_t value = 0;
+    if (base == 10 && end - p <= 19) {
+        const char* q = p;
+        for (; q < end; q++) {
+            unsigned digit = (unsigned)(*q - '0');
+            if (digit >= 10) break;
+            value = value * 10 + digit;
+        }
+        if (q == end) {
+            *magnitude = value;
+            return NUMBER_OK;
+        }
+        value = 0;
+    }
+
+    const uint64_t limit = UINT64_MAX / base;
+    const unsigned last = (unsigned)(UINT64_MAX % base);
+    for (const char* q = p; q < end; q++) {
+        if (*q == '_') {
+            // só entre dois digitos
+            if (q == p || q + 1 == end || q[1] == '_') return NUMBER_INVALID;
+            continue;
+        }
+        unsigned digit = (unsigned)number_digit_value(*q);
+        if (digit >= base) return NUMBER_INVALID;
+        if (value > limit || (value == limit && digit > last)) return NUMBER_OVERFLOW;
+        value = value * base + digit;
+    }
+    *magnitude = value;
+    return NUMBER_OK;
+}
+
+// converte uma string de imediato para int32_t. aceita de INT32_MIN até UINT32_MAX
+// (0xFFFFFFFF vira -1), o que passar disso não é um imediato valido
+static inline int32_t parse_immediate(const char* imm_str, bool* success) {
+    *success = false;
+    if (imm_str == NULL) return 0;
+    uint64_t magnitude;
+    bool negative;
+    if (parse_number(imm_str, strlen(imm_str), &magnitude, &negative) != NUMBER_OK) return 0;
+    if (magnitude > (negative ? (uint64_t)INT32_MAX + 1 : (uint64_t)UINT32_MAX)) return 0;
+    *success = true;
+    return negative ? (int32_t)(0 - (uint32_t)magnitude) : (int32_t)(uint32_t)magnitude;
+}
+
+// tamanho com sufixo opcional k/m (ex: 64k, 4m), para --mem e os tamanhos de região
+static inline int parse_size(const char* text, uint32_t* out) {
+    char* end;
+    unsigned long long value = strtoull(text, &end, 0);
+    if (end == text) return -1;
+    if (*end == 'k' || *end == 'K') { value <<= 10; end++; }
+    else if (*end == 'm' || *end == 'M') { value <<= 20; end++; }
+    if (*end != '\0' || value > UINT32_MAX) return -1;
+    *out = (uint32_t)value;
+    return 0;
+}
+
+// primeira ocorrencia de 'c' fora de literal de caractere (o '#' de `li a0, '#'` não é comentario)
+static inline char* find_unquoted(char* text, char c) {
+    for (char* p = text; *p; p++) {
+        if (*p == '\'') {
+            size_t quoted = char_literal_len(p);
+            if (quoted) {
+                p += quoted - 1;
+                continue;
+            }
+        }
+        if (*p == c) return p;
+    }
+    return NULL;
+}
+
+// proximo campo separado por 'sep' fora de literal de caractere. igual ao strtok_r
+// (separadores seguidos não geram campo vazio), NULL quando acabou
+static inline char* next_field(char** cursor, char sep) {
+    char* start = *cursor;
+    if (!start) return NULL;
+    while (*start == sep) start++;
+    if (!*start) {
+        *cursor = NULL;
+        return NULL;
+    }
+    char* found = find_unquoted(start, sep);
+    if (found) {
+        *found = '\0';
+        *cursor = found + 1;
+    } else {
+        *cursor = NULL;
+    }
+    return start;
+}
+
+
+// le um arquivo e retorna um vetor de strings, uma por linha do arquivo (vazias e comentarios
+// também, para o indice + 1 ser a linha de verdade nas mensagens). só tira o '\r\n' do fim.
 
 static inline char** read_file_lines(const char* filename, size_t* line_count) {  
     FILE* f = fopen(filename, "rb"); // abrindo para leitura de arquivo binário, pensando na compatibilidade
@@ -62,11 +254,7 @@ static inline char** read_file_lines(const char* filename, size_t* line_count) {
 
     while (fgets(buffer, SOURCE_LINE_MAX, f)) {
         buffer[strcspn(buffer, "\r\n")] = '\0';
-
-        char *line = ltrim(buffer); // tira espaços iniciais nas linhas
-        
-        if (line[0] == '\0' || line[0] == '#') // ignora linhas vazias
-            continue;
+        char *line = buffer;
 
         if (*line_count >= (size_t)max_lines) {
             max_lines = max_lines == 0 ? 8 : max_lines * 2;
@@ -85,6 +273,38 @@ static inline char** read_file_lines(const char* filename, size_t* line_count) {
     return lines;
 }
 
+// igual ao read_file_lines, mas de um texto em memoria ('\n' ou '\r\n', sem precisar de '\0' no fim).
+// linhas maiores que SOURCE_LINE_MAX são cortadas, como o fgets faria. o vetor e o texto das linhas
+// vêm num bloco só (é chamada a cada pedido do --serve, um malloc por linha aparecia no perfil):
+// libera com um free(lines), não com o free_lines
+static inline char** read_text_lines(const char* text, size_t length, size_t* line_count) {
+    size_t max_lines = 1;
+    for (const char* p = text; (p = (const char *)memchr(p, '\n', length - (size_t)(p - text))) != NULL; p++)
+        max_lines++;
+
+    // o texto nunca cresce: cada linha perde o '\n' e ganha o '\0'
+    char** lines = (char **)malloc(max_lines * sizeof(char *) + length + 1);
+    CHECK_ALLOC(lines, return NULL);
+    char* storage = (char *)(lines + max_lines);
+
+    *line_count = 0;
+    for (size_t start = 0; start < length; ) {
+        const char* newline = (const char *)memchr(text + start, '\n', length - start);
+        size_t end = newline ? (size_t)(newline - text) : length;
+        size_t next = end + 1;
+        if (end > start && text[end - 1] == '\r') end--;
+
+        size_t len = end - start;
+        if (len > SOURCE_LINE_MAX - 1) len = SOURCE_LINE_MAX - 1;
+        memcpy(storage, text + start, len);
+        storage[len] = '\0';
+        lines[(*line_count)++] = storage;
+        storage += len + 1;
+        start = next;
+    }
+    return lines;
+}
+
 // libera a memória alocada por read_file_lines().
 static inline void free_lines(char** lines) {
     if (!lines) return;
@@ -0,0 +1,67 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "types.h"
+#include "utils.h"
+#include "disasm.h"
+#include "output.h"
+
+// --verify: compara a imagem recem montada com um mif de referencia (qualquer granularidade,
+// o disasm_load já entende) palavra por palavra. blocos iguais passam direto pelo memcmp, que
+// na libc já compara em vetor; só um bloco com diferença é olhado palavra a palavra.
+// as primeiras 'max_report' diferenças saem com endereço, as duas palavras e o disassembly delas.
+
+#define VERIFY_BLOCK 4096            // bytes por memcmp (multiplo de 4)
+#define VERIFY_DEFAULT_MAX_REPORT 10
+
+static inline void verify_report(out_buffer_t* buf, const disasm_image_t* expected, const disasm_image_t* actual,
+                                 size_t offset, int rvc) {
+    char expected_text[DISASM_LINE_MAX], actual_text[DISASM_LINE_MAX];
+    disasm_at(expected, offset, rvc, expected_text);
+    disasm_at(actual, offset, rvc, actual_text);
+    out_buffer_puts(buf, "  ");
+    out_buffer_hex32(buf, actual->base + (uint32_t)offset);
+    out_buffer_puts(buf, ": esperado ");
+    out_buffer_hex32(buf, disasm_read32(expected, offset));
+    out_buffer_printf(buf, "  %s\n              montado  ", expected_text);
+    out_buffer_hex32(buf, disasm_read32(actual, offset));
+    out_buffer_printf(buf, "  %s\n", actual_text);
+}
+
+// retorna a quantidade de palavras diferentes (as que só existem num dos lados contam também)
+static inline size_t verify_images(const disasm_image_t* expected, const disasm_image_t* actual, const char* golden_name,
+                                   size_t max_report, int rvc, FILE* out) {
+    out_buffer_t buf;
+    out_buffer_init(&buf, out);
+
+    size_t common = (expected->size < actual->size ? expected->size : actual->size) & ~(size_t)3;
+    size_t mismatches = 0;
+    for (size_t block = 0; block < common; block += VERIFY_BLOCK) {
+        size_t length = common - block < VERIFY_BLOCK ? common - block : VERIFY_BLOCK;
+        if (memcmp(expected->bytes + block, actual->bytes + block, length) == 0) continue;
+        for (size_t offset = block; offset < block + length; offset += 4) {
+            if (memcmp(expected->bytes + offset, actual->bytes + offset, 4) == 0) continue;
+            if (mismatches < max_report || max_report == 0)
+                verify_report(&buf, expected, actual, offset, rvc);
+            mismatches++;
+        }
+    }
+
+    size_t expected_words = (expected->size + 3) / 4, actual_words = (actual->size + 3) / 4;
+    size_t extra = expected_words > actual_words ? expected_words - actual_words : actual_words - expected_words;
+    if (max_report > 0 && mismatches > max_report)
+        out_buffer_printf(&buf, "  (mais %zu diferenca(s) nao mostrada(s))\n", mismatches - max_report);
+    if (extra > 0)
+        out_buffer_printf(&buf, "  tamanho diferente: '%s' tem %zu palavra(s), o programa montado %zu.\n",
+                          golden_name, expected_words, actual_words);
+    mismatches += extra;
+
+    if (mismatches == 0)
+        out_buffer_printf(&buf, "verificacao: %zu palavra(s) iguais a '%s'.\n", actual_words, golden_name);
+    else
+        out_buffer_printf(&buf, "verificacao: %zu palavra(s) diferente(s) de '%s'.\n", mismatches, golden_name);
+    out_buffer_free(&buf);
+    return mismatches;
+}
+
+#endif
@@ -1,35 +1,434 @@
 #include "include/utils.h"
 #include "include/parser.h"
+#include "include/preprocess.h"
+#include "include/relax.h"
+#include "include/compress.h"
 #include "include/encoder.h"
 #include "include/symbol_table.h"
 #include "include/encoding_table.h"
+#include "include/output.h"
+#include "include/cli.h"
+#include "include/object.h"
+#include "include/linker.h"
+#include "include/elf_writer.h"
+#include "include/disasm.h"
+#include "include/sim.h"
+#include "include/profile.h"
+#include "include/hazard.h"
+#include "include/schedule.h"
+#include "include/peephole.h"
+#include "include/diag.h"
+#include "include/server.h"
+#include "include/lsp.h"
+
+// --link: carrega os objetos, liga a partir do inicio do .text (BASE_ADDRESS ou o da região)
+// e escreve o mif
+static int run_link(const options_t* opts) {
+    size_t count = (size_t)opts->input_count;
+    object_t* objects = (object_t *)calloc(count, sizeof(object_t));
+    CHECK_ALLOC(objects, return EXIT_FAILURE);
+
+    int status = EXIT_SUCCESS;
+    for (size_t i = 0; i < count; ++i) {
+        if (object_read(opts->inputs[i], &objects[i]) != 0) {
+            fprintf(stderr, "erro: nao foi possivel ler o objeto '%s'.\n", opts->inputs[i]);
+            status = EXIT_FAILURE;
+        }
+    }
 
-// 1 para byte mais significativo primeiro
-// 0 para byte menos significativo primeiro 
-// (quando MIF_OUTPUT_GRANULARITY == 8)
-#define MIF_PRINT_BYTES_BIG_ENDIAN 0
+    link_result_t result = {0};
+    if (status == EXIT_SUCCESS) {
+        uint32_t base = section_base_address(SECTION_TEXT);
+        size_t errors = link_objects(objects, opts->inputs, count, base, &result);
+
+        // com regiões o .text ligado vai para a imagem da região dele, que tem tamanho
+        const memory_layout_t* layout = memory_layout_active;
+        const memory_region_t* region = NULL;
+        char filename[sizeof(opts->output_filename) + REGION_NAME_MAX + 8];
+        snprintf(filename, sizeof(filename), "%s", opts->output_filename);
+        if (layout && layout->section_region[SECTION_TEXT] >= 0) {
+            region = &layout->regions[layout->section_region[SECTION_TEXT]];
+            if (!opts->elf) memory_region_filename(opts->output_filename, region->name, filename, sizeof(filename));
+        }
+        if (errors == 0 && region && (uint64_t)result.word_count * 4 > region->length) {
+            fprintf(stderr, "erro: regiao '%s' estourou: o .text ligado tem %zu bytes, a regiao %u.\n",
+                    region->name, result.word_count * 4, region->length);
+            errors++;
+        }
 
-// 32 para a palavra inteira, 8 para imprimir de 8 em 8 bits
-#define MIF_OUTPUT_GRANULARITY 32 
+        if (errors > 0) {
+            fprintf(stderr, "ligacao falhou com %zu erro(s).\n", errors);
+            status = EXIT_FAILURE;
+        } else if (opts->elf) {
+            if (elf_write_text_executable(result.words, result.word_count, &result.symbols, base, opts->output_filename) != 0) {
+                fprintf(stderr, "erro: nao foi possivel escrever o elf '%s'.\n", opts->output_filename);
+                status = EXIT_FAILURE;
+            }
+        } else if (mif_write_image(result.words, result.word_count, filename) != 0) {
+            fprintf(stderr, "erro: nao foi possivel abrir o arquivo de saida mif '%s'.\n", filename);
+            status = EXIT_FAILURE;
+        }
+        link_result_free(&result);
+    }
 
-int main(int argc, char *argv[]) {
-    if (argc < 2 || argc > 3) {
-        fprintf(stderr, "uso: %s <arquivo_assembly.asm> [arquivo_saida.mif]\n", argv[0]);
+    for (size_t i = 0; i < count; ++i)
+        object_free(&objects[i]);
+    free(objects);
+    return status;
+}
+
+// -d: le um mif ou binario e escreve o assembly (stdout se não passou -o)
+static int run_disasm(const options_t* opts) {
+    disasm_image_t image;
+    if (!disasm_load(opts->input_filename, opts->big_endian, opts->base_address, &image))
+        return EXIT_FAILURE;
+
+    FILE* out = stdout;
+    if (opts->output_filename[0] != '\0' && !(out = fopen(opts->output_filename, "w"))) {
+        fprintf(stderr, "erro: nao foi possivel abrir o arquivo de saida '%s'.\n", opts->output_filename);
+        disasm_image_free(&image);
         return EXIT_FAILURE;
     }
 
-    // arquivos
-    const char* input_filename = argv[1];
-    char output_mif_filename[256];
+    disassemble_image(&image, opts->compress, out);
+
+    if (out != stdout) fclose(out);
+    disasm_image_free(&image);
+    return EXIT_SUCCESS;
+}
+
+// --profile/--profile-stacks: grava os relatorios do perfil
+static void write_profile(const sim_t* sim, const sim_profile_t* profile, const symbol_table_t* table,
+                          const sim_result_t* result, const options_t* opts) {
+    if (opts->profile_filename) {
+        FILE* f = fopen(opts->profile_filename, "w");
+        if (!f) {
+            fprintf(stderr, "erro: nao foi possivel abrir o arquivo de perfil '%s'.\n", opts->profile_filename);
+        } else {
+            profile_write_report(f, sim, profile, table, result);
+            fclose(f);
+        }
+    }
+    if (opts->stacks_filename) {
+        FILE* f = fopen(opts->stacks_filename, "w");
+        if (!f) {
+            fprintf(stderr, "erro: nao foi possivel abrir o arquivo de pilhas '%s'.\n", opts->stacks_filename);
+        } else {
+            profile_write_collapsed(f, sim, profile, table);
+            fclose(f);
+        }
+    }
+}
+
+// --run: monta as imagens das seções a partir dos itens já codificados e executa
+static int run_simulator(const instruction_t* items, size_t count, const symbol_table_t* table, int rvc,
+                         const options_t* opts) {
+    uint32_t text_size, data_size;
+    uint32_t* text_words = section_build_image(items, count, SECTION_TEXT, &text_size);
+    uint32_t* data_words = section_build_image(items, count, SECTION_DATA, &data_size);
+
+    // a imagem de palavras vira bytes little-endian (o formato que o simulador lê)
+    disasm_image_t text;
+    disasm_image_from_words(&text, text_words, text_size, section_base_address(SECTION_TEXT));
+    uint8_t* data = (uint8_t *)malloc(data_size ? data_size : 1);
+    CHECK_ALLOC(data, exit(EXIT_FAILURE));
+    for (uint32_t b = 0; b < data_size; ++b)
+        data[b] = (uint8_t)(data_words[b / 4] >> (8 * (b & 3)));
+    free(text_words);
+    free(data_words);
+
+    int status = EXIT_FAILURE;
+    sim_t sim;
+    uint32_t ram_base = SIM_RAM_BASE, ram_size = opts->sim_memory;
+    if (memory_layout_data_ram(&ram_base, &ram_size) >= 0 &&
+        sim_init(&sim, text, data, section_base_address(SECTION_DATA), data_size, ram_base, ram_size, rvc)) {
+        sim_result_t result;
+        if (opts->profile_filename || opts->stacks_filename) {
+            sim_profile_t profile;
+            sim_profile_init(&profile, &sim);
+            sim.profile = &profile;
+            result = sim_run_profiled(&sim, opts->sim_max_steps);
+            write_profile(&sim, &profile, table, &result, opts);
+            sim_profile_free(&profile);
+        } else {
+            result = sim_run(&sim, opts->sim_max_steps);
+        }
+        sim_report(&sim, &result, stdout);
+        status = sim_halt_ok(result.reason) ? EXIT_SUCCESS : EXIT_FAILURE;
+        sim_free(&sim);
+    }
+    disasm_image_free(&text);
+    free(data);
+    return status;
+}
+
+// peephole, relaxação, escalonamento e compressão, na ordem. retorna NULL (e libera os itens)
+// se alguma delas deu erro de layout. 'report' imprime o resumo de cada uma no stdout
+static instruction_t* run_layout_passes(instruction_t* instructions, size_t* count, symbol_table_t* table,
+                                        const options_t* opts, bool report, int* has_compressed) {
+    *has_compressed = 0;
+
+    // peephole antes de tudo: tirar instruções muda endereços, e a relaxação precisa das distancias finais
+    if (opts->peephole) {
+        peephole_stats_t pstats;
+        if (peephole_program(&instructions, count, table, &pstats) > 0) {
+            free_instructions(instructions, *count);
+            return NULL;
+        }
+        if (report) peephole_report(&pstats);
+    }
+
+    // branches fora do range viram branch invertido + jal (muda endereços, então vem antes de tudo)
+    size_t relaxed_branches = 0;
+    if (relax_branches(&instructions, count, table, &relaxed_branches) > 0) {
+        free_instructions(instructions, *count);
+        return NULL;
+    }
+    if (report && relaxed_branches > 0 && opts->verbose)
+        printf("%zu branch(es) fora do range relaxado(s) para branch invertido + jal.\n", relaxed_branches);
+
+    // escalonamento depois da relaxação (os branches já estão no lugar final) e antes da compressão
+    // (todas as instruções ainda têm 4 bytes, então trocar de lugar não move nenhuma label)
+    if (opts->schedule) {
+        schedule_stats_t sstats;
+        schedule_program(instructions, *count, table, &opts->hazard_model, &sstats);
+        if (report) schedule_report(&sstats);
+    }
 
-    // para o caso que o arquivo é passado como parametro ou nao
-    if (argc == 3) {
-        strncpy(output_mif_filename, argv[2], sizeof(output_mif_filename) - 1);
-        output_mif_filename[sizeof(output_mif_filename) - 1] = '\0';
+    // RV32C depois da relaxação: só encolhe, então os branches relaxados continuam cabendo
+    if (opts->compress) {
+        if (opts->mode == MODE_OBJECT) {
+            fprintf(stderr, "aviso: --compress ignorado com -c (objeto relocavel so tem relocacoes de 32 bits).\n");
+        } else {
+            compress_stats_t cstats;
+            if (compress_program(instructions, *count, table, &cstats) > 0) {
+                free_instructions(instructions, *count);
+                return NULL;
+            }
+            if (report) compress_report(&cstats);
+            *has_compressed = cstats.compressed > 0;
+        }
+    }
+    return instructions;
+}
+
+// --map depois do layout final (os ids do bind_symbols viram as referencias)
+static void write_map(const instruction_t* items, size_t count, const symbol_table_t* table, const options_t* opts) {
+    int to_stdout = strcmp(opts->map_filename, "-") == 0;
+    FILE* map_file = to_stdout ? stdout : fopen(opts->map_filename, "w");
+    if (!map_file) {
+        fprintf(stderr, "erro: nao foi possivel abrir o arquivo de mapa '%s'.\n", opts->map_filename);
+        return;
+    }
+    map_write(items, count, table, opts->input_filename, opts->map_format, map_file);
+    if (!to_stdout) fclose(map_file);
+}
+
+// --verify: a imagem que iria para o mif principal (o .text, ou a região dele com --layout)
+// contra o mif de referencia
+static int run_verify(const instruction_t* items, size_t count, int rvc, const options_t* opts) {
+    disasm_image_t expected;
+    uint32_t base = section_base_address(SECTION_TEXT);
+    if (!disasm_load(opts->verify_filename, opts->big_endian, base, &expected))
+        return EXIT_FAILURE;
+
+    uint32_t size;
+    uint32_t* words;
+    const memory_layout_t* layout = memory_layout_active;
+    if (layout && layout->section_region[SECTION_TEXT] >= 0) {
+        const memory_region_t* region = &layout->regions[layout->section_region[SECTION_TEXT]];
+        words = region_build_image(items, count, region, &size);
+        base = region->origin;
+        expected.base = base;
     } else {
-        strcpy(output_mif_filename, "memoria.mif");
+        words = section_build_image(items, count, SECTION_TEXT, &size);
+    }
+    // o mif sempre completa a ultima palavra
+    disasm_image_t actual;
+    disasm_image_from_words(&actual, words, (size + 3) & ~3u, base);
+    free(words);
+
+    size_t mismatches = verify_images(&expected, &actual, opts->verify_filename, opts->verify_max, rvc, stdout);
+    disasm_image_free(&expected);
+    disasm_image_free(&actual);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// --layout/--region: um mif por região (memoria.mif -> memoria_rom.mif), regiões vazias não geram arquivo
+static int write_region_images(const instruction_t* items, size_t count, const options_t* opts) {
+    const memory_layout_t* layout = memory_layout_active;
+    int status = EXIT_SUCCESS;
+    for (size_t r = 0; r < layout->count; ++r) {
+        uint32_t size;
+        uint32_t* words = region_build_image(items, count, &layout->regions[r], &size);
+        char filename[sizeof(opts->output_filename) + REGION_NAME_MAX + 8];
+        memory_region_filename(opts->output_filename, layout->regions[r].name, filename, sizeof(filename));
+        if (size > 0 && mif_write_image(words, (size + 3) / 4, filename) != 0) {
+            fprintf(stderr, "erro: nao foi possivel abrir o arquivo de saida mif '%s'.\n", filename);
+            status = EXIT_FAILURE;
+        }
+        free(words);
+    }
+    return status;
+}
+
+#ifndef _WIN32
+// segunda passagem sem arquivo nenhum: só deixa o item.value pronto para o section_build_image
+static void encode_program(instruction_t* items, size_t count, const symbol_table_t* table) {
+    for (size_t i = 0; i < count; ++i) {
+        instruction_t* item = &items[i];
+        uint32_t machine_code;
+        bool ok = true;
+        if (item->kind == ITEM_INSTRUCTION) {
+            machine_code = compress_encoded(item, encode_instruction(item, table, item->address));
+            ok = machine_code != ENCODING_ERROR_SENTINEL;
+        } else if (item->kind == ITEM_DATA) {
+            // aqui o sentinela não serve: .word -1 codifica para a mesma palavra
+            machine_code = encode_data_item(item, table, NULL, &ok);
+        } else {
+            continue;
+        }
+        item->value = ok ? machine_code : 0;
+    }
+}
+
+// um pedido do --serve: a primeira linha tem as opções separadas por espaço (compress, peephole,
+// schedule, max-errors=N), o resto é o fonte. a resposta é um objeto json:
+//   {"ok": true, "sections": [{"name", "address", "size", "words": ["00500293", ...]}],
+//    "symbols": [{"name", "address", "section", "global"}], "diagnostics": [...], "errors", ...}
+// com erro as seções e simbolos vêm vazios (mesma regra do mif: nada de saida pela metade)
+static void serve_request(const char* request, size_t length, FILE* response, void* context) {
+    options_t opts = *(const options_t *)context;
+    // cada pedido usa a sua copia do layout: o layout_program ajusta o inicio das seções encadeadas
+    memory_layout_active = opts.layout.count > 0 ? &opts.layout : NULL;
+    const char* newline = memchr(request, '\n', length);
+    size_t header_length = newline ? (size_t)(newline - request) : length;
+    size_t source_offset = newline ? header_length + 1 : length;
+
+    char header[SOURCE_LINE_MAX];
+    if (header_length >= sizeof(header)) header_length = sizeof(header) - 1;
+    memcpy(header, request, header_length);
+    header[header_length] = '\0';
+
+    size_t line_count = 0;
+    char** lines = read_text_lines(request + source_offset, length - source_offset, &line_count);
+    CHECK_ALLOC(lines, exit(EXIT_FAILURE));
+    diag_set_source("<pedido>", lines, line_count);
+
+    char* save;
+    for (char* word = strtok_r(header, " \t\r", &save); word; word = strtok_r(NULL, " \t\r", &save)) {
+        if (strcmp(word, "compress") == 0) opts.compress = 1;
+        else if (strcmp(word, "peephole") == 0) opts.peephole = 1;
+        else if (strcmp(word, "schedule") == 0) opts.schedule = 1;
+        else if (strncmp(word, "max-errors=", 11) == 0) opts.max_errors = (size_t)strtoull(word + 11, NULL, 0);
+        else diag_warning(0, "opcao '%s' desconhecida no pedido.", word);
     }
 
+    symbol_table_t table;
+    symbol_table_init(&table);
+    size_t count = 0;
+    int has_compressed = 0;
+    instruction_t* items = parse_lines(lines, line_count, &count, &table);
+    if (items && diag_error_count() == 0)
+        items = run_layout_passes(items, &count, &table, &opts, false, &has_compressed);
+    if (items) {
+        bind_symbols(items, count, &table, false);
+        memory_layout_check(items, count);
+        encode_program(items, count, &table);
+    }
+
+    // palavras e simbolos são a maior parte da resposta: out_buffer em vez de um fprintf por item
+    bool ok = items && diag_error_count() == 0;
+    out_buffer_t buf;
+    out_buffer_init(&buf, response);
+    out_buffer_printf(&buf, "{\"ok\": %s, \"rvc\": %s, \"sections\": [", ok ? "true" : "false", has_compressed ? "true" : "false");
+    for (int s = 0; ok && s < SECTION_COUNT; ++s) {
+        uint32_t size;
+        uint32_t* words = section_build_image(items, count, (SECTION_ID)s, &size);
+        out_buffer_printf(&buf, "%s\n    {\"name\": \"%s\", \"address\": %u, \"size\": %u, \"words\": [",
+                          s ? "," : "", section_name((SECTION_ID)s), section_base_address((SECTION_ID)s), size);
+        for (uint32_t w = 0; w < (size + 3) / 4; ++w) {
+            out_buffer_puts(&buf, w ? ", \"" : "\"");
+            out_buffer_hex8(&buf, words[w]);
+            out_buffer_putc(&buf, '"');
+        }
+        out_buffer_puts(&buf, "]}");
+        free(words);
+    }
+    out_buffer_puts(&buf, ok ? "\n  ], \"symbols\": [" : "], \"symbols\": [");
+    for (size_t i = 0; ok && i < table.count; ++i) {
+        const symbol_t* sym = &table.entries[i];
+        out_buffer_puts(&buf, i ? ",\n    {\"name\": " : "\n    {\"name\": ");
+        out_buffer_json_string(&buf, sym->label);
+        out_buffer_puts(&buf, ", \"address\": ");
+        out_buffer_udec(&buf, sym->address, 0);
+        out_buffer_puts(&buf, ", \"section\": \"");
+        out_buffer_puts(&buf, section_name((SECTION_ID)sym->section));
+        out_buffer_puts(&buf, sym->binding == SYM_GLOBAL ? "\", \"global\": true}" : "\", \"global\": false}");
+    }
+    out_buffer_puts(&buf, ok && table.count ? "\n  ], " : "], ");
+    out_buffer_free(&buf);
+
+    diag_summary_t summary = diag_prepare(opts.max_errors);
+    diag_write_json_fields(response, &summary);
+    fputs("}\n", response);
+    diag_free();
+
+    if (items) free_instructions(items, count);
+    symbol_table_free(&table);
+    free(lines); // read_text_lines: um bloco só
+    memory_layout_active = NULL;
+}
+
+// --serve: o indice da isa é montado aqui, antes das threads (ele é preguiçoso e não tem trava)
+static int run_server(options_t* opts) {
+    isa_index_build();
+    unsigned threads = opts->server_threads;
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned)cpus : 4;
+    }
+    return server_run(opts->server_path, threads, serve_request, opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    options_t opts;
+    if (parse_options(argc, argv, &opts) != 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // --layout/--region: cada seção sai da região dela (ver regions.h)
+    if (opts.layout.count > 0) memory_layout_active = &opts.layout;
+
+    if (opts.mode == MODE_SERVE) {
+#ifndef _WIN32
+        int status = run_server(&opts);
+#else
+        fprintf(stderr, "erro: --serve precisa de unix domain socket, nao suportado no windows.\n");
+        int status = EXIT_FAILURE;
+#endif
+        free_options(&opts);
+        return status;
+    }
+
+    if (opts.mode == MODE_LSP) {
+        int status = lsp_run(stdin, stdout, opts.verbose);
+        free_options(&opts);
+        return status;
+    }
+
+    if (opts.mode == MODE_LINK || opts.mode == MODE_DISASM) {
+        int status = opts.mode == MODE_LINK ? run_link(&opts) : run_disasm(&opts);
+        free_options(&opts);
+        return status;
+    }
+
+    // arquivos
+    const char* input_filename = opts.input_filename;
+    const char* output_mif_filename = opts.output_filename;
+
     // começo da lógica
 
     size_t line_count = 0;
@@ -38,6 +437,7 @@ int main(int argc, char *argv[]) {
     instruction_t* instructions = NULL;
     size_t instruction_arr_count = 0;
     FILE* mif_file = NULL;
+    FILE* listing_file = NULL;
 
     // lê os arquivos e transforma em um vetor de strings com as linhas
     lines = read_file_lines(input_filename, &line_count);
@@ -46,18 +446,46 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    // .include, .macro, .equ e .if viram linhas comuns antes do parser. o pp guarda de onde
+    // veio cada linha (os erros apontam para o arquivo/linha original) até o fim
+    preprocessor_t pp;
+    preprocess_init(&pp);
+    char** raw_lines = lines;
+    size_t raw_count = line_count;
+    lines = preprocess_lines(&pp, input_filename, raw_lines, raw_count, &line_count);
+    for (size_t i = 0; i < raw_count; ++i)
+        free(raw_lines[i]);
+    free(raw_lines);
+
     // inicializa a estrutura de dados que vai armazenas os simbolos
     symbol_table_init(&sym_table);
 
+    // erros e avisos são juntados até o fim (ver diag.h)
+    diag_set_source(input_filename, lines, line_count);
+    diag_set_origins(pp.origins);
+
     // faz o parser das linhas (talvez eu deveria ter feito um tokenizer, mas n sei bem onde)
     // aqui gera uma lista (vetor) de instruções
     instructions = parse_lines(lines, line_count, &instruction_arr_count, &sym_table);
     
-    // verificação para caso as instruções dê errado 
-    // (talvez trocar essas coisas repetitivas por macros depois)
+    // as passagens que mexem no layout só rodam com o parse limpo; com erro o programa vai direto
+    // para a segunda passagem, que ainda acha os erros de codificação do resto do arquivo
+    int has_compressed = 0;
+    if (instructions && diag_error_count() == 0)
+        instructions = run_layout_passes(instructions, &instruction_arr_count, &sym_table, &opts, true, &has_compressed);
+    // layout final: os simbolos das expressões viram posições na tabela (e os que faltam erro, de uma vez)
+    if (instructions)
+        bind_symbols(instructions, instruction_arr_count, &sym_table, opts.mode == MODE_OBJECT);
+    // regiões que estouraram, todas de uma vez junto com os outros erros
+    if (instructions)
+        memory_layout_check(instructions, instruction_arr_count);
+
     if (!instructions) {
+        diag_flush(stderr, opts.diag_format, opts.max_errors);
+        diag_free();
         fprintf(stderr, "erro durante o parsing das linhas.\n");
         symbol_table_free(&sym_table);
+        preprocess_free(&pp);
         if (lines) {
             for(size_t i=0; i<line_count; ++i) 
                 if(lines[i]) free(lines[i]);
@@ -66,12 +494,53 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    // finalmente abre o mif para a saida em modo de escrita
-    mif_file = fopen(output_mif_filename, "w");
+    // -c: gera o objeto relocavel no lugar do mif
+    if (opts.mode == MODE_OBJECT) {
+        object_t obj;
+        int status = EXIT_SUCCESS;
+        size_t errors = object_build(instructions, instruction_arr_count, &sym_table, &obj);
+        diag_flush(stderr, opts.diag_format, opts.max_errors);
+        if (errors > 0 || diag_error_count() > 0) {
+            fprintf(stderr, "objeto '%s' nao foi gerado.\n", opts.output_filename);
+            if (opts.map_filename) fprintf(stderr, "aviso: --map ignorado, o programa tem erros.\n");
+            status = EXIT_FAILURE;
+        } else if ((opts.elf ? elf_write_relocatable(&obj, opts.output_filename)
+                             : object_write(&obj, opts.output_filename)) != 0) {
+            fprintf(stderr, "erro: nao foi possivel escrever o objeto '%s'.\n", opts.output_filename);
+            status = EXIT_FAILURE;
+        } else if (opts.map_filename) {
+            // no objeto os endereços ainda são os de antes da ligação
+            write_map(instructions, instruction_arr_count, &sym_table, &opts);
+        }
+        object_free(&obj);
+        diag_free();
+
+        for (size_t i = 0; i < line_count; ++i)
+            free(lines[i]);
+        free(lines);
+        free_instructions(instructions, instruction_arr_count);
+        symbol_table_free(&sym_table);
+        preprocess_free(&pp);
+        free_options(&opts);
+        return status;
+    }
+
+    // finalmente abre o mif para a saida em modo de escrita (no modo elf o arquivo é escrito no fim,
+    // no --run não tem arquivo). o mif vai para um .tmp que só vira o arquivo final sem erros
+    // com regiões cada uma vira o seu mif no fim (numa região as seções podem vir fora de ordem)
+    int writes_image = !opts.elf && opts.mode != MODE_RUN && opts.mode != MODE_VERIFY;
+    int writes_regions = writes_image && memory_layout_active;
+    int writes_mif = writes_image && !writes_regions;
+    output_file_t mif_output = {0}, data_mif_output = {0};
+    if (writes_mif)
+        mif_file = output_file_open(&mif_output, output_mif_filename);
 
     // caso dê errado libera tudo
-    if (!mif_file) {
+    if (writes_mif && !mif_file) {
         fprintf(stderr, "erro: nao foi possivel abrir o arquivo de saida mif '%s'.\n", output_mif_filename);
+        output_file_close(&mif_output, false);
+        diag_flush(stderr, opts.diag_format, opts.max_errors);
+        diag_free();
         if (lines) {
             for(size_t i=0; i<line_count; ++i)
                 if(lines[i]) free(lines[i]);
@@ -80,83 +549,174 @@ int main(int argc, char *argv[]) {
         if (instructions)
             free_instructions(instructions, instruction_arr_count);
         symbol_table_free(&sym_table);
+        preprocess_free(&pp);
         return EXIT_FAILURE;
     }
 
-    // print para debug
-    printf("--- iniciando segunda passagem (codificacao) ---\n");
-    printf("endereco   | codigo maq. (hex) | mnemonico\n");
-    printf("--------------------------------------------------\n");
-
-    for (size_t i = 0; i < instruction_arr_count; ++i) {
-        uint32_t current_instr_address = instructions[i].address;
-
-        // faz o encode da instrução que está agora
-        uint32_t machine_code = encode_instruction(&instructions[i], &sym_table, current_instr_address);
-
-        // caso consiga gerar a instrução, faz o print e converte paras jogar no mif
-        if (machine_code != ENCODING_ERROR_SENTINEL) {
-            printf("0x%08x | 0x%08x        | %s\n", current_instr_address, machine_code, instructions[i].mnemonic);
-            
-            char binary_string[33];
-            for (int bit_pos = 0; bit_pos < 32; ++bit_pos) {
-                if ((machine_code >> (31 - bit_pos)) & 1) {
-                    binary_string[bit_pos] = '1';
-                } else {
-                    binary_string[bit_pos] = '0';
-                }
-            }
-            binary_string[32] = '\0';
+    // arquivo de listagem é opcional
+    if (opts.listing_filename) {
+        listing_file = fopen(opts.listing_filename, "w");
+        if (!listing_file)
+            fprintf(stderr, "aviso: nao foi possivel abrir o arquivo de listagem '%s', seguindo sem ele.\n", opts.listing_filename);
+    }
 
-            //ninho de rato com defines para poder verificar respostas no rars
-            #if MIF_OUTPUT_GRANULARITY == 32
+    // toda a saida é formatada em buffers grandes e escrita em blocos,
+    // printf por instrução deixava o terminal como gargalo
+    out_buffer_t listing_buf, table_buf;
+    if (listing_file) {
+        out_buffer_init(&listing_buf, listing_file);
+        listing_write_header(&listing_buf, input_filename);
+    }
+    if (opts.verbose) {
+        out_buffer_init(&table_buf, stdout);
+        table_write_header(&table_buf);
+    }
 
-            fprintf(mif_file, "%s\n", binary_string);
+    // cada seção vai para o seu mif (instruções e dados separados, para cores harvard).
+    // o mif de dados só é criado se o programa tiver .data
+    uint64_t text_end = section_end_address(instructions, instruction_arr_count, SECTION_TEXT);
+    uint64_t data_end = section_end_address(instructions, instruction_arr_count, SECTION_DATA);
+    mif_stream_t section_mif[SECTION_COUNT];
+    FILE* data_mif_file = NULL;
+    if (mif_file) {
+        mif_stream_init(&section_mif[SECTION_TEXT], mif_file, section_base_address(SECTION_TEXT));
+        if (data_end > section_base_address(SECTION_DATA)) {
+            data_mif_file = output_file_open(&data_mif_output, opts.data_output_filename);
+            if (!data_mif_file)
+                fprintf(stderr, "erro: nao foi possivel abrir o arquivo de saida mif '%s'.\n", opts.data_output_filename);
+            else
+                mif_stream_init(&section_mif[SECTION_DATA], data_mif_file, section_base_address(SECTION_DATA));
+        }
+    }
 
-            #elif MIF_OUTPUT_GRANULARITY == 8
-                #if MIF_PRINT_BYTES_BIG_ENDIAN == 1
+    for (size_t i = 0; i < instruction_arr_count; ++i) {
+        instruction_t* item = &instructions[i];
+        uint32_t current_instr_address = item->address;
+        mif_stream_t* ms = NULL;
+        if (item->section == SECTION_TEXT && mif_file) ms = &section_mif[SECTION_TEXT];
+        if (item->section == SECTION_DATA && data_mif_file) ms = &section_mif[SECTION_DATA];
+
+        if (item->kind == ITEM_ALIGN) {
+            if (ms) mif_stream_align(ms, item->address, item->size, item->section == SECTION_TEXT);
+            continue;
+        }
+        if (item->kind != ITEM_INSTRUCTION && item->kind != ITEM_DATA)
+            continue; // .org/.space viram buraco, preenchido quando o proximo item chegar
+
+        uint32_t machine_code;
+        if (item->kind == ITEM_INSTRUCTION) {
+            // faz o encode da instrução que está agora
+            machine_code = encode_instruction(item, &sym_table, current_instr_address);
+            machine_code = compress_encoded(item, machine_code);
+        } else {
+            bool ok;
+            machine_code = encode_data_item(item, &sym_table, NULL, &ok);
+            if (!ok) machine_code = ENCODING_ERROR_SENTINEL;
+        }
 
-            fprintf(mif_file, "%.8s\n", &binary_string[0]);  // MSB byte (bits 31-24)
-            fprintf(mif_file, "%.8s\n", &binary_string[8]);  // Byte 2   (bits 23-16)
-            fprintf(mif_file, "%.8s\n", &binary_string[16]); // Byte 1   (bits 15-8)
-            fprintf(mif_file, "%.8s\n", &binary_string[24]); // LSB byte (bits 7-0)
+        int failed = machine_code == ENCODING_ERROR_SENTINEL && item->kind == ITEM_INSTRUCTION;
+        if (item->kind == ITEM_DATA && machine_code == ENCODING_ERROR_SENTINEL && item->size < 4)
+            failed = 1;
+        item->value = failed ? 0 : machine_code;
 
-                #else // LSB byte primeiro
+        // caso consiga gerar a instrução, converte para jogar no mif
+        if (ms)
+            mif_stream_put(ms, item->address, machine_code, item->size, failed);
 
-            fprintf(mif_file, "%.8s\n", &binary_string[24]); // LSB byte (bits 7-0)
-            fprintf(mif_file, "%.8s\n", &binary_string[16]); // Byte 1   (bits 15-8)
-            fprintf(mif_file, "%.8s\n", &binary_string[8]);  // Byte 2   (bits 23-16)
-            fprintf(mif_file, "%.8s\n", &binary_string[0]);  // MSB byte (bits 31-24)
+        if (listing_file) {
+            uint32_t line_idx = item->line_number - 1;
+            const char* source_line = line_idx < line_count ? ltrim(lines[line_idx]) : NULL;
+            listing_write_entry(&listing_buf, item, machine_code, failed, source_line, &sym_table);
+        }
 
-                #endif
-            #else
+        if (opts.verbose && item->kind == ITEM_INSTRUCTION)
+            table_write_entry(&table_buf, item, machine_code);
+    } 
 
-            fprintf(mif_file, "%s\n", binary_string); 
+    // tudo que deu errado no arquivo inteiro sai aqui, de uma vez
+    size_t errors = diag_error_count();
+    diag_flush(stderr, opts.diag_format, opts.max_errors);
 
-            #endif
+    // analise do pipeline em cima das palavras já codificadas
+    if (opts.hazards_filename) {
+        if (errors > 0) {
+            fprintf(stderr, "aviso: --hazards ignorado, o programa tem instrucoes com erro.\n");
         } else {
-            printf("0x%08x | erro encoding       | %s\n", current_instr_address, instructions[i].mnemonic);
-            
-            #if MIF_OUTPUT_GRANULARITY == 32
-
-            fprintf(mif_file, "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\n");
-
-            #elif MIF_OUTPUT_GRANULARITY == 8
+            int to_stdout = strcmp(opts.hazards_filename, "-") == 0;
+            FILE* hazards_file = to_stdout ? stdout : fopen(opts.hazards_filename, "w");
+            if (!hazards_file) {
+                fprintf(stderr, "erro: nao foi possivel abrir o arquivo de hazards '%s'.\n", opts.hazards_filename);
+            } else {
+                hazard_analyze(instructions, instruction_arr_count, &sym_table, &opts.hazard_model, hazards_file);
+                if (!to_stdout) fclose(hazards_file);
+            }
+        }
+    }
 
-            fprintf(mif_file, "XXXXXXXX\n");
-            fprintf(mif_file, "XXXXXXXX\n");
-            fprintf(mif_file, "XXXXXXXX\n");
-            fprintf(mif_file, "XXXXXXXX\n");
+    if (opts.map_filename) {
+        if (errors > 0) fprintf(stderr, "aviso: --map ignorado, o programa tem instrucoes com erro.\n");
+        else write_map(instructions, instruction_arr_count, &sym_table, &opts);
+    }
 
-            #else
+    int status = EXIT_SUCCESS;
+    if (mif_file) {
+        // mif com palavras XXXX não serve para nada: com erro nenhum arquivo é escrito
+        mif_stream_finish(&section_mif[SECTION_TEXT], text_end);
+        if (data_mif_file)
+            mif_stream_finish(&section_mif[SECTION_DATA], data_end);
+        if (output_file_close(&mif_output, errors == 0) != 0 ||
+            output_file_close(&data_mif_output, errors == 0) != 0) {
+            fprintf(stderr, "erro: nao foi possivel escrever o mif '%s'.\n", output_mif_filename);
+            status = EXIT_FAILURE;
+        }
+        if (errors > 0) {
+            fprintf(stderr, "mif '%s' nao foi gerado.\n", output_mif_filename);
+            status = EXIT_FAILURE;
+        }
+    } else if (errors > 0) {
+        // elf (ou simulação) com palavras invalidas não serve para nada
+        if (opts.mode == MODE_RUN)
+            fprintf(stderr, "programa nao foi executado.\n");
+        else if (opts.mode == MODE_VERIFY)
+            fprintf(stderr, "verificacao contra '%s' nao foi feita.\n", opts.verify_filename);
+        else if (writes_regions)
+            fprintf(stderr, "mifs das regioes de '%s' nao foram gerados.\n", output_mif_filename);
+        else
+            fprintf(stderr, "elf '%s' nao foi gerado.\n", output_mif_filename);
+        status = EXIT_FAILURE;
+    } else if (opts.mode == MODE_RUN) {
+        status = run_simulator(instructions, instruction_arr_count, &sym_table, has_compressed, &opts);
+    } else if (opts.mode == MODE_VERIFY) {
+        status = run_verify(instructions, instruction_arr_count, has_compressed, &opts);
+    } else if (writes_regions) {
+        status = write_region_images(instructions, instruction_arr_count, &opts);
+    } else {
+        elf_region_t regions[SECTION_COUNT];
+        for (int s = 0; s < SECTION_COUNT; ++s) {
+            regions[s].name = section_name((SECTION_ID)s);
+            regions[s].section = (uint8_t)s;
+            regions[s].address = section_base_address((SECTION_ID)s);
+            regions[s].bytes = section_build_image(instructions, instruction_arr_count, (SECTION_ID)s, &regions[s].size);
+            regions[s].executable = s == SECTION_TEXT;
+        }
+        if (elf_write_executable(regions, SECTION_COUNT, &sym_table, section_base_address(SECTION_TEXT),
+                                 has_compressed ? ELF_EF_RISCV_RVC : 0, output_mif_filename) != 0) {
+            fprintf(stderr, "erro: nao foi possivel escrever o elf '%s'.\n", output_mif_filename);
+            status = EXIT_FAILURE;
+        }
+        for (int s = 0; s < SECTION_COUNT; ++s)
+            free((void *)regions[s].bytes);
+    }
 
-            fprintf(mif_file, "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\n");
-            #endif
+    if (listing_file) {
+        out_buffer_free(&listing_buf);
+        fclose(listing_file);
+    }
 
-        }
-    } 
-    printf("--------------------------------------------------\n");
-    fclose(mif_file);
+    if (opts.verbose) {
+        table_write_footer(&table_buf);
+        out_buffer_free(&table_buf);
+    }
 
     // liberando a memoria alocada
     
@@ -169,6 +729,9 @@ int main(int argc, char *argv[]) {
     if (instructions) 
         free_instructions(instructions, instruction_arr_count);
     symbol_table_free(&sym_table);
+    preprocess_free(&pp);
+    diag_free();
+    free_options(&opts);
 
-    return EXIT_SUCCESS;
+    return status;
 }
\ No newline at end of file
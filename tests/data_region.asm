@@ -0,0 +1,12 @@
+.data
+valor: .word 41
+.text
+main:
+    la t0, valor
+    lw a0, 0(t0)
+    addi a0, a0, 1
+    sw a0, 0(t0)
+    addi sp, sp, -16
+    sw a0, 0(sp)
+    lw a1, 0(sp)
+    ebreak
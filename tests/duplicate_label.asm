@@ -0,0 +1,9 @@
+.text
+main:
+    nop
+dup:
+    nop
+dup:
+
+
+    addi a0, a0, 1
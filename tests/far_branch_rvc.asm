@@ -0,0 +1,12 @@
+# branch longe demais com --compress: a relaxação vira "bne a0, zero, 8" + "jal x0, far"
+# e o 8 só continua certo se nenhum dos dois for comprimido
+.text
+main:
+    li a0, 1
+    beq a0, zero, far
+    addi a1, zero, 1000     # 32 bits logo depois do par, o desvio tem que cair aqui
+    ebreak
+    .space 4200
+far:
+    addi a1, zero, -1
+    ebreak
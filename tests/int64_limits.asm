@@ -0,0 +1,5 @@
+.text
+main:
+    li a0, 9223372036854775807 - 9223372036854775806
+    li a1, -9223372036854775808 + 9223372036854775807
+    ebreak
@@ -0,0 +1,3 @@
+.text
+main:
+    li a0, 9223372036854775808
@@ -0,0 +1,6 @@
+.text
+main:
+    ebreak
+.data
+primeiro: .word 1, 2, 3
+ultimo: .word 4
@@ -0,0 +1,43 @@
+#!/bin/sh
+# testes de regressão do montador: compila o main.c num diretorio temporario e roda cada caso.
+# uso: ./tests/run.sh (de qualquer lugar). sai com erro se algum caso falhar
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(dirname "$DIR")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+CC=${CC:-gcc}
+if ! $CC -O2 -o "$TMP/asm" "$ROOT/main.c"; then
+    echo "falhou: compilacao"
+    exit 1
+fi
+
+FAILED=0
+
+# check <nome> <texto esperado na saida> <argumentos do montador...>
+check() {
+    name=$1
+    expected=$2
+    shift 2
+    output=$(cd "$DIR" && "$TMP/asm" "$@" 2>&1)
+    if printf '%s\n' "$output" | grep -qF -- "$expected"; then
+        echo "ok: $name"
+    else
+        echo "falhou: $name (esperado '$expected')"
+        printf '%s\n' "$output" | sed 's/^/    /'
+        FAILED=1
+    fi
+}
+
+check "branch relaxado com --compress" "a1   = 0x000003e8" --run far_branch_rvc.asm --compress
+check "2^63-1 e -2^63 em expressao" "a1   = 0xffffffff" --run int64_limits.asm
+check "2^63 nao cabe" "numero nao cabe em 64 bits" int64_overflow.asm -o "$TMP/x.mif"
+check "2^64-1 nao cabe" "numero nao cabe em 64 bits" uint64_max.asm -o "$TMP/x.mif"
+check "offset de 64 bits no lw" "numero nao cabe em 64 bits" uint64_offset.asm -o "$TMP/x.mif"
+check ".word -1 na listagem" "0x10010000 | 0xffffffff" word_minus_one.asm -o "$TMP/x.mif" -l /dev/stdout
+check "--run com o .data numa regiao" "a1   = 0x0000002a" --run data_region.asm --region rom,0x0,64k,.text --region ram,0x20000000,16k,.data
+check "label repetida na linha dela" "erro (linha 6, coluna 1): label 'dup' ja definida." duplicate_label.asm -o "$TMP/x.mif"
+check "--map no fim do espaco de enderecamento" "0xfffffffc |       4 | .data" map_end.asm -o "$TMP/x.mif" --region rom,0x0,64k,.text --region topo,0xfffffff0,16,.data --map -
+
+exit $FAILED
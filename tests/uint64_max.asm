@@ -0,0 +1,3 @@
+.text
+main:
+    li a0, 18446744073709551615
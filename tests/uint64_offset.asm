@@ -0,0 +1,3 @@
+.text
+main:
+    lw a0, 0xFFFFFFFFFFFFFFFC(sp)
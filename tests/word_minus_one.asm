@@ -0,0 +1,5 @@
+.text
+main:
+    ebreak
+.data
+valor: .word -1